@@ -0,0 +1,34 @@
+// Compare E.* DSP functions against the same operations written as JS loops,
+// on a kilo-sample Int16Array like you'd get from an ADC
+
+var N = 2048;
+var samples = new Int16Array(N);
+for (var i=0;i<N;i++) samples[i] = ((i*37)%1000) - 500;
+var out = new Float32Array(N);
+var coeffs = [0.1,0.2,0.4,0.2,0.1];
+
+function time(name, fn) {
+  var t = getTime();
+  var r = fn();
+  console.log(name+": "+Math.round((getTime()-t)*1000000)/1000+"ms ("+r+")");
+}
+
+time("JS sum", function() { var s=0; for (var i=0;i<N;i++) s+=samples[i]; return s; });
+time("E.sum", function() { return E.sum(samples); });
+time("JS variance", function() { var v=0; for (var i=0;i<N;i++) { var d=samples[i]-10; v+=d*d; } return v; });
+time("E.variance", function() { return E.variance(samples, 10); });
+time("JS min/max", function() { var mn=samples[0],mx=samples[0]; for (var i=1;i<N;i++) { var v=samples[i]; if (v<mn) mn=v; if (v>mx) mx=v; } return mn+","+mx; });
+time("E.minMax", function() { var m=E.minMax(samples); return m.min+","+m.max; });
+time("JS dot", function() { var d=0; for (var i=0;i<N;i++) d+=samples[i]*samples[i]; return d; });
+time("E.dot", function() { return E.dot(samples, samples); });
+time("JS FIR", function() { for (var i=0;i<N;i++) { var v=0; for (var k=0;k<5 && k<=i;k++) v+=coeffs[k]*samples[i-k]; out[i]=v; } return out[N-1]; });
+time("E.FIR", function() { E.FIR(samples, coeffs, out); return out[N-1]; });
+var scaleJS = new Float32Array(N), scaleE = new Float32Array(N);
+for (i=0;i<N;i++) { scaleJS[i] = samples[i]; scaleE[i] = samples[i]; }
+time("JS scale", function() { for (var i=0;i<N;i++) scaleJS[i]=scaleJS[i]*2+1; return scaleJS[N-1]; });
+time("E.scale", function() { E.scale(scaleE, 2, 1); return scaleE[N-1]; });
+// FFT has no JS version here, so compare an Array (iterator path) with a typed array
+var reA = [], reT = new Float64Array(256);
+for (i=0;i<256;i++) { reA.push(samples[i]); reT[i] = samples[i]; }
+time("E.FFT Array", function() { E.FFT(reA); return reA[1]; });
+time("E.FFT Float64Array", function() { E.FFT(reT); return reT[1]; });
@@ -0,0 +1,54 @@
+// Render into ArrayBuffer Graphics - a 128x64 1bpp buffer (like a small mono LCD)
+// and a 320x240 16bpp buffer (like a colour TFT). On builds with USE_LCD_SDL, set SDL
+// to true to also render into a headless SDL surface (written to /tmp/benchmark.ppm)
+
+var SDL = false;
+
+function time(name, fn) {
+  var t = getTime();
+  var r = fn();
+  console.log(name+": "+Math.round((getTime()-t)*1000000)/1000+"ms"+(r===undefined?"":" ("+r+")"));
+}
+
+function bench(g, name, bpp, n) {
+  var w = g.getWidth(), h = g.getHeight();
+  var prefix = name+" "+w+"x"+h+" "+bpp+"bpp ";
+  time(prefix+"clear x"+n, function() { for (var i=0;i<n;i++) g.clear(); });
+  time(prefix+"fillRect x"+n, function() {
+    for (var i=0;i<n;i++) {
+      g.setColor(i);
+      g.fillRect(i%w, (i*7)%h, (i*13)%w, (i*3)%h);
+    }
+  });
+  time(prefix+"drawLine x"+n, function() {
+    for (var i=0;i<n;i++) {
+      g.setColor(i);
+      g.drawLine(i%w, 0, w-1-(i*5)%w, h-1);
+      g.drawLine(0, i%h, w-1, (i*3)%h);
+    }
+  });
+  time(prefix+"drawString x"+n, function() {
+    for (var i=0;i<n;i++) g.drawString("Hello World 123", i%w, (i*6)%h);
+  });
+  var iconData = new Uint8Array(32*32*bpp>>3);
+  for (var i=0;i<iconData.length;i++) iconData[i] = i*7;
+  var icon = { width:32, height:32, bpp:bpp, buffer:iconData.buffer };
+  time(prefix+"drawImage 32x32 x"+n, function() {
+    for (var i=0;i<n;i++) g.drawImage(icon, i%w, (i*3)%h, {transparent:0});
+  });
+  time(prefix+"setPixel 32x32 x"+(n/20), function() {
+    for (var i=0;i<n/20;i++)
+      for (var y=0;y<32;y++)
+        for (var x=0;x<32;x++)
+          g.setPixel(x+i, y, 1);
+  });
+  g.setFontVector(20);
+  time(prefix+"vector drawString x"+(n/10), function() {
+    for (var i=0;i<n/10;i++) g.drawString("Espruino", i%w, (i*6)%h);
+  });
+}
+
+bench(Graphics.createArrayBuffer(128,64,1), "ArrayBuffer", 1, 200);
+bench(Graphics.createArrayBuffer(320,240,16), "ArrayBuffer", 16, 200);
+if (SDL)
+  bench(Graphics.createSDL(320,240,"/tmp/benchmark.ppm"), "SDL", 32, 200);
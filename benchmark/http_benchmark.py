@@ -0,0 +1,203 @@
+#!/usr/bin/python
+
+# This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+#
+# Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# ----------------------------------------------------------------------------------------
+# Benchmark the HTTP server of the Linux build over loopback
+#
+# Starts the espruino binary with a small HTTP server, then hammers it with
+# N concurrent connections (one request per connection, as the server closes
+# after each response) and reports requests/sec, latency and peak memory usage.
+#
+#   python benchmark/http_benchmark.py ./espruino -c 8 -d 10 --request-size 0 --response-size 1024
+# ----------------------------------------------------------------------------------------
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+# The server that runs inside Espruino. %(...)d values are filled in from the command line
+SERVER_JS = """
+var http = require("http");
+var body = "x";
+while (body.length*2 <= %(response_size)d) body = body+body;
+body = body + body.substr(0, %(response_size)d-body.length);
+if (%(response_size)d==0) body = "";
+var peak = 0;
+function sample() {
+  var m = process.memory().usage;
+  if (m>peak) peak = m;
+}
+setInterval(sample, %(sample_ms)d);
+http.createServer(function (req, res) {
+  if (req.url=="/stats") {
+    sample();
+    res.writeHead(200, {'Content-Type': 'application/json'});
+    res.end(JSON.stringify({peak:peak, total:process.memory().total}));
+  } else if (req.url=="/quit") {
+    res.writeHead(200);
+    res.end("bye");
+    setTimeout(quit, 100);
+  } else {
+    // read the whole request body (if any) before responding
+    var length = 0|req.headers["Content-Length"], received = 0;
+    var respond = function() {
+      res.writeHead(200, {'Content-Type': 'text/plain', 'Content-Length': body.length});
+      res.end(body);
+    };
+    if (length==0) respond();
+    else req.on('data', function(d) {
+      received += d.length;
+      if (received>=length) respond();
+    });
+  }
+}).listen(%(port)d);
+"""
+
+def http_request(port, path, body="", timeout=10):
+  """ Make one request on a new connection. Returns (status line, response body) """
+  s = socket.create_connection(("127.0.0.1", port), timeout)
+  try:
+    method = "POST" if body else "GET"
+    req = method+" "+path+" HTTP/1.0\r\nHost: localhost\r\nContent-Length: "+str(len(body))+"\r\n\r\n"+body
+    s.sendall(req.encode("latin-1"))
+    data = b""
+    while True:
+      chunk = s.recv(65536)
+      if not chunk: break
+      data += chunk
+  finally:
+    s.close()
+  data = data.decode("latin-1")
+  headers, _, content = data.partition("\r\n\r\n")
+  return headers.split("\r\n")[0], content
+
+def wait_for_server(port, proc, timeout):
+  endtime = time.time()+timeout
+  while time.time() < endtime:
+    if proc.poll() is not None:
+      return False
+    try:
+      socket.create_connection(("127.0.0.1", port), 1).close()
+      return True
+    except socket.error:
+      time.sleep(0.05)
+  return False
+
+def percentile(values, p):
+  if not values: return 0
+  idx = int(round((len(values)-1) * p / 100.0))
+  return values[idx]
+
+class Worker(threading.Thread):
+  def __init__(self, port, body, response_size, endtime, max_requests):
+    threading.Thread.__init__(self)
+    self.daemon = True
+    self.port = port
+    self.body = body
+    self.response_size = response_size
+    self.endtime = endtime
+    self.max_requests = max_requests
+    self.latencies = []
+    self.errors = 0
+
+  def run(self):
+    while time.time() < self.endtime and (not self.max_requests or len(self.latencies) < self.max_requests):
+      start = time.time()
+      try:
+        status, content = http_request(self.port, "/", self.body)
+        if not status.endswith("200 OK") or len(content)!=self.response_size:
+          self.errors += 1
+          continue
+      except socket.error:
+        self.errors += 1
+        continue
+      self.latencies.append(time.time()-start)
+
+def run_benchmark(args):
+  fd, script = tempfile.mkstemp(suffix=".js")
+  os.write(fd, (SERVER_JS % {
+    "port" : args.port,
+    "response_size" : args.response_size,
+    "sample_ms" : args.sample_ms }).encode("latin-1"))
+  os.close(fd)
+
+  log = open(os.devnull, "w") if not args.verbose else None
+  # stdin is held open, as the Linux build spins if it gets EOF on stdin
+  proc = subprocess.Popen([args.binary, script], stdin=subprocess.PIPE, stdout=log, stderr=log)
+  try:
+    if not wait_for_server(args.port, proc, 10):
+      print("Server didn't start")
+      return 1
+
+    body = "y" * args.request_size
+    endtime = time.time() + args.duration
+    max_requests = (args.requests + args.concurrency - 1) // args.concurrency if args.requests else 0
+    workers = [Worker(args.port, body, args.response_size, endtime, max_requests) for i in range(args.concurrency)]
+    start = time.time()
+    for w in workers: w.start()
+    for w in workers: w.join()
+    elapsed = time.time() - start
+
+    latencies = sorted(l for w in workers for l in w.latencies)
+    errors = sum(w.errors for w in workers)
+    stats = json.loads(http_request(args.port, "/stats")[1])
+    try:
+      http_request(args.port, "/quit")
+    except socket.error:
+      pass
+
+    result = {
+      "concurrency" : args.concurrency,
+      "request_size" : args.request_size,
+      "response_size" : args.response_size,
+      "requests" : len(latencies),
+      "errors" : errors,
+      "requests_per_sec" : round(len(latencies) / elapsed, 1),
+      "latency_p50_ms" : round(percentile(latencies, 50)*1000, 2),
+      "latency_p99_ms" : round(percentile(latencies, 99)*1000, 2),
+      "peak_memory_usage" : stats["peak"],
+      "memory_total" : stats["total"],
+    }
+    if args.json:
+      print(json.dumps(result))
+    else:
+      for k in sorted(result.keys()):
+        print("%-20s %s" % (k, result[k]))
+    return 0 if latencies else 1
+  finally:
+    if proc.poll() is None:
+      time.sleep(0.5)
+      if proc.poll() is None: proc.kill()
+    proc.wait()
+    if log: log.close()
+    os.remove(script)
+
+parser = argparse.ArgumentParser(description="Benchmark the Espruino HTTP server over loopback")
+parser.add_argument("binary", nargs="?", default="./espruino", help="The Linux espruino binary")
+parser.add_argument("-c", "--concurrency", type=int, default=4, help="Number of concurrent connections")
+parser.add_argument("-d", "--duration", type=float, default=5, help="How long to run for (seconds)")
+parser.add_argument("-n", "--requests", type=int, default=0, help="Stop after this many requests (0 = no limit)")
+parser.add_argument("--request-size", type=int, default=0, help="Size of the POST body in bytes (0 = GET)")
+parser.add_argument("--response-size", type=int, default=64, help="Size of the response body in bytes")
+parser.add_argument("--port", type=int, default=8090, help="Port for the server to listen on")
+parser.add_argument("--sample-ms", type=int, default=100, help="How often the server samples memory usage")
+parser.add_argument("--json", action="store_true", help="Output results as one line of JSON")
+parser.add_argument("-v", "--verbose", action="store_true", help="Show the output of espruino")
+
+if __name__ == "__main__":
+  sys.exit(run_benchmark(parser.parse_args()))
@@ -0,0 +1,3 @@
+var s = '[';
+for (i=0;i<100;i++) s = s + (i?',':'') + '{"time":'+i+',"sensor":{"temp":'+(20+i/10)+',"raw":['+i+','+(i*2)+','+(i*3)+']},"ok":true,"name":"dev\\t1"}';
+var log = JSON.parse(s + ']');
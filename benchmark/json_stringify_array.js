@@ -0,0 +1,3 @@
+var log = [];
+for (i=0;i<500;i++) log.push(i*1.5);
+var s = JSON.stringify(log);
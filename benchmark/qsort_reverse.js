@@ -0,0 +1,11 @@
+// Built-in sort on data that is sorted in reverse
+
+var tArray = [], tTyped = new Uint16Array(500);
+for (var i = 0; i < 500; i++) {
+  tArray.push(5000 - i*10);
+  tTyped[i] = 5000 - i*10;
+}
+tArray.sort();
+tTyped.sort();
+for (var i = 0; i < 500; i++) tArray[i] = 5000 - i*10;
+tArray.sort(function (a, b) { return a - b; });
@@ -0,0 +1,10 @@
+// Built-in sort on data that is already sorted (the worst case for a simple quicksort)
+
+var tArray = [], tTyped = new Uint16Array(500);
+for (var i = 0; i < 500; i++) {
+  tArray.push(i*10);
+  tTyped[i] = i*10;
+}
+tArray.sort();
+tTyped.sort();
+tArray.sort(function (a, b) { return a - b; });
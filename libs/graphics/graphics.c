@@ -69,6 +69,29 @@ void graphicsFallbackBitmap1bit(JsGraphics *gfx, short x1, short y1, unsigned sh
   }
 }
 
+void graphicsFallbackBlit(JsGraphics *gfx, short x, short y, unsigned short count, const unsigned int *cols) {
+  // Software emulation - draw runs of the same colour with fillRect
+  unsigned int fgColor = gfx->data.fgColor;
+  unsigned short i = 0;
+  while (i<count) {
+    unsigned short start = i;
+    unsigned int col = cols[i++];
+    while (i<count && cols[i]==col) i++;
+    gfx->data.fgColor = col;
+    gfx->fillRect(gfx, (short)(x+start), y, (short)(x+i-1), y);
+  }
+  gfx->data.fgColor = fgColor;
+}
+
+void graphicsFallbackFlip(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
+  // Nothing to do - pixels are written straight to the display (or buffer)
+  NOT_USED(gfx);
+  NOT_USED(x1);
+  NOT_USED(y1);
+  NOT_USED(x2);
+  NOT_USED(y2);
+}
+
 // ----------------------------------------------------------------------------------------------
 
 bool graphicsGetFromVar(JsGraphics *gfx, JsVar *parent) {
@@ -82,6 +105,8 @@ bool graphicsGetFromVar(JsGraphics *gfx, JsVar *parent) {
     gfx->getPixel = graphicsFallbackGetPixel;
     gfx->fillRect = graphicsFallbackFillRect;
     gfx->bitmap1bit = graphicsFallbackBitmap1bit;
+    gfx->blit = graphicsFallbackBlit;
+    gfx->flip = graphicsFallbackFlip;
 #ifdef USE_LCD_SDL
     if (gfx->data.type == JSGRAPHICSTYPE_SDL) {
       lcdSetCallbacks_SDL(gfx);
@@ -121,9 +146,64 @@ void graphicsSetVar(JsGraphics *gfx) {
 
 // ----------------------------------------------------------------------------------------------
 
+void graphicsSetModified(JsGraphics *gfx, int x1, int y1, int x2, int y2) {
+  if (x1>x2) { int t = x1; x1 = x2; x2 = t; }
+  if (y1>y2) { int t = y1; y1 = y2; y2 = t; }
+  if (x1<0) x1 = 0;
+  if (y1<0) y1 = 0;
+  if (x2>=gfx->data.width) x2 = gfx->data.width-1;
+  if (y2>=gfx->data.height) y2 = gfx->data.height-1;
+  if (x2<x1 || y2<y1) return; // offscreen
+  if (x1 < gfx->data.modMinX) gfx->data.modMinX = (short)x1;
+  if (y1 < gfx->data.modMinY) gfx->data.modMinY = (short)y1;
+  if (x2 > gfx->data.modMaxX) gfx->data.modMaxX = (short)x2;
+  if (y2 > gfx->data.modMaxY) gfx->data.modMaxY = (short)y2;
+}
+
+void graphicsClearModified(JsGraphics *gfx) {
+  gfx->data.modMinX = 32767;
+  gfx->data.modMinY = 32767;
+  gfx->data.modMaxX = -1;
+  gfx->data.modMaxY = -1;
+}
+
+void graphicsSetClipRect(JsGraphics *gfx, int x1, int y1, int x2, int y2) {
+  if (x1>x2) { int t = x1; x1 = x2; x2 = t; }
+  if (y1>y2) { int t = y1; y1 = y2; y2 = t; }
+  if (x1<0) x1 = 0;
+  if (y1<0) y1 = 0;
+  if (x2<-1) x2 = -1; // nothing can be drawn
+  if (y2<-1) y2 = -1;
+  if (x2>32767) x2 = 32767;
+  if (y2>32767) y2 = 32767;
+  gfx->data.clipX1 = (short)x1;
+  gfx->data.clipY1 = (short)y1;
+  gfx->data.clipX2 = (short)x2;
+  gfx->data.clipY2 = (short)y2;
+}
+
+// Get the area we can draw in - the clip rect, limited to the screen
+static inline void graphicsGetClip(JsGraphics *gfx, int *x1, int *y1, int *x2, int *y2) {
+  *x1 = gfx->data.clipX1;
+  *y1 = gfx->data.clipY1;
+  *x2 = gfx->data.clipX2 < gfx->data.width ? gfx->data.clipX2 : gfx->data.width-1;
+  *y2 = gfx->data.clipY2 < gfx->data.height ? gfx->data.clipY2 : gfx->data.height-1;
+}
+
+void graphicsFlip(JsGraphics *gfx) {
+  if (gfx->data.modMaxX >= gfx->data.modMinX)
+    gfx->flip(gfx, gfx->data.modMinX, gfx->data.modMinY, gfx->data.modMaxX, gfx->data.modMaxY);
+  graphicsClearModified(gfx);
+}
+
 void graphicsSetPixel(JsGraphics *gfx, short x, short y, unsigned int col) {
-  if (x<0 || y<0 || x>=gfx->data.width || y>=gfx->data.height) return;
+  if (x<gfx->data.clipX1 || y<gfx->data.clipY1 || x>gfx->data.clipX2 || y>gfx->data.clipY2 ||
+      x>=gfx->data.width || y>=gfx->data.height) return;
   gfx->setPixel(gfx,x,y,col & (unsigned int)((1L<<gfx->data.bpp)-1));
+  if (x < gfx->data.modMinX) gfx->data.modMinX = x;
+  if (y < gfx->data.modMinY) gfx->data.modMinY = y;
+  if (x > gfx->data.modMaxX) gfx->data.modMaxX = x;
+  if (y > gfx->data.modMaxY) gfx->data.modMaxY = y;
 }
 
 unsigned int graphicsGetPixel(JsGraphics *gfx, short x, short y) {
@@ -131,10 +211,19 @@ unsigned int graphicsGetPixel(JsGraphics *gfx, short x, short y) {
 }
 
 void graphicsFillRect(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
-  return gfx->fillRect(gfx, x1, y1, x2, y2);
+  if (x1>x2) { short t = x1; x1 = x2; x2 = t; }
+  if (y1>y2) { short t = y1; y1 = y2; y2 = t; }
+  int cx1, cy1, cx2, cy2;
+  graphicsGetClip(gfx, &cx1, &cy1, &cx2, &cy2);
+  if (x1<cx1) x1 = (short)cx1;
+  if (y1<cy1) y1 = (short)cy1;
+  if (x2>cx2) x2 = (short)cx2;
+  if (y2>cy2) y2 = (short)cy2;
+  if (x1>x2 || y1>y2) return; // clipped out
+  graphicsSetModified(gfx, x1, y1, x2, y2);
+  gfx->fillRect(gfx, x1, y1, x2, y2);
 }
 
-
 void graphicsClear(JsGraphics *gfx) {
   unsigned int c = gfx->data.fgColor;
   gfx->data.fgColor = gfx->data.bgColor;
@@ -153,6 +242,141 @@ void graphicsDrawRect(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
   graphicsFillRect(gfx,x1,y2,x1,y1);
 }
 
+// Get the value of pixel idx (counting row by row) in an image
+static inline unsigned int graphicsImageGetPixel(const JsGraphicsImage *img, size_t idx) {
+  const unsigned char *data = img->data;
+  switch (img->bpp) {
+    case 8: return data[idx];
+    case 16: return (unsigned int)(data[idx*2] | (data[idx*2+1]<<8));
+    case 24: return (unsigned int)(data[idx*3] | (data[idx*3+1]<<8) | (data[idx*3+2]<<16));
+    case 32: return (unsigned int)data[idx*4] | ((unsigned int)data[idx*4+1]<<8) | ((unsigned int)data[idx*4+2]<<16) | ((unsigned int)data[idx*4+3]<<24);
+    default: { // 1, 2 or 4 bpp
+      size_t bit = idx*img->bpp;
+      return (unsigned int)(data[bit>>3] >> (bit&7)) & ((1U<<img->bpp)-1);
+    }
+  }
+}
+
+/* If an image's data isn't in one flat block, it's read through a String iterator. Each row
+ * is read forwards, so we just skip on. To go back (eg. to draw a row again when scaling)
+ * we start again from the block the row started in, rather than the start of the String */
+typedef struct {
+  JsvStringIterator it;
+  size_t pos; ///< the index in img->dataVar that 'it' is at
+  bool markRow; ///< remember the block of the next byte read as the start of a row
+  JsVarRef rowBlock; ///< the block the current row started in (or 0)...
+  size_t rowBlockStart; ///< ...and the index in img->dataVar of its first byte
+} GraphicsImageReader;
+
+static unsigned int graphicsImageReadByte(GraphicsImageReader *r, const JsGraphicsImage *img, size_t idx) {
+  idx += img->dataOffset;
+  if (idx < r->pos || !r->it.var) {
+    JsVar *str;
+    size_t start = 0;
+    if (r->rowBlock && idx >= r->rowBlockStart) {
+      str = jsvLock(r->rowBlock);
+      start = r->rowBlockStart;
+    } else
+      str = jsvLockAgain(img->dataVar);
+    jsvStringIteratorFree(&r->it);
+    jsvStringIteratorNew(&r->it, str, idx-start);
+    jsvUnLock(str);
+    r->it.varIndex += start; // so it's the index in the whole String
+  } else
+    jsvStringIteratorSkip(&r->it, idx - r->pos);
+  r->pos = idx;
+  if (r->markRow && r->it.var) {
+    r->rowBlock = jsvGetRef(r->it.var);
+    r->rowBlockStart = r->it.varIndex;
+    r->markRow = false;
+  }
+  return (unsigned char)jsvStringIteratorGetChar(&r->it);
+}
+
+// graphicsImageGetPixel, for images that are read with a GraphicsImageReader
+static unsigned int graphicsImageReaderGetPixel(GraphicsImageReader *r, const JsGraphicsImage *img, size_t idx) {
+  if (img->bpp < 8) {
+    size_t bit = idx*img->bpp;
+    return (graphicsImageReadByte(r, img, bit>>3) >> (bit&7)) & ((1U<<img->bpp)-1);
+  }
+  size_t b, bytes = img->bpp>>3;
+  unsigned int col = 0;
+  for (b=0;b<bytes;b++)
+    col |= graphicsImageReadByte(r, img, idx*bytes+b) << (b*8);
+  return col;
+}
+
+#define GRAPHICS_IMAGE_CHUNK 32 ///< How many pixels of a row graphicsDrawImage converts at once
+
+void graphicsDrawImage(JsGraphics *gfx, short x, short y, const JsGraphicsImage *img) {
+  int scale = img->scale ? img->scale : 1;
+  int imgWidth = img->rotate90 ? img->height : img->width; // size of the image before scaling, as drawn
+  int imgHeight = img->rotate90 ? img->width : img->height;
+  // clip the area we draw to the screen
+  int cx1, cy1, cx2, cy2;
+  graphicsGetClip(gfx, &cx1, &cy1, &cx2, &cy2);
+  int dx1 = x<cx1 ? cx1-x : 0;
+  int dy1 = y<cy1 ? cy1-y : 0;
+  int dx2 = imgWidth*scale;
+  int dy2 = imgHeight*scale;
+  if (x+dx2 > cx2+1) dx2 = cx2+1-x;
+  if (y+dy2 > cy2+1) dy2 = cy2+1-y;
+  if (dx2<=dx1 || dy2<=dy1) return;
+  graphicsSetModified(gfx, x+dx1, y+dy1, x+dx2-1, y+dy2-1);
+
+  unsigned int mask = (unsigned int)((1L<<gfx->data.bpp)-1);
+  unsigned int cols[GRAPHICS_IMAGE_CHUNK];
+  GraphicsImageReader reader;
+  reader.it.var = 0;
+  reader.pos = 0;
+  reader.rowBlock = 0;
+  reader.rowBlockStart = 0;
+  /* When rotated, a row that's drawn is a column of the image going upwards - so
+   * go through it backwards, which reads the image data forwards */
+  bool backwards = img->rotate90;
+  int chunks = (dx2-dx1+GRAPHICS_IMAGE_CHUNK-1) / GRAPHICS_IMAGE_CHUNK;
+  int dx, dy;
+  for (dy=dy1;dy<dy2;dy++) {
+    int iy = dy/scale;
+    int c;
+    reader.markRow = true;
+    for (c=0;c<chunks;c++) {
+      int chunk = dx1 + (backwards ? chunks-1-c : c)*GRAPHICS_IMAGE_CHUNK;
+      int chunkEnd = chunk+GRAPHICS_IMAGE_CHUNK;
+      if (chunkEnd>dx2) chunkEnd = dx2;
+      // work out the colour of every pixel in this part of the row
+      int i;
+      for (i=0;i<chunkEnd-chunk;i++) {
+        dx = backwards ? chunkEnd-1-i : chunk+i;
+        int ix = dx/scale;
+        size_t idx = img->rotate90 ?
+            (size_t)(iy + (img->height-1-ix)*img->width) :
+            (size_t)(ix + iy*img->width);
+        cols[dx-chunk] = img->data ? graphicsImageGetPixel(img, idx) : graphicsImageReaderGetPixel(&reader, img, idx);
+      }
+      // now draw runs of it - skipping transparent pixels
+      dx = chunk;
+      while (dx<chunkEnd) {
+        if (img->hasTransparent && cols[dx-chunk]==img->transparent) {
+          dx++;
+          continue;
+        }
+        int start = dx;
+        while (dx<chunkEnd && !(img->hasTransparent && cols[dx-chunk]==img->transparent)) {
+          unsigned int col = cols[dx-chunk];
+          if (img->palette) col = img->palette[col];
+          else if (img->bpp==1) col = col ? gfx->data.fgColor : gfx->data.bgColor;
+          cols[dx-chunk] = col & mask;
+          dx++;
+        }
+        gfx->blit(gfx, (short)(x+start), (short)(y+dy), (unsigned short)(dx-start), &cols[start-chunk]);
+      }
+    }
+    if (jspIsInterrupted()) break;
+  }
+  jsvStringIteratorFree(&reader.it);
+}
+
 void graphicsDrawString(JsGraphics *gfx, short x1, short y1, const char *str) {
   while (*str) {
     graphicsDrawChar4x6(gfx,x1,y1,*(str++));
@@ -173,9 +397,13 @@ void graphicsDrawLine(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
     }
     int pos = (y1<<8) + 128; // rounding!
     int step = ((y2-y1)<<8) / xl;
-    short x;
+    // pixels with the same y are drawn as one horizontal span
+    short x, startx = x1;
     for (x=x1;x<=x2;x++) {
-      graphicsSetPixel(gfx, x, (short)(pos>>8), gfx->data.fgColor);
+      if (x==x2 || ((pos+step)>>8)!=(pos>>8)) {
+        graphicsFillRect(gfx, startx, (short)(pos>>8), x, (short)(pos>>8));
+        startx = (short)(x+1);
+      }
       pos += step;
     }
   } else {
@@ -186,149 +414,538 @@ void graphicsDrawLine(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
     }
     int pos = (x1<<8) + 128; // rounding!
     int step = ((x2-x1)<<8) / yl;
-    short y;
+    // pixels with the same x are drawn as one vertical span
+    short y, starty = y1;
     for (y=y1;y<=y2;y++) {
-      graphicsSetPixel(gfx, (short)(pos>>8), y, gfx->data.fgColor);
+      if (y==y2 || ((pos+step)>>8)!=(pos>>8)) {
+        graphicsFillRect(gfx, (short)(pos>>8), starty, (short)(pos>>8), y);
+        starty = (short)(y+1);
+      }
       pos += step;
     }
   }
 }
 
-#ifdef HORIZONTAL_SCANLINE
-static inline void graphicsFillPolyCreateHorizScanLines(JsGraphics *gfx, short *minx, short *maxx, short x1, short y1,short x2, short y2) {
-    if (y2 < y1) {
-        short t;
-        t=x1;x1=x2;x2=t;
-        t=y1;y1=y2;y2=t;
-    }
-    int xh = x1*256;
-    int yl = y2-y1;
-    if (yl==0) yl=1;
-    int stepx = (x2-x1)*256 / yl;
-    short y;
-    for (y=y1;y<=y2;y++) {
-        int x = xh>>8;
-        if (x<-32768) x=-32768;
-        if (x>32767) x=32767;
-        if (y>=0 && y<gfx->data.height) {
-            if (x<minx[y]) {
-                minx[y] = (short)x;
-            }
-            if (x>maxx[y]) {
-                maxx[y] = (short)x;
-            }
-        }
-        xh += stepx;
-    }
+// ----------------------------------------------------------------------------------------------
+// Polygon filling
+
+/* Polygons are filled with an active edge table. Vertices are in 1/16ths of a pixel.
+ *
+ * Normally a vertex at a whole number is the centre of that pixel, and the fill is
+ * inclusive: a pixel is filled if its centre is inside the polygon, or if an edge
+ * passes through it. So thin or zero-width polygons still draw, and small vector
+ * text keeps all its strokes. Polygons that each row crosses at most twice (convex
+ * ones, and all of the vector font's) don't need the edge table for this, so are
+ * filled on their own with the min/max of each row.
+ *
+ * When antialiasing, pixels are 1x1 squares with a vertex at a whole number on their
+ * top-left corner, and each pixel is blended by how much of it is covered.
+ *
+ * If several polygons are filled at once, pixels are filled if they are in any of them
+ * (so overlapping polygons don't cancel each other out, and antialiasing doesn't leave
+ * seams where they touch) */
+
+#define POLY_SUBPIXEL_BITS 4
+#define POLY_SUBPIXEL (1<<POLY_SUBPIXEL_BITS) ///< vertices are in 1/POLY_SUBPIXEL pixels
+#define POLY_AA_SAMPLES 4 ///< scanlines per row of pixels when antialiasing
+#define POLY_MAX_POLYS 32 ///< max polygons that can be filled at once (one bit each)
+
+typedef struct {
+  int yTop, yBottom; ///< scanlines (in subpixels) the edge covers
+  int x1, y1, dx, dy; ///< the edge, in subpixels (dy is always positive, or 0 for horizontal edges)
+  int x; ///< x where the edge crosses the current scanline (16.16 fixed point pixels)
+  int xStep; ///< change in x for each scanline
+  unsigned char poly;
+} GraphicsPolyEdge;
+
+// Mix fg and bg colours - alpha is 0 (bg) to 64 (fg)
+static unsigned int graphicsBlendColor(JsGraphics *gfx, unsigned int fg, unsigned int bg, unsigned int alpha) {
+  unsigned int r,g,b;
+  if (gfx->data.bpp==16) {
+    r = 0xF800; g = 0x07E0; b = 0x001F;
+  } else if (gfx->data.bpp>=24) {
+    r = 0xFF0000; g = 0x00FF00; b = 0x0000FF;
+  } else { // just treat it as an intensity
+    r = (unsigned int)((1L<<gfx->data.bpp)-1); g = 0; b = 0;
+  }
+  unsigned int ia = 64-alpha;
+  return ((((fg&r)*alpha + (bg&r)*ia) >> 6) & r) |
+         ((((fg&g)*alpha + (bg&g)*ia) >> 6) & g) |
+         ((((fg&b)*alpha + (bg&b)*ia) >> 6) & b);
 }
-#else
-static inline void graphicsFillPolyCreateVertScanLines(JsGraphics *gfx, short *miny, short *maxy, short x1, short y1,short x2, short y2) {
-    if (x2 < x1) {
-        short t;
-        t=x1;x1=x2;x2=t;
-        t=y1;y1=y2;y2=t;
-    }
-    int yh = y1*256;
-    int xl = x2-x1;
-    if (xl==0) xl=1;
-    int stepy = (y2-y1)*256 / xl;
-    short x;
-    for (x=x1;x<=x2;x++) {
-        int y = yh>>8;
-        if (y<-32768) y=-32768;
-        if (y>32767) y=32767;
-        if (x>=0 && x<gfx->data.width) {
-            if (y<miny[x]) {
-                miny[x] = (short)y;
-            }
-            if (y>maxy[x]) {
-                maxy[x] = (short)y;
-            }
-        }
-        yh += stepy;
-    }
+
+// Row of pixels that the given subpixel y is in (a shift, so it rounds down for negative numbers too)
+static inline int graphicsPolyRow(int y) {
+  return y >> POLY_SUBPIXEL_BITS;
 }
-#endif
 
-void graphicsFillPoly(JsGraphics *gfx, int points, const short *vertices) {
-#ifdef HORIZONTAL_SCANLINE
-  int i;
-  short miny = gfx->data.height-1;
-  short maxy = 0;
-  for (i=0;i<points*2;i+=2) {
-    short y = vertices[i+1];
+// Pixels whose centres lie between ex1 and ex2 (16.16 fixed point), or if there are none, the one that they're in
+static inline void graphicsPolyEdgePixels(int ex1, int ex2, int *px1, int *px2) {
+  if (ex1>ex2) { int t = ex1; ex1 = ex2; ex2 = t; }
+  *px1 = (ex1 - 32768 + 65535) >> 16;
+  *px2 = (ex2 - 32768) >> 16;
+  if (*px1>*px2) *px1 = *px2 = ((ex1>>1) + (ex2>>1)) >> 16;
+}
+
+// Does each horizontal line cross the polygon at most twice? (true for convex polygons)
+static bool graphicsPolyIsMonotone(int points, const int *vertices) {
+  int i, changes = 0, firstDir = 0, lastDir = 0;
+  for (i=0;i<points;i++) {
+    int j = (i+1<points) ? i+1 : 0;
+    int dir = vertices[j*2+1] - vertices[i*2+1];
+    if (!dir) continue;
+    dir = (dir>0) ? 1 : -1;
+    if (!firstDir) firstDir = dir;
+    else if (dir!=lastDir) changes++;
+    lastDir = dir;
+  }
+  if (lastDir!=firstDir) changes++;
+  return changes<=2;
+}
+
+/* The poly fills keep their tables on the stack, sized by the polygon and the area it covers -
+ * so check there's room first (reporting an error if not) */
+static bool graphicsPolyHasStack(size_t bytes) {
+  if (jsuGetFreeStack() < 256+bytes) {
+    jsError("Not enough free stack to fill polygon");
+    return false;
+  }
+  return true;
+}
+
+/* Fill a polygon that each row crosses at most twice, without antialiasing. Every pixel an edge
+ * passes through is filled, and so is everything between the leftmost and rightmost of them */
+static void graphicsFillMonotonePolySubpixel(JsGraphics *gfx, int points, const int *vertices) {
+  int offset = POLY_SUBPIXEL/2;
+  int i, miny = 0x7FFFFFFF, maxy = -0x7FFFFFFF;
+  for (i=0;i<points;i++) {
+    int y = vertices[i*2+1]+offset;
     if (y<miny) miny=y;
     if (y>maxy) maxy=y;
   }
-  if (miny<0) miny=0;
-  if (maxy>=gfx->data.height) maxy=gfx->data.height-1;
-  short minx[gfx->data.height];
-  short maxx[gfx->data.height];
-  short y;
-  for (y=miny;y<=maxy;y++) {
-    minx[y] = gfx->data.width-1;
-    maxx[y] = 0;
+  int cx1, cy1, cx2, cy2;
+  graphicsGetClip(gfx, &cx1, &cy1, &cx2, &cy2);
+  int firstRow = graphicsPolyRow(miny);
+  int lastRow = graphicsPolyRow(maxy);
+  if (firstRow<cy1) firstRow = cy1;
+  if (lastRow>cy2) lastRow = cy2;
+  if (firstRow>lastRow) return; // offscreen
+  int rows = lastRow+1-firstRow;
+  if (!graphicsPolyHasStack((size_t)rows*2*sizeof(short))) return;
+  short minx[rows], maxx[rows];
+  for (i=0;i<rows;i++) {
+    minx[i] = 32767;
+    maxx[i] = -32768;
   }
-  int j = (points-1)*2;
-  for (i=0;i<points*2;i+=2) {
-    graphicsFillPolyCreateVertScanLines(gfx,minx,maxx, vertices[j+0], vertices[j+1], vertices[i+0], vertices[i+1]);
+  int j = points-1;
+  for (i=0;i<points;i++) {
+    int x1 = vertices[j*2]+offset, y1 = vertices[j*2+1]+offset;
+    int x2 = vertices[i*2]+offset, y2 = vertices[i*2+1]+offset;
     j = i;
+    if (y1>y2) {
+      int t;
+      t=x1;x1=x2;x2=t;
+      t=y1;y1=y2;y2=t;
+    }
+    int r1 = graphicsPolyRow(y1), r2 = graphicsPolyRow(y2);
+    // step x (16.16 fixed point pixels) from the top of each row to the next - not needed if the edge is all in one row
+    int dx = x2-x1, dy = y2-y1, xStep = 0;
+    if (r1<firstRow) r1 = firstRow;
+    else if (r1==r2) dy = 0;
+    if (r2>lastRow) r2 = lastRow;
+    if (r1>r2) continue;
+    if (dy) {
+      if (dx > -32768 && dx < 32768) {
+        xStep = dx * (65536/POLY_SUBPIXEL*POLY_SUBPIXEL) / dy;
+      } else {
+        long long step = (long long)dx * (65536/POLY_SUBPIXEL*POLY_SUBPIXEL) / dy;
+        if (step > 0x3FFFFFFF) step = 0x3FFFFFFF;
+        if (step < -0x3FFFFFFF) step = -0x3FFFFFFF;
+        xStep = (int)step;
+      }
+    }
+    int x = x1 * (65536/POLY_SUBPIXEL) + (int)(((long long)(r1*POLY_SUBPIXEL-y1) * xStep) >> POLY_SUBPIXEL_BITS);
+    int r;
+    for (r=r1;r<=r2;r++) {
+      // where the edge enters and leaves this row
+      int ex1 = (r*POLY_SUBPIXEL < y1) ? x1 * (65536/POLY_SUBPIXEL) : x;
+      x += xStep;
+      int ex2 = ((r+1)*POLY_SUBPIXEL > y2) ? x2 * (65536/POLY_SUBPIXEL) : x;
+      int px1, px2;
+      graphicsPolyEdgePixels(ex1, ex2, &px1, &px2);
+      if (px1<cx1) px1 = cx1;
+      if (px2>cx2) px2 = cx2;
+      if (px1<minx[r-firstRow]) minx[r-firstRow] = (short)px1;
+      if (px2>maxx[r-firstRow]) maxx[r-firstRow] = (short)px2;
+    }
   }
-  for (y=miny;y<=maxy;y++) {
+  // fill each row, merging rows that are the same into one rect
+  int y;
+  for (y=0;y<rows;y++) {
     if (maxx[y]>=minx[y]) {
-      // clip
-      if (minx[y]<0) minx[y]=0;
-      if (maxx[y]>=gfx->data.width) maxx[y]=gfx->data.width-1;
-      // try and expand the rect that we fill
       int oldy = y;
-      while (y<maxy && minx[y+1]==minx[oldy] && maxx[y+1]==maxx[oldy])
+      while (y+1<rows && minx[y+1]==minx[oldy] && maxx[y+1]==maxx[oldy])
         y++;
-      // actually fill
-      graphicsFillRect(gfx,minx[y],oldy,maxx[y],y);
+      graphicsFillRect(gfx, minx[oldy], (short)(firstRow+oldy), maxx[oldy], (short)(firstRow+y));
       if (jspIsInterrupted()) break;
     }
   }
-#else
-  int i;
-  short minx = (short)(gfx->data.width-1);
-  short maxx = 0;
-  for (i=0;i<points*2;i+=2) {
-    short x = vertices[i];
-    if (x<minx) minx=x;
-    if (x>maxx) maxx=x;
+}
+
+// Add the span of pixels x1..x2 to a row (clipped to firstCol..lastCol)
+static inline void graphicsPolyAddSpan(short *spanX1, short *spanX2, int *spanCount, int x1, int x2, int firstCol, int lastCol) {
+  if (x1<firstCol) x1 = firstCol;
+  if (x2>lastCol) x2 = lastCol;
+  if (x1>x2) return;
+  // spans mostly arrive in order, so merge with the last one if we can
+  int n = *spanCount;
+  if (n && x1 <= spanX2[n-1]+1 && x2 >= spanX1[n-1]-1) {
+    if (x1<spanX1[n-1]) spanX1[n-1] = (short)x1;
+    if (x2>spanX2[n-1]) spanX2[n-1] = (short)x2;
+    return;
+  }
+  spanX1[n] = (short)x1;
+  spanX2[n] = (short)x2;
+  *spanCount = n+1;
+}
+
+/* Fill polyCount polygons. polyEnds[i] is the index of the vertex after the last one of
+ * polygon i, and vertices are x,y pairs in subpixels. */
+static void graphicsFillPolysSubpixel(JsGraphics *gfx, int polyCount, const unsigned char *polyEnds, const int *vertices) {
+  if (polyCount<=0) return;
+  if (polyCount>POLY_MAX_POLYS) polyCount = POLY_MAX_POLYS;
+  int points = polyEnds[polyCount-1];
+  bool antialias = (gfx->data.flags & JSGRAPHICSFLAGS_ANTIALIAS) && gfx->data.bpp>=8;
+  int poly, i, start = 0;
+  if (!antialias) {
+    // without antialiasing overlapping polys can be filled one at a time, so use the quicker fill if they all allow it
+    bool monotone = true;
+    for (poly=0;monotone && poly<polyCount;poly++) {
+      monotone = graphicsPolyIsMonotone(polyEnds[poly]-start, &vertices[start*2]);
+      start = polyEnds[poly];
+    }
+    if (monotone) {
+      start = 0;
+      for (poly=0;poly<polyCount;poly++) {
+        graphicsFillMonotonePolySubpixel(gfx, polyEnds[poly]-start, &vertices[start*2]);
+        start = polyEnds[poly];
+        if (jspIsInterrupted()) break;
+      }
+      return;
+    }
+    start = 0;
   }
-  if (minx<0) minx=0;
-  if (maxx>=gfx->data.width) maxx=(short)(gfx->data.width-1);
-  short miny[gfx->data.width];
-  short maxy[gfx->data.width];
-  short x;
-  for (x=minx;x<=maxx;x++) {
-    miny[x] = (short)(gfx->data.height-1);
-    maxy[x] = 0;
+  int samples = antialias ? POLY_AA_SAMPLES : 1;
+  int sampleStep = POLY_SUBPIXEL / samples;
+  // without antialiasing, whole numbers are pixel centres - so move them to the middle of the pixel
+  int offset = antialias ? 0 : POLY_SUBPIXEL/2;
+  // make the edge table
+  if (!graphicsPolyHasStack((size_t)points*sizeof(GraphicsPolyEdge))) return;
+  GraphicsPolyEdge edgeData[points];
+  int edgeCount = 0;
+  int minx = 0x7FFFFFFF, maxx = -0x7FFFFFFF, miny = 0x7FFFFFFF, maxy = -0x7FFFFFFF;
+  for (poly=0;poly<polyCount;poly++) {
+    int end = polyEnds[poly];
+    for (i=start;i<end;i++) {
+      int j = (i+1<end) ? i+1 : start;
+      int x1 = vertices[i*2]+offset, y1 = vertices[i*2+1]+offset;
+      int x2 = vertices[j*2]+offset, y2 = vertices[j*2+1]+offset;
+      if (x1<minx) minx=x1;
+      if (x1>maxx) maxx=x1;
+      if (y1<miny) miny=y1;
+      if (y1>maxy) maxy=y1;
+      if (y1==y2 && antialias) continue; // horizontal edges don't cover any area
+      if (y1>y2) {
+        int t;
+        t=x1;x1=x2;x2=t;
+        t=y1;y1=y2;y2=t;
+      }
+      GraphicsPolyEdge *e = &edgeData[edgeCount];
+      e->x1 = x1;
+      e->y1 = y1;
+      e->dx = x2-x1;
+      e->dy = y2-y1;
+      e->yTop = y1;
+      e->yBottom = y2;
+      e->poly = (unsigned char)poly;
+      e->xStep = 0;
+      if (e->dy) {
+        // avoid 64 bit division unless the edge is really wide
+        int stepScale = 65536 / POLY_SUBPIXEL * sampleStep;
+        if (e->dx > -32768 && e->dx < 32768) {
+          e->xStep = e->dx * stepScale / e->dy;
+        } else {
+          long long step = (long long)e->dx * stepScale / e->dy;
+          // very shallow edges only cover one or two rows, so the step isn't used much - just stop it overflowing
+          if (step > 0x3FFFFFFF) step = 0x3FFFFFFF;
+          if (step < -0x3FFFFFFF) step = -0x3FFFFFFF;
+          e->xStep = (int)step;
+        }
+      }
+      edgeCount++;
+    }
+    start = end;
   }
-  int j = (points-1)*2;
-  for (i=0;i<points*2;i+=2) {
-    graphicsFillPolyCreateVertScanLines(gfx,miny,maxy, vertices[j+0], vertices[j+1], vertices[i+0], vertices[i+1]);
-    j = i;
+  if (!edgeCount) return;
+  // work out which rows and columns (of pixels) could be filled
+  int cx1, cy1, cx2, cy2;
+  graphicsGetClip(gfx, &cx1, &cy1, &cx2, &cy2);
+  int row = graphicsPolyRow(miny);
+  int lastRow = graphicsPolyRow(maxy);
+  if (row<cy1) row = cy1;
+  if (lastRow>cy2) lastRow = cy2;
+  int firstCol = minx >> POLY_SUBPIXEL_BITS;
+  int lastCol = maxx >> POLY_SUBPIXEL_BITS;
+  if (firstCol<cx1) firstCol = cx1;
+  if (lastCol>cx2) lastCol = cx2;
+  if (row>lastRow || firstCol>lastCol) return; // offscreen
+
+  /* Sort the edges by the scanline they start on. Glyphs have lots of edges but few rows,
+   * so bucket them by row (edges starting below the last row are dropped) and then
+   * tidy up the order within each row */
+  int rows = lastRow+1-row;
+  // rowIndex, edges, active, the four span arrays and coverage
+  size_t tableSize = (size_t)(rows+1)*sizeof(unsigned short) +
+                     (size_t)edgeCount*(2*sizeof(GraphicsPolyEdge*) + 8*sizeof(short)) +
+                     (size_t)(antialias ? (lastCol+1-firstCol) : 1)*sizeof(unsigned short);
+  if (!graphicsPolyHasStack(tableSize)) return;
+  unsigned short rowIndex[rows+1];
+  memset(rowIndex, 0, sizeof(rowIndex));
+  for (i=0;i<edgeCount;i++) {
+    int r = graphicsPolyRow(edgeData[i].yTop) - row;
+    if (r<0) r = 0;
+    if (r<rows) rowIndex[r+1]++;
   }
-  for (x=minx;x<=maxx;x++) {
-    if (maxy[x]>=miny[x]) {
-      // clip
-      if (miny[x]<0) miny[x]=0;
-      if (maxy[x]>=gfx->data.height) maxy[x]=(short)(gfx->data.height-1);
-      // try and expand the rect that we fill
-      int oldx = x;
-      while (x<maxx && miny[x+1]==miny[oldx] && maxy[x+1]==maxy[oldx])
+  for (i=0;i<rows;i++) rowIndex[i+1] = (unsigned short)(rowIndex[i+1]+rowIndex[i]);
+  GraphicsPolyEdge *edges[edgeCount];
+  for (i=0;i<edgeCount;i++) {
+    int r = graphicsPolyRow(edgeData[i].yTop) - row;
+    if (r<0) r = 0;
+    if (r<rows) edges[rowIndex[r]++] = &edgeData[i];
+  }
+  edgeCount = rowIndex[rows];
+  for (i=1;i<edgeCount;i++) {
+    GraphicsPolyEdge *e = edges[i];
+    int k = i;
+    while (k>0 && edges[k-1]->yTop > e->yTop) {
+      edges[k] = edges[k-1];
+      k--;
+    }
+    edges[k] = e;
+  }
+
+  GraphicsPolyEdge *active[edgeCount];
+  int activeCount = 0, nextEdge = 0;
+  /* The spans we drew on the last row, so rows that are the same can be merged into one fillRect.
+   * Each edge can add a span for itself and one for the inside of the polygon it closes */
+  short spanX1[edgeCount*2], spanX2[edgeCount*2], lastSpanX1[edgeCount*2], lastSpanX2[edgeCount*2];
+  int spanCount = 0, lastSpanCount = 0, lastSpanRow = row;
+  // coverage for each pixel of the row (antialiasing) - 256 is fully covered for one scanline
+  unsigned short coverage[antialias ? (lastCol+1-firstCol) : 1];
+  if (antialias) memset(coverage, 0, sizeof(coverage));
+  unsigned int fgColor = gfx->data.fgColor & (unsigned int)((1L<<gfx->data.bpp)-1);
+  unsigned int bgColor = gfx->data.bgColor & (unsigned int)((1L<<gfx->data.bpp)-1);
+
+  for (;row<=lastRow;row++) {
+    spanCount = 0;
+    if (!antialias) {
+      // every edge that touches this row of pixels is active, not just those crossing its centre
+      int rowTop = row*POLY_SUBPIXEL, rowBottom = rowTop+POLY_SUBPIXEL, y = rowTop+POLY_SUBPIXEL/2;
+      int a = 0;
+      // if every edge is vertical and covers the whole row, this row is the same as the last one
+      bool steady = true;
+      int steadyBottom = 0x7FFFFFFF;
+      for (i=0;i<activeCount;i++) {
+        GraphicsPolyEdge *e = active[i];
+        if (e->yBottom >= rowTop) {
+          e->x += e->xStep;
+          active[a++] = e;
+          if (e->xStep || e->yTop > rowTop || e->yBottom < rowBottom) steady = false;
+          else if (e->yBottom < steadyBottom) steadyBottom = e->yBottom;
+        }
+      }
+      if (a!=activeCount) steady = false;
+      activeCount = a;
+      if (nextEdge<edgeCount) {
+        if (edges[nextEdge]->yTop < rowBottom) steady = false;
+        else if (edges[nextEdge]->yTop < steadyBottom) steadyBottom = edges[nextEdge]->yTop;
+      }
+      if (steady) {
+        // skip on to the last row before an edge starts or ends
+        int steadyRow = graphicsPolyRow(steadyBottom) - 1;
+        if (steadyRow>lastRow) steadyRow = lastRow;
+        if (steadyRow>row) row = steadyRow;
+        continue;
+      }
+      while (nextEdge<edgeCount && edges[nextEdge]->yTop < rowBottom) {
+        GraphicsPolyEdge *e = edges[nextEdge++];
+        if (e->yBottom < rowTop) continue;
+        // x at the centre of the row (extrapolated if the edge doesn't reach it)
+        e->x = e->x1 * (65536/POLY_SUBPIXEL) + (int)(((long long)(y-e->y1) * e->xStep) >> POLY_SUBPIXEL_BITS);
+        active[activeCount++] = e;
+      }
+      // sort by x (insertion sort, as they're nearly always in order already)
+      for (i=1;i<activeCount;i++) {
+        GraphicsPolyEdge *e = active[i];
+        int k = i;
+        while (k>0 && active[k-1]->x > e->x) {
+          active[k] = active[k-1];
+          k--;
+        }
+        active[k] = e;
+      }
+      // Go left to right, filling the pixels each edge passes through, and keeping track of which polys we're inside
+      unsigned int inside = 0;
+      int spanStart = 0;
+      for (i=0;i<activeCount;i++) {
+        GraphicsPolyEdge *e = active[i];
+        int ex1, ex2; // where the edge enters and leaves this row
+        if (e->yTop > rowTop) ex1 = e->x1 * (65536/POLY_SUBPIXEL);
+        else ex1 = e->x - e->xStep/2;
+        if (e->yBottom < rowBottom) ex2 = (e->x1+e->dx) * (65536/POLY_SUBPIXEL);
+        else ex2 = e->x + e->xStep/2;
+        int px1, px2;
+        graphicsPolyEdgePixels(ex1, ex2, &px1, &px2);
+        graphicsPolyAddSpan(spanX1, spanX2, &spanCount, px1, px2, firstCol, lastCol);
+        // does the edge cross the centre of the row?
+        if (!e->dy || e->yTop > y || e->yBottom <= y) continue;
+        unsigned int wasInside = inside;
+        inside ^= 1U<<e->poly;
+        if (!wasInside) {
+          spanStart = e->x;
+        } else if (!inside) {
+          // pixels whose centres are inside
+          graphicsPolyAddSpan(spanX1, spanX2, &spanCount,
+              (spanStart - 32768 + 65535) >> 16, ((e->x - 32768 + 65535) >> 16) - 1,
+              firstCol, lastCol);
+        }
+      }
+      // spans are added in order of their edges, which may not quite be the order of their pixels
+      for (i=1;i<spanCount;i++) {
+        short x1 = spanX1[i], x2 = spanX2[i];
+        int k = i;
+        while (k>0 && spanX1[k-1] > x1) {
+          spanX1[k] = spanX1[k-1];
+          spanX2[k] = spanX2[k-1];
+          k--;
+        }
+        spanX1[k] = x1;
+        spanX2[k] = x2;
+      }
+      int merged = 0;
+      for (i=0;i<spanCount;i++) {
+        if (merged && spanX1[i] <= spanX2[merged-1]+1) {
+          if (spanX2[i] > spanX2[merged-1]) spanX2[merged-1] = spanX2[i];
+        } else {
+          spanX1[merged] = spanX1[i];
+          spanX2[merged] = spanX2[i];
+          merged++;
+        }
+      }
+      spanCount = merged;
+      // if this row's spans are different to the last row's, draw the last rows
+      bool same = spanCount==lastSpanCount;
+      for (i=0;same && i<spanCount;i++)
+        same = spanX1[i]==lastSpanX1[i] && spanX2[i]==lastSpanX2[i];
+      if (!same) {
+        for (i=0;i<lastSpanCount;i++)
+          graphicsFillRect(gfx, lastSpanX1[i], (short)lastSpanRow, lastSpanX2[i], (short)(row-1));
+        for (i=0;i<spanCount;i++) {
+          lastSpanX1[i] = spanX1[i];
+          lastSpanX2[i] = spanX2[i];
+        }
+        lastSpanCount = spanCount;
+        lastSpanRow = row;
+      }
+    } else {
+      int sample;
+      for (sample=0;sample<samples;sample++) {
+        int y = row*POLY_SUBPIXEL + sample*sampleStep + sampleStep/2;
+        // remove edges that have ended, and step the others on
+        int a = 0;
+        for (i=0;i<activeCount;i++) {
+          if (active[i]->yBottom > y) {
+            active[i]->x += active[i]->xStep;
+            active[a++] = active[i];
+          }
+        }
+        activeCount = a;
+        // add edges that start on this scanline (we may have skipped some scanlines if they were offscreen)
+        while (nextEdge<edgeCount && edges[nextEdge]->yTop <= y) {
+          GraphicsPolyEdge *e = edges[nextEdge++];
+          if (e->yBottom <= y) continue;
+          e->x = e->x1 * (65536/POLY_SUBPIXEL) + (int)(((long long)(y-e->y1) * e->xStep * POLY_AA_SAMPLES) >> POLY_SUBPIXEL_BITS);
+          active[activeCount++] = e;
+        }
+        // sort by x (insertion sort, as they're nearly always in order already)
+        for (i=1;i<activeCount;i++) {
+          GraphicsPolyEdge *e = active[i];
+          int k = i;
+          while (k>0 && active[k-1]->x > e->x) {
+            active[k] = active[k-1];
+            k--;
+          }
+          active[k] = e;
+        }
+        // Go left to right, keeping track of which polys we're inside
+        unsigned int inside = 0;
+        int spanStart = 0;
+        for (i=0;i<activeCount;i++) {
+          unsigned int wasInside = inside;
+          inside ^= 1U<<active[i]->poly;
+          if (!wasInside) {
+            spanStart = active[i]->x;
+          } else if (!inside) {
+            // add how much of each pixel is covered (in 1/256ths)
+            int x1 = spanStart >> 8, x2 = active[i]->x >> 8;
+            if (x1 < firstCol*256) x1 = firstCol*256;
+            if (x2 > (lastCol+1)*256) x2 = (lastCol+1)*256;
+            if (x1<x2) {
+              int p1 = x1>>8, p2 = (x2-1)>>8;
+              if (p1==p2) {
+                coverage[p1-firstCol] = (unsigned short)(coverage[p1-firstCol] + x2-x1);
+              } else {
+                coverage[p1-firstCol] = (unsigned short)(coverage[p1-firstCol] + 256-(x1&255));
+                int p;
+                for (p=p1+1;p<p2;p++)
+                  coverage[p-firstCol] = (unsigned short)(coverage[p-firstCol] + 256);
+                coverage[p2-firstCol] = (unsigned short)(coverage[p2-firstCol] + x2-p2*256);
+              }
+            }
+          }
+        }
+      }
+      // fully covered runs of pixels are filled, and partly covered pixels are blended with the background
+      int x = firstCol;
+      while (x<=lastCol) {
+        unsigned int c = coverage[x-firstCol];
+        if (c >= 256*POLY_AA_SAMPLES) {
+          int runStart = x;
+          while (x<lastCol && coverage[x+1-firstCol] >= 256*POLY_AA_SAMPLES) x++;
+          graphicsFillRect(gfx, (short)runStart, (short)row, (short)x, (short)row);
+        } else if (c) {
+          graphicsSetPixel(gfx, (short)x, (short)row, graphicsBlendColor(gfx, fgColor, bgColor, c*64/(256*POLY_AA_SAMPLES)));
+        }
         x++;
-      // actually fill
-      graphicsFillRect(gfx,oldx,miny[x],x,maxy[x]);
-      if (jspIsInterrupted()) break;
+      }
+      memset(coverage, 0, sizeof(coverage));
     }
+    if (jspIsInterrupted()) break;
   }
-#endif
+  for (i=0;i<lastSpanCount;i++)
+    graphicsFillRect(gfx, lastSpanX1[i], (short)lastSpanRow, lastSpanX2[i], (short)(row-1));
 }
 
-
+void graphicsFillPoly(JsGraphics *gfx, int points, const short *vertices) {
+  if (points<=0 || points>255) return;
+  if (!graphicsPolyHasStack((size_t)points*2*sizeof(int))) return;
+  int verts[points*2];
+  int i;
+  for (i=0;i<points*2;i++)
+    verts[i] = vertices[i]*POLY_SUBPIXEL;
+  unsigned char polyEnd = (unsigned char)points;
+  graphicsFillPolysSubpixel(gfx, 1, &polyEnd, verts);
+}
 
 // prints character, returns width
 unsigned int graphicsFillVectorChar(JsGraphics *gfx, short x1, short y1, short size, char ch) {
@@ -342,19 +959,19 @@ unsigned int graphicsFillVectorChar(JsGraphics *gfx, short x1, short y1, short s
   for (i=0;i<fontOffset;i++)
     vertOffset += vectorFonts[i].vertCount;
   VectorFontChar vector = vectorFonts[fontOffset];
-  short verts[VECTOR_FONT_MAX_POLY_SIZE*2];
-  int idx=0;
+  // all the character's polys are filled at once
+  int verts[vector.vertCount+1];
+  unsigned char polyEnds[POLY_MAX_POLYS];
+  int polys = 0;
+  // scale from font units to subpixels, in 1/256ths (so we don't divide for every vertex)
+  int scale = size*POLY_SUBPIXEL*256/VECTOR_FONT_POLY_SIZE;
   for (i=0;i<vector.vertCount;i+=2) {
-    verts[idx+0] = (short)(x1+(((vectorFontPolys[vertOffset+i+0]&0x7F)*size+(VECTOR_FONT_POLY_SIZE/2))/VECTOR_FONT_POLY_SIZE));
-    verts[idx+1] = (short)(y1+(((vectorFontPolys[vertOffset+i+1]&0x7F)*size+(VECTOR_FONT_POLY_SIZE/2))/VECTOR_FONT_POLY_SIZE));
-    idx+=2;
-    if (vectorFontPolys[vertOffset+i+1] & VECTOR_FONT_POLY_SEPARATOR) {
-      graphicsFillPoly(gfx,idx/2, verts);
-
-      if (jspIsInterrupted()) break;
-      idx=0;
-    }
+    verts[i+0] = x1*POLY_SUBPIXEL + (((vectorFontPolys[vertOffset+i+0]&0x7F)*scale + 128) >> 8);
+    verts[i+1] = y1*POLY_SUBPIXEL + (((vectorFontPolys[vertOffset+i+1]&0x7F)*scale + 128) >> 8);
+    if ((vectorFontPolys[vertOffset+i+1] & VECTOR_FONT_POLY_SEPARATOR) && polys<POLY_MAX_POLYS)
+      polyEnds[polys++] = (unsigned char)((i+2)/2);
   }
+  graphicsFillPolysSubpixel(gfx, polys, polyEnds, verts);
   return (vector.width * (unsigned int)size)/(VECTOR_FONT_POLY_SIZE*2);
 }
 
@@ -375,8 +992,13 @@ void graphicsSplash(JsGraphics *gfx) {
 }
 
 void graphicsIdle() {
+  lcdIdle_JS();
 #ifdef USE_LCD_SDL
   lcdIdle_SDL();
 #endif
 }
 
+void graphicsKill() {
+  lcdKill_JS();
+}
+
@@ -29,6 +29,8 @@ typedef enum {
   JSGRAPHICSFLAGS_NONE,
   JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG = 1, ///< ArrayBuffer: zig-zag (even rows reversed)
   JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE = 2, ///< ArrayBuffer: if 1 bpp, treat bytes as stacked vertically
+  JSGRAPHICSFLAGS_ANTIALIAS = 4, ///< Antialias polygons and vector fonts (if bpp>=8)
+  JSGRAPHICSFLAGS_JS_SPANS = 8, ///< JS: draw with the 'spans' callback
 } JsGraphicsFlags;
 
 #define JSGRAPHICS_FONTSIZE_4X6 (-1) // a bitmap font
@@ -39,6 +41,7 @@ typedef enum {
 #define JSGRAPHICS_CUSTOMFONT_WIDTH JS_HIDDEN_CHAR_STR"fntW"
 #define JSGRAPHICS_CUSTOMFONT_HEIGHT JS_HIDDEN_CHAR_STR"fntH"
 #define JSGRAPHICS_CUSTOMFONT_FIRSTCHAR JS_HIDDEN_CHAR_STR"fnt1st"
+#define JSGRAPHICS_CUSTOMFONT_OFFSETS JS_HIDDEN_CHAR_STR"fntOff" // Uint16Array of the column each character starts at (plus one for the end), if widths are a String
 
 typedef struct {
   JsGraphicsType type;
@@ -48,25 +51,56 @@ typedef struct {
   unsigned int fgColor, bgColor; ///< current foreground and background colors
   short fontSize; ///< See JSGRAPHICS_FONTSIZE_ constants
   short cursorX, cursorY; ///< current cursor positions
+  short modMinX, modMinY, modMaxX, modMaxY; ///< area that has been modified since getModified(true) or flip. Nothing is modified if modMaxX<modMinX
+  short clipX1, clipY1, clipX2, clipY2; ///< only draw inside this area (inclusive). x1,y1 are never negative, but x2,y2 may be off the screen
 } PACKED_FLAGS JsGraphicsData;
 
+/// An image to draw with graphicsDrawImage
+typedef struct {
+  unsigned short width, height;
+  unsigned char bpp;
+  const unsigned char *data; ///< pixels, packed in the same way as an ArrayBuffer Graphics' buffer (lowest bits first). 0 if they're in dataVar
+  JsVar *dataVar; ///< if data is 0, the String holding the pixels (which may be a chain of blocks), starting at dataOffset
+  size_t dataOffset;
+  bool hasTransparent; ///< if true, pixels with a value of 'transparent' are not drawn
+  unsigned int transparent;
+  bool rotate90; ///< rotate the image 90 degrees clockwise
+  unsigned char scale; ///< draw each pixel as a scale*scale square
+  const unsigned int *palette; ///< if set, the colour to draw for each pixel value (1<<bpp entries). Otherwise 1 bit images use fg/bg colour and others use the pixel value
+} JsGraphicsImage;
+
 typedef struct JsGraphics {
   JsVar *graphicsVar; // this won't be locked again - we just know that it is already locked by something else
   JsGraphicsData data;
   unsigned char _blank; ///< this is needed as jsvGetString for 'data' wants to add a trailing zero  
+  void *backendData; ///< Backend-specific state that is only valid for this call - eg. a pointer to an ArrayBuffer's data
+  JsVar *backendVar; ///< Backend-specific var that is only valid for this call (and isn't locked) - eg. the String holding an ArrayBuffer's data
+  JsVarRef backendBlock; ///< ArrayBuffer: the block of backendVar that was written to last (or 0)...
+  size_t backendBlockStart; ///< ...and the index in backendVar of its first byte
 
   void (*setPixel)(struct JsGraphics *gfx, short x, short y, unsigned int col);
   void (*fillRect)(struct JsGraphics *gfx, short x1, short y1, short x2, short y2);
   void (*bitmap1bit)(struct JsGraphics *gfx, short x1, short y1, unsigned short width, unsigned short height, unsigned char *data);
   unsigned int (*getPixel)(struct JsGraphics *gfx, short x, short y);
+  void (*blit)(struct JsGraphics *gfx, short x, short y, unsigned short count, const unsigned int *cols); ///< set count pixels in a row from x,y to the given colours. They will all be onscreen
+  void (*flip)(struct JsGraphics *gfx, short x1, short y1, short x2, short y2); ///< send the given (modified) area to the display
 } PACKED_FLAGS JsGraphics;
 
 static inline void graphicsStructInit(JsGraphics *gfx) {
   gfx->data.fgColor = 0xFFFFFFFF;
   gfx->data.bgColor = 0;
+  gfx->data.flags = JSGRAPHICSFLAGS_NONE;
   gfx->data.fontSize = JSGRAPHICS_FONTSIZE_4X6;
   gfx->data.cursorX = 0;
   gfx->data.cursorY = 0;
+  gfx->data.modMinX = 32767;
+  gfx->data.modMinY = 32767;
+  gfx->data.modMaxX = -1;
+  gfx->data.modMaxY = -1;
+  gfx->data.clipX1 = 0;
+  gfx->data.clipY1 = 0;
+  gfx->data.clipX2 = 32767;
+  gfx->data.clipY2 = 32767;
 }
 
 // ---------------------------------- these are in lcd.c
@@ -80,14 +114,20 @@ unsigned int graphicsGetPixel(JsGraphics *gfx, short x, short y);
 void         graphicsClear(JsGraphics *gfx);
 void         graphicsFillRect(JsGraphics *gfx, short x1, short y1, short x2, short y2);
 void         graphicsBitmap1bit(JsGraphics *gfx, short x1, short y1, unsigned short width, unsigned short height, unsigned char *data);
+void graphicsDrawImage(JsGraphics *gfx, short x, short y, const JsGraphicsImage *img);
 void graphicsDrawRect(JsGraphics *gfx, short x1, short y1, short x2, short y2);
 void graphicsDrawString(JsGraphics *gfx, short x1, short y1, const char *str);
 void graphicsDrawLine(JsGraphics *gfx, short x1, short y1, short x2, short y2);
 void graphicsFillPoly(JsGraphics *gfx, int points, const short *vertices);
 unsigned int graphicsFillVectorChar(JsGraphics *gfx, short x1, short y1, short size, char ch); ///< prints character, returns width
 unsigned int graphicsVectorCharWidth(JsGraphics *gfx, short size, char ch); ///< returns the width of a character
+void graphicsSetModified(JsGraphics *gfx, int x1, int y1, int x2, int y2); ///< mark the given area as modified (clipped to the screen)
+void graphicsClearModified(JsGraphics *gfx); ///< mark nothing as modified
+void graphicsSetClipRect(JsGraphics *gfx, int x1, int y1, int x2, int y2); ///< only draw inside the given area
+void graphicsFlip(JsGraphics *gfx); ///< send the modified area to the display (if the backend needs it), and clear it
 void graphicsSplash(JsGraphics *gfx); ///< splash screen
 
 void graphicsIdle(); ///< called when idling
+void graphicsKill(); ///< called when the interpreter is reset
 
 #endif // GRAPHICS_H
@@ -16,6 +16,8 @@
 #include "jswrap_graphics.h"
 #include "jsutils.h"
 #include "jsinteractive.h"
+#include "jswrap_arraybuffer.h"
+#include "jswrap_spi_i2c.h"
 
 #include "lcd_arraybuffer.h"
 #include "lcd_js.h"
@@ -40,6 +42,11 @@ bool jswrap_graphics_idle() {
   return false;
 }
 
+/*JSON{ "type":"kill", "generate" : "jswrap_graphics_kill" }*/
+void jswrap_graphics_kill() {
+  graphicsKill();
+}
+
 /*JSON{ "type":"init", "generate" : "jswrap_graphics_init" }*/
 void jswrap_graphics_init() {
 #ifdef USE_LCD_FSMC
@@ -79,7 +86,7 @@ JsVar *jswrap_graphics_createArrayBuffer(int width, int height, int bpp, JsVar *
     jsWarn("Invalid Size");
     return 0;
   }
-  if (!(bpp==1 || bpp==8 || bpp==16 || bpp==24 || bpp==32)) {
+  if (!(bpp==1 || bpp==2 || bpp==4 || bpp==8 || bpp==16 || bpp==24 || bpp==32)) {
     jsWarn("Invalid BPP");
     return 0;
   }
@@ -118,7 +125,8 @@ JsVar *jswrap_graphics_createArrayBuffer(int width, int height, int bpp, JsVar *
          "params" : [ [ "width", "int32", "Pixels wide" ],
                       [ "height", "int32", "Pixels high" ],
                       [ "bpp", "int32", "Number of bits per pixel" ],
-                      [ "callback", "JsVar", "A function of the form ```function(x,y,col)``` that is called whenever a pixel needs to be drawn, or an object with: ```{setPixel:function(x,y,col),fillRect:function(x1,y1,x2,y2,col)}```. All arguments are already bounds checked." ] ],
+                      [ "callback", "JsVar", ["A function of the form ```function(x,y,col)``` that is called whenever a pixel needs to be drawn, or an object with: ```{setPixel:function(x,y,col),fillRect:function(x1,y1,x2,y2,col),flip:function(x1,y1,x2,y2),spans:function(data,count),batch:int}```. All arguments are already bounds checked. `flip` is optional, and is called by `Graphics.flip()` with the area that has been modified since the last flip.",
+                                              "If `spans` is given then `setPixel` and `fillRect` aren't needed. Everything drawn is instead collected into horizontal runs of pixels, and `spans` is called with a `Uint16Array` (or `Uint32Array` if bpp>16) containing `count` runs of 4 elements each: `x,y,length,color`. It is called when `batch` runs (default 32) have been collected, on `Graphics.flip()`, and when idle - so a display driver can send many pixels at once rather than handling each one in JavaScript. The array is reused, so copy anything you need from it before returning."] ] ],
          "return" : [ "JsVar", "The new Graphics object" ]
 }*/
 JsVar *jswrap_graphics_createCallback(int width, int height, int bpp, JsVar *callback) {
@@ -132,25 +140,48 @@ JsVar *jswrap_graphics_createCallback(int width, int height, int bpp, JsVar *cal
   }
   JsVar *callbackSetPixel = 0;
   JsVar *callbackFillRect = 0;
+  JsVar *callbackFlip = 0;
+  JsVar *callbackSpans = 0;
+  int spansBatch = 32;
   if (jsvIsObject(callback)) {
     jsvUnLock(callbackSetPixel);
     callbackSetPixel = jsvObjectGetChild(callback, "setPixel", 0);
     callbackFillRect = jsvObjectGetChild(callback, "fillRect", 0);
+    callbackFlip = jsvObjectGetChild(callback, "flip", 0);
+    callbackSpans = jsvObjectGetChild(callback, "spans", 0);
+    JsVar *batch = jsvObjectGetChild(callback, "batch", 0);
+    if (!jsvIsUndefined(batch)) spansBatch = (int)jsvGetInteger(batch);
+    jsvUnLock(batch);
+    if (spansBatch<1) spansBatch = 1;
+    if (spansBatch>1024) spansBatch = 1024;
   } else
     callbackSetPixel = jsvLockAgain(callback);
-  if (!jsvIsFunction(callbackSetPixel)) {
+  if (!jsvIsUndefined(callbackSpans) && !jsvIsFunction(callbackSpans)) {
+    jsError("Expecting Callback Function or an Object but got %t", callbackSpans);
+    jsvUnLock(callbackSetPixel);jsvUnLock(callbackFillRect);jsvUnLock(callbackFlip);jsvUnLock(callbackSpans);
+    return 0;
+  }
+  if (!callbackSpans && !jsvIsFunction(callbackSetPixel)) {
     jsError("Expecting Callback Function or an Object but got %t", callbackSetPixel);
-    jsvUnLock(callbackSetPixel);jsvUnLock(callbackFillRect);
+    jsvUnLock(callbackSetPixel);jsvUnLock(callbackFillRect);jsvUnLock(callbackFlip);jsvUnLock(callbackSpans);
     return 0;
   }
   if (!jsvIsUndefined(callbackFillRect) && !jsvIsFunction(callbackFillRect)) {
     jsError("Expecting Callback Function or an Object but got %t", callbackFillRect);
-    jsvUnLock(callbackSetPixel);jsvUnLock(callbackFillRect);
+    jsvUnLock(callbackSetPixel);jsvUnLock(callbackFillRect);jsvUnLock(callbackFlip);jsvUnLock(callbackSpans);
+    return 0;
+  }
+  if (!jsvIsUndefined(callbackFlip) && !jsvIsFunction(callbackFlip)) {
+    jsError("Expecting Callback Function or an Object but got %t", callbackFlip);
+    jsvUnLock(callbackSetPixel);jsvUnLock(callbackFillRect);jsvUnLock(callbackFlip);jsvUnLock(callbackSpans);
     return 0;
   }
 
   JsVar *parent = jspNewObject(0, "Graphics");
-  if (!parent) return 0; // low memory
+  if (!parent) { // low memory
+    jsvUnLock(callbackSetPixel);jsvUnLock(callbackFillRect);jsvUnLock(callbackFlip);jsvUnLock(callbackSpans);
+    return 0;
+  }
 
   JsGraphics gfx;
   graphicsStructInit(&gfx);
@@ -159,25 +190,35 @@ JsVar *jswrap_graphics_createCallback(int width, int height, int bpp, JsVar *cal
   gfx.data.width = (unsigned short)width;
   gfx.data.height = (unsigned short)height;
   gfx.data.bpp = (unsigned char)bpp;
-  lcdInit_JS(&gfx, callbackSetPixel, callbackFillRect);
+  lcdInit_JS(&gfx, callbackSetPixel, callbackFillRect, callbackFlip, callbackSpans, spansBatch);
   graphicsSetVar(&gfx);
-  jsvUnLock(callbackSetPixel);jsvUnLock(callbackFillRect);
+  jsvUnLock(callbackSetPixel);jsvUnLock(callbackFillRect);jsvUnLock(callbackFlip);jsvUnLock(callbackSpans);
   return parent;
 }
 
 #ifdef USE_LCD_SDL
 /*JSON{ "type":"staticmethod", "class": "Graphics", "name" : "createSDL", "ifdef" : "USE_LCD_SDL",
-         "description" : "Create a Graphics object that renders to SDL window (Linux-based devices only)",
+         "description" : ["Create a Graphics object that renders to SDL window (Linux-based devices only)",
+                          "If `ppmFile` is specified then no window is opened. Instead the Graphics renders to an offscreen surface, which is written to `ppmFile` as a binary PPM image whenever it would have been displayed (on `Graphics.flip()`, or when idle after drawing). This is handy for benchmarking and comparing rendering without a display." ],
          "generate" : "jswrap_graphics_createSDL",
          "params" : [ [ "width", "int32", "Pixels wide" ],
-                      [ "height", "int32", "Pixels high" ] ],
+                      [ "height", "int32", "Pixels high" ],
+                      [ "ppmFile", "JsVar", "(optional) The file to write a PPM image to, rather than opening a window" ] ],
          "return" : [ "JsVar", "The new Graphics object" ]
 }*/
-JsVar *jswrap_graphics_createSDL(int width, int height) {
+JsVar *jswrap_graphics_createSDL(int width, int height, JsVar *ppmFile) {
   if (width<=0 || height<=0 || width>1023 || height>1023) {
     jsWarn("Invalid Size");
     return 0;
   }
+  char ppmFilename[256];
+  if (!jsvIsUndefined(ppmFile)) {
+    if (!jsvIsString(ppmFile)) {
+      jsError("Expecting ppmFile to be a String, got %t", ppmFile);
+      return 0;
+    }
+    jsvGetString(ppmFile, ppmFilename, sizeof(ppmFilename));
+  }
 
   JsVar *parent = jspNewObject(0, "Graphics");
   if (!parent) return 0; // low memory
@@ -188,7 +229,7 @@ JsVar *jswrap_graphics_createSDL(int width, int height) {
   gfx.data.width = (unsigned short)width;
   gfx.data.height = (unsigned short)height;
   gfx.data.bpp = 32;
-  lcdInit_SDL(&gfx);
+  lcdInit_SDL(&gfx, jsvIsUndefined(ppmFile) ? 0 : ppmFilename);
   graphicsSetVar(&gfx);
   return parent;
 }
@@ -216,6 +257,7 @@ int jswrap_graphics_getWidthOrHeight(JsVar *parent, bool height) {
 void jswrap_graphics_clear(JsVar *parent) {
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
   graphicsClear(&gfx);
+  graphicsSetVar(&gfx); // modified area changed
 }
 
 /*JSON{ "type":"method", "class": "Graphics", "name" : "fillRect",
@@ -229,6 +271,7 @@ void jswrap_graphics_clear(JsVar *parent) {
 void jswrap_graphics_fillRect(JsVar *parent, int x1, int y1, int x2, int y2) {
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
   graphicsFillRect(&gfx, (short)x1,(short)y1,(short)x2,(short)y2);
+  graphicsSetVar(&gfx); // modified area changed
 }
 
 /*JSON{ "type":"method", "class": "Graphics", "name" : "drawRect",
@@ -242,6 +285,7 @@ void jswrap_graphics_fillRect(JsVar *parent, int x1, int y1, int x2, int y2) {
 void jswrap_graphics_drawRect(JsVar *parent, int x1, int y1, int x2, int y2) {
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
   graphicsDrawRect(&gfx, (short)x1,(short)y1,(short)x2,(short)y2);
+  graphicsSetVar(&gfx); // modified area changed
 }
 
 /*JSON{ "type":"method", "class": "Graphics", "name" : "getPixel",
@@ -271,6 +315,7 @@ void jswrap_graphics_setPixel(JsVar *parent, int x, int y, JsVar *color) {
   graphicsSetPixel(&gfx, (short)x, (short)y, col);
   gfx.data.cursorX = (short)x;
   gfx.data.cursorY = (short)y;
+  graphicsSetVar(&gfx); // modified area changed
 }
 
 
@@ -356,6 +401,7 @@ void jswrap_graphics_setFontSizeX(JsVar *parent, int size, bool checkValid) {
     jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_WIDTH, 0);
     jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_HEIGHT, 0);
     jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_FIRSTCHAR, 0);
+    jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_OFFSETS, 0);
   }
   gfx.data.fontSize = (short)size;
   graphicsSetVar(&gfx);
@@ -387,15 +433,82 @@ void jswrap_graphics_setFontCustom(JsVar *parent, JsVar *bitmap, int firstChar,
    jsError("Invalid height");
    return;
  }
-  jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_BMP, bitmap);
+  // Work out where each character starts now, so we don't have to add up the widths every time we draw one
+  JsVar *offsets = 0;
+  if (jsvIsString(width)) {
+    size_t chars = jsvGetStringLength(width);
+    if (chars>256) chars = 256;
+    JsVar *length = jsvNewFromInteger((JsVarInt)chars+1);
+    offsets = jswrap_typedarray_constructor(ARRAYBUFFERVIEW_UINT16, length, 0, 0);
+    jsvUnLock(length);
+    if (!offsets) return; // low memory
+    JsvArrayBufferIterator it;
+    jsvArrayBufferIteratorNew(&it, offsets, 0);
+    JsvStringIterator wit;
+    jsvStringIteratorNew(&wit, width, 0);
+    JsVarInt offset = 0;
+    while (jsvArrayBufferIteratorHasElement(&it)) {
+      jsvArrayBufferIteratorSetIntegerValue(&it, offset);
+      offset += (unsigned char)jsvStringIteratorGetChar(&wit);
+      jsvStringIteratorNext(&wit);
+      jsvArrayBufferIteratorNext(&it);
+    }
+    jsvStringIteratorFree(&wit);
+    jsvArrayBufferIteratorFree(&it);
+  }
+  JsVar *bitmapData = jsvLockAgain(bitmap);
+#ifdef FLAT_ARRAYBUFFERS
+  // Keep a flat copy of the bitmap, so drawString can go straight to each character rather than iterating over the String
+  size_t bitmapLength = jsvGetStringLength(bitmap);
+  if (bitmapLength>0 && bitmapLength<=JSV_ARRAYBUFFER_MAX_LENGTH) {
+    JsVar *flatBitmap = jswrap_arraybuffer_constructor((JsVarInt)bitmapLength);
+    size_t length;
+    char *ptr = flatBitmap ? jsvGetArrayBufferPointer(flatBitmap, &length) : 0;
+    if (ptr) {
+      JsvStringIterator bit;
+      jsvStringIteratorNew(&bit, bitmap, 0);
+      while (jsvStringIteratorHasChar(&bit)) {
+        *(ptr++) = jsvStringIteratorGetChar(&bit);
+        jsvStringIteratorNext(&bit);
+      }
+      jsvStringIteratorFree(&bit);
+      jsvUnLock(bitmapData);
+      bitmapData = jsvLockAgain(flatBitmap);
+    }
+    jsvUnLock(flatBitmap);
+  }
+#endif
+  jsvUnLock(jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_BMP, bitmapData));
   jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_WIDTH, width);
-  jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_HEIGHT, jsvNewFromInteger(height));
-  jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_FIRSTCHAR, jsvNewFromInteger(firstChar));
+  jsvUnLock(jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_HEIGHT, jsvNewFromInteger(height)));
+  jsvUnLock(jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_FIRSTCHAR, jsvNewFromInteger(firstChar)));
+  jsvUnLock(jsvObjectSetChild(parent, JSGRAPHICS_CUSTOMFONT_OFFSETS, offsets));
   gfx.data.fontSize = JSGRAPHICS_FONTSIZE_CUSTOM;
   graphicsSetVar(&gfx);
 }
 
 
+/// Get the first column and width of character idx of a custom font from the table made by setFontCustom. Returns false if it isn't in the font
+static bool jswrap_graphics_getCustomFontChar(JsVar *offsets, int idx, int *offset, int *width) {
+  if (!jsvIsArrayBuffer(offsets) || idx<0 || (size_t)idx+1 >= jsvGetArrayBufferLength(offsets)) return false;
+#ifdef FLAT_ARRAYBUFFERS
+  size_t length;
+  uint16_t *ptr = (uint16_t*)jsvGetArrayBufferPointer(offsets, &length);
+  if (ptr) {
+    *offset = ptr[idx];
+    *width = ptr[idx+1] - ptr[idx];
+    return true;
+  }
+#endif
+  JsvArrayBufferIterator it;
+  jsvArrayBufferIteratorNew(&it, offsets, (size_t)idx);
+  *offset = (int)jsvArrayBufferIteratorGetIntegerValue(&it);
+  jsvArrayBufferIteratorNext(&it);
+  *width = (int)jsvArrayBufferIteratorGetIntegerValue(&it) - *offset;
+  jsvArrayBufferIteratorFree(&it);
+  return true;
+}
+
 /*JSON{ "type":"method", "class": "Graphics", "name" : "drawString",
          "description" : "Draw a string of text in the current font",
          "generate" : "jswrap_graphics_drawString",
@@ -406,14 +519,22 @@ void jswrap_graphics_setFontCustom(JsVar *parent, JsVar *bitmap, int firstChar,
 void jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y) {
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
 
-  JsVar *customBitmap = 0, *customWidth = 0;
+  JsVar *customBitmap = 0, *customWidth = 0, *customOffsets = 0;
   int customHeight, customFirstChar;
   if (gfx.data.fontSize == JSGRAPHICS_FONTSIZE_CUSTOM) {
     customBitmap = jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_BMP, 0);
     customWidth = jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_WIDTH, 0);
+    customOffsets = jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_OFFSETS, 0);
     customHeight = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_HEIGHT, 0));
     customFirstChar = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_FIRSTCHAR, 0));
   }
+  // if setFontCustom made a flat copy of the bitmap, use it directly
+  const unsigned char *customBitmapPtr = 0;
+  size_t customBitmapLength = 0;
+  if (jsvIsArrayBuffer(customBitmap)) {
+    customBitmapPtr = (const unsigned char *)jsvGetArrayBufferPointer(customBitmap, &customBitmapLength);
+    if (!customBitmapPtr) customBitmapLength = 0;
+  }
 
   JsVar *str = jsvAsString(var, false);
   JsvStringIterator it;
@@ -430,39 +551,41 @@ void jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y) {
       // get char width and offset in string
       int width = 0, bmpOffset = 0;
       if (jsvIsString(customWidth)) {
-        if (ch>=customFirstChar) {
-          JsvStringIterator wit;
-          jsvStringIteratorNew(&wit, customWidth, 0);
-          while (jsvStringIteratorHasChar(&wit) && (int)jsvStringIteratorGetIndex(&wit)<(ch-customFirstChar)) {
-            bmpOffset += (unsigned char)jsvStringIteratorGetChar(&wit);
-            jsvStringIteratorNext(&wit);
-          }
-          width = (unsigned char)jsvStringIteratorGetChar(&wit);
-          jsvStringIteratorFree(&wit);
-        }
+        if (ch>=customFirstChar && !jswrap_graphics_getCustomFontChar(customOffsets, ch-customFirstChar, &bmpOffset, &width))
+          width = 0;
       } else {
         width = (int)jsvGetInteger(customWidth);
         bmpOffset = width*(ch-customFirstChar);
       }
       if (ch>=customFirstChar) {
         bmpOffset *= customHeight;
-        // now render character
+        // now render character, as vertical runs of pixels
         JsvStringIterator cit;
-        jsvStringIteratorNew(&cit, customBitmap, (size_t)bmpOffset>>3);
-        bmpOffset &= 7;
+        if (!customBitmapPtr) jsvStringIteratorNew(&cit, customBitmap, (size_t)bmpOffset>>3);
         int cx,cy;
         for (cx=0;cx<width;cx++) {
+          int runStart = -1;
           for (cy=0;cy<customHeight;cy++) {
-            if ((jsvStringIteratorGetChar(&cit)<<bmpOffset)&128)
-              graphicsSetPixel(&gfx, (short)(cx+x), (short)(cy+y), gfx.data.fgColor);
+            unsigned char bits;
+            if (customBitmapPtr) {
+              size_t idx = (size_t)bmpOffset>>3;
+              bits = idx<customBitmapLength ? customBitmapPtr[idx] : 0;
+            } else
+              bits = (unsigned char)jsvStringIteratorGetChar(&cit);
+            if ((bits<<(bmpOffset&7))&128) {
+              if (runStart<0) runStart = cy;
+            } else if (runStart>=0) {
+              graphicsFillRect(&gfx, (short)(cx+x), (short)(runStart+y), (short)(cx+x), (short)(cy-1+y));
+              runStart = -1;
+            }
             bmpOffset++;
-            if (bmpOffset==8) {
-              bmpOffset=0;
+            if (!customBitmapPtr && !(bmpOffset&7))
               jsvStringIteratorNext(&cit);
-            }
           }
+          if (runStart>=0)
+            graphicsFillRect(&gfx, (short)(cx+x), (short)(runStart+y), (short)(cx+x), (short)(customHeight-1+y));
         }
-        jsvStringIteratorFree(&cit);
+        if (!customBitmapPtr) jsvStringIteratorFree(&cit);
       }
       x += width;
     }
@@ -474,6 +597,8 @@ void jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y) {
 
   jsvUnLock(customBitmap);
   jsvUnLock(customWidth);
+  jsvUnLock(customOffsets);
+  graphicsSetVar(&gfx); // modified area changed
 }
 
 /*JSON{ "type":"method", "class": "Graphics", "name" : "stringWidth",
@@ -485,10 +610,11 @@ void jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y) {
 JsVarInt jswrap_graphics_stringWidth(JsVar *parent, JsVar *var) {
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
 
-  JsVar *customWidth = 0;
+  JsVar *customWidth = 0, *customOffsets = 0;
   int customFirstChar;
   if (gfx.data.fontSize == JSGRAPHICS_FONTSIZE_CUSTOM) {
     customWidth = jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_WIDTH, 0);
+    customOffsets = jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_OFFSETS, 0);
     customFirstChar = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, JSGRAPHICS_CUSTOMFONT_FIRSTCHAR, 0));
   }
 
@@ -504,8 +630,9 @@ JsVarInt jswrap_graphics_stringWidth(JsVar *parent, JsVar *var) {
       width += 4;
     } else if (gfx.data.fontSize == JSGRAPHICS_FONTSIZE_CUSTOM) {
       if (jsvIsString(customWidth)) {
-        if (ch>=customFirstChar)
-          width += (unsigned char)jsvGetCharInString(customWidth, (size_t)(ch-customFirstChar));
+        int offset, charWidth;
+        if (ch>=customFirstChar && jswrap_graphics_getCustomFontChar(customOffsets, ch-customFirstChar, &offset, &charWidth))
+          width += charWidth;
       } else
         width += (int)jsvGetInteger(customWidth);
     }
@@ -515,9 +642,417 @@ JsVarInt jswrap_graphics_stringWidth(JsVar *parent, JsVar *var) {
   jsvUnLock(str);
 
   jsvUnLock(customWidth);
+  jsvUnLock(customOffsets);
   return width;
 }
 
+/*JSON{ "type":"method", "class": "Graphics", "name" : "getModified",
+         "description" : ["Return the area of the Graphics that has been modified (since it was created, or since the last time `getModified(true)` or `flip()` was called)",
+                          "This is useful if you're mirroring a Graphics' buffer onto a display, as only the modified area needs to be sent"],
+         "generate" : "jswrap_graphics_getModified",
+         "params" : [ [ "reset", "bool", "Whether to reset the modified area afterwards" ] ],
+         "return" : [ "JsVar", "An object `{x1,y1,x2,y2}` containing the modified area (inclusive), or undefined if nothing has been modified" ]
+}*/
+JsVar *jswrap_graphics_getModified(JsVar *parent, bool reset) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
+  JsVar *obj = 0;
+  if (gfx.data.modMaxX >= gfx.data.modMinX) {
+    obj = jsvNewWithFlags(JSV_OBJECT);
+    if (obj) {
+      jsvUnLock(jsvObjectSetChild(obj, "x1", jsvNewFromInteger(gfx.data.modMinX)));
+      jsvUnLock(jsvObjectSetChild(obj, "y1", jsvNewFromInteger(gfx.data.modMinY)));
+      jsvUnLock(jsvObjectSetChild(obj, "x2", jsvNewFromInteger(gfx.data.modMaxX)));
+      jsvUnLock(jsvObjectSetChild(obj, "y2", jsvNewFromInteger(gfx.data.modMaxY)));
+    }
+  }
+  if (reset) {
+    graphicsClearModified(&gfx);
+    graphicsSetVar(&gfx);
+  }
+  return obj;
+}
+
+/*JSON{ "type":"method", "class": "Graphics", "name" : "flip",
+         "description" : ["Send the area that has been modified since the last flip to the display, for Graphics types that need it (eg. SDL, or a Graphics.createCallback with a `flip` function). The modified area is then reset.",
+                          "For other types of Graphics this just resets the modified area (see `getModified`)" ],
+         "generate" : "jswrap_graphics_flip"
+}*/
+void jswrap_graphics_flip(JsVar *parent) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
+  graphicsFlip(&gfx);
+  graphicsSetVar(&gfx);
+}
+
+// Read a palette of 1<<bpp colours from an Array or ArrayBuffer. Returns false (with an error) if it isn't valid
+static bool jswrap_graphics_getPalette(JsVar *v, int bpp, unsigned int *palette) {
+  if (bpp>8 || !(jsvIsArray(v) || jsvIsArrayBuffer(v)) || jsvGetLength(v) < (1<<bpp)) {
+    jsError("Expecting palette to be an Array or ArrayBuffer with %d elements", 1<<bpp);
+    return false;
+  }
+  memset(palette, 0, sizeof(unsigned int)<<bpp);
+  JsvIterator it;
+  jsvIteratorNew(&it, v);
+  while (jsvIteratorHasElement(&it)) {
+    JsVarInt idx = jsvGetIntegerAndUnLock(jsvIteratorGetKey(&it));
+    if (idx>=0 && idx<(1<<bpp))
+      palette[idx] = (unsigned int)jsvIteratorGetIntegerValue(&it);
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  return true;
+}
+
+#define JSGRAPHICS_FLIPTO_CHUNK 64 ///< bytes converted and sent at once by flipTo
+
+// Where flipTo sends its data
+typedef struct {
+  JsVar *spi;
+  JsVar *sendFn; ///< if set, spi.send is a JS function that we call. Otherwise we send to 'device'
+  IOEventFlags device;
+  Pin dc;
+  size_t length; ///< bytes in buf
+  unsigned char buf[JSGRAPHICS_FLIPTO_CHUNK];
+} JsGraphicsFlipTo;
+
+static void jswrap_graphics_flipToSend(JsGraphicsFlipTo *f) {
+  if (!f->length) return;
+  if (f->sendFn) {
+    JsVar *data = jsvNewStringOfLength((unsigned int)f->length);
+    if (data) {
+      jsvSetString(data, (char*)f->buf, f->length);
+      jspExecuteFunction(f->sendFn, f->spi, 1, &data);
+      jsvUnLock(data);
+    }
+  } else {
+    spi_send_bytes(f->device, f->buf, f->length);
+  }
+  f->length = 0;
+}
+
+static inline void jswrap_graphics_flipToByte(JsGraphicsFlipTo *f, unsigned char b) {
+  f->buf[f->length++] = b;
+  if (f->length >= JSGRAPHICS_FLIPTO_CHUNK)
+    jswrap_graphics_flipToSend(f);
+}
+
+// Send a command byte to the display (with DC low)
+static void jswrap_graphics_flipToCommand(JsGraphicsFlipTo *f, unsigned char cmd) {
+  jswrap_graphics_flipToSend(f);
+  jshPinOutput(f->dc, false);
+  jswrap_graphics_flipToByte(f, cmd);
+  jswrap_graphics_flipToSend(f);
+  jshPinOutput(f->dc, true);
+}
+
+// Get a pixel as RGB565
+static inline unsigned int jswrap_graphics_flipToRGB565(JsGraphics *gfx, short x, short y, const unsigned int *palette) {
+  unsigned int c = gfx->getPixel(gfx, x, y);
+  if (palette) return palette[c];
+  switch (gfx->data.bpp) {
+    case 16: return c;
+    case 24:
+    case 32: return ((c>>8)&0xF800) | ((c>>5)&0x07E0) | ((c>>3)&0x001F);
+    default: { // greyscale
+      unsigned int max = (1U<<gfx->data.bpp)-1;
+      unsigned int v = c*255/max;
+      return ((v>>3)<<11) | ((v>>2)<<5) | (v>>3);
+    }
+  }
+}
+
+/*JSON{ "type":"method", "class": "Graphics", "name" : "flipTo",
+         "description" : ["Send the area of this ArrayBuffer Graphics that has been modified since the last flip to an SPI display, converting it to the display's pixel format as it goes (a few bytes at a time, so no copy of the frame is needed). The modified area is then reset.",
+                          "`format` is either `\"rgb565\"` (default) - 16 bit colour, big-endian, row by row, as used by ST7735/ILI9341 displays - or `\"1bpp\"` - 1 bit per pixel in pages of 8 rows, with a byte for each column (lowest bit at the top), as used by SSD1306/PCD8544 displays.",
+                          "For `rgb565`, 16 bit pixels are sent as they are, 24 and 32 bit pixels are treated as RGB888, and others as greyscale unless `palette` is given. For `1bpp`, pixels are on if they are nonzero.",
+                          "If `window` is `true`, `dc` must be given and the display's address window is set before the data is sent (with the CASET/RASET/RAMWR commands for `rgb565` and the column/page address commands 0x21/0x22 for `1bpp`). `window` can also be a function `function(x1,y1,x2,y2)` that is called to set the window. For `1bpp`, y1 and y2 are expanded to whole pages. If there's no `window` then the whole frame is sent.",
+                          "`spi` can also be any object with a `send(data)` method (eg. a software SPI implementation), which is called with Strings of data." ],
+         "generate" : "jswrap_graphics_flipTo",
+         "params" : [ [ "spi", "JsVar", "The SPI device to send to (eg. `SPI1`)" ],
+                      [ "options", "JsVar", "An object `{ format : \"rgb565\"/\"1bpp\", window : true/function, dc : pin, cs : pin, palette : Array }` - all optional" ] ]
+}*/
+void jswrap_graphics_flipTo(JsVar *parent, JsVar *spi, JsVar *options) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
+  if (gfx.data.type != JSGRAPHICSTYPE_ARRAYBUFFER) {
+    jsError("flipTo only works for Graphics created with createArrayBuffer");
+    return;
+  }
+  if (!jsvIsObject(spi)) {
+    jsError("Expecting an SPI device, got %t", spi);
+    return;
+  }
+  JsGraphicsFlipTo f;
+  f.spi = spi;
+  f.length = 0;
+  f.device = EV_NONE;
+  f.sendFn = jsvObjectGetChild(spi, "send", 0);
+  if (!jsvIsFunction(f.sendFn)) {
+    jsvUnLock(f.sendFn);
+    f.sendFn = 0;
+    f.device = jsiGetDeviceFromClass(spi);
+    if (f.device<EV_SPI1 || f.device>EV_SPI_MAX) {
+      jsError("Expecting an SPI device or an object with a send method");
+      return;
+    }
+  }
+
+  bool pages = false;
+  JsVar *windowVar = 0;
+  Pin cs = PIN_UNDEFINED;
+  f.dc = PIN_UNDEFINED;
+  unsigned int paletteData[gfx.data.bpp<=8 ? 1<<gfx.data.bpp : 1];
+  const unsigned int *palette = 0;
+  if (jsvIsObject(options)) {
+    JsVar *v = jsvObjectGetChild(options, "format", 0);
+    if (jsvIsString(v) && jsvIsStringEqual(v, "1bpp")) pages = true;
+    else if (!jsvIsUndefined(v) && !(jsvIsString(v) && jsvIsStringEqual(v, "rgb565"))) {
+      jsError("Unknown format - expecting \"rgb565\" or \"1bpp\"");
+      jsvUnLock(v);
+      jsvUnLock(f.sendFn);
+      return;
+    }
+    jsvUnLock(v);
+    windowVar = jsvObjectGetChild(options, "window", 0);
+    f.dc = jshGetPinFromVarAndUnLock(jsvObjectGetChild(options, "dc", 0));
+    cs = jshGetPinFromVarAndUnLock(jsvObjectGetChild(options, "cs", 0));
+    v = jsvObjectGetChild(options, "palette", 0);
+    if (!jsvIsUndefined(v) && !pages) {
+      if (!jswrap_graphics_getPalette(v, gfx.data.bpp, paletteData)) {
+        jsvUnLock(v);
+        jsvUnLock(windowVar);
+        jsvUnLock(f.sendFn);
+        return;
+      }
+      palette = paletteData;
+    }
+    jsvUnLock(v);
+  }
+  bool windowFn = jsvIsFunction(windowVar);
+  bool windowCmd = !windowFn && jsvGetBool(windowVar);
+  if (windowCmd && f.dc==PIN_UNDEFINED) {
+    jsError("window:true needs a dc pin");
+    jsvUnLock(windowVar);
+    jsvUnLock(f.sendFn);
+    return;
+  }
+
+  // work out what to send
+  int x1 = gfx.data.modMinX, y1 = gfx.data.modMinY, x2 = gfx.data.modMaxX, y2 = gfx.data.modMaxY;
+  if (!windowFn && !windowCmd) {
+    // the display's window can't be set, so send everything
+    x1 = 0;
+    y1 = 0;
+    x2 = gfx.data.width-1;
+    y2 = gfx.data.height-1;
+  }
+  if (pages) {
+    y1 = y1&~7;
+    y2 = y2|7;
+    if (y2 >= gfx.data.height) y2 = gfx.data.height-1;
+  }
+  /* Reset the modified area now, as the window and send callbacks can use this Graphics too (eg.
+   * setColor) and we mustn't write our copy back over their changes afterwards. Anything they draw
+   * is then sent next time */
+  graphicsClearModified(&gfx);
+  graphicsSetVar(&gfx);
+  if (x2>=x1 && y2>=y1) {
+    if (windowFn) {
+      JsVar *args[4];
+      args[0] = jsvNewFromInteger(x1);
+      args[1] = jsvNewFromInteger(y1);
+      args[2] = jsvNewFromInteger(x2);
+      args[3] = jsvNewFromInteger(y2);
+      jspExecuteFunction(windowVar, parent, 4, args);
+      jsvUnLock(args[0]);
+      jsvUnLock(args[1]);
+      jsvUnLock(args[2]);
+      jsvUnLock(args[3]);
+    }
+    if (cs!=PIN_UNDEFINED) jshPinOutput(cs, false);
+    if (windowCmd) {
+      if (pages) {
+        jswrap_graphics_flipToCommand(&f, 0x21); // column address
+        jswrap_graphics_flipToCommand(&f, (unsigned char)x1);
+        jswrap_graphics_flipToCommand(&f, (unsigned char)x2);
+        jswrap_graphics_flipToCommand(&f, 0x22); // page address
+        jswrap_graphics_flipToCommand(&f, (unsigned char)(y1>>3));
+        jswrap_graphics_flipToCommand(&f, (unsigned char)(y2>>3));
+      } else {
+        jswrap_graphics_flipToCommand(&f, 0x2A); // CASET
+        jswrap_graphics_flipToByte(&f, (unsigned char)(x1>>8));
+        jswrap_graphics_flipToByte(&f, (unsigned char)x1);
+        jswrap_graphics_flipToByte(&f, (unsigned char)(x2>>8));
+        jswrap_graphics_flipToByte(&f, (unsigned char)x2);
+        jswrap_graphics_flipToCommand(&f, 0x2B); // RASET
+        jswrap_graphics_flipToByte(&f, (unsigned char)(y1>>8));
+        jswrap_graphics_flipToByte(&f, (unsigned char)y1);
+        jswrap_graphics_flipToByte(&f, (unsigned char)(y2>>8));
+        jswrap_graphics_flipToByte(&f, (unsigned char)y2);
+        jswrap_graphics_flipToCommand(&f, 0x2C); // RAMWR
+      }
+    } else if (f.dc!=PIN_UNDEFINED)
+      jshPinOutput(f.dc, true); // data
+    int x, y;
+    if (pages) {
+      for (y=y1;y<=y2;y+=8) {
+        for (x=x1;x<=x2;x++) {
+          unsigned char b = 0;
+          int bit;
+          for (bit=0;bit<8 && y+bit<=y2;bit++)
+            if (gfx.getPixel(&gfx, (short)x, (short)(y+bit))) b |= (unsigned char)(1<<bit);
+          jswrap_graphics_flipToByte(&f, b);
+        }
+        if (jspIsInterrupted()) break;
+      }
+    } else {
+      for (y=y1;y<=y2;y++) {
+        for (x=x1;x<=x2;x++) {
+          unsigned int c = jswrap_graphics_flipToRGB565(&gfx, (short)x, (short)y, palette);
+          jswrap_graphics_flipToByte(&f, (unsigned char)(c>>8));
+          jswrap_graphics_flipToByte(&f, (unsigned char)c);
+        }
+        if (jspIsInterrupted()) break;
+      }
+    }
+    jswrap_graphics_flipToSend(&f);
+    if (cs!=PIN_UNDEFINED) jshPinOutput(cs, true);
+  }
+  jsvUnLock(windowVar);
+  jsvUnLock(f.sendFn);
+}
+
+/*JSON{ "type":"method", "class": "Graphics", "name" : "drawImage",
+         "description" : ["Draw an image at the specified position. Pixels of 1 bit images are drawn in the foreground colour if set, or the background colour if not. Other images are drawn with the pixel values as colours.",
+                          "The image's pixels are packed row by row, in the same way as the `buffer` of a Graphics created with `Graphics.createArrayBuffer` (so the first pixel is in the lowest bits of the first byte, and 16 bit pixels are little-endian)." ],
+         "generate" : "jswrap_graphics_drawImage",
+         "params" : [ [ "image", "JsVar", ["An object with the following fields `{ width : int, height : int, bpp : int, buffer : ArrayBuffer/String }`. bpp = bits per pixel (1,2,4,8,16,24 or 32)",
+                                           "This can also be another Graphics created with `Graphics.createArrayBuffer` (without `zigzag` or `vertical_byte`), so that off-screen layers can be composited onto this one"] ],
+                      [ "x", "int32", "The X offset to draw the image" ],
+                      [ "y", "int32", "The Y offset to draw the image" ],
+                      [ "options", "JsVar", ["An optional object of the form `{ transparent : int, rotate90 : bool, scale : int, palette : Array }`",
+                                             "transparent = pixels of this value (before any colour mapping) are not drawn",
+                                             "rotate90 = rotate the image 90 degrees clockwise",
+                                             "scale = an integer to scale the image up by (default is 1)",
+                                             "palette = for images of 8 bpp or less, an Array or ArrayBuffer of the colour to draw for each pixel value (it must have `1<<bpp` elements)"] ] ]
+}*/
+void jswrap_graphics_drawImage(JsVar *parent, JsVar *image, int x, int y, JsVar *options) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
+
+  if (!jsvIsObject(image)) {
+    jsError("Expecting first argument to be an object");
+    return;
+  }
+  JsGraphicsImage img;
+  int width, height, bpp;
+  JsVar *layerData = jsvObjectGetChild(image, JS_HIDDEN_CHAR_STR"gfx", 0);
+  if (layerData) {
+    // Another Graphics - we can draw its buffer directly if it's packed like an image
+    jsvUnLock(layerData);
+    JsGraphics layer; if (!graphicsGetFromVar(&layer, image)) return;
+    if (layer.data.type != JSGRAPHICSTYPE_ARRAYBUFFER ||
+        (layer.data.flags & (JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG|JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE))) {
+      jsError("Can only draw Graphics created with createArrayBuffer (without zigzag or vertical_byte)");
+      return;
+    }
+    width = layer.data.width;
+    height = layer.data.height;
+    bpp = layer.data.bpp;
+  } else {
+    width = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(image, "width", 0));
+    height = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(image, "height", 0));
+    bpp = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(image, "bpp", 0));
+  }
+  if (width<=0 || height<=0 || width>1023 || height>1023) {
+    jsError("Invalid image size");
+    return;
+  }
+  if (!(bpp==1 || bpp==2 || bpp==4 || bpp==8 || bpp==16 || bpp==24 || bpp==32)) {
+    jsError("Invalid image bpp");
+    return;
+  }
+  img.width = (unsigned short)width;
+  img.height = (unsigned short)height;
+  img.bpp = (unsigned char)bpp;
+  img.hasTransparent = false;
+  img.transparent = 0;
+  img.rotate90 = false;
+  img.scale = 1;
+  img.palette = 0;
+  unsigned int palette[bpp<=8 ? 1<<bpp : 1];
+  if (jsvIsObject(options)) {
+    JsVar *v = jsvObjectGetChild(options, "transparent", 0);
+    if (!jsvIsUndefined(v)) {
+      img.hasTransparent = true;
+      img.transparent = (unsigned int)jsvGetInteger(v);
+    }
+    jsvUnLock(v);
+    img.rotate90 = jsvGetBoolAndUnLock(jsvObjectGetChild(options, "rotate90", 0));
+    v = jsvObjectGetChild(options, "scale", 0);
+    if (!jsvIsUndefined(v)) {
+      int scale = (int)jsvGetInteger(v);
+      if (scale<1) scale = 1;
+      if (scale>255) scale = 255;
+      img.scale = (unsigned char)scale;
+    }
+    jsvUnLock(v);
+    v = jsvObjectGetChild(options, "palette", 0);
+    if (!jsvIsUndefined(v)) {
+      if (!jswrap_graphics_getPalette(v, bpp, palette)) {
+        jsvUnLock(v);
+        return;
+      }
+      img.palette = palette;
+    }
+    jsvUnLock(v);
+  }
+
+  size_t needed = ((size_t)width*(size_t)height*(size_t)bpp + 7) >> 3;
+  JsVar *buffer = jsvObjectGetChild(image, "buffer", 0);
+  const char *data = 0;
+  size_t length = 0;
+  if (jsvIsArrayBuffer(buffer)) {
+    data = jsvGetArrayBufferPointer(buffer, &length);
+    if (!data) length = jsvGetArrayBufferLength(buffer) * JSV_ARRAYBUFFER_GET_SIZE(buffer->varData.arraybuffer.type);
+  } else if (jsvIsString(buffer)) {
+    length = jsvGetStringLength(buffer);
+  } else {
+    jsError("Expecting image buffer to be an ArrayBuffer or a String");
+    jsvUnLock(buffer);
+    return;
+  }
+  if (length < needed) {
+    jsError("Image buffer too small (%d bytes, need %d)", (int)length, (int)needed);
+    jsvUnLock(buffer);
+    return;
+  }
+  img.dataVar = 0;
+  img.dataOffset = 0;
+  if (!data) {
+    // not in one flat block - graphicsDrawImage reads the String it's in as it goes
+    if (jsvIsString(buffer)) {
+      img.dataVar = jsvLockAgain(buffer);
+    } else {
+      img.dataOffset = buffer->varData.arraybuffer.byteOffset;
+      img.dataVar = jsvLock(buffer->firstChild);
+      while (jsvIsArrayBuffer(img.dataVar)) {
+        JsVar *s = jsvLock(img.dataVar->firstChild);
+        jsvUnLock(img.dataVar);
+        img.dataVar = s;
+      }
+    }
+    if (!jsvIsString(img.dataVar)) { // eg. a view past the end of a flat buffer
+      jsError("Image buffer too small");
+      jsvUnLock(img.dataVar);
+      jsvUnLock(buffer);
+      return;
+    }
+  }
+  img.data = (const unsigned char*)data;
+  graphicsDrawImage(&gfx, (short)x, (short)y, &img);
+  jsvUnLock(img.dataVar);
+  jsvUnLock(buffer);
+  graphicsSetVar(&gfx); // modified area changed
+}
+
 /*JSON{ "type":"method", "class": "Graphics", "name" : "drawLine",
          "description" : "Draw a line between x1,y1 and x2,y2 in the current foreground color",
          "generate" : "jswrap_graphics_drawLine",
@@ -529,6 +1064,7 @@ JsVarInt jswrap_graphics_stringWidth(JsVar *parent, JsVar *var) {
 void jswrap_graphics_drawLine(JsVar *parent, int x1, int y1, int x2, int y2) {
   JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
   graphicsDrawLine(&gfx, (short)x1,(short)y1,(short)x2,(short)y2);
+  graphicsSetVar(&gfx); // modified area changed
 }
 
 /*JSON{ "type":"method", "class": "Graphics", "name" : "lineTo",
@@ -558,8 +1094,39 @@ void jswrap_graphics_moveTo(JsVar *parent, int x, int y) {
   graphicsSetVar(&gfx);
 }
 
+/*JSON{ "type":"method", "class": "Graphics", "name" : "setClipRect",
+         "description" : ["Only draw inside the given rectangle (inclusive). Everything that is drawn is clipped to it, which is handy for redrawing just part of the screen.",
+                          "To draw on the whole screen again, use `g.setClipRect(0,0,g.getWidth()-1,g.getHeight()-1)`" ],
+         "generate" : "jswrap_graphics_setClipRect",
+         "params" : [ [ "x1", "int32", "The left" ],
+                      [ "y1", "int32", "The top" ],
+                      [ "x2", "int32", "The right" ],
+                      [ "y2", "int32", "The bottom" ] ]
+}*/
+void jswrap_graphics_setClipRect(JsVar *parent, int x1, int y1, int x2, int y2) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
+  graphicsSetClipRect(&gfx, x1, y1, x2, y2);
+  graphicsSetVar(&gfx);
+}
+
+/*JSON{ "type":"method", "class": "Graphics", "name" : "setAntialias",
+         "description" : ["Set whether polygons and vector fonts are antialiased. This only works when there are 8 or more bits per pixel. The edges are blended with the background color, so this works best when drawing onto areas that have been cleared.",
+                          "16 bit colours are treated as RGB565, 24 and 32 bit colours as RGB888, and 8 bit colours as intensities" ],
+         "generate" : "jswrap_graphics_setAntialias",
+         "params" : [ [ "antialias", "bool", "Whether to antialias" ] ]
+}*/
+void jswrap_graphics_setAntialias(JsVar *parent, bool antialias) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return;
+  if (antialias)
+    gfx.data.flags = (JsGraphicsFlags)(gfx.data.flags | JSGRAPHICSFLAGS_ANTIALIAS);
+  else
+    gfx.data.flags = (JsGraphicsFlags)(gfx.data.flags & ~(unsigned int)JSGRAPHICSFLAGS_ANTIALIAS);
+  graphicsSetVar(&gfx);
+}
+
 /*JSON{ "type":"method", "class": "Graphics", "name" : "fillPoly",
-         "description" : "Draw a filled polygon in the current foreground color",
+         "description" : ["Draw a filled polygon in the current foreground color. Vertices are at the centres of pixels, and every pixel that is inside the polygon or that an edge passes through is filled - so a square from 0,0 to 10,10 fills the same pixels as `fillRect(0,0,10,10)` (11x11), and even a zero-width polygon draws a line.",
+                          "When antialiasing (see `setAntialias`) pixel x,y instead covers x to x+1 and y to y+1, and pixels on the edges are blended by how much of them is covered" ],
          "generate" : "jswrap_graphics_fillPoly",
          "params" : [ [ "poly", "JsVar", "An array of vertices, of the form ```[x1,y1,x2,y2,x3,y3,etc]```" ] ]
 }*/
@@ -580,5 +1147,6 @@ void jswrap_graphics_fillPoly(JsVar *parent, JsVar *poly) {
     jsWarn("Maximum number of points (%d) exceeded for fillPoly", maxVerts/2);
   }
   graphicsFillPoly(&gfx, idx/2, verts);
+  graphicsSetVar(&gfx); // modified area changed
 }
 
@@ -19,12 +19,13 @@
 
 bool jswrap_graphics_idle();
 void jswrap_graphics_init();
+void jswrap_graphics_kill();
 
 // For creating graphics classes
 JsVar *jswrap_graphics_createArrayBuffer(int width, int height, int bpp,  JsVar *options);
 JsVar *jswrap_graphics_createCallback(int width, int height, int bpp, JsVar *callback);
 #ifdef USE_LCD_SDL
-JsVar *jswrap_graphics_createSDL(int width, int height);
+JsVar *jswrap_graphics_createSDL(int width, int height, JsVar *ppmFile);
 #endif
 
 
@@ -40,7 +41,13 @@ void jswrap_graphics_setFontSizeX(JsVar *parent, int size, bool checkValid);
 void jswrap_graphics_setFontCustom(JsVar *parent, JsVar *bitmap, int firstChar, JsVar *width, int height);
 void jswrap_graphics_drawString(JsVar *parent, JsVar *str, int x, int y);
 JsVarInt jswrap_graphics_stringWidth(JsVar *parent, JsVar *var);
+JsVar *jswrap_graphics_getModified(JsVar *parent, bool reset);
+void jswrap_graphics_flip(JsVar *parent);
+void jswrap_graphics_flipTo(JsVar *parent, JsVar *spi, JsVar *options);
+void jswrap_graphics_drawImage(JsVar *parent, JsVar *image, int x, int y, JsVar *options);
 void jswrap_graphics_drawLine(JsVar *parent, int x1, int y1, int x2, int y2);
 void jswrap_graphics_lineTo(JsVar *parent, int x, int y);
 void jswrap_graphics_moveTo(JsVar *parent, int x, int y);
+void jswrap_graphics_setClipRect(JsVar *parent, int x1, int y1, int x2, int y2);
+void jswrap_graphics_setAntialias(JsVar *parent, bool antialias);
 void jswrap_graphics_fillPoly(JsVar *parent, JsVar *poly);
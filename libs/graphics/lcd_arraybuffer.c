@@ -26,61 +26,214 @@ size_t lcdGetPixelIndex_ArrayBuffer(JsGraphics *gfx, int x, int y, int pixelCoun
     return (size_t)((x + y*gfx->data.width)*gfx->data.bpp);
 }
 
+#ifdef FLAT_ARRAYBUFFERS
+/* The framebuffer is flat, so gfx->backendData points straight at it (see lcdSetCallbacks_ArrayBuffer).
+ * Everything below writes spans of one colour directly into it, specialised for each bpp */
+
+// Write count pixels of bytesPerPixel bytes each (16, 24 or 32 bpp), little-endian
+static void lcdFillBytes_ArrayBuffer(unsigned char *ptr, int count, int bytesPerPixel, unsigned int col) {
+  unsigned char pattern[4] = { (unsigned char)col, (unsigned char)(col>>8), (unsigned char)(col>>16), (unsigned char)(col>>24) };
+  if (bytesPerPixel==3) {
+    while (count--) {
+      *(ptr++) = pattern[0];
+      *(ptr++) = pattern[1];
+      *(ptr++) = pattern[2];
+    }
+    return;
+  }
+  if (bytesPerPixel==2) {
+    if (pattern[0]==pattern[1]) { // eg. black or white
+      memset(ptr, pattern[0], (size_t)count*2);
+      return;
+    }
+    pattern[2] = pattern[0];
+    pattern[3] = pattern[1];
+  }
+  // write single pixels until we're word aligned
+  while (count>0 && ((size_t)ptr&3)) {
+    memcpy(ptr, pattern, (size_t)bytesPerPixel);
+    ptr += bytesPerPixel;
+    count--;
+  }
+  // then whole words
+  uint32_t word;
+  memcpy(&word, pattern, 4);
+  uint32_t *wptr = (uint32_t*)ptr;
+  int words = count*bytesPerPixel/4;
+  int i;
+  for (i=0;i<words;i++)
+    wptr[i] = word;
+  ptr += words*4;
+  count -= words*4/bytesPerPixel;
+  if (count>0) memcpy(ptr, pattern, (size_t)bytesPerPixel);
+}
+
+// Fill pixelCount pixels starting at the given bit index (not for VERTICAL_BYTE)
+static void lcdFillSpan_ArrayBuffer(JsGraphics *gfx, size_t idx, int pixelCount, unsigned int col) {
+  unsigned char *data = (unsigned char*)gfx->backendData;
+  unsigned int bpp = gfx->data.bpp;
+  if (bpp<8) {
+    unsigned int mask = (1U<<bpp)-1;
+    unsigned char pattern = (unsigned char)((col&mask) * (0xFF/mask)); // col repeated across a whole byte
+    unsigned char *ptr = &data[idx>>3];
+    unsigned int bit = (unsigned int)(idx&7);
+    unsigned int bits = (unsigned int)pixelCount*bpp;
+    if (bit) { // partial first byte
+      unsigned int n = 8-bit;
+      if (n>bits) n=bits;
+      unsigned char m = (unsigned char)(((1U<<n)-1) << bit);
+      *ptr = (unsigned char)((*ptr & ~m) | (pattern & m));
+      ptr++;
+      bits -= n;
+    }
+    memset(ptr, pattern, bits>>3);
+    ptr += bits>>3;
+    bits &= 7;
+    if (bits) { // partial last byte
+      unsigned char m = (unsigned char)((1U<<bits)-1);
+      *ptr = (unsigned char)((*ptr & ~m) | (pattern & m));
+    }
+  } else if (bpp==8) {
+    memset(&data[idx>>3], (int)(col&0xFF), (size_t)pixelCount);
+  } else {
+    lcdFillBytes_ArrayBuffer(&data[idx>>3], pixelCount, (int)(bpp>>3), col);
+  }
+}
+
+// Fill a rectangle of a 1bpp VERTICAL_BYTE buffer, where each byte is 8 pixels stacked vertically
+static void lcdFillRectVertical_ArrayBuffer(JsGraphics *gfx, short x1, short y1, short x2, short y2, unsigned int col) {
+  unsigned char *data = (unsigned char*)gfx->backendData;
+  int page;
+  for (page=y1>>3;page<=(y2>>3);page++) {
+    int top = page*8 < y1 ? (y1&7) : 0;
+    int bottom = page*8+7 > y2 ? (y2&7) : 7;
+    unsigned char m = (unsigned char)(((2U<<bottom)-1) & ~((1U<<top)-1));
+    unsigned char *ptr = &data[x1 + page*gfx->data.width];
+    int x;
+    if (col&1) {
+      for (x=x1;x<=x2;x++) *(ptr++) |= m;
+    } else {
+      m = (unsigned char)~m;
+      for (x=x1;x<=x2;x++) *(ptr++) &= m;
+    }
+  }
+}
+#endif
+
+/* If the framebuffer isn't flat, its data is a chain of String blocks. gfx->backendVar is the String
+ * (see lcdSetCallbacks_ArrayBuffer), and gfx->backendBlock remembers the last block we got to - so
+ * each span in an operation doesn't have to walk the chain from the start again */
+static void lcdIteratorNew_ArrayBuffer(JsGraphics *gfx, JsvStringIterator *it, size_t byteIdx) {
+  JsVar *str;
+  size_t start = 0;
+  if (gfx->backendBlock && byteIdx>=gfx->backendBlockStart) {
+    str = jsvLock(gfx->backendBlock);
+    start = gfx->backendBlockStart;
+  } else
+    str = jsvLockAgain(gfx->backendVar);
+  jsvStringIteratorNew(it, str, byteIdx-start);
+  jsvUnLock(str);
+  it->varIndex += start; // so it's the index in the whole String
+}
+
+static void lcdIteratorFree_ArrayBuffer(JsGraphics *gfx, JsvStringIterator *it) {
+  if (it->var) {
+    gfx->backendBlock = jsvGetRef(it->var);
+    gfx->backendBlockStart = it->varIndex;
+  }
+  jsvStringIteratorFree(it);
+}
+
+/* Write count pixels starting at the given bit index with one iterator - all the
+ * colour col, or the colours in cols if it's set */
+static void lcdWritePixels_ArrayBuffer(JsGraphics *gfx, size_t idx, int count, unsigned int col, const unsigned int *cols) {
+  JsvStringIterator it;
+  lcdIteratorNew_ArrayBuffer(gfx, &it, idx>>3);
+  unsigned int bpp = gfx->data.bpp;
+  int p;
+  if (bpp < 8) { // writing individual bits
+    unsigned int mask = (1U<<bpp)-1;
+    unsigned int bit = (unsigned int)(idx&7);
+    bool vertical = (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE)!=0;
+    for (p=0;p<count;p++) {
+      if (cols) col = cols[p];
+      unsigned int existing = (unsigned char)jsvStringIteratorGetChar(&it);
+      jsvStringIteratorSetChar(&it, (char)((existing&~(mask<<bit)) | ((col&mask)<<bit)));
+      if (vertical) {
+        jsvStringIteratorNextInline(&it);
+      } else {
+        bit += bpp;
+        if (bit>=8) {
+          bit = 0;
+          jsvStringIteratorNextInline(&it);
+        }
+      }
+    }
+  } else { // we're writing whole bytes
+    unsigned int i;
+    for (p=0;p<count;p++) {
+      if (cols) col = cols[p];
+      for (i=0;i<bpp;i+=8) {
+        jsvStringIteratorSetChar(&it, (char)(col >> i));
+        jsvStringIteratorNextInline(&it);
+      }
+    }
+  }
+  lcdIteratorFree_ArrayBuffer(gfx, &it);
+}
+
 unsigned int lcdGetPixel_ArrayBuffer(JsGraphics *gfx, short x, short y) {
   unsigned int col = 0;
-  JsVar *buf = jsvObjectGetChild(gfx->graphicsVar, "buffer", 0);
-  if (buf && jsvIsArrayBuffer(buf)) {
+#ifdef FLAT_ARRAYBUFFERS
+  if (gfx->backendData) {
+    if (x<0 || y<0 || x>=gfx->data.width || y>=gfx->data.height) return 0;
+    const unsigned char *data = (const unsigned char*)gfx->backendData;
     size_t idx = lcdGetPixelIndex_ArrayBuffer(gfx,x,y,1);
-    JsvArrayBufferIterator it;
-    jsvArrayBufferIteratorNew(&it, buf, idx>>3 );
     if (gfx->data.bpp < 8) {
-      idx = idx & 7;
       unsigned int mask = (unsigned int)(1<<gfx->data.bpp)-1;
-      unsigned int existing = (unsigned int)jsvArrayBufferIteratorGetIntegerValue(&it);
-      col = ((existing>>idx)&mask);
+      col = (data[idx>>3]>>(idx&7))&mask;
+    } else {
+      int i;
+      for (i=0;i<gfx->data.bpp;i+=8)
+        col |= ((unsigned int)data[(idx>>3)+(size_t)(i>>3)]) << i;
+    }
+    return col;
+  }
+#endif
+  if (gfx->backendVar) {
+    size_t idx = lcdGetPixelIndex_ArrayBuffer(gfx,x,y,1);
+    JsvStringIterator it;
+    lcdIteratorNew_ArrayBuffer(gfx, &it, idx>>3);
+    if (gfx->data.bpp < 8) {
+      unsigned int mask = (unsigned int)(1<<gfx->data.bpp)-1;
+      col = ((unsigned int)(unsigned char)jsvStringIteratorGetChar(&it) >> (idx&7)) & mask;
     } else {
       int i;
       for (i=0;i<gfx->data.bpp;i+=8) {
-        col |= ((unsigned int)jsvArrayBufferIteratorGetIntegerValue(&it)) << i;
-        jsvArrayBufferIteratorNext(&it);
+        col |= ((unsigned int)(unsigned char)jsvStringIteratorGetChar(&it)) << i;
+        jsvStringIteratorNextInline(&it);
       }
     }
-    jsvArrayBufferIteratorFree(&it);
+    lcdIteratorFree_ArrayBuffer(gfx, &it);
   }
   return col;
 }
 
 // set pixelCount pixels starting at x,y
 void lcdSetPixels_ArrayBuffer(JsGraphics *gfx, short x, short y, short pixelCount, unsigned int col) {
-  JsVar *buf = jsvObjectGetChild(gfx->graphicsVar, "buffer", 0);
-  if (buf && jsvIsArrayBuffer(buf)) {
-    size_t idx = lcdGetPixelIndex_ArrayBuffer(gfx,x,y,pixelCount);
-    JsvArrayBufferIterator it;
-    jsvArrayBufferIteratorNew(&it, buf, idx>>3 );
-    short p;
-    for (p=0;p<pixelCount;p++) { // writing individual bits
-      if (gfx->data.bpp < 8) {
-        idx = idx & 7;
-        unsigned int mask = (unsigned int)(1<<gfx->data.bpp)-1;
-        unsigned int existing = (unsigned int)jsvArrayBufferIteratorGetIntegerValue(&it);
-        jsvArrayBufferIteratorSetIntegerValue(&it, (existing&~(mask<<idx)) | ((col&mask)<<idx));
-        if (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE) {
-          jsvArrayBufferIteratorNext(&it);
-        } else {
-          idx += gfx->data.bpp;
-          if (idx>=8) jsvArrayBufferIteratorNext(&it);
-        }
-      } else { // we're writing whole bytes
-        int i;
-        for (i=0;i<gfx->data.bpp;i+=8) {
-          jsvArrayBufferIteratorSetIntegerValue(&it, col >> i);
-          jsvArrayBufferIteratorNext(&it);
-        }
-      }
-    }
-    jsvArrayBufferIteratorFree(&it);
-    jsvUnLock(buf);
+#ifdef FLAT_ARRAYBUFFERS
+  if (gfx->backendData) {
+    if (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE) {
+      if ((gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG) && (y&1))
+        x = (short)(gfx->data.width - (x+pixelCount));
+      lcdFillRectVertical_ArrayBuffer(gfx, x, y, (short)(x+pixelCount-1), y, col);
+    } else
+      lcdFillSpan_ArrayBuffer(gfx, lcdGetPixelIndex_ArrayBuffer(gfx,x,y,pixelCount), pixelCount, col);
+    return;
   }
+#endif
+  if (gfx->backendVar)
+    lcdWritePixels_ArrayBuffer(gfx, lcdGetPixelIndex_ArrayBuffer(gfx,x,y,pixelCount), pixelCount, col, 0);
 }
 
 
@@ -105,20 +258,116 @@ void  lcdFillRect_ArrayBuffer(struct JsGraphics *gfx, short x1, short y1, short
   if (x2>=gfx->data.width) x2 = (short)(gfx->data.width - 1);
   if (y2>=gfx->data.height) y2 = (short)(gfx->data.height - 1);
   if (x2<x1 || y2<y1) return; // nope
+#ifdef FLAT_ARRAYBUFFERS
+  if (gfx->backendData && !(gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG)) {
+    if (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE) {
+      lcdFillRectVertical_ArrayBuffer(gfx, x1, y1, x2, y2, gfx->data.fgColor);
+    } else if (x1==0 && x2==gfx->data.width-1) {
+      // whole rows are contiguous, so do them as one span
+      lcdFillSpan_ArrayBuffer(gfx, lcdGetPixelIndex_ArrayBuffer(gfx,0,y1,1), (1+y2-y1)*gfx->data.width, gfx->data.fgColor);
+    } else {
+      size_t idx = lcdGetPixelIndex_ArrayBuffer(gfx,x1,y1,1);
+      size_t stride = (size_t)gfx->data.width*gfx->data.bpp;
+      short y;
+      for (y=y1;y<=y2;y++,idx+=stride)
+        lcdFillSpan_ArrayBuffer(gfx, idx, 1+x2-x1, gfx->data.fgColor);
+    }
+    return;
+  }
+#endif
   short y;
   for (y=y1;y<=y2;y++)
     lcdSetPixels_ArrayBuffer(gfx, x1, y, (short)(1+x2-x1), gfx->data.fgColor);
 }
 
+// The number of bytes needed to store the whole framebuffer
+static size_t lcdGetBufferSize_ArrayBuffer(JsGraphics *gfx) {
+  if (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE)
+    return (size_t)gfx->data.width * (size_t)((gfx->data.height+7)>>3);
+  return ((size_t)gfx->data.width * gfx->data.height * gfx->data.bpp + 7) >> 3;
+}
+
+void lcdBlit_ArrayBuffer(JsGraphics *gfx, short x, short y, unsigned short count, const unsigned int *cols) {
+  unsigned short i;
+#ifdef FLAT_ARRAYBUFFERS
+  if (gfx->backendData && !(gfx->data.flags & (JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG|JSGRAPHICSFLAGS_ARRAYBUFFER_VERTICAL_BYTE))) {
+    size_t idx = lcdGetPixelIndex_ArrayBuffer(gfx,x,y,1);
+    unsigned char *ptr = &((unsigned char*)gfx->backendData)[idx>>3];
+    switch (gfx->data.bpp) {
+      case 8:
+        for (i=0;i<count;i++) *(ptr++) = (unsigned char)cols[i];
+        break;
+      case 16:
+        for (i=0;i<count;i++) {
+          *(ptr++) = (unsigned char)cols[i];
+          *(ptr++) = (unsigned char)(cols[i]>>8);
+        }
+        break;
+      case 24:
+      case 32: {
+        int b, bytes = gfx->data.bpp>>3;
+        for (i=0;i<count;i++)
+          for (b=0;b<bytes;b++)
+            *(ptr++) = (unsigned char)(cols[i]>>(b*8));
+        break;
+      }
+      default: { // 1, 2 or 4 bpp
+        unsigned int bpp = gfx->data.bpp;
+        unsigned int mask = (1U<<bpp)-1;
+        unsigned int bit = (unsigned int)(idx&7);
+        for (i=0;i<count;i++) {
+          *ptr = (unsigned char)((*ptr & ~(mask<<bit)) | ((cols[i]&mask)<<bit));
+          bit += bpp;
+          if (bit>=8) {
+            bit = 0;
+            ptr++;
+          }
+        }
+      }
+    }
+    return;
+  }
+#endif
+  if (gfx->backendVar && !((gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG) && (y&1))) {
+    // one iterator for the whole run (zigzag rows are reversed, so those go a pixel at a time)
+    lcdWritePixels_ArrayBuffer(gfx, lcdGetPixelIndex_ArrayBuffer(gfx,x,y,count), count, 0, cols);
+    return;
+  }
+  for (i=0;i<count;i++)
+    lcdSetPixels_ArrayBuffer(gfx, (short)(x+i), y, 1, cols[i]);
+}
+
 void lcdInit_ArrayBuffer(JsGraphics *gfx) {
   // create buffer
-  JsVar *buf = jswrap_arraybuffer_constructor(gfx->data.width * gfx->data.height * gfx->data.bpp / 8);
+  JsVar *buf = jswrap_arraybuffer_constructor((JsVarInt)lcdGetBufferSize_ArrayBuffer(gfx));
   jsvAddNamedChild(gfx->graphicsVar, buf, "buffer");
   jsvUnLock(buf);
 }
 
 void lcdSetCallbacks_ArrayBuffer(JsGraphics *gfx) {
+  gfx->backendData = 0;
+  gfx->backendVar = 0;
+  gfx->backendBlock = 0;
+  gfx->backendBlockStart = 0;
+  /* Look up the buffer once for the whole call. graphicsVar is locked by our caller and references the
+   * buffer, so the data won't go away even though we don't keep the buffer itself locked. */
+  JsVar *buf = jsvObjectGetChild(gfx->graphicsVar, "buffer", 0);
+  if (jsvIsArrayBuffer(buf)) {
+#ifdef FLAT_ARRAYBUFFERS
+    size_t byteLength = 0;
+    char *data = jsvGetArrayBufferPointer(buf, &byteLength);
+    if (data && byteLength>=lcdGetBufferSize_ArrayBuffer(gfx))
+      gfx->backendData = data;
+#endif
+    if (!gfx->backendData && buf->firstChild && !buf->varData.arraybuffer.byteOffset) {
+      JsVar *str = jsvLock(buf->firstChild);
+      if (jsvIsString(str)) gfx->backendVar = str;
+      jsvUnLock(str);
+    }
+  }
+  jsvUnLock(buf);
   gfx->setPixel = lcdSetPixel_ArrayBuffer;
   gfx->getPixel = lcdGetPixel_ArrayBuffer;
   gfx->fillRect = lcdFillRect_ArrayBuffer;
+  gfx->blit = lcdBlit_ArrayBuffer;
 }
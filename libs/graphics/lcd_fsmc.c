@@ -1237,6 +1237,17 @@ void lcdBitmap1bit_FSMC(JsGraphics *gfx, short x1, short y1, unsigned short widt
   lcdSetFullWindow(gfx);
 }
 
+/* Output a row of pixels */
+void lcdBlit_FSMC(JsGraphics *gfx, short x, short y, unsigned short count, const unsigned int *cols) {
+  lcdSetWindow(gfx,x,y,x+count-1,y);
+  lcdSetCursor(gfx,x+count-1,y);
+  LCD_WR_REG(0x22); // start data tx
+  unsigned int i;
+  for(i=0;i<count;i++)
+    LCD_WR_Data(cols[i]);
+  lcdSetFullWindow(gfx);
+}
+
 unsigned int lcdGetPixel_FSMC(JsGraphics *gfx, short x, short y) {
   if (x<0 || y<0 || x>=gfx->data.width || y>=gfx->data.height) return 0;
   lcdSetCursor(gfx,x,y);
@@ -1265,5 +1276,6 @@ void lcdSetCallbacks_FSMC(JsGraphics *gfx) {
   gfx->getPixel = lcdGetPixel_FSMC;
   gfx->fillRect = lcdFillRect_FSMC;
   gfx->bitmap1bit = lcdBitmap1bit_FSMC;
+  gfx->blit = lcdBlit_FSMC;
 }
 
@@ -16,6 +16,7 @@
 #include "jsvar.h"
 #include "jsparse.h"
 #include "jsinteractive.h"
+#include "jswrap_arraybuffer.h"
 
 
 void lcdSetPixel_JS(JsGraphics *gfx, short x, short y, unsigned int col) {
@@ -57,7 +58,7 @@ void  lcdFillRect_JS(struct JsGraphics *gfx, short x1, short y1, short x2, short
   if (x2<x1 || y2<y1) return; // nope
 
   if (x1==x2 && y1==y2) {
-    lcdSetPixel_JS(gfx,x1,y1,gfx->data.fgColor);
+    graphicsSetPixel(gfx,x1,y1,gfx->data.fgColor); // masks the colour to bpp
     return;
   }
 
@@ -76,15 +77,191 @@ void  lcdFillRect_JS(struct JsGraphics *gfx, short x1, short y1, short x2, short
     jsvUnLock(args[3]);
     jsvUnLock(args[4]);
     jsvUnLock(fillRect);
+  } else {
+    // no fillRect callback - do it pixel by pixel
+    short x,y;
+    for (y=y1;y<=y2;y++)
+      for (x=x1;x<=x2;x++)
+        graphicsSetPixel(gfx,x,y,gfx->data.fgColor);
   }
 }
 
-void lcdInit_JS(JsGraphics *gfx, JsVar *setPixelCallback, JsVar *fillRectCallback) {
-  jsvAddNamedChild(gfx->graphicsVar, setPixelCallback, "iSetPixel");
-  jsvAddNamedChild(gfx->graphicsVar, fillRectCallback, "iFillRect");
+// ----------------------------------------------------------------------------------------------
+/* If a 'spans' callback was given, everything is drawn as runs of pixels of one colour. These
+ * are packed into the 'iSpanBuf' ArrayBuffer as x,y,length,colour, and the callback is called with
+ * it when it is full, on flip, or when idle. Only one Graphics can have spans waiting at once, so
+ * the state is kept here rather than in each Graphics. The callback can draw to another Graphics
+ * with spans, so the state is handed over and cleared before it is called. */
+
+static JsVar *lcdSpanGraphics = 0; ///< the Graphics that has spans waiting (locked)
+static JsVar *lcdSpanBuffer = 0; ///< its iSpanBuf (locked)
+static char *lcdSpanData = 0; ///< pointer to lcdSpanBuffer's data, if it is flat
+static int lcdSpanCount, lcdSpanBatch; ///< spans in lcdSpanBuffer, and how many will fit
+static short lcdSpanX, lcdSpanY, lcdSpanLength; ///< the span that is being extended (not in lcdSpanBuffer yet). None if lcdSpanLength==0
+static unsigned int lcdSpanColor;
+
+static void lcdSpanSetElement_JS(int idx, unsigned int value) {
+  if (lcdSpanData) {
+    if (lcdSpanBuffer->varData.arraybuffer.type == ARRAYBUFFERVIEW_UINT32) {
+      uint32_t v = value;
+      memcpy(&lcdSpanData[idx*4], &v, 4);
+    } else {
+      uint16_t v = (uint16_t)value;
+      memcpy(&lcdSpanData[idx*2], &v, 2);
+    }
+  } else {
+    JsvArrayBufferIterator it;
+    jsvArrayBufferIteratorNew(&it, lcdSpanBuffer, (size_t)idx);
+    jsvArrayBufferIteratorSetIntegerValue(&it, (JsVarInt)value);
+    jsvArrayBufferIteratorFree(&it);
+  }
+}
+
+// Call the spans callback with the spans in lcdSpanBuffer, after which no Graphics has spans waiting
+static void lcdSpanSend_JS() {
+  JsVar *graphics = lcdSpanGraphics;
+  JsVar *buffer = lcdSpanBuffer;
+  int count = lcdSpanCount;
+  lcdSpanGraphics = 0;
+  lcdSpanBuffer = 0;
+  lcdSpanData = 0;
+  lcdSpanCount = 0;
+  lcdSpanLength = 0;
+  JsVar *spans = count ? jsvObjectGetChild(graphics, "iSpans", 0) : 0;
+  if (spans) {
+    JsVar *args[2];
+    args[0] = buffer;
+    args[1] = jsvNewFromInteger(count);
+    jspExecuteFunction(spans, graphics, 2, args);
+    jsvUnLock(args[1]);
+    jsvUnLock(spans);
+  }
+  jsvUnLock(buffer);
+  jsvUnLock(graphics);
+}
+
+// Put the span we're extending into lcdSpanBuffer (sending the buffer if it's then full)
+static void lcdSpanCommit_JS() {
+  if (!lcdSpanLength) return;
+  int idx = lcdSpanCount*4;
+  lcdSpanSetElement_JS(idx+0, (unsigned short)lcdSpanX);
+  lcdSpanSetElement_JS(idx+1, (unsigned short)lcdSpanY);
+  lcdSpanSetElement_JS(idx+2, (unsigned short)lcdSpanLength);
+  lcdSpanSetElement_JS(idx+3, lcdSpanColor);
+  lcdSpanLength = 0;
+  if (++lcdSpanCount >= lcdSpanBatch)
+    lcdSpanSend_JS();
+}
+
+// Send all waiting spans to the callback - including any the callback itself draws
+static void lcdSpanFlush_JS() {
+  while (lcdSpanGraphics) {
+    lcdSpanCommit_JS(); // sends the buffer if it's now full
+    if (lcdSpanGraphics && !lcdSpanLength) lcdSpanSend_JS();
+  }
+}
+
+static void lcdSpanAdd_JS(JsGraphics *gfx, short x, short y, short length, unsigned int col) {
+  if (lcdSpanGraphics == gfx->graphicsVar) {
+    // carry on the last span if we can
+    if (lcdSpanLength && y==lcdSpanY && col==lcdSpanColor && x==lcdSpanX+lcdSpanLength) {
+      lcdSpanLength = (short)(lcdSpanLength+length);
+      return;
+    }
+    lcdSpanCommit_JS(); // if this sends the buffer, we'll have to start again below
+  }
+  if (lcdSpanGraphics != gfx->graphicsVar) {
+    lcdSpanFlush_JS(); // another Graphics had spans waiting
+    JsVar *buf = jsvObjectGetChild(gfx->graphicsVar, "iSpanBuf", 0);
+    if (!jsvIsArrayBuffer(buf) || jsvGetArrayBufferLength(buf)<4) {
+      jsvUnLock(buf);
+      return;
+    }
+    size_t byteLength = 0;
+    lcdSpanBuffer = buf;
+    lcdSpanGraphics = jsvLockAgain(gfx->graphicsVar);
+    lcdSpanData = jsvGetArrayBufferPointer(buf, &byteLength);
+    lcdSpanBatch = (int)(jsvGetArrayBufferLength(buf)/4);
+    lcdSpanCount = 0;
+    lcdSpanLength = 0;
+  }
+  lcdSpanX = x;
+  lcdSpanY = y;
+  lcdSpanLength = length;
+  lcdSpanColor = col;
+}
+
+void lcdSetPixelSpans_JS(JsGraphics *gfx, short x, short y, unsigned int col) {
+  if (x<0 || y<0 || x>=gfx->data.width || y>=gfx->data.height) return;
+  lcdSpanAdd_JS(gfx, x, y, 1, col);
+}
+
+void lcdFillRectSpans_JS(struct JsGraphics *gfx, short x1, short y1, short x2, short y2) {
+  if (x1>x2) { short t = x1; x1 = x2; x2 = t; }
+  if (y1>y2) { short t = y1; y1 = y2; y2 = t; }
+  if (x1<0) x1=0;
+  if (y1<0) y1=0;
+  if (x2>=gfx->data.width) x2 = (short)(gfx->data.width - 1);
+  if (y2>=gfx->data.height) y2 = (short)(gfx->data.height - 1);
+  if (x2<x1 || y2<y1) return; // nope
+  unsigned int col = gfx->data.fgColor & (unsigned int)((1L<<gfx->data.bpp)-1);
+  short y;
+  for (y=y1;y<=y2;y++)
+    lcdSpanAdd_JS(gfx, x1, y, (short)(x2+1-x1), col);
+}
+
+void lcdIdle_JS() {
+  lcdSpanFlush_JS();
+}
+
+void lcdKill_JS() {
+  // don't lose anything that was drawn (eg. when save() is called)
+  lcdSpanFlush_JS();
+}
+
+// ----------------------------------------------------------------------------------------------
+
+void lcdFlip_JS(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
+  if (lcdSpanGraphics == gfx->graphicsVar)
+    lcdSpanFlush_JS(); // the spans must be drawn before the display is updated
+  JsVar *flip = jsvObjectGetChild(gfx->graphicsVar, "iFlip", 0);
+  if (flip) {
+    JsVar *args[4];
+    args[0] = jsvNewFromInteger(x1);
+    args[1] = jsvNewFromInteger(y1);
+    args[2] = jsvNewFromInteger(x2);
+    args[3] = jsvNewFromInteger(y2);
+    jspExecuteFunction(flip, gfx->graphicsVar, 4, args);
+    jsvUnLock(args[0]);
+    jsvUnLock(args[1]);
+    jsvUnLock(args[2]);
+    jsvUnLock(args[3]);
+    jsvUnLock(flip);
+  }
+}
+
+void lcdInit_JS(JsGraphics *gfx, JsVar *setPixelCallback, JsVar *fillRectCallback, JsVar *flipCallback, JsVar *spansCallback, int spansBatch) {
+  if (setPixelCallback) jsvAddNamedChild(gfx->graphicsVar, setPixelCallback, "iSetPixel");
+  if (fillRectCallback) jsvAddNamedChild(gfx->graphicsVar, fillRectCallback, "iFillRect");
+  if (flipCallback) jsvAddNamedChild(gfx->graphicsVar, flipCallback, "iFlip");
+  if (spansCallback) {
+    gfx->data.flags |= JSGRAPHICSFLAGS_JS_SPANS;
+    jsvAddNamedChild(gfx->graphicsVar, spansCallback, "iSpans");
+    JsVar *length = jsvNewFromInteger(spansBatch*4);
+    JsVar *buf = jswrap_typedarray_constructor(gfx->data.bpp>16 ? ARRAYBUFFERVIEW_UINT32 : ARRAYBUFFERVIEW_UINT16, length, 0, 0);
+    if (buf) jsvAddNamedChild(gfx->graphicsVar, buf, "iSpanBuf");
+    jsvUnLock(buf);
+    jsvUnLock(length);
+  }
 }
 
 void lcdSetCallbacks_JS(JsGraphics *gfx) {
-  gfx->setPixel = lcdSetPixel_JS;
-  gfx->fillRect = lcdFillRect_JS;
+  if (gfx->data.flags & JSGRAPHICSFLAGS_JS_SPANS) {
+    gfx->setPixel = lcdSetPixelSpans_JS;
+    gfx->fillRect = lcdFillRectSpans_JS;
+  } else {
+    gfx->setPixel = lcdSetPixel_JS;
+    gfx->fillRect = lcdFillRect_JS;
+  }
+  gfx->flip = lcdFlip_JS;
 }
@@ -13,5 +13,7 @@
  */
 #include "graphics.h"
 
-void lcdInit_JS(JsGraphics *gfx, JsVar *setPixelCallback, JsVar *fillRectCallback);
+void lcdInit_JS(JsGraphics *gfx, JsVar *setPixelCallback, JsVar *fillRectCallback, JsVar *flipCallback, JsVar *spansCallback, int spansBatch);
 void lcdSetCallbacks_JS(JsGraphics *gfx);
+void lcdIdle_JS(); ///< send any spans that are waiting
+void lcdKill_JS(); ///< send any spans that are waiting before everything is freed
@@ -16,38 +16,133 @@
 #include "jsutils.h"
 #include "lcd_sdl.h"
 #include <SDL/SDL.h>
+#include <stdio.h>
 
 #define BPP 4
 #define DEPTH 32
 
 SDL_Surface *screen = 0;
 bool needsFlip = false;
+bool screenLocked = false; ///< We lock the surface on the first draw, and only unlock it when flipping
+bool screenHeadless = false; ///< If set, screen is an offscreen surface that is written to ppmFilename
+char ppmFilename[256];
+
+static bool lcdLock_SDL() {
+  if (!screen) return false;
+  if (!screenLocked && SDL_MUSTLOCK(screen)) {
+    if (SDL_LockSurface(screen) < 0) return false;
+    screenLocked = true;
+  }
+  return true;
+}
+
+static void lcdUnlock_SDL() {
+  if (screenLocked) SDL_UnlockSurface(screen);
+  screenLocked = false;
+}
+
+static inline unsigned int *lcdGetPixelPtr_SDL(short x, short y) {
+  return (unsigned int*)((unsigned char*)screen->pixels + y*screen->pitch) + x;
+}
 
 unsigned int lcdGetPixel_SDL(JsGraphics *gfx, short x, short y) {
-  if (!screen) return 0;
   if (x<0 || y<0 || x>=gfx->data.width || y>=gfx->data.height) return 0;
-  if(SDL_MUSTLOCK(screen))
-      if(SDL_LockSurface(screen) < 0) return 0;
-  unsigned int *pixmem32 = ((unsigned int*)screen->pixels) + y + x;
-  unsigned int col = *pixmem32;
-  if(SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
+  // if nothing is being drawn, only keep the surface locked while we read it
+  bool wasLocked = screenLocked;
+  if (!lcdLock_SDL()) return 0;
+  unsigned int col = *lcdGetPixelPtr_SDL(x, y);
+  if (!wasLocked) lcdUnlock_SDL();
   return col;
 }
 
 
 void lcdSetPixel_SDL(JsGraphics *gfx, short x, short y, unsigned int col) {
-  if (!screen) return;
   if (x<0 || y<0 || x>=gfx->data.width || y>=gfx->data.height) return;
+  if (!lcdLock_SDL()) return;
+  *lcdGetPixelPtr_SDL(x, y) = col;
+  needsFlip = true;
+}
+
+void lcdFillRect_SDL(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
+  if (x1>x2) {
+    short t = x1;
+    x1 = x2;
+    x2 = t;
+  }
+  if (y1>y2) {
+    short t = y1;
+    y1 = y2;
+    y2 = t;
+  }
+  if (x1<0) x1=0;
+  if (y1<0) y1=0;
+  if (x2>=gfx->data.width) x2 = (short)(gfx->data.width - 1);
+  if (y2>=gfx->data.height) y2 = (short)(gfx->data.height - 1);
+  if (x2<x1 || y2<y1) return; // nope
+  if (!lcdLock_SDL()) return;
+  unsigned int col = gfx->data.fgColor;
+  short x,y;
+  for (y=y1;y<=y2;y++) {
+    unsigned int *ptr = lcdGetPixelPtr_SDL(x1, y);
+    for (x=x1;x<=x2;x++)
+      *(ptr++) = col;
+  }
+  needsFlip = true;
+}
 
-  if(SDL_MUSTLOCK(screen))
-    if(SDL_LockSurface(screen) < 0) return;
-  unsigned int *pixmem32 = ((unsigned int*)screen->pixels) + y*gfx->data.width + x;
-  *pixmem32 = col;
-  if(SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
+void lcdBlit_SDL(JsGraphics *gfx, short x, short y, unsigned short count, const unsigned int *cols) {
+  NOT_USED(gfx);
+  if (!lcdLock_SDL()) return;
+  memcpy(lcdGetPixelPtr_SDL(x, y), cols, count*sizeof(unsigned int));
   needsFlip = true;
 }
 
-void lcdInit_SDL(JsGraphics *gfx) {
+/// Write the whole offscreen surface out as a binary PPM
+static void lcdWritePPM_SDL() {
+  FILE *f = fopen(ppmFilename, "wb");
+  if (!f) {
+    jsError("Unable to open '%s'", ppmFilename);
+    return;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", screen->w, screen->h);
+  unsigned char row[3*screen->w];
+  short x,y;
+  for (y=0;y<screen->h;y++) {
+    unsigned int *ptr = lcdGetPixelPtr_SDL(0, y);
+    for (x=0;x<screen->w;x++) {
+      unsigned int col = ptr[x];
+      row[x*3+0] = (unsigned char)(col>>16);
+      row[x*3+1] = (unsigned char)(col>>8);
+      row[x*3+2] = (unsigned char)col;
+    }
+    fwrite(row, 3, (size_t)screen->w, f);
+  }
+  fclose(f);
+}
+
+void lcdFlip_SDL(JsGraphics *gfx, short x1, short y1, short x2, short y2) {
+  NOT_USED(gfx);
+  if (!screen) return;
+  lcdUnlock_SDL();
+  if (screenHeadless)
+    lcdWritePPM_SDL();
+  else
+    SDL_UpdateRect(screen, x1, y1, (Uint32)(x2+1-x1), (Uint32)(y2+1-y1));
+  needsFlip = false;
+}
+
+void lcdInit_SDL(JsGraphics *gfx, const char *ppmFile) {
+  if (ppmFile) {
+    // headless - draw into an offscreen surface (in the same XRGB format a 32 bit window would use)
+    strncpy(ppmFilename, ppmFile, sizeof(ppmFilename)-1);
+    ppmFilename[sizeof(ppmFilename)-1] = 0;
+    screenHeadless = true;
+    if (!(screen = SDL_CreateRGBSurface(SDL_SWSURFACE, gfx->data.width, gfx->data.height, DEPTH, 0xFF0000, 0xFF00, 0xFF, 0))) {
+      jsError("SDL_CreateRGBSurface failed\n");
+      exit(1);
+    }
+    return;
+  }
   if (SDL_Init(SDL_INIT_VIDEO) < 0 ) {
     jsError("SDL_Init failed\n");
     exit(1);
@@ -63,12 +158,18 @@ void lcdInit_SDL(JsGraphics *gfx) {
 void lcdIdle_SDL() {
   if (needsFlip) {
     needsFlip = false;
-    SDL_Flip(screen);
+    lcdUnlock_SDL();
+    if (screenHeadless)
+      lcdWritePPM_SDL();
+    else
+      SDL_Flip(screen);
   }
 }
 
 void lcdSetCallbacks_SDL(JsGraphics *gfx) {
   gfx->setPixel = lcdSetPixel_SDL;
   gfx->getPixel = lcdGetPixel_SDL;
-  // FIXME: idle callback would be a great idea to save lock/unlock
+  gfx->fillRect = lcdFillRect_SDL;
+  gfx->blit = lcdBlit_SDL;
+  gfx->flip = lcdFlip_SDL;
 }
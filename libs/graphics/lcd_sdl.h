@@ -14,6 +14,6 @@
 #include "graphics.h"
 
 
-void lcdInit_SDL(JsGraphics *gfx);
+void lcdInit_SDL(JsGraphics *gfx, const char *ppmFile);
 void lcdIdle_SDL();
 void lcdSetCallbacks_SDL(JsGraphics *gfx);
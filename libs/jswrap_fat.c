@@ -31,19 +31,41 @@
 /*JSON{ "type":"library",
         "class" : "fs",
         "description" : ["This library handles interfacing with a FAT32 filesystem on an SD card. The API is designed to be similar to node.js's - However Espruino does not currently support asynchronous file IO, so the functions behave like node.js's xxxxSync functions. Versions of the functions with 'Sync' after them are also provided for compatibility.",
-                         "Currently this provides minimal file IO - it's great for logging and loading/saving settings, but not good for loading large amounts of data as you will soon fill your memory up.",
+                         "`readFile` and `writeFile` are great for loading/saving settings, but `readFile` loads the whole file into memory. For logging or for large files use `fs.open`, which returns a `File` that can be read and written a bit at a time.",
                          "It is currently only available on boards that contain an SD card slot, such as the Olimexino and the HY. It can not currently be added to boards that did not ship with a card slot.",
                          "To use this, you must type ```var fs = require('fs')``` to get access to the library" ]
 }*/
 
+/*JSON{ "type":"class",
+        "class" : "File",
+        "description" : ["An open file, created by `fs.open`. The file stays open (so it can be read or written a bit at a time) until `close` is called, or until Espruino is reset. Open files are flushed but stay open when `save()` is called." ]
+}*/
+
 #ifndef LINUX
 #define JS_DIR_BUF_SIZE 64
+typedef FIL JsFsFile;
 #else
 #define JS_DIR_BUF_SIZE 256
 typedef int FRESULT;
 #define FR_OK (0)
+typedef FILE *JsFsFile;
 #endif
 
+#define JS_FS_OPEN_FILES JS_HIDDEN_CHAR_STR"FSF" ///< Array of File objects that are open
+#define JS_FS_FILE_DATA JS_HIDDEN_CHAR_STR"fil" ///< Child of a File containing the id of its JsFsOpenFile
+#define JS_FS_MAX_OPEN_FILES 4
+
+typedef struct {
+  JsFsFile handle;
+  JsVarInt id; ///< The id stored in the File object using this handle, or 0 if it's free
+} JsFsOpenFile;
+
+/* The native files opened with fs.open. File objects only store an id, so the
+ * (large) JsFsFile never has to be copied in and out of variables. Ids are never
+ * reused, so a File that was saved or loaded can't pick up someone else's handle */
+static JsFsOpenFile jsfsOpenFiles[JS_FS_MAX_OPEN_FILES];
+static JsVarInt jsfsLastFileId = 0;
+
 #ifndef LINUX
 
 #if _USE_LFN
@@ -97,6 +119,63 @@ static bool jsfsInit() {
 
 
 
+// Read up to maxLength bytes from the file and append them to result
+static FRESULT jsfsReadToString(JsFsFile *file, JsVar *result, size_t maxLength) {
+  char buf[JS_DIR_BUF_SIZE];
+  FRESULT res = FR_OK;
+  while (res==FR_OK && maxLength>0) {
+    size_t toRead = maxLength<JS_DIR_BUF_SIZE ? maxLength : JS_DIR_BUF_SIZE;
+    size_t bytesRead = 0;
+#ifndef LINUX
+    res = f_read(file, buf, toRead, &bytesRead);
+#else
+    bytesRead = fread(buf, 1, toRead, *file);
+#endif
+    if (!jsvAppendStringBuf(result, buf, (int)bytesRead))
+      break; // was out of memory
+    maxLength -= bytesRead;
+    if (bytesRead<toRead) break; // end of file
+  }
+  return res;
+}
+
+// Write data (converted to a string) to the file at its current position
+static FRESULT jsfsWriteFromVar(JsFsFile *file, JsVar *data, size_t *bytesWritten) {
+  char buf[JS_DIR_BUF_SIZE];
+  FRESULT res = FR_OK;
+  JsvStringIterator it;
+  JsVar *dataString = jsvAsString(data, false);
+  jsvStringIteratorNew(&it, dataString, 0);
+  size_t toWrite = 0;
+  size_t written = 0;
+  *bytesWritten = 0;
+
+  while (jsvStringIteratorHasChar(&it) && res==FR_OK && written==toWrite) {
+    toWrite = 0;
+    while (jsvStringIteratorHasChar(&it) && toWrite < JS_DIR_BUF_SIZE) {
+      buf[toWrite++] = jsvStringIteratorGetChar(&it);
+      jsvStringIteratorNext(&it);
+    }
+#ifndef LINUX
+    res = f_write(file, buf, toWrite, &written);
+#else
+    written = fwrite(buf, 1, toWrite, *file);
+#endif
+    *bytesWritten += written;
+  }
+  jsvStringIteratorFree(&it);
+  jsvUnLock(dataString);
+  return res;
+}
+
+static void jsfsClose(JsFsFile *file) {
+#ifndef LINUX
+  f_close(file);
+#else
+  fclose(*file);
+#endif
+}
+
 /* Unmount...
     if (res==FR_OK) {
       jsiConsolePrint("Unmounting...\n");
@@ -104,13 +183,96 @@ static bool jsfsInit() {
     }
  */
 
+static void jsfsFlush(JsFsFile *file) {
+#ifndef LINUX
+  f_sync(file);
+#else
+  fflush(*file);
+#endif
+}
+
+// Find the open file with the given id - or a free one if id==0
+static JsFsOpenFile *jsfsFindOpenFile(JsVarInt id) {
+  int i;
+  for (i=0;i<JS_FS_MAX_OPEN_FILES;i++)
+    if (jsfsOpenFiles[i].id == id)
+      return &jsfsOpenFiles[i];
+  return 0;
+}
+
+// Get the native file for a File object. Returns 0 if the file isn't open
+static JsFsOpenFile *fileGetFromVar(JsVar *parent) {
+  JsVarInt id = jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, JS_FS_FILE_DATA, 0));
+  if (!id) return 0;
+  return jsfsFindOpenFile(id);
+}
+
+/*JSON{ "type":"init", "generate" : "wrap_fat_init", "ifndef" : "SAVE_ON_FLASH" }*/
+void wrap_fat_init() {
+  /* Files are left open over save(), so match them up with the File objects we
+   * have now. Forget Files whose handle has gone (eg. loaded after a power cycle)
+   * and close handles nothing uses any more (eg. after reset()) */
+  JsVarInt used[JS_FS_MAX_OPEN_FILES];
+  int i, usedCount = 0;
+  JsVar *arr = jsvObjectGetChild(execInfo.root, JS_FS_OPEN_FILES, 0);
+  if (arr) {
+    JsvArrayIterator it;
+    jsvArrayIteratorNew(&it, arr);
+    while (jsvArrayIteratorHasElement(&it)) {
+      JsVar *fileVar = jsvArrayIteratorGetElement(&it);
+      JsFsOpenFile *file = fileGetFromVar(fileVar);
+      if (file && usedCount<JS_FS_MAX_OPEN_FILES) {
+        used[usedCount++] = file->id;
+        jsvArrayIteratorNext(&it);
+      } else {
+        jsvRemoveNamedChild(fileVar, JS_FS_FILE_DATA);
+        jsvArrayIteratorRemoveAndGotoNext(&it, arr);
+      }
+      jsvUnLock(fileVar);
+    }
+    jsvArrayIteratorFree(&it);
+    jsvUnLock(arr);
+  }
+  for (i=0;i<JS_FS_MAX_OPEN_FILES;i++) {
+    JsFsOpenFile *file = &jsfsOpenFiles[i];
+    if (file->id) {
+      int u;
+      bool isUsed = false;
+      for (u=0;u<usedCount;u++)
+        if (used[u]==file->id) isUsed = true;
+      if (!isUsed) {
+        jsfsClose(&file->handle);
+        file->id = 0;
+      }
+    }
+  }
+#ifndef LINUX
+  if (fat_initialised && !usedCount) {
+    fat_initialised = false;
+    f_mount(0, 0, 0);
+  }
+#endif
+}
+
 /*JSON{ "type":"kill", "generate" : "wrap_fat_kill", "ifndef" : "SAVE_ON_FLASH" }*/
 void wrap_fat_kill() { // Uninitialise fat
+  /* Flush any files that were left open, but don't close them - this may just be
+   * save(), after which they can still be used. wrap_fat_init closes them if not */
+  bool filesOpen = false;
+  int i;
+  for (i=0;i<JS_FS_MAX_OPEN_FILES;i++) {
+    if (jsfsOpenFiles[i].id) {
+      jsfsFlush(&jsfsOpenFiles[i].handle);
+      filesOpen = true;
+    }
+  }
 #ifndef LINUX
-  if (fat_initialised) {
+  if (fat_initialised && !filesOpen) {
     fat_initialised = false;
     f_mount(0, 0, 0);
   }
+#else
+  NOT_USED(filesOpen);
 #endif
 }
 
@@ -221,37 +383,12 @@ bool wrap_fat_writeOrAppendFile(JsVar *path, JsVar *data, bool append) {
 //        if (res != FR_OK) jsfsReportError("Unable to move to end of file", res);
       }
 #else
-      FILE *file = fopen(pathStr, append?"a":"w");
+      JsFsFile file = fopen(pathStr, append?"a":"w");
       if (file) {
 #endif
-
-      JsvStringIterator it;
-      JsVar *dataString = jsvAsString(data, false);
-      jsvStringIteratorNew(&it, dataString, 0);
-      size_t toWrite = 0;
-      size_t written = 0;
-
-      while (jsvStringIteratorHasChar(&it) && res==FR_OK && written==toWrite) {
-
-        // re-use pathStr buffer
-        toWrite = 0;
-        while (jsvStringIteratorHasChar(&it) && toWrite < JS_DIR_BUF_SIZE) {
-          pathStr[toWrite++] = jsvStringIteratorGetChar(&it);
-          jsvStringIteratorNext(&it);
-        }
-#ifndef LINUX
-        res = f_write(&file, pathStr, toWrite, &written);
-#else
-        written = fwrite(pathStr, 1, toWrite, file);
-#endif
-      }
-      jsvStringIteratorFree(&it);
-      jsvUnLock(dataString);
-#ifndef LINUX
-      f_close(&file);
-#else
-      fclose(file);
-#endif
+      size_t written;
+      res = jsfsWriteFromVar(&file, data, &written);
+      jsfsClose(&file);
     }
   }
   if (res) {
@@ -286,28 +423,13 @@ JsVar *wrap_fat_readFile(JsVar *path) {
     FIL file;
     if ((res=f_open(&file, pathStr, FA_READ)) == FR_OK) {
 #else
-    FILE *file = fopen(pathStr, "r");
+    JsFsFile file = fopen(pathStr, "r");
     if (file) {
 #endif
       result = jsvNewFromEmptyString();
-      if (result) { // out of memory?
-        // re-use pathStr buffer
-        size_t bytesRead = JS_DIR_BUF_SIZE;
-        while (res==FR_OK && bytesRead==JS_DIR_BUF_SIZE) {
-#ifndef LINUX
-          res = f_read (&file, pathStr, JS_DIR_BUF_SIZE, &bytesRead);
-#else
-          bytesRead = fread(pathStr,1,JS_DIR_BUF_SIZE,file);
-#endif
-          if (!jsvAppendStringBuf(result, pathStr, (int)bytesRead))
-            break; // was out of memory
-        }
-      }
-#ifndef LINUX
-      f_close(&file);
-#else
-      fclose(file);
-#endif
+      if (result) // out of memory?
+        res = jsfsReadToString(&file, result, ~(size_t)0);
+      jsfsClose(&file);
     }
   }
 
@@ -348,3 +470,161 @@ bool wrap_fat_unlink(JsVar *path) {
     return true;
   }
 
+
+/*JSON{  "type" : "staticmethod", "class" : "fs", "name" : "open",
+         "generate" : "wrap_fat_open",
+         "description" : [ "Open a file so that it can be read or written a bit at a time. Only the data being read or written needs to be in memory, so this can be used for logging or for files that are too big to load with `readFile`.",
+                           "Call `close` on the returned File when you're done with it - all files are closed when Espruino is reset.",
+                           "NOTE: Espruino does not yet support Async file IO, so this function behaves like the 'Sync' version." ],
+         "params" : [ [ "path", "JsVar", "The path of the file to open" ],
+                      [ "mode", "JsVar", "The mode - `'r'` (read, the default), `'w'` (write, creating or emptying the file), `'a'` (write at the end of the file, creating it if needed), or any of these followed by `'+'` to allow both reading and writing" ] ],
+         "return" : [ "JsVar", "A File object, or undefined if the file couldn't be opened" ]
+}*/
+/*JSON{  "type" : "staticmethod", "class" : "fs", "name" : "openSync", "ifndef" : "SAVE_ON_FLASH",
+         "generate" : "wrap_fat_open",
+         "description" : [ "Open a file so that it can be read or written a bit at a time" ],
+         "params" : [ [ "path", "JsVar", "The path of the file to open" ],
+                      [ "mode", "JsVar", "The mode - `'r'` (read, the default), `'w'` (write, creating or emptying the file), `'a'` (write at the end of the file, creating it if needed), or any of these followed by `'+'` to allow both reading and writing" ] ],
+         "return" : [ "JsVar", "A File object, or undefined if the file couldn't be opened" ]
+}*/
+JsVar *wrap_fat_open(JsVar *path, JsVar *mode) {
+  char pathStr[JS_DIR_BUF_SIZE] = "";
+  if (!jsvIsUndefined(path))
+    jsvGetString(path, pathStr, JS_DIR_BUF_SIZE);
+  char modeStr[4] = "r";
+  if (!jsvIsUndefined(mode))
+    jsvGetString(mode, modeStr, sizeof(modeStr));
+  bool update = modeStr[1]=='+';
+  if ((modeStr[0]!='r' && modeStr[0]!='w' && modeStr[0]!='a') ||
+      (modeStr[1] && (!update || modeStr[2]))) {
+    jsError("Unknown file mode '%s' - expecting r, w, a, r+, w+ or a+", modeStr);
+    return 0;
+  }
+
+  FRESULT res = 0;
+  JsFsOpenFile *file = jsfsFindOpenFile(0);
+  if (!file) {
+    jsError("Too many open files - only %d can be open at once", JS_FS_MAX_OPEN_FILES);
+    return 0;
+  }
+  if (!jsfsInit()) return 0;
+#ifndef LINUX
+  BYTE flags = 0;
+  if (modeStr[0]=='r') flags = FA_READ | FA_OPEN_EXISTING;
+  if (modeStr[0]=='w') flags = FA_WRITE | FA_CREATE_ALWAYS;
+  if (modeStr[0]=='a') flags = FA_WRITE | FA_OPEN_ALWAYS;
+  if (update) flags |= FA_READ | FA_WRITE;
+  if ((res=f_open(&file->handle, pathStr, flags)) == FR_OK) {
+    if (modeStr[0]=='a') f_lseek(&file->handle, file->handle.fsize);
+#else
+  file->handle = fopen(pathStr, modeStr);
+  if (!file->handle) res = -1;
+  if (file->handle) {
+#endif
+    JsVar *fileVar = jspNewObject(0, "File");
+    JsVar *arr = jsvObjectGetChild(execInfo.root, JS_FS_OPEN_FILES, JSV_ARRAY);
+    JsVar *id = jsvNewFromInteger(jsfsLastFileId+1);
+    if (fileVar && arr && id) {
+      file->id = ++jsfsLastFileId;
+      jsvObjectSetChild(fileVar, JS_FS_FILE_DATA, id);
+      jsvArrayPush(arr, fileVar);
+    } else { // out of memory
+      jsfsClose(&file->handle);
+      jsvUnLock(fileVar);
+      fileVar = 0;
+    }
+    jsvUnLock(id);
+    jsvUnLock(arr);
+    return fileVar;
+  }
+  jsfsReportError("Unable to open file", res);
+  return 0;
+}
+
+/*JSON{  "type" : "method", "class" : "File", "name" : "close",
+         "generate" : "wrap_file_close",
+         "description" : [ "Close the file. Any data that was written is flushed to the card" ]
+}*/
+void wrap_file_close(JsVar *parent) {
+  JsFsOpenFile *file = fileGetFromVar(parent);
+  if (!file) return; // already closed
+  jsfsClose(&file->handle);
+  file->id = 0;
+  jsvRemoveNamedChild(parent, JS_FS_FILE_DATA);
+  JsVar *arr = jsvObjectGetChild(execInfo.root, JS_FS_OPEN_FILES, 0);
+  if (arr) {
+    JsVar *idx = jsvGetArrayIndexOf(arr, parent, true);
+    if (idx) {
+      jsvRemoveChild(arr, idx);
+      jsvUnLock(idx);
+    }
+    jsvUnLock(arr);
+  }
+}
+
+/*JSON{  "type" : "method", "class" : "File", "name" : "read",
+         "generate" : "wrap_file_read",
+         "description" : [ "Read data from the current position in the file, moving the position on" ],
+         "params" : [ [ "length", "int", "The maximum number of bytes to read" ] ],
+         "return" : [ "JsVar", "A string containing the data, or undefined if at the end of the file" ]
+}*/
+JsVar *wrap_file_read(JsVar *parent, JsVarInt length) {
+  JsFsOpenFile *file = fileGetFromVar(parent);
+  if (!file) {
+    jsError("File is not open");
+    return 0;
+  }
+  if (length<=0) return 0;
+  JsVar *result = jsvNewFromEmptyString();
+  if (!result) return 0; // out of memory
+  FRESULT res = jsfsReadToString(&file->handle, result, (size_t)length);
+  if (res) jsfsReportError("Unable to read file", res);
+  if (jsvIsEmptyString(result)) {
+    jsvUnLock(result);
+    return 0; // end of file
+  }
+  return result;
+}
+
+/*JSON{  "type" : "method", "class" : "File", "name" : "write",
+         "generate" : "wrap_file_write",
+         "description" : [ "Write data at the current position in the file, moving the position on" ],
+         "params" : [ [ "data", "JsVar", "The data to write to the file" ] ],
+         "return" : [ "int", "The number of bytes written" ]
+}*/
+JsVarInt wrap_file_write(JsVar *parent, JsVar *data) {
+  JsFsOpenFile *file = fileGetFromVar(parent);
+  if (!file) {
+    jsError("File is not open");
+    return 0;
+  }
+  size_t written;
+  FRESULT res = jsfsWriteFromVar(&file->handle, data, &written);
+  if (res) jsfsReportError("Unable to write file", res);
+  return (JsVarInt)written;
+}
+
+/*JSON{  "type" : "method", "class" : "File", "name" : "seek",
+         "generate" : "wrap_file_seek",
+         "description" : [ "Move the current position in the file" ],
+         "params" : [ [ "position", "int", "The position in bytes from the start of the file" ] ],
+         "return" : [ "bool", "True on success, false on failure" ]
+}*/
+bool wrap_file_seek(JsVar *parent, JsVarInt position) {
+  JsFsOpenFile *file = fileGetFromVar(parent);
+  if (!file) {
+    jsError("File is not open");
+    return false;
+  }
+  if (position<0) position = 0;
+#ifndef LINUX
+  FRESULT res = f_lseek(&file->handle, (DWORD)position);
+#else
+  FRESULT res = fseek(file->handle, (long)position, SEEK_SET);
+#endif
+  if (res) {
+    jsfsReportError("Unable to seek", res);
+    return false;
+  }
+  return true;
+}
@@ -13,8 +13,15 @@
  */
 #include "jsvar.h"
 
+void wrap_fat_init();
 void wrap_fat_kill();
 JsVar *wrap_fat_readdir(JsVar *path);
 bool wrap_fat_writeOrAppendFile(JsVar *path, JsVar *data, bool append);
 JsVar *wrap_fat_readFile(JsVar *path);
 bool wrap_fat_unlink(JsVar *path);
+JsVar *wrap_fat_open(JsVar *path, JsVar *mode);
+
+void wrap_file_close(JsVar *parent);
+JsVar *wrap_file_read(JsVar *parent, JsVarInt length);
+JsVarInt wrap_file_write(JsVar *parent, JsVar *data);
+bool wrap_file_seek(JsVar *parent, JsVarInt position);
@@ -209,4 +209,7 @@ void netSetCallbacks_cc3000(JsNetwork *net) {
   net->gethostbyname = net_cc3000_gethostbyname;
   net->recv = net_cc3000_recv;
   net->send = net_cc3000_send;
+  net->createdgram = 0; // not supported yet
+  net->sendto = 0;
+  net->recvfrom = 0;
 }
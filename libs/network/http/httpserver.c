@@ -12,22 +12,17 @@
  * ----------------------------------------------------------------------------
  */
 #include "httpserver.h"
+#include "socketserver.h"
 #include "jsparse.h"
 #include "jsinteractive.h"
 #include "jshardware.h"
 
 #define HTTP_NAME_PORT "port"
-#define HTTP_NAME_SOCKET "sckt"
-#define HTTP_NAME_HAD_HEADERS "hdrs"
-#define HTTP_NAME_RECEIVE_DATA "dRcv"
-#define HTTP_NAME_SEND_DATA "dSnd"
 #define HTTP_NAME_RESPONSE_VAR "res"
 #define HTTP_NAME_OPTIONS_VAR "opt"
 #define HTTP_NAME_SERVER_VAR "svr"
 #define HTTP_NAME_CODE "code"
 #define HTTP_NAME_HEADERS "hdr"
-#define HTTP_NAME_CLOSENOW "closeNow"
-#define HTTP_NAME_CLOSE "close"
 #define HTTP_NAME_ON_CONNECT "#onconnect"
 #define HTTP_NAME_ON_DATA "#ondata"
 #define HTTP_NAME_ON_CLOSE "#onclose"
@@ -187,15 +182,6 @@ void httpInit() {
 #endif
 }
 
-void _httpConnectionKill(JsNetwork *net, JsVar *connection) {
-  if (!net || networkState != NETWORKSTATE_ONLINE) return;
-  int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_SOCKET,0))-1; // so -1 if undefined
-  if (sckt>=0) {
-    net->closesocket(net, sckt);
-  }
-}
-
-
 NO_INLINE static void _httpCloseAllConnectionsFor(JsNetwork *net, char *name) {
   JsVar *arr = httpGetArray(name, false);
   if (!arr) return;
@@ -203,7 +189,10 @@ NO_INLINE static void _httpCloseAllConnectionsFor(JsNetwork *net, char *name) {
   jsvArrayIteratorNew(&it, arr);
   while (jsvArrayIteratorHasElement(&it)) {
     JsVar *connection = jsvArrayIteratorGetElement(&it);
-    _httpConnectionKill(net, connection);
+    SocketState state;
+    socketGetState(connection, &state);
+    socketKill(net, state.data.sckt);
+    socketFreeState(&state);
     jsvUnLock(connection);
     jsvArrayIteratorNext(&it);
   }
@@ -229,29 +218,6 @@ void httpKill(JsNetwork *net) {
 
 
 
-bool _http_send(JsNetwork *net, int sckt, JsVar **sendData) {
-  char buf[64];
-
-  int a=1;
-  if (!jsvIsEmptyString(*sendData)) {
-    size_t bufLen = httpStringGet(*sendData, buf, sizeof(buf));
-    a = net->send(net, sckt, buf, bufLen);
-    // Now cut what we managed to send off the beginning of sendData
-    if (a>0) {
-      JsVar *newSendData = 0;
-      if (a!=(int)jsvGetStringLength(*sendData))
-        newSendData = jsvNewFromStringVar(*sendData, (size_t)a, JSVAPPENDSTRINGVAR_MAXLENGTH);
-      jsvUnLock(*sendData);
-      *sendData = newSendData;
-    }
-  }
-  if (a<0) { // could just be busy which is ok
-    jsError("Socket error %d while sending", a);
-    return false;
-  }
-  return true;
-}
-
 bool httpServerConnectionsIdle(JsNetwork *net) {
   char buf[64];
 
@@ -265,35 +231,35 @@ bool httpServerConnectionsIdle(JsNetwork *net) {
     hadSockets = true;
     JsVar *connection = jsvArrayIteratorGetElement(&it);
     JsVar *connectReponse = jsvObjectGetChild(connection,HTTP_NAME_RESPONSE_VAR,0);
-    int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_SOCKET,0))-1; // so -1 if undefined
+    SocketState state, resState;
+    socketGetState(connection, &state);
+    socketGetState(connectReponse, &resState);
+    SocketStateFlags oldFlags = state.data.flags;
+    SocketStateFlags oldResFlags = resState.data.flags;
 
-    bool closeConnectionNow = jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_CLOSENOW, false));
+    bool closeConnectionNow = socketHasState(&state, SOCKET_STATE_CLOSENOW);
     // TODO: look for unreffed connections?
 
     if (!closeConnectionNow) {
-      int num = net->recv(net, sckt, buf,sizeof(buf));
+      int num = net->recv(net, state.data.sckt, buf,sizeof(buf));
       if (num<0) {
         // we probably disconnected so just get rid of this
         closeConnectionNow = true;
       } else {
-        // add it to our request string
-        if (num>0) {
-          JsVar *receiveData = jsvObjectGetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
+        // add it to our request string - or if there's data left over from before, see if there's now a 'data' listener for it
+        if (num>0 || socketHasState(&state, SOCKET_STATE_RECEIVE_DATA)) {
+          JsVar *receiveData = socketGetStateData(connection, &state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA);
           JsVar *oldReceiveData = receiveData;
           if (!receiveData) receiveData = jsvNewFromEmptyString();
           if (receiveData) {
-            jsvAppendStringBuf(receiveData, buf, num);
-            bool hadHeaders = jsvGetBoolAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_HAD_HEADERS,0));
-            if (!hadHeaders && httpParseHeaders(&receiveData, connection, true)) {
-              hadHeaders = true;
-              jsvUnLock(jsvObjectSetChild(connection, HTTP_NAME_HAD_HEADERS, jsvNewFromBool(hadHeaders)));
-              JsVar *resVar = jsvObjectGetChild(connection,HTTP_NAME_RESPONSE_VAR,0);
+            if (num>0) jsvAppendStringBuf(receiveData, buf, num);
+            if (num>0 && !socketHasState(&state, SOCKET_STATE_HAD_HEADERS) && httpParseHeaders(&receiveData, connection, true)) {
+              socketSetStateFlag(&state, SOCKET_STATE_HAD_HEADERS, true);
               JsVar *server = jsvObjectGetChild(connection,HTTP_NAME_SERVER_VAR,0);
-              jsiQueueObjectCallbacks(server, HTTP_NAME_ON_CONNECT, connection, resVar);
+              jsiQueueObjectCallbacks(server, HTTP_NAME_ON_CONNECT, connection, connectReponse);
               jsvUnLock(server);
-              jsvUnLock(resVar);
             }
-            if (hadHeaders && !jsvIsEmptyString(receiveData) && jsiObjectHasCallbacks(connection, HTTP_NAME_ON_DATA)) {
+            if (socketHasState(&state, SOCKET_STATE_HAD_HEADERS) && !jsvIsEmptyString(receiveData) && jsiObjectHasCallbacks(connection, HTTP_NAME_ON_DATA)) {
               // Execute 'data' callback with the data that we have
               jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_DATA, receiveData, 0);
               // clear received data
@@ -302,44 +268,49 @@ bool httpServerConnectionsIdle(JsNetwork *net) {
             }
             // if received data changed, update it
             if (receiveData != oldReceiveData)
-              jsvObjectSetChild(connection,HTTP_NAME_RECEIVE_DATA,receiveData);
+              socketSetStateData(connection, &state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA, receiveData);
             jsvUnLock(receiveData);
           }
         }
       }
 
       // send data if possible
-      JsVar *sendData = jsvObjectGetChild(connectReponse,HTTP_NAME_SEND_DATA,0);
+      JsVar *sendData = socketGetStateData(connectReponse, &resState, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA);
       if (sendData) {
-          if (!_http_send(net, sckt, &sendData))
-            closeConnectionNow = true;
-        jsvObjectSetChild(connectReponse, HTTP_NAME_SEND_DATA, sendData); // _http_send prob updated sendData
+        if (!socketSend(net, state.data.sckt, &sendData))
+          closeConnectionNow = true;
+        socketSetStateData(connectReponse, &resState, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA, sendData); // socketSend prob updated sendData
       }
-      if (jsvGetBoolAndUnLock(jsvObjectGetChild(connectReponse,HTTP_NAME_CLOSE,0)) && !sendData)
+      if (socketHasState(&resState, SOCKET_STATE_CLOSE) && !sendData)
         closeConnectionNow = true;
       jsvUnLock(sendData);
     }
     if (closeConnectionNow) {
       // send out any data that we were POSTed
-      JsVar *receiveData = jsvObjectGetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
-      bool hadHeaders = jsvGetBoolAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_HAD_HEADERS,0));
-      if (hadHeaders && !jsvIsEmptyString(receiveData)) {
+      JsVar *receiveData = socketGetStateData(connection, &state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA);
+      if (socketHasState(&state, SOCKET_STATE_HAD_HEADERS) && !jsvIsEmptyString(receiveData)) {
          // Execute 'data' callback with the data that we have
          jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_DATA, receiveData, 0);
       }
       jsvUnLock(receiveData);
       // fire the close listener
-      JsVar *resVar = jsvObjectGetChild(connection,HTTP_NAME_RESPONSE_VAR,0);
-      jsiQueueObjectCallbacks(resVar, HTTP_NAME_ON_CLOSE, 0, 0);
-      jsvUnLock(resVar);
+      jsiQueueObjectCallbacks(connectReponse, HTTP_NAME_ON_CLOSE, 0, 0);
 
-      _httpConnectionKill(net, connection);
+      socketKill(net, state.data.sckt);
       JsVar *connectionName = jsvArrayIteratorGetIndex(&it);
       jsvArrayIteratorNext(&it);
       jsvRemoveChild(arr, connectionName);
       jsvUnLock(connectionName);
-    } else
+    } else {
+      // only write state back if it changed
+      if (state.data.flags != oldFlags)
+        socketSetState(connection, &state);
+      if (resState.data.flags != oldResFlags)
+        socketSetState(connectReponse, &resState);
       jsvArrayIteratorNext(&it);
+    }
+    socketFreeState(&state);
+    socketFreeState(&resState);
     jsvUnLock(connection);
     jsvUnLock(connectReponse);
   }
@@ -363,33 +334,34 @@ bool httpClientConnectionsIdle(JsNetwork *net) {
   while (jsvArrayIteratorHasElement(&it)) {
     hadSockets = true;
     JsVar *connection = jsvArrayIteratorGetElement(&it);
-    bool closeConnectionNow = jsvGetBoolAndUnLock(jsvObjectGetChild(connection, HTTP_NAME_CLOSENOW, false));
-    int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_SOCKET,0))-1; // so -1 if undefined
-    if (sckt<0) closeConnectionNow = true;
-    bool hadHeaders = jsvGetBoolAndUnLock(jsvObjectGetChild(connection,HTTP_NAME_HAD_HEADERS,0));
-    JsVar *receiveData = jsvObjectGetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
+    SocketState state;
+    socketGetState(connection, &state);
+    SocketStateFlags oldFlags = state.data.flags;
+    bool closeConnectionNow = socketHasState(&state, SOCKET_STATE_CLOSENOW);
+    if (state.data.sckt<0) closeConnectionNow = true;
+    JsVar *receiveData = socketGetStateData(connection, &state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA);
 
     /* We do this up here because we want to wait until we have been once
      * around the idle loop (=callbacks have been executed) before we run this */
-    if (hadHeaders && receiveData) {
+    if (socketHasState(&state, SOCKET_STATE_HAD_HEADERS) && receiveData) {
       JsVar *resVar = jsvObjectGetChild(connection,HTTP_NAME_RESPONSE_VAR,0);
       jsiQueueObjectCallbacks(resVar, HTTP_NAME_ON_DATA, receiveData, 0);
       jsvUnLock(resVar);
       // clear - because we have issued a callback
-      jsvObjectSetChild(connection,HTTP_NAME_RECEIVE_DATA,0);
+      socketSetStateData(connection, &state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA, 0);
     }
 
     if (!closeConnectionNow) {
-      JsVar *sendData = jsvObjectGetChild(connection,HTTP_NAME_SEND_DATA,0);
+      JsVar *sendData = socketGetStateData(connection, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA);
       // send data if possible
       if (sendData) {
-        bool b = _http_send(net, sckt, &sendData);
+        bool b = socketSend(net, state.data.sckt, &sendData);
         if (!b)
           closeConnectionNow = true;
-        jsvObjectSetChild(connection, HTTP_NAME_SEND_DATA, sendData); // _http_send prob updated sendData
+        socketSetStateData(connection, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA, sendData); // socketSend prob updated sendData
       }
       // Now read data if possible
-      int num = net->recv(net, sckt, buf, sizeof(buf));
+      int num = net->recv(net, state.data.sckt, buf, sizeof(buf));
       if (num<0) {
         // we probably disconnected so just get rid of this
         closeConnectionNow = true;
@@ -398,19 +370,18 @@ bool httpClientConnectionsIdle(JsNetwork *net) {
         if (num>0) {
           if (!receiveData) {
             receiveData = jsvNewFromEmptyString();
-            jsvObjectSetChild(connection, HTTP_NAME_RECEIVE_DATA, receiveData);
+            socketSetStateData(connection, &state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA, receiveData);
           }
           if (receiveData) { // could be out of memory
             jsvAppendStringBuf(receiveData, buf, num);
-            if (!hadHeaders) {
+            if (!socketHasState(&state, SOCKET_STATE_HAD_HEADERS)) {
               JsVar *resVar = jsvObjectGetChild(connection,HTTP_NAME_RESPONSE_VAR,0);
               if (httpParseHeaders(&receiveData, resVar, false)) {
-                hadHeaders = true;
-                jsvUnLock(jsvObjectSetChild(connection, HTTP_NAME_HAD_HEADERS, jsvNewFromBool(hadHeaders)));
+                socketSetStateFlag(&state, SOCKET_STATE_HAD_HEADERS, true);
                 jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_CONNECT, resVar, 0);
               }
               jsvUnLock(resVar);
-              jsvObjectSetChild(connection, HTTP_NAME_RECEIVE_DATA, receiveData);
+              socketSetStateData(connection, &state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA, receiveData);
             }
           }
         }
@@ -423,13 +394,18 @@ bool httpClientConnectionsIdle(JsNetwork *net) {
       jsiQueueObjectCallbacks(resVar, HTTP_NAME_ON_CLOSE, 0, 0);
       jsvUnLock(resVar);
 
-      _httpConnectionKill(net, connection);
+      socketKill(net, state.data.sckt);
       JsVar *connectionName = jsvArrayIteratorGetIndex(&it);
       jsvArrayIteratorNext(&it);
       jsvRemoveChild(arr, connectionName);
       jsvUnLock(connectionName);
-    } else
+    } else {
+      // only write state back if it changed
+      if (state.data.flags != oldFlags)
+        socketSetState(connection, &state);
       jsvArrayIteratorNext(&it);
+    }
+    socketFreeState(&state);
     jsvUnLock(connection);
   }
   jsvUnLock(arr);
@@ -454,10 +430,11 @@ bool httpIdle(JsNetwork *net) {
       hadSockets = true;
 
       JsVar *server = jsvArrayIteratorGetElement(&it);
-      int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChild(server,HTTP_NAME_SOCKET,0))-1; // so -1 if undefined
-
-      int theClient = net->accept(net, sckt);
-      if (theClient >= 0) {
+      SocketState state;
+      socketGetState(server, &state);
+      // accept everything that's waiting, so a burst of connections doesn't overflow the listen backlog
+      int theClient;
+      while ((theClient = net->accept(net, state.data.sckt)) >= 0) {
         JsVar *req = jspNewObject(0, "httpSRq");
         JsVar *res = jspNewObject(0, "httpSRs");
         if (res && req) { // out of memory?
@@ -468,16 +445,16 @@ bool httpIdle(JsNetwork *net) {
           }
           jsvObjectSetChild(req, HTTP_NAME_RESPONSE_VAR, res);
           jsvObjectSetChild(req, HTTP_NAME_SERVER_VAR, server);
-          jsvUnLock(jsvObjectSetChild(req, HTTP_NAME_SOCKET, jsvNewFromInteger(theClient+1)));
+          socketUpdateState(req, theClient, SOCKET_STATE_NONE);
           // on response
           jsvUnLock(jsvObjectSetChild(res, HTTP_NAME_CODE, jsvNewFromInteger(200)));
           jsvUnLock(jsvObjectSetChild(res, HTTP_NAME_HEADERS, jsvNewWithFlags(JSV_OBJECT)));
-        }
+        } else
+          net->closesocket(net, theClient);
         jsvUnLock(req);
         jsvUnLock(res);
-        //add(new CNetworkConnect(theClient, this));
-        // add to service queue
       }
+      socketFreeState(&state);
 
       jsvUnLock(server);
       jsvArrayIteratorNext(&it);
@@ -511,9 +488,9 @@ void httpServerListen(JsNetwork *net, JsVar *server, int port) {
   int sckt = net->createsocket(net, 0/*server*/, (unsigned short)port);
   if (sckt<0) {
     jsError("Unable to create socket\n");
-    jsvUnLock(jsvObjectSetChild(server, HTTP_NAME_CLOSENOW, jsvNewFromBool(true)));
+    socketUpdateState(server, -1, SOCKET_STATE_CLOSENOW);
   } else {
-    jsvUnLock(jsvObjectSetChild(server, HTTP_NAME_SOCKET, jsvNewFromInteger(sckt+1)));
+    socketUpdateState(server, sckt, SOCKET_STATE_NONE);
     // add to list of servers
     jsvArrayPush(arr, server);
   }
@@ -524,7 +501,10 @@ void httpServerClose(JsNetwork *net, JsVar *server) {
   JsVar *arr = httpGetArray(HTTP_ARRAY_HTTP_SERVERS,false);
   if (arr) {
     // close socket
-    _httpConnectionKill(net, server);
+    SocketState state;
+    socketGetState(server, &state);
+    socketKill(net, state.data.sckt);
+    socketFreeState(&state);
     // remove from array
     JsVar *idx = jsvGetArrayIndexOf(arr, server, true);
     if (idx) {
@@ -556,7 +536,9 @@ JsVar *httpClientRequestNew(JsVar *options, JsVar *callback) {
 
 void httpClientRequestWrite(JsVar *httpClientReqVar, JsVar *data) {
   // Append data to sendData
-  JsVar *sendData = jsvObjectGetChild(httpClientReqVar, HTTP_NAME_SEND_DATA, false);
+  SocketState state;
+  socketGetState(httpClientReqVar, &state);
+  JsVar *sendData = socketGetStateData(httpClientReqVar, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA);
   if (!sendData) {
     JsVar *options = jsvObjectGetChild(httpClientReqVar, HTTP_NAME_OPTIONS_VAR, false);
     if (options) {
@@ -589,9 +571,11 @@ void httpClientRequestWrite(JsVar *httpClientReqVar, JsVar *data) {
     } else {
       sendData = jsvNewFromString("");
     }
-    jsvObjectSetChild(httpClientReqVar, HTTP_NAME_SEND_DATA, sendData);
+    socketSetStateData(httpClientReqVar, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA, sendData);
+    socketSetState(httpClientReqVar, &state);
     jsvUnLock(options);
   }
+  socketFreeState(&state);
   if (data && sendData) {
     JsVar *s = jsvAsString(data, false);
     if (s) jsvAppendStringVarComplete(sendData,s);
@@ -617,7 +601,7 @@ void httpClientRequestEnd(JsNetwork *net, JsVar *httpClientReqVar) {
 
   if(!host_addr) {
     jsError("Unable to locate host");
-    jsvUnLock(jsvObjectSetChild(httpClientReqVar, HTTP_NAME_CLOSENOW, jsvNewFromBool(true)));
+    socketUpdateState(httpClientReqVar, -1, SOCKET_STATE_CLOSENOW);
     jsvUnLock(options);
     net->checkError(net);
     return;
@@ -626,9 +610,9 @@ void httpClientRequestEnd(JsNetwork *net, JsVar *httpClientReqVar) {
   int sckt =  net->createsocket(net, host_addr, port);
   if (sckt<0) {
     jsError("Unable to create socket\n");
-    jsvUnLock(jsvObjectSetChild(httpClientReqVar, HTTP_NAME_CLOSENOW, jsvNewFromBool(true)));
+    socketUpdateState(httpClientReqVar, -1, SOCKET_STATE_CLOSENOW);
   } else {
-    jsvUnLock(jsvObjectSetChild(httpClientReqVar, HTTP_NAME_SOCKET, jsvNewFromInteger(sckt+1)));
+    socketUpdateState(httpClientReqVar, sckt, SOCKET_STATE_NONE);
   }
 
   jsvUnLock(options);
@@ -659,7 +643,9 @@ void httpServerResponseWriteHead(JsVar *httpServerResponseVar, int statusCode, J
 
 void httpServerResponseData(JsVar *httpServerResponseVar, JsVar *data) {
   // Append data to sendData
-  JsVar *sendData = jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_SEND_DATA, 0);
+  SocketState state;
+  socketGetState(httpServerResponseVar, &state);
+  JsVar *sendData = socketGetStateData(httpServerResponseVar, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA);
   if (!sendData) {
     // no sendData, so no headers - add them!
     JsVar *sendHeaders = jsvObjectGetChild(httpServerResponseVar, HTTP_NAME_HEADERS, 0);
@@ -675,8 +661,10 @@ void httpServerResponseData(JsVar *httpServerResponseVar, JsVar *data) {
       // we have already sent headers
       sendData = jsvNewFromEmptyString();
     }
-    jsvObjectSetChild(httpServerResponseVar, HTTP_NAME_SEND_DATA, sendData);
+    socketSetStateData(httpServerResponseVar, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA, sendData);
+    socketSetState(httpServerResponseVar, &state);
   }
+  socketFreeState(&state);
   if (sendData && !jsvIsUndefined(data)) {
     JsVar *s = jsvAsString(data, false);
     if (s) jsvAppendStringVarComplete(sendData,s);
@@ -687,6 +675,6 @@ void httpServerResponseData(JsVar *httpServerResponseVar, JsVar *data) {
 
 void httpServerResponseEnd(JsVar *httpServerResponseVar) {
   httpServerResponseData(httpServerResponseVar, 0); // force onnection->sendData to be created even if data not called
-  jsvUnLock(jsvObjectSetChild(httpServerResponseVar, HTTP_NAME_CLOSE, jsvNewFromBool(true)));
+  socketUpdateState(httpServerResponseVar, -1, SOCKET_STATE_CLOSE);
 }
 
@@ -57,8 +57,7 @@ void jswrap_http_kill() {
                          "NOTE: This is currently only available in the Raspberry Pi version",
                          "This is a cut-down version of node.js's library",
                          "Please see http://nodemanual.org/latest/nodejs_ref_guide/http.html",
-                         "To use this, you must type ```var http = require('http')``` to get access to the library",
-                         "NOTE: The HTTP client + server send in ~8 byte chunks. This is normally fine but big servers - eg. Google will reject requests made like this (DDoS protection?)"
+                         "To use this, you must type ```var http = require('http')``` to get access to the library"
                           ]
 }*/
 /*JSON{ "type":"class",
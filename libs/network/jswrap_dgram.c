@@ -0,0 +1,126 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * Contains JavaScript 'dgram' (UDP socket) Functions
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_dgram.h"
+#include "socketserver.h"
+#include "network.h"
+
+/*
+
+var s = require("dgram").createSocket("udp4", function(msg, rinfo) {
+  console.log(rinfo.address+":"+rinfo.port+" sent "+msg);
+});
+s.bind(8125);
+s.send("foo:1|c", 8125, "localhost");
+
+ */
+
+/*JSON{ "type":"idle", "generate" : "jswrap_dgram_idle" }*/
+bool jswrap_dgram_idle() {
+  JsNetwork net;
+  if (!networkGetFromVar(&net)) return false;
+  bool b = dgramIdle(&net);
+  networkFree(&net);
+  return b;
+}
+
+/*JSON{ "type":"init", "generate" : "jswrap_dgram_init" }*/
+void jswrap_dgram_init() {
+  dgramInit();
+}
+
+/*JSON{ "type":"kill", "generate" : "jswrap_dgram_kill" }*/
+void jswrap_dgram_kill() {
+  JsNetwork net;
+  if (!networkGetFromVar(&net)) return;
+  dgramKill(&net);
+  networkFree(&net);
+}
+
+/*JSON{ "type":"library",
+        "class" : "dgram",
+        "description" : [
+                         "This library allows you to send and receive UDP datagrams",
+                         "This is a cut-down version of node.js's library",
+                         "Please see http://nodejs.org/api/dgram.html",
+                         "To use this, you must type ```var dgram = require('dgram')``` to get access to the library"
+                          ]
+}*/
+/*JSON{ "type":"class",
+        "class" : "Dgram",
+        "description" : ["A UDP socket, created by dgram.createSocket",
+                         "Events are `message` (called once for each datagram with the data and an object containing `address`, `port` and `size`) and `close`" ]
+}*/
+
+// ---------------------------------------------------------------------------------
+/*JSON{ "type":"staticmethod",
+         "class" : "dgram", "name" : "createSocket",
+         "generate" : "jswrap_dgram_createSocket",
+         "description" : ["Create a UDP socket. To receive datagrams, call `bind` with the port to listen on" ],
+         "params" : [ [ "type", "JsVar", "The type of socket - only 'udp4' is supported"],
+                      [ "callback", "JsVar", "An optional function(msg, rinfo) that is added as a listener for the `message` event"] ],
+         "return" : ["JsVar", "Returns a new Dgram object"]
+}*/
+JsVar *jswrap_dgram_createSocket(JsVar *type, JsVar *callback) {
+  if (!jsvIsUndefined(type) && !jsvIsStringEqual(type, "udp4")) {
+    jsError("Only 'udp4' sockets are supported");
+    return 0;
+  }
+  if (!jsvIsUndefined(callback) && !jsvIsFunction(callback)) {
+    jsError("Expecting Callback Function but got %t", callback);
+    return 0;
+  }
+  return dgramSocketNew(jsvIsUndefined(callback) ? 0 : callback);
+}
+
+// ---------------------------------------------------------------------------------
+/*JSON{ "type":"method",
+         "class" : "Dgram", "name" : "bind",
+         "description" : [ "Start listening for datagrams on the given port" ],
+         "generate" : "jswrap_dgram_socket_bind",
+         "params" : [ [ "port", "int32", "The port to listen on"] ]
+}*/
+void jswrap_dgram_socket_bind(JsVar *parent, int port) {
+  JsNetwork net;
+  if (!networkGetFromVarIfOnline(&net)) return;
+
+  dgramSocketBind(&net, parent, port);
+  networkFree(&net);
+}
+
+/*JSON{ "type":"method",
+         "class" : "Dgram", "name" : "send",
+         "description" : [ "Queue a datagram to be sent. Datagrams are sent (several at once where the network allows) when idle" ],
+         "generate" : "jswrap_dgram_socket_send",
+         "params" : [ [ "msg", "JsVar", "A string, Array or ArrayBuffer containing the data to send"],
+                      [ "port", "int32", "The port to send to"],
+                      [ "address", "JsVar", "The host name or IP address to send to (default is 'localhost')"] ]
+}*/
+void jswrap_dgram_socket_send(JsVar *parent, JsVar *msg, int port, JsVar *address) {
+  JsNetwork net;
+  if (!networkGetFromVarIfOnline(&net)) return;
+
+  dgramSocketSend(&net, parent, msg, port, address);
+  networkFree(&net);
+}
+
+/*JSON{ "type":"method",
+         "class" : "Dgram", "name" : "close",
+         "description" : [ "Close this socket once any queued datagrams have been sent" ],
+         "generate" : "jswrap_dgram_socket_close"
+}*/
+void jswrap_dgram_socket_close(JsVar *parent) {
+  dgramSocketClose(parent);
+}
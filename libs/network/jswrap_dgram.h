@@ -0,0 +1,24 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Contains JavaScript 'dgram' (UDP socket) Functions
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+bool jswrap_dgram_idle();
+void jswrap_dgram_init();
+void jswrap_dgram_kill();
+
+JsVar *jswrap_dgram_createSocket(JsVar *type, JsVar *callback);
+
+void jswrap_dgram_socket_bind(JsVar *parent, int port);
+void jswrap_dgram_socket_send(JsVar *parent, JsVar *msg, int port, JsVar *address);
+void jswrap_dgram_socket_close(JsVar *parent);
@@ -0,0 +1,158 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * Contains JavaScript 'net' (raw TCP socket) Functions
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_net.h"
+#include "socketserver.h"
+#include "network.h"
+
+/*
+
+var server = require("net").createServer(function(socket) {
+  socket.on('data', function(d) { socket.write(d); });
+}).listen(8080);
+
+ */
+
+/*JSON{ "type":"idle", "generate" : "jswrap_net_idle" }*/
+bool jswrap_net_idle() {
+  JsNetwork net;
+  if (!networkGetFromVar(&net)) return false;
+  bool b = netIdle(&net);
+  networkFree(&net);
+  return b;
+}
+
+/*JSON{ "type":"init", "generate" : "jswrap_net_init" }*/
+void jswrap_net_init() {
+  netInit();
+}
+
+/*JSON{ "type":"kill", "generate" : "jswrap_net_kill" }*/
+void jswrap_net_kill() {
+  JsNetwork net;
+  if (!networkGetFromVar(&net)) return;
+  netKill(&net);
+  networkFree(&net);
+}
+
+/*JSON{ "type":"library",
+        "class" : "net",
+        "description" : [
+                         "This library allows you to create TCP/IP servers and clients",
+                         "This is a cut-down version of node.js's library",
+                         "Please see http://nodejs.org/api/net.html",
+                         "To use this, you must type ```var net = require('net')``` to get access to the library",
+                         "Data is received as a String (which can contain binary data) in chunks of whatever was available - so it's up to you to split it into messages."
+                          ]
+}*/
+/*JSON{ "type":"class",
+        "class" : "Server",
+        "description" : ["The socket server created by net.createServer" ]
+}*/
+/*JSON{ "type":"class",
+        "class" : "Socket",
+        "description" : ["An actual socket connection - allowing transmit/receive of TCP data",
+                         "Events are `data` (with the received data as an argument), `drain` (after `write` returned false, when all data has been sent) and `close`" ]
+}*/
+
+// ---------------------------------------------------------------------------------
+/*JSON{ "type":"staticmethod",
+         "class" : "net", "name" : "createServer",
+         "generate" : "jswrap_net_createServer",
+         "description" : ["Create a Server", "When a request to the server is made, the callback is called with a Socket as an argument." ],
+         "params" : [ [ "callback", "JsVar", "A function(connection) that will be called when a connection is made"] ],
+         "return" : ["JsVar", "Returns a new Server object"]
+}*/
+JsVar *jswrap_net_createServer(JsVar *callback) {
+  if (!jsvIsFunction(callback)) {
+    jsError("Expecting Callback Function but got %t", callback);
+    return 0;
+  }
+  return netServerNew(callback);
+}
+
+/*JSON{ "type":"staticmethod",
+         "class" : "net", "name" : "connect",
+         "generate" : "jswrap_net_connect",
+         "description" : ["Create a socket connection" ],
+         "params" : [  [ "options", "JsVar", "An object containing host,port fields"],
+                       [ "callback", "JsVar", "A function(socket) that will be called when a connection is made. You can then call `socket.write(...)` and `socket.on('data', ...)`"] ],
+         "return" : ["JsVar", "Returns a new Socket object"]
+}*/
+JsVar *jswrap_net_connect(JsVar *options, JsVar *callback) {
+  if (!jsvIsObject(options)) {
+    jsError("Expecting Options to be an Object but it was %t", options);
+    return 0;
+  }
+  if (!jsvIsUndefined(callback) && !jsvIsFunction(callback)) {
+    jsError("Expecting Callback Function but got %t", callback);
+    return 0;
+  }
+  JsNetwork net;
+  if (!networkGetFromVarIfOnline(&net)) return 0;
+  JsVar *socket = netSocketConnect(&net, options, callback);
+  networkFree(&net);
+  return socket;
+}
+
+// ---------------------------------------------------------------------------------
+/*JSON{ "type":"method",
+         "class" : "Server", "name" : "listen",
+         "description" : [ "Start listening for new connections on the given port" ],
+         "generate" : "jswrap_net_server_listen",
+         "params" : [ [ "port", "int32", "The port to listen on"] ]
+}*/
+void jswrap_net_server_listen(JsVar *parent, int port) {
+  JsNetwork net;
+  if (!networkGetFromVarIfOnline(&net)) return;
+
+  netServerListen(&net, parent, port);
+  networkFree(&net);
+}
+
+/*JSON{ "type":"method",
+         "class" : "Server", "name" : "close",
+         "description" : [ "Stop listening for new connections" ],
+         "generate" : "jswrap_net_server_close"
+}*/
+void jswrap_net_server_close(JsVar *parent) {
+  JsNetwork net;
+  if (!networkGetFromVarIfOnline(&net)) return;
+
+  netServerClose(&net, parent);
+  networkFree(&net);
+}
+
+// ---------------------------------------------------------------------------------
+/*JSON{ "type":"method",
+         "class" : "Socket", "name" : "write",
+         "description" : [ "Queue data to be sent. It is sent (in as large chunks as the network allows) when idle" ],
+         "generate" : "jswrap_net_socket_write",
+         "params" : [ [ "data", "JsVar", "A string, Array or ArrayBuffer containing data to send"] ],
+         "return" : ["bool", "False if too much data is waiting to be sent - stop writing and wait for the `drain` event"]
+}*/
+bool jswrap_net_socket_write(JsVar *parent, JsVar *data) {
+  return netSocketWrite(parent, data);
+}
+
+/*JSON{ "type":"method",
+         "class" : "Socket", "name" : "end",
+         "description" : [ "Close this socket once all data has been sent - optional data to append as an argument" ],
+         "generate" : "jswrap_net_socket_end",
+         "params" : [ [ "data", "JsVar", "A string, Array or ArrayBuffer containing data to send"] ]
+}*/
+void jswrap_net_socket_end(JsVar *parent, JsVar *data) {
+  netSocketEnd(parent, data);
+}
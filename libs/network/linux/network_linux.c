@@ -11,6 +11,9 @@
  * Implementation of JsNetwork for Linux
  * ----------------------------------------------------------------------------
  */
+#ifdef __linux__
+#define _GNU_SOURCE // for sendmmsg/recvmmsg
+#endif
 #include "network.h"
 #include "network_linux.h"
 
@@ -39,6 +42,57 @@
  #define closesocket(SOCK) close(SOCK)
 
 
+/* All sockets are non-blocking. Rather than doing a select for each socket every time we
+ * try to recv from it, net_linux_idle checks every socket we have open with one select, and
+ * recv/accept skip sockets that had nothing waiting. */
+static fd_set net_linux_open; ///< Sockets that we have open
+static fd_set net_linux_readable; ///< Sockets that had something to recv/accept at the last idle
+static int net_linux_maxSocket = -1;
+
+static void net_linux_setNonBlocking(int sckt) {
+#ifdef WIN_OS
+  u_long n = 1;
+  ioctlsocket(sckt,FIONBIO,&n);
+#else
+  fcntl(sckt, F_SETFL, fcntl(sckt, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+/// Start checking this socket on idle. It's marked readable, so we'll try it at least once
+static void net_linux_addSocket(int sckt) {
+  net_linux_setNonBlocking(sckt);
+  if (sckt>=FD_SETSIZE) return; // can't go in an fd_set - we just always try it
+  if (net_linux_maxSocket<0) {
+    FD_ZERO(&net_linux_open);
+    FD_ZERO(&net_linux_readable);
+  }
+  FD_SET(sckt, &net_linux_open);
+  FD_SET(sckt, &net_linux_readable);
+  if (sckt>net_linux_maxSocket) net_linux_maxSocket = sckt;
+}
+
+static void net_linux_removeSocket(int sckt) {
+  if (sckt>=FD_SETSIZE || net_linux_maxSocket<0) return;
+  FD_CLR(sckt, &net_linux_open);
+  FD_CLR(sckt, &net_linux_readable);
+}
+
+/// Did this socket have anything waiting at the last idle? (or has it not been checked yet)
+static bool net_linux_isReadable(int sckt) {
+  return sckt>=FD_SETSIZE || net_linux_maxSocket<0 || !FD_ISSET(sckt, &net_linux_open) || FD_ISSET(sckt, &net_linux_readable);
+}
+
+/// We've read everything that was waiting - don't try again until the next idle says there's more
+static void net_linux_setDrained(int sckt) {
+  if (sckt<FD_SETSIZE && net_linux_maxSocket>=0)
+    FD_CLR(sckt, &net_linux_readable);
+}
+
+/// Was the error from a non-blocking socket just because it wasn't ready?
+static bool net_linux_isNotReady() {
+  return errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR;
+}
+
 /// Get an IP address from a name. Sets out_ip_addr to 0 on failure
 void net_linux_gethostbyname(JsNetwork *net, char * hostName, unsigned long* out_ip_addr) {
   NOT_USED(net);
@@ -50,6 +104,14 @@ void net_linux_gethostbyname(JsNetwork *net, char * hostName, unsigned long* out
 /// Called on idle. Do any checks required for this device
 void net_linux_idle(JsNetwork *net) {
   NOT_USED(net);
+  if (net_linux_maxSocket<0) return;
+  // find out which of our sockets have something to recv/accept, with one syscall
+  net_linux_readable = net_linux_open;
+  struct timeval timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 0;
+  if (select(net_linux_maxSocket+1, &net_linux_readable, NULL, NULL, &timeout) == SOCKET_ERROR)
+    net_linux_readable = net_linux_open; // just try them all
 }
 
 /// Call just before returning to idle loop. This checks for errors and tries to recover. Returns true if no errors.
@@ -71,11 +133,8 @@ int net_linux_createsocket(JsNetwork *net, unsigned long host, unsigned short po
     sckt = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (sckt<0) return sckt; // error
 
-    // turn on non-blocking mode
-    #ifdef WIN_OS
-    u_long n = 1;
-    ioctlsocket(sckt,FIONBIO,&n);
-    #endif
+    // turn on non-blocking mode - connect returns straight away and we find out how it went when we recv
+    net_linux_addSocket(sckt);
 
     sin.sin_addr.s_addr = (in_addr_t)host;
 
@@ -121,12 +180,13 @@ int net_linux_createsocket(JsNetwork *net, unsigned long host, unsigned short po
     }
 
     // Make the socket listen
-    nret = listen(sckt, 10); // 10 connections (but this ignored on CC30000)
+    nret = listen(sckt, SOMAXCONN);
     if (nret == SOCKET_ERROR) {
       jsError("Socket listen failed");
       closesocket(sckt);
       return -1;
     }
+    net_linux_addSocket(sckt);
   }
   return sckt;
 }
@@ -134,71 +194,161 @@ int net_linux_createsocket(JsNetwork *net, unsigned long host, unsigned short po
 /// destroys the given socket
 void net_linux_closesocket(JsNetwork *net, int sckt) {
   NOT_USED(net);
+  net_linux_removeSocket(sckt);
   closesocket(sckt);
 }
 
 /// If the given server socket can accept a connection, return it (or return < 0)
 int net_linux_accept(JsNetwork *net, int sckt) {
   NOT_USED(net);
-  // TODO: look for unreffed servers?
-  fd_set s;
-  FD_ZERO(&s);
-  FD_SET(sckt,&s);
-  // check for waiting clients
-  struct timeval timeout;
-  timeout.tv_sec = 0;
-  timeout.tv_usec = 0;
-  int n = select(sckt+1,&s,NULL,NULL,&timeout);
-  if (n>0) {
-    // we have a client waiting to connect... try to connect and see what happens
-    int theClient = accept(sckt,0,0);
-    return theClient;
+  if (!net_linux_isReadable(sckt)) return -1; // nobody was waiting to connect at the last idle
+  int theClient = accept(sckt,0,0);
+  if (theClient<0) {
+    net_linux_setDrained(sckt);
+    return -1;
   }
-  return -1;
+  net_linux_addSocket(theClient);
+  return theClient;
 }
 
 /// Receive data if possible. returns nBytes on success, 0 on no data, or -1 on failure
 int net_linux_recv(JsNetwork *net, int sckt, void *buf, size_t len) {
   NOT_USED(net);
-  int num = 0;
-  fd_set s;
-  FD_ZERO(&s);
-  FD_SET(sckt,&s);
-  // check for waiting clients
-  struct timeval timeout;
-  timeout.tv_sec = 0;
-  timeout.tv_usec = 0;
-  int n = select(sckt+1,&s,NULL,NULL,&timeout);
-  if (n==SOCKET_ERROR) {
-    // we probably disconnected
-    return -1;
-  } else if (n>0) {
-    // receive data
-    num = (int)recv(sckt,buf,len,0);
-    if (num==0) num=-1; // select says data, but recv says 0 means connection is closed
+  if (!net_linux_isReadable(sckt)) return 0; // nothing was waiting at the last idle
+  int num = (int)recv(sckt,buf,len,0);
+  if (num==0) return -1; // connection is closed
+  if (num<0) {
+    if (!net_linux_isNotReady()) return -1; // we probably disconnected
+    net_linux_setDrained(sckt);
+    return 0;
   }
-
+  if ((size_t)num<len) net_linux_setDrained(sckt); // we got everything there was
   return num;
 }
 
 /// Send data if possible. returns nBytes on success, 0 on no data, or -1 on failure
 int net_linux_send(JsNetwork *net, int sckt, const void *buf, size_t len) {
   NOT_USED(net);
-  fd_set writefds;
-  FD_ZERO(&writefds);
-  FD_SET(sckt, &writefds);
-  struct timeval time;
-  time.tv_sec = 0;
-  time.tv_usec = 0;
-  int n = select(sckt+1, 0, &writefds, 0, &time);
-  if (n==SOCKET_ERROR ) {
-     // we probably disconnected so just get rid of this
-    return -1;
-  } else if (FD_ISSET(sckt, &writefds)) {
-    n = send(sckt, buf, len, MSG_NOSIGNAL);
-    return n;
-  } else
+  int n = (int)send(sckt, buf, len, MSG_NOSIGNAL);
+  if (n<0 && net_linux_isNotReady())
     return 0; // just not ready
+  return n;
+}
+
+/// Creates a UDP socket, bound to the given port if port!=0. Returns >=0 on success
+int net_linux_createdgram(JsNetwork *net, unsigned short port) {
+  NOT_USED(net);
+  int sckt = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sckt == INVALID_SOCKET) {
+    jsError("Socket creation failed");
+    return -1;
+  }
+  if (port) {
+    int optval = 1;
+    if (setsockopt(sckt,SOL_SOCKET,SO_REUSEADDR,(const char *)&optval,sizeof(optval)) < 0)
+      jsWarn("setsockopt failed\n");
+
+    sockaddr_in serverInfo;
+    memset(&serverInfo, 0, sizeof(serverInfo));
+    serverInfo.sin_family = AF_INET;
+    serverInfo.sin_addr.s_addr = INADDR_ANY; // allow anyone to send to us
+    serverInfo.sin_port = (unsigned short)htons(port);
+    if (bind(sckt, (struct sockaddr*)&serverInfo, sizeof(serverInfo)) == SOCKET_ERROR) {
+      jsError("Socket bind failed");
+      closesocket(sckt);
+      return -1;
+    }
+  }
+  net_linux_addSocket(sckt);
+  return sckt;
+}
+
+#define NET_LINUX_DGRAM_BATCH 16 ///< Max datagrams we pass to the kernel in one sendmmsg/recvmmsg
+
+/// Send as many of the given datagrams as possible without blocking. returns the number sent, or -1 on failure
+int net_linux_sendto(JsNetwork *net, int sckt, JsNetworkDatagram *msgs, int count) {
+  NOT_USED(net);
+  if (count > NET_LINUX_DGRAM_BATCH) count = NET_LINUX_DGRAM_BATCH;
+  sockaddr_in addr[NET_LINUX_DGRAM_BATCH];
+  memset(addr, 0, sizeof(addr));
+  int i;
+  for (i=0;i<count;i++) {
+    addr[i].sin_family = AF_INET;
+    addr[i].sin_addr.s_addr = (in_addr_t)msgs[i].host;
+    addr[i].sin_port = htons(msgs[i].port);
+  }
+  int n = 0;
+#ifdef MSG_WAITFORONE // sendmmsg is available - send them all with one system call
+  struct mmsghdr hdrs[NET_LINUX_DGRAM_BATCH];
+  struct iovec iov[NET_LINUX_DGRAM_BATCH];
+  memset(hdrs, 0, sizeof(hdrs));
+  for (i=0;i<count;i++) {
+    iov[i].iov_base = msgs[i].buf;
+    iov[i].iov_len = msgs[i].len;
+    hdrs[i].msg_hdr.msg_name = &addr[i];
+    hdrs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    hdrs[i].msg_hdr.msg_iov = &iov[i];
+    hdrs[i].msg_hdr.msg_iovlen = 1;
+  }
+  n = sendmmsg(sckt, hdrs, (unsigned int)count, MSG_DONTWAIT|MSG_NOSIGNAL);
+#else
+  while (n<count) {
+    if (sendto(sckt, msgs[n].buf, msgs[n].len, MSG_DONTWAIT|MSG_NOSIGNAL, (struct sockaddr*)&addr[n], sizeof(sockaddr_in)) < 0) {
+      if (n==0) n = -1;
+      break;
+    }
+    n++;
+  }
+#endif
+  if (n<0)
+    return net_linux_isNotReady() ? 0 : -1;
+  return n;
+}
+
+/// Receive up to count datagrams if possible. returns the number received, or -1 on failure
+int net_linux_recvfrom(JsNetwork *net, int sckt, JsNetworkDatagram *msgs, int count) {
+  NOT_USED(net);
+  if (!net_linux_isReadable(sckt)) return 0; // nothing was waiting at the last idle
+  if (count > NET_LINUX_DGRAM_BATCH) count = NET_LINUX_DGRAM_BATCH;
+  sockaddr_in addr[NET_LINUX_DGRAM_BATCH];
+  int i, n = 0;
+#ifdef MSG_WAITFORONE // recvmmsg is available - get everything that's waiting with one system call
+  struct mmsghdr hdrs[NET_LINUX_DGRAM_BATCH];
+  struct iovec iov[NET_LINUX_DGRAM_BATCH];
+  memset(hdrs, 0, sizeof(hdrs));
+  for (i=0;i<count;i++) {
+    iov[i].iov_base = msgs[i].buf;
+    iov[i].iov_len = msgs[i].len;
+    hdrs[i].msg_hdr.msg_name = &addr[i];
+    hdrs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    hdrs[i].msg_hdr.msg_iov = &iov[i];
+    hdrs[i].msg_hdr.msg_iovlen = 1;
+  }
+  n = recvmmsg(sckt, hdrs, (unsigned int)count, MSG_DONTWAIT, 0);
+  for (i=0;i<n;i++)
+    msgs[i].len = hdrs[i].msg_len;
+#else
+  while (n<count) {
+    socklen_t addrLen = sizeof(sockaddr_in);
+    ssize_t len = recvfrom(sckt, msgs[n].buf, msgs[n].len, MSG_DONTWAIT, (struct sockaddr*)&addr[n], &addrLen);
+    if (len < 0) {
+      if (n==0) n = -1;
+      break;
+    }
+    msgs[n++].len = (size_t)len;
+  }
+#endif
+  if (n<0) {
+    if (!net_linux_isNotReady()) return -1;
+    net_linux_setDrained(sckt);
+    return 0; // no data
+  }
+  if (n<count) net_linux_setDrained(sckt); // we got everything there was
+  for (i=0;i<n;i++) {
+    msgs[i].host = (unsigned long)addr[i].sin_addr.s_addr;
+    msgs[i].port = ntohs(addr[i].sin_port);
+  }
+  return n;
 }
 
 void netSetCallbacks_linux(JsNetwork *net) {
@@ -210,4 +360,7 @@ void netSetCallbacks_linux(JsNetwork *net) {
   net->gethostbyname = net_linux_gethostbyname;
   net->recv = net_linux_recv;
   net->send = net_linux_send;
+  net->createdgram = net_linux_createdgram;
+  net->sendto = net_linux_sendto;
+  net->recvfrom = net_linux_recvfrom;
 }
@@ -44,6 +44,14 @@ typedef struct {
   //Pin pinCS, pinIRQ, pinEN;
 } PACKED_FLAGS JsNetworkData;
 
+/// One UDP datagram, as passed to JsNetwork's sendto/recvfrom
+typedef struct {
+  unsigned long host; ///< IP address, in the same form as returned by gethostbyname
+  unsigned short port;
+  void *buf;
+  size_t len; ///< Length of the data in buf (for recvfrom this is set to the length received)
+} JsNetworkDatagram;
+
 typedef struct JsNetwork {
   JsVar *networkVar; // this won't be locked again - we just know that it is already locked by something else
   JsNetworkData data;
@@ -66,6 +74,14 @@ typedef struct JsNetwork {
   int (*recv)(struct JsNetwork *net, int sckt, void *buf, size_t len);
   /// Send data if possible. returns nBytes on success, 0 on no data, or -1 on failure
   int (*send)(struct JsNetwork *net, int sckt, const void *buf, size_t len);
+
+  // The datagram (UDP) functions are optional - they are 0 if the device doesn't support them
+  /// Creates a UDP socket, bound to the given port if port!=0. Returns >=0 on success. Close it with closesocket
+  int (*createdgram)(struct JsNetwork *net, unsigned short port);
+  /// Send as many of the given datagrams as possible without blocking. returns the number sent, or -1 on failure
+  int (*sendto)(struct JsNetwork *net, int sckt, JsNetworkDatagram *msgs, int count);
+  /// Receive up to count datagrams if possible (each into msgs[i].buf, which has room for msgs[i].len bytes). returns the number received, or -1 on failure
+  int (*recvfrom)(struct JsNetwork *net, int sckt, JsNetworkDatagram *msgs, int count);
 } PACKED_FLAGS JsNetwork;
 
 // ---------------------------------- these are in network.c
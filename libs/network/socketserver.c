@@ -0,0 +1,709 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Per-socket state shared by the socket libraries, raw TCP sockets ('net')
+ * and UDP sockets ('dgram')
+ * ----------------------------------------------------------------------------
+ */
+#include "socketserver.h"
+#include "jsparse.h"
+#include "jsinteractive.h"
+
+#define NET_NAME_ON_CONNECT "#onconnect"
+#define NET_NAME_ON_DATA "#ondata"
+#define NET_NAME_ON_DRAIN "#ondrain"
+#define NET_NAME_ON_CLOSE "#onclose"
+
+#define NET_ARRAY_SERVERS JS_HIDDEN_CHAR_STR"NetS"
+#define NET_ARRAY_SOCKETS JS_HIDDEN_CHAR_STR"NetC"
+
+#define DGRAM_NAME_ON_MESSAGE "#onmessage"
+#define DGRAM_ARRAY_SOCKETS JS_HIDDEN_CHAR_STR"NetU"
+#define DGRAM_HEADER_SIZE 6 ///< Queued datagrams start with the 4 byte host and 2 byte port
+
+// ----------------------------------------------------------------------------- socket state
+
+void socketGetState(JsVar *obj, SocketState *state) {
+  state->var = jsvObjectGetChild(obj, SOCKET_NAME_STATE, 0);
+  if (state->var) {
+    jsvGetString(state->var, (char*)&state->data, sizeof(SocketStateData)+1/*trailing zero*/);
+  } else {
+    state->data.sckt = -1;
+    state->data.flags = SOCKET_STATE_NONE;
+  }
+}
+
+void socketSetState(JsVar *obj, SocketState *state) {
+  if (!state->var) {
+    state->var = jsvNewStringOfLength(sizeof(SocketStateData));
+    if (!state->var) return; // out of memory
+    jsvObjectSetChild(obj, SOCKET_NAME_STATE, state->var); // keep our lock - it's freed by socketFreeState
+  }
+  jsvSetString(state->var, (char*)&state->data, sizeof(SocketStateData));
+}
+
+void socketUpdateState(JsVar *obj, int sckt, SocketStateFlags setFlags) {
+  SocketState state;
+  socketGetState(obj, &state);
+  if (sckt>=0) state.data.sckt = sckt;
+  socketSetStateFlag(&state, setFlags, true);
+  socketSetState(obj, &state);
+  socketFreeState(&state);
+}
+
+JsVar *socketGetStateData(JsVar *obj, SocketState *state, SocketStateFlags flag, const char *name) {
+  if (!socketHasState(state, flag)) return 0;
+  return jsvObjectGetChild(obj, name, 0);
+}
+
+void socketSetStateData(JsVar *obj, SocketState *state, SocketStateFlags flag, const char *name, JsVar *data) {
+  if (data) {
+    jsvObjectSetChild(obj, name, data);
+  } else if (socketHasState(state, flag)) {
+    jsvRemoveNamedChild(obj, name);
+  }
+  socketSetStateFlag(state, flag, data!=0);
+}
+
+// ----------------------------------------------------------------------------- socket helpers
+
+void socketKill(JsNetwork *net, int sckt) {
+  if (!net || networkState != NETWORKSTATE_ONLINE) return;
+  if (sckt>=0) {
+    net->closesocket(net, sckt);
+  }
+}
+
+bool socketSend(JsNetwork *net, int sckt, JsVar **sendData) {
+  char buf[SOCKET_CHUNK_SIZE];
+  size_t sent = 0;
+  int a = 0;
+
+  if (jsvIsEmptyString(*sendData)) {
+    jsvUnLock(*sendData);
+    *sendData = 0;
+    return true;
+  }
+
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, *sendData, 0);
+  while (jsvStringIteratorHasChar(&it)) {
+    size_t bufLen = 0;
+    while (bufLen<sizeof(buf) && jsvStringIteratorHasChar(&it)) {
+      buf[bufLen++] = jsvStringIteratorGetChar(&it);
+      jsvStringIteratorNextInline(&it);
+    }
+    a = net->send(net, sckt, buf, bufLen);
+    if (a>0) sent += (size_t)a;
+    if (a!=(int)bufLen) break; // error, or the socket can't take any more right now
+  }
+  jsvStringIteratorFree(&it);
+
+  // Now cut what we managed to send off the beginning of sendData
+  if (sent>0) {
+    JsVar *newSendData = 0;
+    if (sent!=jsvGetStringLength(*sendData))
+      newSendData = jsvNewFromStringVar(*sendData, sent, JSVAPPENDSTRINGVAR_MAXLENGTH);
+    jsvUnLock(*sendData);
+    *sendData = newSendData;
+  }
+  if (a<0) { // could just be busy which is ok
+    jsError("Socket error %d while sending", a);
+    return false;
+  }
+  return true;
+}
+
+static JsVar *netGetArray(const char *name, bool create) {
+  return jsvObjectGetChild(execInfo.root, name, create?JSV_ARRAY:0);
+}
+
+/// Append a String, or the bytes of an Array/ArrayBuffer, to the end of str
+static void netAppendData(JsVar *str, JsVar *data) {
+  if (jsvIsArray(data) || jsvIsArrayBuffer(data)) {
+    JsvStringIterator dst;
+    jsvStringIteratorNew(&dst, str, 0);
+    jsvStringIteratorGotoEnd(&dst);
+    JsvIterator it;
+    jsvIteratorNew(&it, data);
+    while (jsvIteratorHasElement(&it)) {
+      jsvStringIteratorAppend(&dst, (char)jsvIteratorGetIntegerValue(&it));
+      jsvIteratorNext(&it);
+    }
+    jsvIteratorFree(&it);
+    jsvStringIteratorFree(&dst);
+  } else {
+    JsVar *s = jsvAsString(data, false);
+    if (s) jsvAppendStringVarComplete(str, s);
+    jsvUnLock(s);
+  }
+}
+
+// ----------------------------------------------------------------------------- net
+
+void netInit() {
+}
+
+NO_INLINE static void netCloseAllFor(JsNetwork *net, const char *name) {
+  JsVar *arr = netGetArray(name, false);
+  if (!arr) return;
+  JsvArrayIterator it;
+  jsvArrayIteratorNew(&it, arr);
+  while (jsvArrayIteratorHasElement(&it)) {
+    JsVar *obj = jsvArrayIteratorGetElement(&it);
+    SocketState state;
+    socketGetState(obj, &state);
+    socketKill(net, state.data.sckt);
+    socketFreeState(&state);
+    jsvUnLock(obj);
+    jsvArrayIteratorNext(&it);
+  }
+  jsvArrayIteratorFree(&it);
+  jsvRemoveAllChildren(arr);
+  jsvUnLock(arr);
+}
+
+NO_INLINE static void netCloseAll(JsNetwork *net) {
+  netCloseAllFor(net, NET_ARRAY_SOCKETS);
+  netCloseAllFor(net, NET_ARRAY_SERVERS);
+}
+
+void netKill(JsNetwork *net) {
+  netCloseAll(net);
+}
+
+/// Read everything that's available (up to SOCKET_MAX_RECEIVE) onto the end of receiveData. Returns false if the socket closed
+static bool netReceive(JsNetwork *net, JsVar *socket, SocketState *state) {
+  char buf[SOCKET_CHUNK_SIZE];
+  JsVar *receiveData = socketGetStateData(socket, state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA);
+  bool ok = true;
+  int total = 0;
+  while (total < SOCKET_MAX_RECEIVE) {
+    int num = net->recv(net, state->data.sckt, buf, sizeof(buf));
+    if (num<0) {
+      // we probably disconnected
+      ok = false;
+      break;
+    }
+    if (num==0) break;
+    if (!receiveData) {
+      receiveData = jsvNewFromEmptyString();
+      if (!receiveData) break; // out of memory
+      socketSetStateData(socket, state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA, receiveData);
+    }
+    jsvAppendStringBuf(receiveData, buf, num);
+    total += num;
+  }
+  // Fire off what we have in one go, but keep it if nobody is listening yet
+  if (receiveData && jsiObjectHasCallbacks(socket, NET_NAME_ON_DATA)) {
+    jsiQueueObjectCallbacks(socket, NET_NAME_ON_DATA, receiveData, 0);
+    socketSetStateData(socket, state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA, 0);
+  }
+  jsvUnLock(receiveData);
+  return ok;
+}
+
+static bool netSocketsIdle(JsNetwork *net) {
+  JsVar *arr = netGetArray(NET_ARRAY_SOCKETS, false);
+  if (!arr) return false;
+
+  bool hadSockets = false;
+  JsvArrayIterator it;
+  jsvArrayIteratorNew(&it, arr);
+  while (jsvArrayIteratorHasElement(&it)) {
+    hadSockets = true;
+    JsVar *socket = jsvArrayIteratorGetElement(&it);
+    SocketState state;
+    socketGetState(socket, &state);
+    SocketStateFlags oldFlags = state.data.flags;
+    bool closeConnectionNow = socketHasState(&state, SOCKET_STATE_CLOSENOW) || state.data.sckt<0;
+
+    if (!closeConnectionNow) {
+      if (!socketHasState(&state, SOCKET_STATE_CONNECTED)) {
+        socketSetStateFlag(&state, SOCKET_STATE_CONNECTED, true);
+        jsiQueueObjectCallbacks(socket, NET_NAME_ON_CONNECT, socket, 0);
+      }
+
+      if (!netReceive(net, socket, &state))
+        closeConnectionNow = true;
+
+      // send data if possible
+      JsVar *sendData = socketGetStateData(socket, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA);
+      if (sendData) {
+        if (!socketSend(net, state.data.sckt, &sendData))
+          closeConnectionNow = true;
+        socketSetStateData(socket, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA, sendData); // socketSend prob updated sendData
+      }
+      if (!sendData && socketHasState(&state, SOCKET_STATE_BUSY)) {
+        socketSetStateFlag(&state, SOCKET_STATE_BUSY, false);
+        jsiQueueObjectCallbacks(socket, NET_NAME_ON_DRAIN, 0, 0);
+      }
+      if (socketHasState(&state, SOCKET_STATE_CLOSE) && !sendData)
+        closeConnectionNow = true;
+      jsvUnLock(sendData);
+    }
+
+    if (closeConnectionNow) {
+      // send out any data that we were sent but nobody listened to
+      JsVar *receiveData = socketGetStateData(socket, &state, SOCKET_STATE_RECEIVE_DATA, SOCKET_NAME_RECEIVE_DATA);
+      if (receiveData) {
+        jsiQueueObjectCallbacks(socket, NET_NAME_ON_DATA, receiveData, 0);
+        jsvUnLock(receiveData);
+      }
+      jsiQueueObjectCallbacks(socket, NET_NAME_ON_CLOSE, 0, 0);
+
+      socketKill(net, state.data.sckt);
+      JsVar *socketName = jsvArrayIteratorGetIndex(&it);
+      jsvArrayIteratorNext(&it);
+      jsvRemoveChild(arr, socketName);
+      jsvUnLock(socketName);
+    } else {
+      // only write state back if it changed
+      if (state.data.flags != oldFlags)
+        socketSetState(socket, &state);
+      jsvArrayIteratorNext(&it);
+    }
+    socketFreeState(&state);
+    jsvUnLock(socket);
+  }
+  jsvArrayIteratorFree(&it);
+  jsvUnLock(arr);
+
+  return hadSockets;
+}
+
+bool netIdle(JsNetwork *net) {
+  if (networkState != NETWORKSTATE_ONLINE) {
+    // clear all clients and servers
+    netCloseAll(net);
+    return false;
+  }
+  bool hadSockets = false;
+  JsVar *arr = netGetArray(NET_ARRAY_SERVERS, false);
+  JsVar *sockets = netGetArray(NET_ARRAY_SOCKETS, false);
+  if (arr || sockets) net->idle(net); // let the device check which sockets have anything for us
+  jsvUnLock(sockets);
+  if (arr) {
+    JsvArrayIterator it;
+    jsvArrayIteratorNew(&it, arr);
+    while (jsvArrayIteratorHasElement(&it)) {
+      hadSockets = true;
+
+      JsVar *server = jsvArrayIteratorGetElement(&it);
+      SocketState state;
+      socketGetState(server, &state);
+      // accept everything that's waiting, so a burst of connections doesn't overflow the listen backlog
+      int theClient;
+      while ((theClient = net->accept(net, state.data.sckt)) >= 0) {
+        JsVar *socket = jspNewObject(0, "Socket");
+        JsVar *sockets = netGetArray(NET_ARRAY_SOCKETS, true);
+        if (socket && sockets) { // out of memory?
+          jsvArrayPush(sockets, socket);
+          // it's connected already - so don't fire the Socket's 'connect' event
+          socketUpdateState(socket, theClient, SOCKET_STATE_CONNECTED);
+          jsiQueueObjectCallbacks(server, NET_NAME_ON_CONNECT, socket, 0);
+        } else
+          net->closesocket(net, theClient);
+        jsvUnLock(sockets);
+        jsvUnLock(socket);
+      }
+      socketFreeState(&state);
+
+      jsvUnLock(server);
+      jsvArrayIteratorNext(&it);
+    }
+    jsvArrayIteratorFree(&it);
+    jsvUnLock(arr);
+  }
+
+  if (netSocketsIdle(net)) hadSockets = true;
+  return hadSockets;
+}
+
+// -----------------------------
+
+JsVar *netServerNew(JsVar *callback) {
+  JsVar *server = jspNewObject(0, "Server");
+  if (!server) return 0; // out of memory
+
+  jsvObjectSetChild(server, NET_NAME_ON_CONNECT, callback); // no unlock needed
+  return server;
+}
+
+void netServerListen(JsNetwork *net, JsVar *server, int port) {
+  JsVar *arr = netGetArray(NET_ARRAY_SERVERS, true);
+  if (!arr) return; // out of memory
+
+  int sckt = net->createsocket(net, 0/*server*/, (unsigned short)port);
+  if (sckt<0) {
+    jsError("Unable to create socket\n");
+  } else {
+    socketUpdateState(server, sckt, SOCKET_STATE_NONE);
+    // add to list of servers
+    jsvArrayPush(arr, server);
+  }
+  jsvUnLock(arr);
+  net->checkError(net);
+}
+
+void netServerClose(JsNetwork *net, JsVar *server) {
+  JsVar *arr = netGetArray(NET_ARRAY_SERVERS, false);
+  if (arr) {
+    // close socket
+    SocketState state;
+    socketGetState(server, &state);
+    socketKill(net, state.data.sckt);
+    socketFreeState(&state);
+    // remove from array
+    JsVar *idx = jsvGetArrayIndexOf(arr, server, true);
+    if (idx) {
+      jsvRemoveChild(arr, idx);
+      jsvUnLock(idx);
+    } else
+      jsWarn("Server not found!");
+    jsvUnLock(arr);
+  }
+}
+
+JsVar *netSocketConnect(JsNetwork *net, JsVar *options, JsVar *callback) {
+  unsigned short port = (unsigned short)jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "port", 0));
+
+  char hostName[128];
+  JsVar *hostNameVar = jsvObjectGetChild(options, "host", 0);
+  if (jsvIsUndefined(hostNameVar))
+    strncpy(hostName, "localhost", sizeof(hostName));
+  else
+    jsvGetString(hostNameVar, hostName, sizeof(hostName));
+  jsvUnLock(hostNameVar);
+
+  unsigned long host_addr = 0;
+  networkGetHostByName(net, hostName, &host_addr);
+  if (!host_addr) {
+    jsError("Unable to locate host");
+    net->checkError(net);
+    return 0;
+  }
+
+  JsVar *arr = netGetArray(NET_ARRAY_SOCKETS, true);
+  if (!arr) return 0; // out of memory
+  JsVar *socket = jspNewObject(0, "Socket");
+  if (!socket) { // out of memory
+    jsvUnLock(arr);
+    return 0;
+  }
+  if (callback) jsvUnLock(jsvAddNamedChild(socket, callback, NET_NAME_ON_CONNECT));
+
+  int sckt = net->createsocket(net, host_addr, port);
+  if (sckt<0) {
+    jsError("Unable to create socket\n");
+    socketUpdateState(socket, -1, SOCKET_STATE_CLOSENOW);
+  } else {
+    socketUpdateState(socket, sckt, SOCKET_STATE_NONE);
+  }
+  jsvArrayPush(arr, socket);
+  jsvUnLock(arr);
+
+  net->checkError(net);
+  return socket;
+}
+
+bool netSocketWrite(JsVar *socket, JsVar *data) {
+  SocketState state;
+  socketGetState(socket, &state);
+  bool ok = true;
+  if (socketHasState(&state, SOCKET_STATE_CLOSE|SOCKET_STATE_CLOSENOW)) {
+    jsError("Socket has been closed");
+    ok = false;
+  } else {
+    JsVar *sendData = socketGetStateData(socket, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA);
+    if (!sendData) {
+      sendData = jsvNewFromEmptyString();
+      socketSetStateData(socket, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA, sendData);
+    }
+    if (sendData) {
+      if (!jsvIsUndefined(data)) netAppendData(sendData, data);
+      // Tell the caller to back off if too much is queued - we'll fire 'drain' once it's sent
+      if (jsvGetStringLength(sendData) > SOCKET_HIGH_WATER) {
+        socketSetStateFlag(&state, SOCKET_STATE_BUSY, true);
+        ok = false;
+      }
+    } else
+      ok = false; // out of memory
+    socketSetState(socket, &state);
+    jsvUnLock(sendData);
+  }
+  socketFreeState(&state);
+  return ok;
+}
+
+void netSocketEnd(JsVar *socket, JsVar *data) {
+  if (!jsvIsUndefined(data)) netSocketWrite(socket, data);
+  socketUpdateState(socket, -1, SOCKET_STATE_CLOSE);
+}
+
+// ----------------------------------------------------------------------------- dgram
+
+void dgramInit() {
+}
+
+void dgramKill(JsNetwork *net) {
+  netCloseAllFor(net, DGRAM_ARRAY_SOCKETS);
+}
+
+/// Turn an IP address (as from gethostbyname) into a String
+static JsVar *dgramGetAddressString(unsigned long host) {
+  char buf[16];
+  int i, l = 0;
+  for (i=0;i<4;i++) {
+    if (i) buf[l++] = '.';
+    itoa((JsVarInt)((host >> (i*8)) & 255), &buf[l], 10);
+    l = (int)strlen(buf);
+  }
+  return jsvNewFromString(buf);
+}
+
+/// Read waiting datagrams (up to DGRAM_MAX_RECEIVE), firing one 'message' event for each. Returns false on error
+static bool dgramReceive(JsNetwork *net, JsVar *socket, SocketState *state) {
+  char buf[DGRAM_BATCH][DGRAM_MAX_SIZE];
+  JsNetworkDatagram msgs[DGRAM_BATCH];
+  bool hasListener = jsiObjectHasCallbacks(socket, DGRAM_NAME_ON_MESSAGE);
+  int total = 0;
+  while (total < DGRAM_MAX_RECEIVE) {
+    int i;
+    for (i=0;i<DGRAM_BATCH;i++) {
+      msgs[i].buf = buf[i];
+      msgs[i].len = DGRAM_MAX_SIZE;
+    }
+    int n = net->recvfrom(net, state->data.sckt, msgs, DGRAM_BATCH);
+    if (n<0) return false;
+    if (n==0) break;
+    // if nobody is listening, datagrams just get dropped (as they would be by the network anyway)
+    for (i=0;i<n && hasListener;i++) {
+      JsVar *msg = jsvNewFromEmptyString();
+      JsVar *rinfo = jsvNewWithFlags(JSV_OBJECT);
+      if (msg && rinfo) { // out of memory?
+        jsvAppendStringBuf(msg, msgs[i].buf, (int)msgs[i].len);
+        jsvUnLock(jsvObjectSetChild(rinfo, "address", dgramGetAddressString(msgs[i].host)));
+        jsvUnLock(jsvObjectSetChild(rinfo, "port", jsvNewFromInteger(msgs[i].port)));
+        jsvUnLock(jsvObjectSetChild(rinfo, "size", jsvNewFromInteger((JsVarInt)msgs[i].len)));
+        jsiQueueObjectCallbacks(socket, DGRAM_NAME_ON_MESSAGE, msg, rinfo);
+      }
+      jsvUnLock(msg);
+      jsvUnLock(rinfo);
+    }
+    total += n;
+    if (n<DGRAM_BATCH) break; // that's all there was
+  }
+  return true;
+}
+
+/// Send as many queued datagrams as we can, DGRAM_BATCH at a time
+static void dgramSend(JsNetwork *net, JsVar *socket, SocketState *state) {
+  JsVar *queue = socketGetStateData(socket, state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA);
+  if (!queue) return;
+  char buf[DGRAM_BATCH][DGRAM_MAX_SIZE];
+  JsNetworkDatagram msgs[DGRAM_BATCH];
+  while (true) {
+    int count = 0;
+    JsvArrayIterator it;
+    jsvArrayIteratorNew(&it, queue);
+    while (count<DGRAM_BATCH && jsvArrayIteratorHasElement(&it)) {
+      JsVar *d = jsvArrayIteratorGetElement(&it);
+      unsigned char header[DGRAM_HEADER_SIZE];
+      size_t i, len = jsvGetStringLength(d);
+      JsvStringIterator sit;
+      jsvStringIteratorNew(&sit, d, 0);
+      for (i=0;i<len;i++) {
+        char ch = jsvStringIteratorGetChar(&sit);
+        if (i<DGRAM_HEADER_SIZE) header[i] = (unsigned char)ch;
+        else buf[count][i-DGRAM_HEADER_SIZE] = ch;
+        jsvStringIteratorNextInline(&sit);
+      }
+      jsvStringIteratorFree(&sit);
+      msgs[count].host = (unsigned long)header[0] | ((unsigned long)header[1]<<8) |
+                         ((unsigned long)header[2]<<16) | ((unsigned long)header[3]<<24);
+      msgs[count].port = (unsigned short)(header[4] | (header[5]<<8));
+      msgs[count].len = len - DGRAM_HEADER_SIZE;
+      msgs[count].buf = buf[count];
+      jsvUnLock(d);
+      count++;
+      jsvArrayIteratorNext(&it);
+    }
+    jsvArrayIteratorFree(&it);
+    if (!count) break;
+
+    int n = net->sendto(net, state->data.sckt, msgs, count);
+    if (n<0) {
+      // datagrams are unreliable anyway - just drop the one that failed so we don't retry it forever
+      jsError("Socket error while sending");
+      n = 1;
+    }
+    int i;
+    for (i=0;i<n;i++)
+      jsvUnLock(jsvArrayPopFirst(queue));
+    if (n<count) break; // the network can't take any more right now
+  }
+  if (jsvGetChildren(queue)==0)
+    socketSetStateData(socket, state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA, 0);
+  jsvUnLock(queue);
+}
+
+bool dgramIdle(JsNetwork *net) {
+  if (networkState != NETWORKSTATE_ONLINE) {
+    dgramKill(net);
+    return false;
+  }
+  JsVar *arr = netGetArray(DGRAM_ARRAY_SOCKETS, false);
+  if (!arr) return false;
+  net->idle(net); // let the device check which sockets have anything for us
+
+  bool hadSockets = false;
+  JsvArrayIterator it;
+  jsvArrayIteratorNew(&it, arr);
+  while (jsvArrayIteratorHasElement(&it)) {
+    hadSockets = true;
+    JsVar *socket = jsvArrayIteratorGetElement(&it);
+    SocketState state;
+    socketGetState(socket, &state);
+    SocketStateFlags oldFlags = state.data.flags;
+    bool closeNow = socketHasState(&state, SOCKET_STATE_CLOSENOW) || state.data.sckt<0;
+
+    if (!closeNow) {
+      if (!dgramReceive(net, socket, &state))
+        closeNow = true;
+      dgramSend(net, socket, &state);
+      if (socketHasState(&state, SOCKET_STATE_CLOSE) && !socketHasState(&state, SOCKET_STATE_SEND_DATA))
+        closeNow = true;
+    }
+
+    if (closeNow) {
+      jsiQueueObjectCallbacks(socket, NET_NAME_ON_CLOSE, 0, 0);
+      socketKill(net, state.data.sckt);
+      JsVar *socketName = jsvArrayIteratorGetIndex(&it);
+      jsvArrayIteratorNext(&it);
+      jsvRemoveChild(arr, socketName);
+      jsvUnLock(socketName);
+    } else {
+      if (state.data.flags != oldFlags)
+        socketSetState(socket, &state);
+      jsvArrayIteratorNext(&it);
+    }
+    socketFreeState(&state);
+    jsvUnLock(socket);
+  }
+  jsvArrayIteratorFree(&it);
+  jsvUnLock(arr);
+  return hadSockets;
+}
+
+// -----------------------------
+
+JsVar *dgramSocketNew(JsVar *callback) {
+  JsVar *socket = jspNewObject(0, "Dgram");
+  if (!socket) return 0; // out of memory
+  if (callback) jsvUnLock(jsvAddNamedChild(socket, callback, DGRAM_NAME_ON_MESSAGE));
+  return socket;
+}
+
+/// Create the OS socket (if it hasn't been created already) and start handling it on idle. Returns false on failure
+static bool dgramSocketCreate(JsNetwork *net, JsVar *socket, int port) {
+  SocketState state;
+  socketGetState(socket, &state);
+  int sckt = state.data.sckt;
+  bool closed = socketHasState(&state, SOCKET_STATE_CLOSE|SOCKET_STATE_CLOSENOW);
+  socketFreeState(&state);
+  if (closed) {
+    jsError("Socket has been closed");
+    return false;
+  }
+  if (sckt>=0) {
+    if (port) jsError("Socket is already bound");
+    return !port;
+  }
+  if (!net->createdgram) {
+    jsError("Datagram sockets are not supported by this network device");
+    return false;
+  }
+  JsVar *arr = netGetArray(DGRAM_ARRAY_SOCKETS, true);
+  if (!arr) return false; // out of memory
+  sckt = net->createdgram(net, (unsigned short)port);
+  if (sckt<0) {
+    jsError("Unable to create socket\n");
+  } else {
+    socketUpdateState(socket, sckt, SOCKET_STATE_NONE);
+    jsvArrayPush(arr, socket);
+  }
+  jsvUnLock(arr);
+  net->checkError(net);
+  return sckt>=0;
+}
+
+void dgramSocketBind(JsNetwork *net, JsVar *socket, int port) {
+  dgramSocketCreate(net, socket, port);
+}
+
+void dgramSocketSend(JsNetwork *net, JsVar *socket, JsVar *data, int port, JsVar *host) {
+  char hostName[128];
+  if (jsvIsUndefined(host))
+    strncpy(hostName, "localhost", sizeof(hostName));
+  else
+    jsvGetString(host, hostName, sizeof(hostName));
+  unsigned long host_addr = 0;
+  networkGetHostByName(net, hostName, &host_addr);
+  if (!host_addr) {
+    jsError("Unable to locate host");
+    return;
+  }
+  // sockets that haven't been bound get bound to any free port, as in node.js
+  if (!dgramSocketCreate(net, socket, 0)) return;
+
+  // queue it up, with the address on the front - it's sent on idle
+  unsigned char header[DGRAM_HEADER_SIZE];
+  header[0] = (unsigned char)host_addr;
+  header[1] = (unsigned char)(host_addr>>8);
+  header[2] = (unsigned char)(host_addr>>16);
+  header[3] = (unsigned char)(host_addr>>24);
+  header[4] = (unsigned char)port;
+  header[5] = (unsigned char)(port>>8);
+  JsVar *d = jsvNewFromEmptyString();
+  if (!d) return; // out of memory
+  jsvAppendStringBuf(d, (char*)header, DGRAM_HEADER_SIZE);
+  netAppendData(d, data);
+  if (jsvGetStringLength(d) > DGRAM_HEADER_SIZE+DGRAM_MAX_SIZE) {
+    jsError("Datagram too long (max %d bytes)", DGRAM_MAX_SIZE);
+    jsvUnLock(d);
+    return;
+  }
+
+  SocketState state;
+  socketGetState(socket, &state);
+  JsVar *queue = socketGetStateData(socket, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA);
+  if (!queue) {
+    queue = jsvNewWithFlags(JSV_ARRAY);
+    socketSetStateData(socket, &state, SOCKET_STATE_SEND_DATA, SOCKET_NAME_SEND_DATA, queue);
+    socketSetState(socket, &state);
+  }
+  if (queue) jsvArrayPush(queue, d);
+  jsvUnLock(queue);
+  socketFreeState(&state);
+  jsvUnLock(d);
+}
+
+void dgramSocketClose(JsVar *socket) {
+  SocketState state;
+  socketGetState(socket, &state);
+  if (state.data.sckt<0) {
+    // never bound, so it isn't being handled on idle
+    jsiQueueObjectCallbacks(socket, NET_NAME_ON_CLOSE, 0, 0);
+  }
+  socketSetStateFlag(&state, SOCKET_STATE_CLOSE, true);
+  socketSetState(socket, &state);
+  socketFreeState(&state);
+}
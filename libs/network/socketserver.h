@@ -0,0 +1,119 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Per-socket state shared by the socket libraries, raw TCP sockets ('net')
+ * and UDP sockets ('dgram')
+ * ----------------------------------------------------------------------------
+ */
+#ifndef _SOCKETSERVER_H
+#define _SOCKETSERVER_H
+
+#include "jsutils.h"
+#include "jsvar.h"
+#include "network.h"
+
+#ifdef LINUX
+#define SOCKET_CHUNK_SIZE 1024 ///< Size of the buffer we send/receive with (it's on the stack)
+#define SOCKET_MAX_RECEIVE 8192 ///< Maximum amount of data we'll read from one socket in one idle
+#define SOCKET_HIGH_WATER 8192 ///< If more than this is waiting to be sent, write() returns false
+#else
+#define SOCKET_CHUNK_SIZE 64
+#define SOCKET_MAX_RECEIVE 256
+#define SOCKET_HIGH_WATER 512
+#endif
+
+#define SOCKET_NAME_STATE JS_HIDDEN_CHAR_STR"st"
+#define SOCKET_NAME_RECEIVE_DATA "dRcv"
+#define SOCKET_NAME_SEND_DATA "dSnd"
+
+typedef enum {
+  SOCKET_STATE_NONE = 0,
+  SOCKET_STATE_CLOSENOW = 1, ///< Close the connection on the next idle
+  SOCKET_STATE_CLOSE = 2, ///< Close the connection once all data has been sent (end() was called)
+  SOCKET_STATE_RECEIVE_DATA = 4, ///< SOCKET_NAME_RECEIVE_DATA exists (so we only look it up when we need to)
+  SOCKET_STATE_SEND_DATA = 8, ///< SOCKET_NAME_SEND_DATA exists (so we only look it up when we need to)
+  SOCKET_STATE_HAD_HEADERS = 16, ///< HTTP: We have received (and parsed) the headers
+  SOCKET_STATE_CONNECTED = 32, ///< net: the 'connect' event has been fired
+  SOCKET_STATE_BUSY = 64, ///< net: write() returned false, so fire 'drain' once everything is sent
+} PACKED_FLAGS SocketStateFlags;
+
+/* Per-socket state, stored as a binary string in SOCKET_NAME_STATE (like JsGraphicsData)
+ * so the idle loop needs one lookup per object rather than one per field. Received and sent
+ * data stay as normal children so that they are still seen by the garbage collector. */
+typedef struct {
+  int sckt; ///< The socket number, or -1 if there isn't one
+  SocketStateFlags flags;
+} PACKED_FLAGS SocketStateData;
+
+typedef struct {
+  JsVar *var; ///< The string that SocketStateData is stored in (locked), or 0 if it hasn't been created yet
+  SocketStateData data;
+  unsigned char _blank; ///< this is needed as jsvGetString for 'data' wants to add a trailing zero
+} PACKED_FLAGS SocketState;
+
+void socketGetState(JsVar *obj, SocketState *state);
+void socketSetState(JsVar *obj, SocketState *state);
+static inline void socketFreeState(SocketState *state) {
+  jsvUnLock(state->var);
+}
+static inline bool socketHasState(SocketState *state, SocketStateFlags flag) {
+  return (state->data.flags & flag) != 0;
+}
+static inline void socketSetStateFlag(SocketState *state, SocketStateFlags flag, bool set) {
+  if (set) state->data.flags = (SocketStateFlags)(state->data.flags | flag);
+  else state->data.flags = (SocketStateFlags)(state->data.flags & ~flag);
+}
+/// Set the socket (if sckt>=0) and add the given flags, for use outside of the idle loop
+void socketUpdateState(JsVar *obj, int sckt, SocketStateFlags setFlags);
+/// Get a data child (SOCKET_NAME_RECEIVE_DATA/SOCKET_NAME_SEND_DATA) - only looking it up if the state says it exists
+JsVar *socketGetStateData(JsVar *obj, SocketState *state, SocketStateFlags flag, const char *name);
+/// Set (or remove if data==0) a data child, keeping the flag in the state in sync
+void socketSetStateData(JsVar *obj, SocketState *state, SocketStateFlags flag, const char *name, JsVar *data);
+
+/// Close the socket (if sckt>=0)
+void socketKill(JsNetwork *net, int sckt);
+/** Send as much of sendData as the socket will take right now, and cut what was sent off the front.
+ * sendData is set to 0 when everything has been sent. Returns false on a socket error. */
+bool socketSend(JsNetwork *net, int sckt, JsVar **sendData);
+
+// ----------------------------------------------------------------------------- net
+void netInit();
+void netKill(JsNetwork *net);
+bool netIdle(JsNetwork *net);
+
+JsVar *netServerNew(JsVar *callback);
+void netServerListen(JsNetwork *net, JsVar *server, int port);
+void netServerClose(JsNetwork *net, JsVar *server);
+
+JsVar *netSocketConnect(JsNetwork *net, JsVar *options, JsVar *callback);
+bool netSocketWrite(JsVar *socket, JsVar *data);
+void netSocketEnd(JsVar *socket, JsVar *data);
+
+// ----------------------------------------------------------------------------- dgram
+#ifdef LINUX
+#define DGRAM_MAX_SIZE 2048 ///< Largest datagram we'll send or receive (longer ones are truncated when received)
+#define DGRAM_BATCH 8 ///< How many datagrams we try to send/receive with one call to the network device
+#define DGRAM_MAX_RECEIVE 64 ///< Maximum number of datagrams we'll read from one socket in one idle
+#else
+#define DGRAM_MAX_SIZE 256
+#define DGRAM_BATCH 1
+#define DGRAM_MAX_RECEIVE 4
+#endif
+
+void dgramInit();
+void dgramKill(JsNetwork *net);
+bool dgramIdle(JsNetwork *net);
+
+JsVar *dgramSocketNew(JsVar *callback);
+void dgramSocketBind(JsNetwork *net, JsVar *socket, int port);
+void dgramSocketSend(JsNetwork *net, JsVar *socket, JsVar *data, int port, JsVar *host);
+void dgramSocketClose(JsVar *socket);
+
+#endif // _SOCKETSERVER_H
@@ -151,5 +151,8 @@ void netSetCallbacks_wiznet(JsNetwork *net) {
   net->gethostbyname = net_wiznet_gethostbyname;
   net->recv = net_wiznet_recv;
   net->send = net_wiznet_send;
+  net->createdgram = 0; // not supported yet
+  net->sendto = 0;
+  net->recvfrom = 0;
 }
 
@@ -9,8 +9,8 @@
 # file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #
 # ----------------------------------------------------------------------------------------
-# Scans files for comments of the form /*JSON......*/ and then builds a tree structure of ifs to
-# efficiently detect the symbols without using RAM. See common.py for formatting
+# Scans files for comments of the form /*JSON......*/ and then builds a perfect hash table of
+# all the symbols so they can be found quickly without using RAM. See common.py for formatting
 # ----------------------------------------------------------------------------------------
 
 import subprocess;
@@ -21,22 +21,11 @@ import os;
 sys.path.append(".");
 import common
 
-# Scans files for comments of the form /*JSON......*/ and then builds a tree structure of ifs to
-# efficiently detect the symbols without using RAM. See common.py for formatting
-
 jsondatas = common.get_jsondata(False)
 includes = common.get_includes_from_jsondata(jsondatas)
 
 # ------------------------------------------------------------------------------------------------------
 
-def treewalk(tree, name, jsondata):
-  if len(name)==0:
-    tree[""] = jsondata
-  else:	
-    firstchar = name[:1]
-    if not firstchar in tree: tree[firstchar] = {}
-    treewalk(tree[firstchar], name[1:], jsondata)
-
 # ------------------------------------------------------------------------------------------------------
 # Creates something like 'name[0]=='s' && name[1]=='e' && name[2]=='t' && name[3]==0'
 def createStringCompare(varName, checkOffsets, checkCharacters):
@@ -111,8 +100,10 @@ def getTestFor(className, static):
     return createStringCompare("constructorName->varData.str", checkOffsets, checkCharacters)
     exit(1)
 
-print "Building decision tree"
-tree = {}
+print "Building symbol table"
+# Each class test ('!parent' for functions, 'parent' for methods on all objects, or a
+# check on parent/constructorName), and the functions that are available for it
+classes = {}
 for jsondata in jsondatas:
   if "name" in jsondata:
     jsondata["static"] = not (jsondata["type"]=="property" or jsondata["type"]=="method")
@@ -121,12 +112,21 @@ for jsondata in jsondatas:
     if not jsondata["type"]=="constructor":
       if "class" in jsondata: className = getTestFor(jsondata["class"], jsondata["static"])
 
-
-    if not className in tree: 
+    if not className in classes:
       print "Adding "+className+" to tree"
-      tree[className] = {}
-    treewalk(tree[className], jsondata["name"], jsondata)
-    classTree = tree[className]
+      classes[className] = {}
+    classes[className][jsondata["name"]] = jsondata
+
+# The order classes are checked in when a name is in more than one. Methods on all
+# objects come first, then classes we can check from parent, then ones where we have
+# to look at the constructor
+classOrder = ["!parent", "parent"]
+for className in classes:
+  if not className in classOrder and not "constructorName" in className:
+    classOrder.append(className)
+for className in classes:
+  if "constructorName" in className:
+    classOrder.append(className)
 
 # ------------------------------------------------------------------------------------------------------
 #print json.dumps(tree, sort_keys=True, indent=2)
@@ -179,7 +179,22 @@ def codeOutFunction(indent, func):
     params = []
     if "params" in func: params = func["params"]
 
-    if len(params)==0: 
+    # Functions with numeric arguments get them parsed straight into native types
+    nativeTypes = { "int" : "JsVarInt", "int32" : "int", "float" : "JsVarFloat", "bool" : "bool", "pin" : "Pin" }
+    nativeParsers = { "int" : "jspParseFunctionArgInt", "int32" : "(int)jspParseFunctionArgInt", "float" : "jspParseFunctionArgFloat", "bool" : "jspParseFunctionArgBool", "pin" : "jspParseFunctionArgPin" }
+    parseNative = "generate" in func and any(param[1] in nativeTypes for param in params) and not any(param[1]=="JsVarArray" for param in params)
+
+    if parseNative:
+      codeOut(indent+"jspParseFunctionStart();")
+      n = 0
+      for param in params:
+        if param[1] in nativeTypes:
+          codeOut(indent+nativeTypes[param[1]]+" "+param[0]+" = "+nativeParsers[param[1]]+"("+str(n)+");")
+        else:
+          codeOut(indent+"JsVar *"+param[0]+" = jspParseFunctionArg("+str(n)+", "+("false" if param[1]=="JsVarName" else "true")+");")
+        n = n + 1
+      codeOut(indent+"jspParseFunctionEnd();")
+    elif len(params)==0: 
       if func["type"]=="variable" or common.is_property(func):
         codeOut(indent+"jspParseVariableName();")
       else:
@@ -219,7 +234,7 @@ def codeOutFunction(indent, func):
       if "needs_parentName" in func:
         commandargs.append("parentName")
       for param in params:
-        if param[1]=="JsVar" or param[1]=="JsVarName" or param[1]=="JsVarArray":
+        if param[1]=="JsVar" or param[1]=="JsVarName" or param[1]=="JsVarArray" or parseNative:
           commandargs.append(param[0]);
         else:
           commandargs.append(getUnLockGetter(param[1], param[0], func["name"]));
@@ -234,6 +249,7 @@ def codeOutFunction(indent, func):
 
     # note: generate_full doesn't use commandargs, so doesn't unlock
     for param in params:
+      if parseNative and param[1] in nativeTypes: continue
       if "generate_full" in func or param[1]=="JsVar" or param[1]=="JsVarName" or param[1]=="JsVarArray":
         codeOut(indent+"jsvUnLock("+param[0]+");");
 
@@ -247,44 +263,45 @@ def codeOutFunction(indent, func):
     sys.stderr.write("ERROR: codeOutFunction: Function '"+func["name"]+"' does not have generate, generate_full or wrap elements'\n")
     exit(1)
 
-def codeOutTree(indent, tree, offset):
-  first = True
-  for char in tree:
-    if char!="":
-      charOffset = offset
-      charTree = tree[char]
-      line = indent
-      if first: first = False
-      else: line = line + "} else "
-      checkOffsets = [charOffset]
-      checkCharacters = [char]
-      while len(charTree)==1:
-        charOffset = charOffset + 1
-        char = charTree.keys()[0]
-        charTree = charTree[char]        
-        checkOffsets.append(charOffset)
-        if char=='': checkCharacters.append('\\0')
-        else: checkCharacters.append(char)
-      line = line + "if (" + createStringCompare("name", checkOffsets, checkCharacters) + ") {"
-      codeOut(line)   
-      if char=='':
-        codeOutFunction(indent+"  ", charTree)
-      else:
-        codeOutTree(indent+"  ", charTree, charOffset+1)
-      # Now we do the handling part!
-  if "" in tree:
-    func = tree[""]
-    line = indent;
-    if first: first = False
-    if not first: line = line + "} else "
-    line = line + "if (name["+str(offset)+"]==0) {";
-    codeOut(line)
-    codeOutFunction(indent+"  ", func)
-  if not first:
-    codeOut(indent+'}')
-
-
-
+# ------------------------------------------------------------------------------------------------------
+# Perfect hashing - 'hash and displace'. Names are split into buckets with one hash,
+# then each bucket gets a seed for a second hash that puts all its names in empty slots
+
+def symbolHash(name, seed):
+  # FNV-1a - must match jswHash in the generated code
+  h = (2166136261 ^ seed) & 0xFFFFFFFF
+  for ch in name:
+    h = ((h ^ ord(ch)) * 16777619) & 0xFFFFFFFF
+  return h
+
+def buildPerfectHash(names):
+  tableSize = 1
+  while tableSize*4 < len(names)*5: tableSize = tableSize*2 # leave some slots free so it is quick to build
+  bucketCount = max(1, len(names)/2)
+  buckets = [[] for i in range(bucketCount)]
+  for name in names:
+    buckets[symbolHash(name, 0) % bucketCount].append(name)
+  seeds = [0] * bucketCount
+  slots = [None] * tableSize
+  for b in sorted(range(bucketCount), key=lambda b: -len(buckets[b])):
+    if len(buckets[b])==0: continue
+    seed = 1
+    while True:
+      positions = [symbolHash(name, seed) & (tableSize-1) for name in buckets[b]]
+      if len(set(positions))==len(positions) and all(slots[p]==None for p in positions): break
+      seed = seed + 1
+      if seed > 65535:
+        sys.stderr.write("ERROR: Unable to build perfect hash for symbols\n")
+        exit(1)
+    seeds[b] = seed
+    for i in range(len(positions)):
+      slots[positions[i]] = buckets[b][i]
+  return tableSize, seeds, slots
+
+def getHandlerName(className, func):
+  name = func["name"]
+  if "class" in func and func["type"]!="constructor": name = func["class"]+"_"+name
+  return "jswh_"+str(classOrder.index(className))+"_"+re.sub("[^A-Za-z0-9_]", "_", name)
 
 print ""
 print "" 
@@ -307,91 +324,177 @@ codeOut('#define CMP2(var, a,b) ((*(unsigned short*)&(var))==CH2(a,b))');
 codeOut('#define CMP3(var, a,b,c) (((*(unsigned int*)&(var))&0x00FFFFFF)==CH4(a,b,c,0))');
 codeOut('#define CMP4(var, a,b,c,d) ((*(unsigned int*)&(var))==CH4(a,b,c,d))');
 codeOut('');
-codeOut('JsVar *jswHandleFunctionCall(JsVar *parent, JsVar *parentName, const char *name) {')
-codeOut('  if (parent) {')
-codeOut('    // ------------------------------------------ METHODS ON OBJECT')
-if "parent" in tree:
-  codeOutTree("    ", tree["parent"], 0)
-codeOut('    // ------------------------------------------ INSTANCE + STATIC METHODS')
-for className in tree:
-  if className!="parent" and  className!="!parent" and not "parentName" in className and not "constructorName" in className:
-    codeOut('    if ('+className+') {')
-    codeOutTree("      ", tree[className], 0)
-    codeOut("    }")
-codeOut('    // ------------------------------------------ INSTANCE METHODS WE MUST CHECK CONSTRUCTOR FOR')
-codeOut('    JsVar *constructorName = jsvIsObject(parent)?jsvSkipOneNameAndUnLock(jsvFindChildFromString(parent, JSPARSE_CONSTRUCTOR_VAR, false)):0;')
-codeOut('    if (constructorName && jsvIsName(constructorName)) {')
-first = True
-for className in tree:
+codeOut('#define JSW_SYMBOL_BUILTIN_OBJECT 1 ///< Name is the name of a builtin object')
+codeOut('#define JSW_SYMBOL_LIBRARY 2 ///< Name is the name of a builtin library')
+codeOut('')
+codeOut('typedef JsVar *(*JswHandler)(JsVar *parent, JsVar *parentName);')
+codeOut('')
+codeOut('typedef struct {')
+codeOut('  unsigned char classIndex; ///< Which class test (see jswCheckClass)')
+codeOut('  JswHandler handler; ///< Parses the arguments and executes the function')
+codeOut('} JswCandidate;')
+codeOut('')
+codeOut('typedef struct {')
+codeOut('  const char *name;')
+codeOut('  unsigned short firstCandidate; ///< Index in jswCandidates')
+codeOut('  unsigned char candidateCount; ///< Number of classes that have something called this')
+codeOut('  unsigned char flags; ///< JSW_SYMBOL_BUILTIN_OBJECT/LIBRARY')
+codeOut('} JswSymbol;')
+codeOut('')
+codeOut('// ------------------------------------------ HANDLERS')
+for className in classOrder:
+  for name in sorted(classes[className].keys()):
+    func = classes[className][name]
+    codeOut('static JsVar *'+getHandlerName(className, func)+'(JsVar *parent, JsVar *parentName) {')
+    codeOut('  NOT_USED(parent);')
+    codeOut('  NOT_USED(parentName);')
+    codeOutFunction("  ", func)
+    if "#if" in func: codeOut('  return JSW_HANDLEFUNCTIONCALL_UNHANDLED;')
+    codeOut('}')
+    codeOut('')
+
+codeOut('/** Check whether parent is in the class with the given index. constructorName is')
+codeOut(' * looked up the first time it is needed, and must be unlocked by the caller */')
+codeOut('static bool jswCheckClass(unsigned char classIndex, JsVar *parent, JsVar **constructorNamePtr) {')
+codeOut('  switch (classIndex) {')
+codeOut('    case 0: return !parent;')
+codeOut('    case 1: return parent!=0;')
+for className in classOrder[2:]:
+  idx = str(classOrder.index(className))
   if "constructorName" in className:
-    if first:
-      codeOut('    if ('+className+') {')
-      first = False
-    else:
-      codeOut('    } else if ('+className+') {')
-    codeOut('      jsvUnLock(constructorName);constructorName=0;')
-    codeOutTree("          ", tree[className], 0)
-if not first:
-  codeOut("    } else ")
-codeOut('      jsvUnLock(constructorName);');
-codeOut('    }')
-codeOut('  } else { /* if (!parent) */')
-codeOut('    // ------------------------------------------ FUNCTIONS')
+    codeOut('    case '+idx+': {')
+    codeOut('      if (!parent) return false;')
+    codeOut('      if (*constructorNamePtr == JSW_HANDLEFUNCTIONCALL_UNHANDLED) {')
+    codeOut('        JsVar *constructorName = jsvIsObject(parent)?jsvSkipOneNameAndUnLock(jsvFindChildFromString(parent, JSPARSE_CONSTRUCTOR_VAR, false)):0;')
+    codeOut('        if (constructorName && !jsvIsName(constructorName)) {')
+    codeOut('          jsvUnLock(constructorName);')
+    codeOut('          constructorName = 0;')
+    codeOut('        }')
+    codeOut('        *constructorNamePtr = constructorName;')
+    codeOut('      }')
+    codeOut('      JsVar *constructorName = *constructorNamePtr;')
+    codeOut('      return constructorName && '+className+';')
+    codeOut('    }')
+  else:
+    codeOut('    case '+idx+': return parent && ('+className+');')
+codeOut('    default: return false;')
+codeOut('  }')
+codeOut('}')
+codeOut('')
+
+builtinObjects = []
+builtinLibraries = []
+for jsondata in jsondatas:
+  if jsondata["type"]=="library" and not jsondata["class"] in builtinLibraries:
+    builtinLibraries.append(jsondata["class"])
+for jsondata in jsondatas:
+  if "class" in jsondata and not jsondata["class"] in builtinLibraries and not jsondata["class"] in builtinObjects:
+    builtinObjects.append(jsondata["class"])
+
+candidates = {}
+for className in classOrder:
+  for name in classes[className]:
+    if not name in candidates: candidates[name] = []
+    candidates[name].append((className, classes[className][name]))
+symbolNames = sorted(set(candidates.keys() + builtinObjects + builtinLibraries))
+tableSize, seeds, slots = buildPerfectHash(symbolNames)
+
+codeOut('static const JswCandidate jswCandidates[] = {')
+candidateIndex = {}
+n = 0
+for name in symbolNames:
+  if name in candidates:
+    candidateIndex[name] = n
+    for (className, func) in candidates[name]:
+      codeOut('  { '+str(classOrder.index(className))+', '+getHandlerName(className, func)+' },')
+      n = n + 1
+if n==0: codeOut('  { 0, 0 }')
+codeOut('};')
+codeOut('')
+codeOut('#define JSW_SYMBOL_TABLE_SIZE '+str(tableSize))
+codeOut('#define JSW_SYMBOL_BUCKETS '+str(len(seeds)))
+codeOut('/// Seeds for the second hash, for each bucket of the first')
+codeOut('static const unsigned short jswSymbolSeeds[JSW_SYMBOL_BUCKETS] = {')
+for i in range(0, len(seeds), 16):
+  codeOut('  '+','.join([str(x) for x in seeds[i:i+16]])+',')
+codeOut('};')
+codeOut('')
+codeOut('static const JswSymbol jswSymbols[] = {')
+for name in symbolNames:
+  flags = []
+  if name in builtinObjects: flags.append("JSW_SYMBOL_BUILTIN_OBJECT")
+  if name in builtinLibraries: flags.append("JSW_SYMBOL_LIBRARY")
+  if len(flags)==0: flags.append("0")
+  count = len(candidates[name]) if name in candidates else 0
+  first = candidateIndex[name] if name in candidates else 0
+  codeOut('  { "'+name+'", '+str(first)+', '+str(count)+', '+'|'.join(flags)+' },')
+codeOut('};')
+codeOut('')
+codeOut('/// The perfect hash table - index+1 of the symbol in jswSymbols, or 0 if empty')
+codeOut('static const unsigned short jswSymbolSlots[JSW_SYMBOL_TABLE_SIZE] = {')
+slotValues = [str(symbolNames.index(name)+1) if name!=None else "0" for name in slots]
+for i in range(0, len(slotValues), 16):
+  codeOut('  '+','.join(slotValues[i:i+16])+',')
+codeOut('};')
+codeOut('')
+codeOut('/// FNV-1a hash of a name - this must match symbolHash in build_jswrapper.py')
+codeOut('static unsigned int jswHash(const char *name, unsigned int seed) {')
+codeOut('  unsigned int h = 2166136261u ^ seed;')
+codeOut('  while (*name) h = (h ^ (unsigned char)*(name++)) * 16777619u;')
+codeOut('  return h;')
+codeOut('}')
+codeOut('')
+codeOut('/// Find the symbol with the given name, or return 0')
+codeOut('static const JswSymbol *jswFindSymbol(const char *name) {')
+codeOut('  unsigned short seed = jswSymbolSeeds[jswHash(name, 0) % JSW_SYMBOL_BUCKETS];')
+codeOut('  unsigned short slot = jswSymbolSlots[jswHash(name, seed) & (JSW_SYMBOL_TABLE_SIZE-1)];')
+codeOut('  if (!slot) return 0;')
+codeOut('  const JswSymbol *sym = &jswSymbols[slot-1];')
+codeOut('  if (strcmp(sym->name, name)) return 0;')
+codeOut('  return sym;')
+codeOut('}')
+codeOut('')
+codeOut('JsVar *jswHandleFunctionCall(JsVar *parent, JsVar *parentName, const char *name) {')
+codeOut('  if (!parent) {')
 codeOut('    // Handle pin names - eg LED1 or D5 (this is hardcoded in build_jsfunctions.py)')
 codeOut('    Pin pin = jshGetPinFromString(name);')
 codeOut('    if (pin != PIN_UNDEFINED) {')
 codeOut('      jspParseVariableName();')
 codeOut('      return jsvNewFromPin(pin);')
 codeOut('    }')
-if "!parent" in tree:
-  codeOutTree("    ", tree["!parent"], 0)
-codeOut('  }');
-
+codeOut('  }')
+codeOut('  const JswSymbol *sym = jswFindSymbol(name);')
+codeOut('  if (!sym) return JSW_HANDLEFUNCTIONCALL_UNHANDLED;')
+codeOut('  JsVar *constructorName = JSW_HANDLEFUNCTIONCALL_UNHANDLED; // not looked up yet')
+codeOut('  const JswCandidate *c = &jswCandidates[sym->firstCandidate];')
+codeOut('  const JswCandidate *end = c + sym->candidateCount;')
+codeOut('  for (;c<end;c++) {')
+codeOut('    if (jswCheckClass(c->classIndex, parent, &constructorName)) {')
+codeOut('      if (constructorName != JSW_HANDLEFUNCTIONCALL_UNHANDLED) jsvUnLock(constructorName);')
+codeOut('      constructorName = JSW_HANDLEFUNCTIONCALL_UNHANDLED;')
+codeOut('      JsVar *r = c->handler(parent, parentName);')
+codeOut('      if (r != JSW_HANDLEFUNCTIONCALL_UNHANDLED) return r;')
+codeOut('    }')
+codeOut('  }')
+codeOut('  if (constructorName != JSW_HANDLEFUNCTIONCALL_UNHANDLED) jsvUnLock(constructorName);')
 codeOut('  return JSW_HANDLEFUNCTIONCALL_UNHANDLED;')
 codeOut('}')
-
 codeOut('')
 codeOut('')
 
-
-builtinLibraryChecks = []
-for jsondata in jsondatas:
-  if jsondata["type"]=="library":
-    check = 'strcmp(name, "'+jsondata["class"]+'")==0';
-    builtinLibraryChecks.append(check)
-
-
-builtinChecks = []
-notRealObjects = []
-for jsondata in jsondatas:
-  if "class" in jsondata:
-    check = 'strcmp(name, "'+jsondata["class"]+'")==0';
-    if not check in builtinLibraryChecks:
-      if "not_real_object" in jsondata:
-        notRealObjects.append(check)
-      if not check in builtinChecks:
-        builtinChecks.append(check)
-
-
-codeOut('bool jswIsBuiltInObject(const char *name) {') 
-codeOut('  return\n'+" ||\n    ".join(builtinChecks)+';')
+codeOut('bool jswIsBuiltInObject(const char *name) {')
+codeOut('  const JswSymbol *sym = jswFindSymbol(name);')
+codeOut('  return sym && (sym->flags & JSW_SYMBOL_BUILTIN_OBJECT);')
 codeOut('}')
-
 codeOut('')
 codeOut('')
-
-
-codeOut('bool jswIsBuiltInLibrary(const char *name) {') 
-if len(builtinLibraryChecks)==0:
-  codeOut('  return false;')
-else:
-  codeOut('  return\n'+" ||\n    ".join(builtinLibraryChecks)+';')
+codeOut('bool jswIsBuiltInLibrary(const char *name) {')
+codeOut('  const JswSymbol *sym = jswFindSymbol(name);')
+codeOut('  return sym && (sym->flags & JSW_SYMBOL_LIBRARY);')
 codeOut('}')
-
 codeOut('')
 codeOut('')
 
-
 objectChecks = {}
 for jsondata in jsondatas:
   if "type" in jsondata and jsondata["type"]=="class":
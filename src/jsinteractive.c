@@ -121,10 +121,19 @@ NO_INLINE void jsiConsolePrint(const char *str) {
   }
 }
 
+/// vcbprintf_callback that prints to the console
+void jsiConsolePrintCallback(const char *str, size_t len, void *user_data) {
+  NOT_USED(user_data);
+  while (len--) {
+    if (*str == '\n') jsiConsolePrintChar('\r');
+    jsiConsolePrintChar(*(str++));
+  }
+}
+
 void jsiConsolePrintf(const char *fmt, ...) {
   va_list argp;
   va_start(argp, fmt);
-  vcbprintf((vcbprintf_callback)jsiConsolePrint,0, fmt, argp);
+  vcbprintf(jsiConsolePrintCallback,0, fmt, argp);
   va_end(argp);
 }
 
@@ -602,6 +611,7 @@ void jsiInit(bool autoLoad) {
   if (loadFlash) {
     jspSoftKill();
     jsvSoftKill();
+    jsvFreeFlatBuffers();
     jshLoadFromFlash();
     jsvSoftInit();
     jspSoftInit();
@@ -1531,8 +1541,10 @@ void jsiIdle() {
       jsvGarbageCollect(); // nice to have everything all tidy!
       jsiSoftKill();
       jspSoftKill();
-      jsvSoftKill();
-      jshSaveToFlash();
+      if (jsvSoftKill())
+        jshSaveToFlash();
+      else
+        jsError("Not enough free memory to save ArrayBuffers - not saved");
       jsvSoftInit();
       jspSoftInit();
       jsiSoftInit();
@@ -1543,6 +1555,7 @@ void jsiIdle() {
       jsiSoftKill();
       jspSoftKill();
       jsvSoftKill();
+      jsvFreeFlatBuffers();
       jshLoadFromFlash();
       jsvSoftInit();
       jspSoftInit();
@@ -53,6 +53,8 @@ IOEventFlags jsiGetConsoleDevice();
 void jsiConsolePrintChar(char data);
 /// Transmit a string
 void jsiConsolePrint(const char *str);
+/// vcbprintf_callback that prints to the console (user_data is ignored)
+void jsiConsolePrintCallback(const char *str, size_t len, void *user_data);
 /// Write the formatted string to the console (see vcbprintf)
 void jsiConsolePrintf(const char *fmt, ...);
 /// Print the contents of a string var - directly
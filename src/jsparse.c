@@ -362,6 +362,99 @@ NO_INLINE bool jspParseFunction8(JspSkipFlags skipName, JsVar **a, JsVar **b, Js
   return true;
 }
 
+NO_INLINE bool jspParseFunctionStart() {
+  JSP_MATCH(LEX_ID);
+  JSP_MATCH('(');
+  return true;
+}
+
+NO_INLINE bool jspParseFunctionEnd() {
+  // throw away extra params
+  while (!JSP_HAS_ERROR && execInfo.lex->tk != ')') {
+    JSP_MATCH(',');
+    jsvUnLock(jspeAssignmentExpression());
+  }
+  JSP_MATCH(')');
+  return true;
+}
+
+/// Move on to argument n - returns false if there isn't one
+static bool jspParseFunctionArgNext(int n) {
+  if (JSP_HAS_ERROR || execInfo.lex->tk == ')') return false;
+  if (n>0) JSP_MATCH(',');
+  return true;
+}
+
+/// Is the current token the whole argument (eg. '5' in 'f(5,x)' but not in 'f(5+x)')?
+static bool jspIsWholeArgument() {
+  return execInfo.lex->currCh==',' || execInfo.lex->currCh==')';
+}
+
+NO_INLINE JsVar *jspParseFunctionArg(int n, bool skipName) {
+  if (!jspParseFunctionArgNext(n)) return 0;
+  JsVar *v = jspeAssignmentExpression();
+  return skipName ? jsvSkipNameAndUnLock(v) : v;
+}
+
+NO_INLINE JsVarInt jspParseFunctionArgInt(int n) {
+  if (!jspParseFunctionArgNext(n)) return 0;
+  if (execInfo.lex->tk==LEX_INT && jspIsWholeArgument()) {
+    JsVarInt v = stringToInt(jslGetTokenValueAsString(execInfo.lex));
+    JSP_MATCH(LEX_INT);
+    return v;
+  }
+  return jsvGetIntegerAndUnLock(jsvSkipNameAndUnLock(jspeAssignmentExpression()));
+}
+
+NO_INLINE JsVarFloat jspParseFunctionArgFloat(int n) {
+  if (!jspParseFunctionArgNext(n)) return NAN;
+  if ((execInfo.lex->tk==LEX_INT || execInfo.lex->tk==LEX_FLOAT) && jspIsWholeArgument()) {
+    JsVarFloat v;
+    if (execInfo.lex->tk==LEX_INT) {
+      v = (JsVarFloat)stringToInt(jslGetTokenValueAsString(execInfo.lex));
+      JSP_MATCH(LEX_INT);
+    } else {
+      v = stringToFloat(jslGetTokenValueAsString(execInfo.lex));
+      JSP_MATCH(LEX_FLOAT);
+    }
+    return v;
+  }
+  return jsvGetFloatAndUnLock(jsvSkipNameAndUnLock(jspeAssignmentExpression()));
+}
+
+NO_INLINE bool jspParseFunctionArgBool(int n) {
+  if (!jspParseFunctionArgNext(n)) return false;
+  if ((execInfo.lex->tk==LEX_R_TRUE || execInfo.lex->tk==LEX_R_FALSE) && jspIsWholeArgument()) {
+    bool v = execInfo.lex->tk==LEX_R_TRUE;
+    JSP_MATCH(execInfo.lex->tk);
+    return v;
+  }
+  return jsvGetBoolAndUnLock(jsvSkipNameAndUnLock(jspeAssignmentExpression()));
+}
+
+NO_INLINE Pin jspParseFunctionArgPin(int n) {
+  if (!jspParseFunctionArgNext(n)) return PIN_UNDEFINED;
+  if (execInfo.lex->tk==LEX_INT && jspIsWholeArgument()) {
+    Pin pin = (Pin)stringToInt(jslGetTokenValueAsString(execInfo.lex));
+    JSP_MATCH_WITH_RETURN(LEX_INT, PIN_UNDEFINED);
+    return pin;
+  }
+  if (execInfo.lex->tk==LEX_ID && jspIsWholeArgument()) {
+    // A pin name like LED1 - as long as there isn't a variable with the same name
+    const char *name = jslGetTokenValueAsString(execInfo.lex);
+    JsVar *v = jspeiFindInScopes(name);
+    if (!v) {
+      Pin pin = jshGetPinFromString(name);
+      if (pin != PIN_UNDEFINED) {
+        JSP_MATCH_WITH_RETURN(LEX_ID, PIN_UNDEFINED);
+        return pin;
+      }
+    }
+    jsvUnLock(v);
+  }
+  return jshGetPinFromVarAndUnLock(jsvSkipNameAndUnLock(jspeAssignmentExpression()));
+}
+
 /// parse a function with any number of argument, and return an array of de-named aruments
 NO_INLINE JsVar *jspParseFunctionAsArray() {
   JSP_MATCH(LEX_ID);
@@ -16,6 +16,7 @@
 
 #include "jsvar.h"
 #include "jslex.h"
+#include "jspin.h"
 
 void jspInit();
 void jspKill();
@@ -115,6 +116,18 @@ bool jspParseEmptyFunction();    ///< parse function with no arguments
 JsVar *jspParseSingleFunction(); ///< parse function with a single argument, return its value (no names!)
 JsVar *jspParseFunctionAsArray(); ///< parse a function with any number of argument, and return an array of de-named aruments
 
+/* Parse a function's arguments one at a time, as native types (used by build_jswrapper.py).
+ * Call jspParseFunctionStart, then jspParseFunctionArg... for each argument n (from 0) in turn,
+ * then jspParseFunctionEnd. Arguments that are just a number or a pin name are read straight
+ * from the lexer, without allocating a JsVar for them. Missing arguments are undefined. */
+bool jspParseFunctionStart(); ///< parse the function name and start bracket
+bool jspParseFunctionEnd(); ///< throw away any extra arguments and parse the end bracket
+JsVar *jspParseFunctionArg(int n, bool skipName);
+JsVarInt jspParseFunctionArgInt(int n);
+JsVarFloat jspParseFunctionArgFloat(int n);
+bool jspParseFunctionArgBool(int n);
+Pin jspParseFunctionArgPin(int n);
+
 /** Handle a function call (assumes we've parsed the function name and we're
  * on the start bracket). 'thisArg' is the value of the 'this' variable when the
  * function is executed (it's usually the parent object)
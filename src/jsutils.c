@@ -133,7 +133,7 @@ NO_INLINE void jsError(const char *fmt, ...) {
   jsiConsolePrint("ERROR: ");
   va_list argp;
   va_start(argp, fmt);
-  vcbprintf((vcbprintf_callback)jsiConsolePrint,0, fmt, argp);
+  vcbprintf(jsiConsolePrintCallback,0, fmt, argp);
   va_end(argp);
   jsiConsolePrint("\n");
 }
@@ -143,7 +143,7 @@ NO_INLINE void jsErrorInternal(const char *fmt, ...) {
   jsiConsolePrint("INTERNAL ERROR: ");
   va_list argp;
   va_start(argp, fmt);
-  vcbprintf((vcbprintf_callback)jsiConsolePrint,0, fmt, argp);
+  vcbprintf(jsiConsolePrintCallback,0, fmt, argp);
   va_end(argp);
   jsiConsolePrint("\n");
 }
@@ -164,7 +164,7 @@ NO_INLINE void jsWarn(const char *fmt, ...) {
   jsiConsolePrint("WARNING: ");
   va_list argp;
   va_start(argp, fmt);
-  vcbprintf((vcbprintf_callback)jsiConsolePrint,0, fmt, argp);
+  vcbprintf(jsiConsolePrintCallback,0, fmt, argp);
   va_end(argp);
   jsiConsolePrint("\n");
 }
@@ -244,6 +244,31 @@ void *memcpy(void *dst, const void *src, size_t size) {
                 ((char*)dst)[i] = ((char*)src)[i];
         return dst;
 }
+void *memmove(void *dst, const void *src, size_t size) {
+        size_t i;
+        if (dst < src) {
+                for (i=0;i<size;i++)
+                        ((char*)dst)[i] = ((char*)src)[i];
+        } else {
+                for (i=size;i>0;i--)
+                        ((char*)dst)[i-1] = ((char*)src)[i-1];
+        }
+        return dst;
+}
+void *memchr(const void *s, int c, size_t size) {
+        size_t i;
+        for (i=0;i<size;i++)
+                if (((unsigned char*)s)[i] == (unsigned char)c)
+                        return (void*)&((char*)s)[i];
+        return 0;
+}
+int memcmp(const void *a, const void *b, size_t size) {
+        size_t i;
+        for (i=0;i<size;i++)
+                if (((unsigned char*)a)[i] != ((unsigned char*)b)[i])
+                        return ((unsigned char*)a)[i] - ((unsigned char*)b)[i];
+        return 0;
+}
 
 unsigned int rand() {
     static unsigned int m_w = 0xDEADBEEF;    /* must not be zero */
@@ -407,6 +432,38 @@ JsVarFloat wrapAround(JsVarFloat val, JsVarFloat size) {
   return val * size;
 }
 
+/// Send the escaped version of a character to the callback (see escapeCharacter)
+static void vcbprintf_escaped(vcbprintf_callback user_callback, void *user_data, char ch) {
+  const char *e = escapeCharacter(ch);
+  user_callback(e, strlen(e), user_data);
+}
+
+/// Send the contents of a String to the callback a whole block (or an unescaped run of one) at a time
+static void vcbprintf_stringvar(vcbprintf_callback user_callback, void *user_data, JsVar *v, bool quoted) {
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, v, 0);
+  while (jsvStringIteratorHasChar(&it)) {
+    const char *str = &it.var->varData.str[it.charIdx];
+    size_t n = it.charsInVar - it.charIdx;
+    if (quoted) {
+      size_t i = 0;
+      while (i<n && str[i]>=' ' && str[i]!='"' && str[i]!='\\') i++;
+      if (i) {
+        user_callback(str, i, user_data);
+        n = i;
+      } else {
+        vcbprintf_escaped(user_callback, user_data, str[0]);
+        n = 1;
+      }
+    } else {
+      user_callback(str, n, user_data);
+    }
+    it.charIdx += n-1;
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+}
+
 /** Espruino-special printf with a callback
  * Supported are:
  *   %d = int
@@ -429,46 +486,34 @@ void vcbprintf(vcbprintf_callback user_callback, void *user_data, const char *fm
       fmt++;
       char fmtChar = *fmt++;
       switch (fmtChar) {
-      case 'd': itoa(va_arg(argp, int), buf, 10); user_callback(buf,user_data); break;
-      case 'x': itoa(va_arg(argp, int), buf, 16); user_callback(buf,user_data); break;
+      case 'd': itoa(va_arg(argp, int), buf, 10); user_callback(buf, strlen(buf), user_data); break;
+      case 'x': itoa(va_arg(argp, int), buf, 16); user_callback(buf, strlen(buf), user_data); break;
       case 'L': {
         unsigned int rad = 10;
         if (*fmt=='x') { rad=16; fmt++; }
-        itoa(va_arg(argp, JsVarInt), buf, rad); user_callback(buf,user_data);
+        itoa(va_arg(argp, JsVarInt), buf, rad); user_callback(buf, strlen(buf), user_data);
       } break;
-      case 'f': ftoa_bounded(va_arg(argp, JsVarFloat), buf, sizeof(buf)); user_callback(buf,user_data);  break;
-      case 's': user_callback(va_arg(argp, char *), user_data); break;
-      case 'c': buf[0]=(char)va_arg(argp, int/*char*/);buf[1]=0; user_callback(buf, user_data); break;
+      case 'f': ftoa_bounded(va_arg(argp, JsVarFloat), buf, sizeof(buf)); user_callback(buf, strlen(buf), user_data);  break;
+      case 's': { const char *str = va_arg(argp, char *); user_callback(str, strlen(str), user_data); } break;
+      case 'c': buf[0]=(char)va_arg(argp, int/*char*/); user_callback(buf, 1, user_data); break;
       case 'q':
       case 'v': {
         bool quoted = fmtChar=='q';
-        if (quoted) user_callback("\"",user_data);
+        if (quoted) user_callback("\"", 1, user_data);
         JsVar *v = jsvAsString(va_arg(argp, JsVar*), false/*no unlock*/);
-        buf[1] = 0;
-        JsvStringIterator it;
-        jsvStringIteratorNew(&it, v, 0);
-        // OPT: this could be faster than it is (sending whole blocks at once)
-        while (jsvStringIteratorHasChar(&it)) {
-          buf[0] = jsvStringIteratorGetChar(&it);
-          if (quoted) {
-            user_callback(escapeCharacter(buf[0]), user_data);
-          } else {
-            user_callback(buf,user_data);
-          }
-          jsvStringIteratorNext(&it);
-        }
-        jsvStringIteratorFree(&it);
+        vcbprintf_stringvar(user_callback, user_data, v, quoted);
         jsvUnLock(v);
-        if (quoted) user_callback("\"",user_data);
+        if (quoted) user_callback("\"", 1, user_data);
       } break;
-      case 't': user_callback(jsvGetTypeOf(va_arg(argp, JsVar*)), user_data); break;
-      case 'p': jshGetPinString(buf, (Pin)va_arg(argp, int/*Pin*/)); user_callback(buf, user_data); break;
+      case 't': { const char *str = jsvGetTypeOf(va_arg(argp, JsVar*)); user_callback(str, strlen(str), user_data); } break;
+      case 'p': jshGetPinString(buf, (Pin)va_arg(argp, int/*Pin*/)); user_callback(buf, strlen(buf), user_data); break;
       default: assert(0); return; // eep
       }
     } else {
-      buf[0] = *(fmt++);
-      buf[1] = 0;
-      user_callback(&buf[0], user_data);
+      // send everything up to the next format specifier in one go
+      const char *start = fmt;
+      while (*fmt && *fmt!='%') fmt++;
+      user_callback(start, (size_t)(fmt-start), user_data);
     }
   }
 }
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #endif
 #include <stdarg.h> // for va_args
+#include <stdint.h>
 
 #ifdef LINUX
 #include <math.h>
@@ -205,7 +206,12 @@ typedef enum {
     JSV_BOOLEAN     = JSV_FLOAT+1, ///< boolean (note JSV_NUMERICMASK)
     JSV_PIN         = JSV_BOOLEAN+1, ///< pin (note JSV_NUMERICMASK)
     JSV_NUMERICEND  = JSV_PIN, ///< --------- End of numeric variable types
+#ifdef FLAT_ARRAYBUFFERS
+    JSV_FLAT_BUFFER = JSV_NUMERICEND+1, ///< ArrayBuffer data held in one malloc'd block (see jsvNewFlatBuffer)
+    JSV_VAR_END     = JSV_FLAT_BUFFER, ///< End of variable types
+#else
     JSV_VAR_END     = JSV_NUMERICEND, ///< End of numeric variable types
+#endif
 
     JSV_VARTYPEMASK = NEXT_POWER_2(JSV_VAR_END)-1,
 
@@ -341,6 +347,9 @@ char *strncpy(char *dst, const char *src, size_t c);
 size_t strlen(const char *s);
 int strcmp(const char *a, const char *b);
 void *memcpy(void *dst, const void *src, size_t size);
+void *memmove(void *dst, const void *src, size_t size);
+void *memchr(const void *s, int c, size_t size);
+int memcmp(const void *a, const void *b, size_t size);
 #define RAND_MAX (0xFFFFFFFFU)
 unsigned int rand();
 #endif
@@ -361,7 +370,9 @@ void ftoa_bounded(JsVarFloat val,char *str, size_t len);
 JsVarFloat wrapAround(JsVarFloat val, JsVarFloat size);
 
 
-typedef void (*vcbprintf_callback)(const char *str, void *user_data);
+/** Callback for vcbprintf. It's given runs of 'len' characters at a time,
+ * which are NOT zero terminated */
+typedef void (*vcbprintf_callback)(const char *str, size_t len, void *user_data);
 /** Espruino-special printf with a callback
  * Supported are:
  *   %d = int
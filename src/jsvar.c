@@ -66,6 +66,11 @@ void jsvSetMaxVarsUsed(unsigned int size) {
 }
 
 
+#ifdef FLAT_ARRAYBUFFERS
+#define JSV_FLAT_BUFFERS_SAVED JS_HIDDEN_CHAR_STR"FlatB" ///< Array in root of flat buffers that jsvSoftKill turned into Strings
+static void jsvRestoreFlatBuffers();
+#endif
+
 // maps the empty variables in...
 void jsvSoftInit() {
   jsVarFirstEmpty = 0;
@@ -81,9 +86,86 @@ void jsvSoftInit() {
       lastEmpty = jsvGetAddressOf(i);
     }
   }
+#ifdef FLAT_ARRAYBUFFERS
+  jsvRestoreFlatBuffers();
+#endif
+}
+
+#ifdef FLAT_ARRAYBUFFERS
+/// Free the memory pointed to by a flat buffer (but not the JsVar itself)
+static void jsvFreeFlatBuffer(JsVar *var) {
+  free(var->varData.flatBuffer);
+  var->varData.flatBuffer = 0;
+}
+
+/** Turn a flat buffer into a normal String (in place, so references to it
+ * stay valid) and free the memory it used. There must be enough free variables */
+static void jsvFlatBufferToString(JsVar *var) {
+  char *block = var->varData.flatBuffer;
+  size_t len = jsvGetFlatBufferLength(var);
+  var->flags = (JsVarFlags)((var->flags & ~JSV_VARTYPEMASK) | JSV_STRING_0);
+  var->lastChild = 0;
+  jsvAppendStringBuf(var, block + sizeof(size_t), (int)len);
+  free(block);
+}
+
+/// The number of variables needed to store a String of the given length
+static unsigned int jsvGetVarsForString(size_t len) {
+  if (len <= JSVAR_DATA_STRING_LEN) return 1;
+  return 1 + (unsigned int)((len - JSVAR_DATA_STRING_LEN + JSVAR_DATA_STRING_MAX_LEN - 1) / JSVAR_DATA_STRING_MAX_LEN);
+}
+
+/// Find the root without creating it (there isn't one if we're just starting up)
+static JsVar *jsvFindRoot() {
+  JsVarRef i;
+  for (i=1;i<=jsVarsSize;i++)
+    if (jsvIsRoot(jsvGetAddressOf(i)))
+      return jsvLock(i);
+  return 0;
+}
+#endif
+
+bool jsvSoftKill() {
+  bool ok = true;
+#ifdef FLAT_ARRAYBUFFERS
+  /* Flat buffers point to memory outside of our variables, which
+   * won't survive being saved and loaded - so turn them into Strings.
+   * Each one is remembered in JSV_FLAT_BUFFERS_SAVED so that jsvSoftInit
+   * can turn it back. We only convert a buffer if there's room for it,
+   * so data is never lost */
+  JsVar *root = jsvFindRoot();
+  if (!root) return true;
+  unsigned int freeVars = jsvGetMemoryTotal() - jsvGetMemoryUsage();
+  JsVar *arr = 0;
+  JsVarRef i;
+  for (i=1;i<=jsVarsSize && ok;i++) {
+    if (jsvIsFlatBuffer(jsvGetAddressOf(i))) {
+      JsVar *var = jsvLock(i);
+      // the String, the array element that points to it, and the array (and its name) if not made yet
+      unsigned int needed = jsvGetVarsForString(jsvGetFlatBufferLength(var)) + 1 + (arr ? 0 : 2);
+      if (needed <= freeVars) {
+        if (!arr) arr = jsvObjectGetChild(root, JSV_FLAT_BUFFERS_SAVED, JSV_ARRAY);
+        jsvFlatBufferToString(var);
+        jsvArrayPush(arr, var);
+        freeVars -= needed;
+      } else
+        ok = false;
+      jsvUnLock(var);
+    }
+  }
+  jsvUnLock(arr);
+  jsvUnLock(root);
+#endif
+  return ok;
 }
 
-void jsvSoftKill() {
+void jsvFreeFlatBuffers() {
+#ifdef FLAT_ARRAYBUFFERS
+  JsVarRef ref;
+  for (ref=1;ref<=jsVarsSize;ref++)
+    if (jsvIsFlatBuffer(jsvGetAddressOf(ref)))
+      jsvFreeFlatBuffer(jsvGetAddressOf(ref));
+#endif
 }
 
 /** This links all JsVars together, so we can have our nice
@@ -116,6 +198,7 @@ void jsvInit() {
 }
 
 void jsvKill() {
+  jsvFreeFlatBuffers();
 #ifdef RESIZABLE_JSVARS
   jsVarsSize = 0;
   unsigned int i;
@@ -302,11 +385,64 @@ void jsvFreePtr(JsVar *var) {
     } else {
       assert(!var->firstChild);
       assert(!var->lastChild);
+#ifdef FLAT_ARRAYBUFFERS
+      if (jsvIsFlatBuffer(var)) jsvFreeFlatBuffer(var);
+#endif
     }
     // free!
     jsvFreePtrInternal(var);
 }
 
+#ifdef FLAT_ARRAYBUFFERS
+/** Turn a String back into a flat buffer (in place) and free its StringExts.
+ * If there isn't enough memory it's left as a String, which still works */
+static void jsvStringToFlatBuffer(JsVar *var) {
+  size_t len = jsvGetStringLength(var);
+  char *block = (char*)malloc(sizeof(size_t)+len);
+  if (!block) return;
+  *(size_t*)block = len;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, var, 0);
+  size_t i = 0;
+  while (jsvStringIteratorHasChar(&it)) {
+    block[sizeof(size_t) + i++] = jsvStringIteratorGetChar(&it);
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  JsVarRef stringDataRef = var->lastChild;
+  var->lastChild = 0;
+  while (stringDataRef) {
+    JsVar *child = jsvLock(stringDataRef);
+    stringDataRef = child->lastChild;
+    jsvFreePtrInternal(child);
+    jsvUnLock(child);
+  }
+  var->flags = (JsVarFlags)((var->flags & ~JSV_VARTYPEMASK) | JSV_FLAT_BUFFER);
+  var->varData.flatBuffer = block;
+}
+
+/// Turn the Strings that jsvSoftKill made back into flat buffers
+static void jsvRestoreFlatBuffers() {
+  JsVar *root = jsvFindRoot();
+  if (!root) return;
+  JsVar *arr = jsvObjectGetChild(root, JSV_FLAT_BUFFERS_SAVED, 0);
+  if (arr) {
+    JsvArrayIterator it;
+    jsvArrayIteratorNew(&it, arr);
+    while (jsvArrayIteratorHasElement(&it)) {
+      JsVar *var = jsvArrayIteratorGetElement(&it);
+      if (jsvIsString(var)) jsvStringToFlatBuffer(var);
+      jsvUnLock(var);
+      jsvArrayIteratorNext(&it);
+    }
+    jsvArrayIteratorFree(&it);
+    jsvUnLock(arr);
+    jsvRemoveNamedChild(root, JSV_FLAT_BUFFERS_SAVED);
+  }
+  jsvUnLock(root);
+}
+#endif
+
 /// Get a reference from a var - SAFE for null vars
 JsVarRef jsvGetRef(JsVar *var) {
     if (!var) return 0;
@@ -896,9 +1032,8 @@ bool jsvAppendStringBuf(JsVar *var, const char *str, int length) {
 }
 
 /// Special version of append designed for use with vcbprintf_callback (See jsvAppendPrintf)
-void jsvStringIteratorPrintfCallback(const char *str, void *user_data) {
-  while (*str)
-    jsvStringIteratorAppend((JsvStringIterator *)user_data, *(str++));
+void jsvStringIteratorPrintfCallback(const char *str, size_t len, void *user_data) {
+  jsvStringIteratorAppendString((JsvStringIterator *)user_data, str, len);
 }
 
 void jsvAppendPrintf(JsVar *var, const char *fmt, ...) {
@@ -908,7 +1043,7 @@ void jsvAppendPrintf(JsVar *var, const char *fmt, ...) {
 
   va_list argp;
   va_start(argp, fmt);
-  vcbprintf((vcbprintf_callback)&jsvStringIteratorPrintfCallback,&it, fmt, argp);
+  vcbprintf(jsvStringIteratorPrintfCallback,&it, fmt, argp);
   va_end(argp);
 
   jsvStringIteratorFree(&it);
@@ -1088,6 +1223,59 @@ JsVarFloat jsvGetFloatAndUnLock(JsVar *v) { return _jsvGetFloatAndUnLock(v); }
 bool jsvGetBoolAndUnLock(JsVar *v) { return _jsvGetBoolAndUnLock(v); }
 #endif
 
+#ifdef FLAT_ARRAYBUFFERS
+JsVar *jsvNewFlatBuffer(size_t byteLength) {
+  char *block = (char*)calloc(1, sizeof(size_t)+byteLength);
+  if (!block) return 0;
+  *(size_t*)block = byteLength;
+  JsVar *var = jsvNewWithFlags(JSV_FLAT_BUFFER);
+  if (!var) {
+    free(block);
+    return 0;
+  }
+  var->varData.flatBuffer = block;
+  return var;
+}
+#endif
+
+JsVar *jsvNewArrayBufferWithData(JsVar *data, size_t byteLength) {
+  assert(jsvIsString(data) || jsvIsFlatBuffer(data));
+  assert(byteLength <= JSV_ARRAYBUFFER_MAX_LENGTH);
+  JsVar *arr = jsvNewWithFlags(JSV_ARRAYBUFFER);
+  if (!arr) return 0;
+  arr->firstChild = jsvGetRef(jsvRef(data));
+  arr->varData.arraybuffer.type = ARRAYBUFFERVIEW_ARRAYBUFFER;
+  arr->varData.arraybuffer.byteOffset = 0;
+  arr->varData.arraybuffer.length = (unsigned int)(byteLength & JSV_ARRAYBUFFER_MAX_LENGTH);
+  return arr;
+}
+
+char *jsvGetArrayBufferPointer(JsVar *arrayBuffer, size_t *byteLength) {
+  assert(jsvIsArrayBuffer(arrayBuffer));
+#ifdef FLAT_ARRAYBUFFERS
+  JsVar *data = jsvLock(arrayBuffer->firstChild);
+  while (jsvIsArrayBuffer(data)) {
+    JsVar *s = jsvLock(data->firstChild);
+    jsvUnLock(data);
+    data = s;
+  }
+  char *ptr = 0;
+  if (jsvIsFlatBuffer(data)) {
+    size_t offset = arrayBuffer->varData.arraybuffer.byteOffset;
+    size_t length = arrayBuffer->varData.arraybuffer.length * JSV_ARRAYBUFFER_GET_SIZE(arrayBuffer->varData.arraybuffer.type);
+    if (offset + length <= jsvGetFlatBufferLength(data)) {
+      ptr = jsvGetFlatBufferPointer(data) + offset;
+      *byteLength = length;
+    }
+  }
+  jsvUnLock(data);
+  return ptr;
+#else
+  NOT_USED(byteLength);
+  return 0;
+#endif
+}
+
 /** Get the item at the given location in the array buffer and return the result */
 size_t jsvGetArrayBufferLength(JsVar *arrayBuffer) {
   assert(jsvIsArrayBuffer(arrayBuffer));
@@ -1280,6 +1468,14 @@ JsVar *jsvCopyNameOnly(JsVar *src, bool linkChildren, bool keepAsName) {
 }
 
 JsVar *jsvCopy(JsVar *src) {
+#ifdef FLAT_ARRAYBUFFERS
+  if (jsvIsFlatBuffer(src)) {
+    // don't share the block - that would free it twice
+    JsVar *dst = jsvNewFlatBuffer(jsvGetFlatBufferLength(src));
+    if (dst) memcpy(jsvGetFlatBufferPointer(dst), jsvGetFlatBufferPointer(src), jsvGetFlatBufferLength(src));
+    return dst;
+  }
+#endif
   JsVar *dst = jsvNewWithFlags(src->flags);
   if (!dst) return 0; // out of memory
   if (!jsvIsStringExt(src)) {
@@ -2166,6 +2362,13 @@ void _jsvTrace(JsVarRef ref, int indent, JsVarRef baseRef, int level) {
       jsvUnLock(var);
       return;
     } else if (jsvIsFunction(var)) jsiConsolePrint("Function {");
+#ifdef FLAT_ARRAYBUFFERS
+    else if (jsvIsFlatBuffer(var)) {
+      jsiConsolePrintf("FlatBuffer %d bytes\n", (int)jsvGetFlatBufferLength(var));
+      jsvUnLock(var);
+      return;
+    }
+#endif
     else {
         jsiConsolePrintf("Flags %d\n", var->flags & (JsVarFlags)~(JSV_LOCK_MASK));
     }
@@ -2282,6 +2485,9 @@ bool jsvGarbageCollect() {
     JsVar *var = jsvGetAddressOf(i);
     if (var->flags & JSV_GARBAGE_COLLECT) {
       freedSomething = true;
+#ifdef FLAT_ARRAYBUFFERS
+      if (jsvIsFlatBuffer(var)) jsvFreeFlatBuffer(var);
+#endif
       // free!
       var->flags = JSV_UNUSED;
       // add this to our free list
@@ -2405,6 +2611,164 @@ void jsvStringIteratorAppend(JsvStringIterator *it, char ch) {
   jsvSetCharactersInVar(it->var, it->charsInVar);
 }
 
+void jsvStringIteratorAppendString(JsvStringIterator *it, const char *str, size_t len) {
+  if (!it->var) return;
+  assert(it->charsInVar==0 || it->charIdx+1 == it->charsInVar /* check at end */);
+  while (len) {
+    size_t idx = it->charsInVar; // where the next character goes
+    size_t maxChars = jsvGetMaxCharactersInVar(it->var);
+    if (idx >= maxChars) {
+      assert(!it->var->lastChild);
+      JsVar *next = jsvNewWithFlags(JSV_STRING_EXT);
+      if (!next) return; // out of memory
+      // we don't ref, because  StringExts are never reffed as they only have one owner (and ALWAYS have an owner)
+      it->var->lastChild = jsvGetRef(next);
+      jsvUnLock(it->var);
+      it->var = next;
+      it->varIndex += idx;
+      idx = 0; // it's new, so empty
+      maxChars = jsvGetMaxCharactersInVar(it->var);
+    }
+    size_t n = maxChars - idx;
+    if (n > len) n = len;
+    memcpy(&it->var->varData.str[idx], str, n);
+    str += n;
+    len -= n;
+    it->charsInVar = idx+n;
+    it->charIdx = it->charsInVar-1;
+    jsvSetCharactersInVar(it->var, it->charsInVar);
+  }
+}
+
+void jsvStringIteratorSkip(JsvStringIterator *it, size_t count) {
+  while (count && jsvStringIteratorHasChar(it)) {
+    size_t n = it->charsInVar - it->charIdx;
+    if (n > count) n = count;
+    count -= n;
+    it->charIdx += n-1;
+    jsvStringIteratorNext(it);
+  }
+}
+
+void jsvStringIteratorAppendFromIterator(JsvStringIterator *it, JsvStringIterator *src, size_t len) {
+  while (len && jsvStringIteratorHasChar(src)) {
+    size_t n = src->charsInVar - src->charIdx;
+    if (n > len) n = len;
+    jsvStringIteratorAppendString(it, &src->var->varData.str[src->charIdx], n);
+    len -= n;
+    src->charIdx += n-1;
+    jsvStringIteratorNext(src);
+  }
+}
+
+// --------------------------------------------------------------------------------------------
+void jsvStringSearchNew(JsvStringSearch *s, JsVar *haystack, JsVar *needle, size_t startIdx) {
+  assert(jsvHasCharacterData(needle));
+  s->haystack = jsvLockAgain(haystack);
+  s->needle = jsvLockAgain(needle);
+  jsvStringIteratorNew(&s->it, haystack, startIdx);
+  s->needleLen = jsvGetStringLength(needle);
+  s->haystackLen = 0;
+  s->pos = s->bufStart = startIdx;
+  s->bufLen = 0;
+  // we match (up to) the first sizeof(window) chars of the needle from the buffer
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, needle, 0);
+  s->windowLen = 0;
+  while (s->windowLen < sizeof(s->window) && jsvStringIteratorHasChar(&it)) {
+    s->window[s->windowLen++] = jsvStringIteratorGetChar(&it);
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  // Horspool's table of how far we can move on, given the last character we looked at
+  size_t i;
+  for (i=0;i<sizeof(s->skip);i++)
+    s->skip[i] = (unsigned char)s->windowLen;
+  for (i=0;i+1<s->windowLen;i++)
+    s->skip[s->window[i] & (sizeof(s->skip)-1)] = (unsigned char)(s->windowLen-1-i);
+  // if the needle doesn't fit in the window we check the rest separately, which needs the length
+  if (s->needleLen > s->windowLen)
+    s->haystackLen = jsvGetStringLength(haystack);
+}
+
+/// Make sure the buffer starts at 'pos', and fill it up from the haystack
+static void jsvStringSearchFill(JsvStringSearch *s) {
+  size_t bufEnd = s->bufStart + s->bufLen;
+  if (s->pos < bufEnd) {
+    s->bufLen = bufEnd - s->pos;
+    memmove(s->buf, &s->buf[s->pos - s->bufStart], s->bufLen);
+  } else {
+    jsvStringIteratorSkip(&s->it, s->pos - bufEnd);
+    s->bufLen = 0;
+  }
+  s->bufStart = s->pos;
+  while (s->bufLen < sizeof(s->buf) && jsvStringIteratorHasChar(&s->it)) {
+    size_t n = s->it.charsInVar - s->it.charIdx;
+    if (n > sizeof(s->buf) - s->bufLen) n = sizeof(s->buf) - s->bufLen;
+    memcpy(&s->buf[s->bufLen], &s->it.var->varData.str[s->it.charIdx], n);
+    s->bufLen += n;
+    s->it.charIdx += n-1;
+    jsvStringIteratorNext(&s->it);
+  }
+}
+
+/// The window matched at 'idx' - check any of the needle that didn't fit in it
+static bool jsvStringSearchMatchesRest(JsvStringSearch *s, size_t idx) {
+  if (s->needleLen == s->windowLen) return true;
+  if (idx + s->needleLen > s->haystackLen) return false;
+  return jsvCompareString(s->haystack, s->needle, idx + s->windowLen, s->windowLen, true)==0;
+}
+
+int jsvStringSearchNext(JsvStringSearch *s) {
+  size_t w = s->windowLen;
+  assert(w>0);
+  while (true) {
+    size_t o = s->pos - s->bufStart;
+    if (o + w > s->bufLen) {
+      jsvStringSearchFill(s);
+      o = 0;
+      if (w > s->bufLen) return -1; // not enough of the haystack left
+    }
+    const char *buf = s->buf;
+    size_t last = s->bufLen - w; // the last offset a match could start at in the buffer
+    if (w < 4) {
+      // short needles - look for the first char
+      while (o <= last) {
+        const char *f = memchr(&buf[o], s->window[0], last+1-o);
+        if (!f) {
+          o = last+1;
+          break;
+        }
+        o = (size_t)(f - buf);
+        if (memcmp(f, s->window, w)==0 && jsvStringSearchMatchesRest(s, s->bufStart + o))
+          break;
+        o++;
+      }
+    } else {
+      // longer needles - Horspool, skipping on the last char of each position we try
+      char lastCh = s->window[w-1];
+      while (o <= last) {
+        char ch = buf[o+w-1];
+        if (ch==lastCh && memcmp(&buf[o], s->window, w-1)==0 && jsvStringSearchMatchesRest(s, s->bufStart + o))
+          break;
+        o += s->skip[ch & (sizeof(s->skip)-1)];
+      }
+    }
+    if (o <= last) { // found
+      size_t idx = s->bufStart + o;
+      s->pos = idx+1;
+      return (int)idx;
+    }
+    s->pos = s->bufStart + o;
+  }
+}
+
+void jsvStringSearchFree(JsvStringSearch *s) {
+  jsvStringIteratorFree(&s->it);
+  jsvUnLock(s->needle);
+  jsvUnLock(s->haystack);
+}
+
 
 // --------------------------------------------------------------------------------------------
 void   jsvArrayBufferIteratorNew(JsvArrayBufferIterator *it, JsVar *arrayBuffer, size_t index) {
@@ -2419,24 +2783,44 @@ void   jsvArrayBufferIteratorNew(JsvArrayBufferIterator *it, JsVar *arrayBuffer,
     jsvUnLock(arrayBufferData);
     arrayBufferData = s;
   }
-  assert(jsvIsString(arrayBufferData));
+  assert(jsvIsString(arrayBufferData) || jsvIsFlatBuffer(arrayBufferData));
 
   it->byteLength += it->byteOffset; // because we'll check if we have more bytes using this
+#ifdef FLAT_ARRAYBUFFERS
+  it->flatData = 0;
+  // never let a view read or write past the end of the block
+  if (jsvIsFlatBuffer(arrayBufferData) && it->byteLength > jsvGetFlatBufferLength(arrayBufferData))
+    it->byteLength = jsvGetFlatBufferLength(arrayBufferData);
+#endif
   it->byteOffset = it->byteOffset + index*JSV_ARRAYBUFFER_GET_SIZE(it->type);
   if (it->byteOffset>=(it->byteLength+1-JSV_ARRAYBUFFER_GET_SIZE(it->type))) {
     jsvUnLock(arrayBufferData);
     it->type = ARRAYBUFFERVIEW_UNDEFINED;
     return;
   }
+  it->hasAccessedElement = false;
+#ifdef FLAT_ARRAYBUFFERS
+  if (jsvIsFlatBuffer(arrayBufferData)) {
+    // keep our lock in it.var, so Clone and Free work as they do for Strings
+    it->it.var = arrayBufferData;
+    it->flatData = jsvGetFlatBufferPointer(arrayBufferData);
+    return;
+  }
+#endif
   jsvStringIteratorNew(&it->it, arrayBufferData, (size_t)it->byteOffset);
   jsvUnLock(arrayBufferData);
-  it->hasAccessedElement = false;
 }
 
 static void jsvArrayBufferIteratorGetValueData(JsvArrayBufferIterator *it, char *data) {
   if (it->type == ARRAYBUFFERVIEW_UNDEFINED) return;
   assert(!it->hasAccessedElement); // we just haven't implemented this case yet
   unsigned int i,dataLen = JSV_ARRAYBUFFER_GET_SIZE(it->type);
+#ifdef FLAT_ARRAYBUFFERS
+  if (it->flatData) {
+    memcpy(data, &it->flatData[it->byteOffset], dataLen);
+    return;
+  }
+#endif
   for (i=0;i<dataLen;i++) {
     data[i] = jsvStringIteratorGetChar(&it->it);
     if (dataLen!=1) jsvStringIteratorNext(&it->it);
@@ -2453,7 +2837,7 @@ static JsVarInt jsvArrayBufferIteratorDataToInt(JsvArrayBufferIterator *it, char
   else if (dataLen==8) v = *(long long*)data;
   else assert(0);
   if ((!JSV_ARRAYBUFFER_IS_SIGNED(it->type)) && v<0)
-    v += 1 << (8*dataLen);
+    v += ((JsVarInt)1) << (8*dataLen);
   return v;
 }
 
@@ -2508,11 +2892,26 @@ JsVarFloat jsvArrayBufferIteratorGetFloatValue(JsvArrayBufferIterator *it) {
   }
 }
 
+static void jsvArrayBufferIteratorSetValueData(JsvArrayBufferIterator *it, char *data) {
+  assert(!it->hasAccessedElement); // we just haven't implemented this case yet
+  unsigned int i,dataLen = JSV_ARRAYBUFFER_GET_SIZE(it->type);
+#ifdef FLAT_ARRAYBUFFERS
+  if (it->flatData) {
+    memcpy(&it->flatData[it->byteOffset], data, dataLen);
+    return;
+  }
+#endif
+  for (i=0;i<dataLen;i++) {
+    jsvStringIteratorSetChar(&it->it, data[i]);
+    if (dataLen!=1) jsvStringIteratorNext(&it->it);
+  }
+  if (dataLen!=1) it->hasAccessedElement = true;
+}
+
 void   jsvArrayBufferIteratorSetValue(JsvArrayBufferIterator *it, JsVar *value) {
   if (it->type == ARRAYBUFFERVIEW_UNDEFINED) return;
-  assert(!it->hasAccessedElement); // we just haven't implemented this case yet
   char data[8];
-  unsigned int i,dataLen = JSV_ARRAYBUFFER_GET_SIZE(it->type);
+  unsigned int dataLen = JSV_ARRAYBUFFER_GET_SIZE(it->type);
 
   if (JSV_ARRAYBUFFER_IS_FLOAT(it->type)) {
     JsVarFloat v = jsvGetFloat(value);       ;
@@ -2528,12 +2927,14 @@ void   jsvArrayBufferIteratorSetValue(JsvArrayBufferIterator *it, JsVar *value)
     else if (dataLen==8) { long long c = (long long)v; memcpy(data,&c,dataLen); }
     else assert(0);
   }
+  jsvArrayBufferIteratorSetValueData(it, data);
+}
 
-  for (i=0;i<dataLen;i++) {
-    jsvStringIteratorSetChar(&it->it, data[i]);
-    if (dataLen!=1) jsvStringIteratorNext(&it->it);
-  }
-  if (dataLen!=1) it->hasAccessedElement = true;
+void   jsvArrayBufferIteratorSetFloatValue(JsvArrayBufferIterator *it, JsVarFloat value) {
+  if (it->type == ARRAYBUFFERVIEW_UNDEFINED) return;
+  char data[8];
+  jsvArrayBufferDataSetFloat(data, it->type, 0, value);
+  jsvArrayBufferIteratorSetValueData(it, data);
 }
 
 void   jsvArrayBufferIteratorSetIntegerValue(JsvArrayBufferIterator *it, JsVarInt value) {
@@ -2556,6 +2957,9 @@ bool   jsvArrayBufferIteratorHasElement(JsvArrayBufferIterator *it) {
 void   jsvArrayBufferIteratorNext(JsvArrayBufferIterator *it) {
   it->index++;
   it->byteOffset += JSV_ARRAYBUFFER_GET_SIZE(it->type);
+#ifdef FLAT_ARRAYBUFFERS
+  if (it->flatData) return;
+#endif
   if (!it->hasAccessedElement) {
     unsigned int dataLen = JSV_ARRAYBUFFER_GET_SIZE(it->type);
     while (dataLen--)
@@ -51,6 +51,17 @@ typedef enum {
 #define JSV_ARRAYBUFFER_IS_SIGNED(T) (((T)&ARRAYBUFFERVIEW_SIGNED)!=0)
 #define JSV_ARRAYBUFFER_IS_FLOAT(T) (((T)&ARRAYBUFFERVIEW_FLOAT)!=0)
 
+#ifdef FLAT_ARRAYBUFFERS
+/* Flat buffers can be much bigger than a String made of JsVars, so
+ * use 24 bits for offset and length - it still fits in varData */
+#define JSV_ARRAYBUFFER_MAX_LENGTH 0xFFFFFF
+
+typedef struct {
+  unsigned int byteOffset : 24;
+  unsigned int length : 24;
+  JsVarDataArrayBufferViewType type;
+} PACKED_FLAGS JsVarDataArrayBufferView;
+#else
 #define JSV_ARRAYBUFFER_MAX_LENGTH 65535
 
 typedef struct {
@@ -58,6 +69,7 @@ typedef struct {
   unsigned short length;
   JsVarDataArrayBufferViewType type;
 } PACKED_FLAGS JsVarDataArrayBufferView;
+#endif
 
 typedef union {
     char str[JSVAR_DATA_STRING_LEN]; ///< The contents of this variable if it is a string
@@ -68,6 +80,7 @@ typedef union {
     JsVarFloat floating; ///< The contents of this variable if it is a double
     JsCallback callback; ///< Callback for native functions, or 0
     JsVarDataArrayBufferView arraybuffer; ///< information for array buffer views.
+    char *flatBuffer; ///< FLAT_BUFFER: malloc'd block - a size_t byte length, followed by the data
 } PACKED_FLAGS JsVarData;
 
 typedef struct {
@@ -94,7 +107,7 @@ typedef struct {
    * For OBJECT/ARRAY/FUNCTION - this is the first child
    * For NAMES and REF - this is a link to the variable it points to
    * For STRING_EXT - extra character data (NOT a link)
-   * For ARRAYBUFFER - a link to a string containing the data for the array buffer   *
+   * For ARRAYBUFFER - a link to a string (or flat buffer) containing the data for the array buffer
    */
   JsVarRef firstChild;
 
@@ -125,7 +138,8 @@ void jsvSetMaxVarsUsed(unsigned int size);
 void jsvInit();
 void jsvKill();
 void jsvSoftInit(); ///< called when loading from flash
-void jsvSoftKill(); ///< called when saving to flash
+bool jsvSoftKill(); ///< called when saving to flash - returns false if not everything could be stored in variables (jsvSoftInit undoes what was done)
+void jsvFreeFlatBuffers(); ///< free the data of any flat buffers - used before variables are replaced when loading
 JsVar *jsvFindOrCreateRoot(); ///< Find or create the ROOT variable item - used mainly if recovering from a saved state.
 unsigned int jsvGetMemoryUsage(); ///< Get number of memory records (JsVars) used
 unsigned int jsvGetMemoryTotal(); ///< Get total amount of memory records
@@ -196,6 +210,11 @@ static inline bool jsvIsObject(const JsVar *v) { return v && (((v->flags&JSV_VAR
 static inline bool jsvIsArray(const JsVar *v) { return v && (v->flags&JSV_VARTYPEMASK)==JSV_ARRAY; }
 static inline bool jsvIsArrayBuffer(const JsVar *v) { return v && (v->flags&JSV_VARTYPEMASK)==JSV_ARRAYBUFFER; }
 static inline bool jsvIsArrayBufferName(const JsVar *v) { return v && (v->flags&(JSV_VARTYPEMASK|JSV_NAME))==JSV_ARRAYBUFFERNAME; }
+#ifdef FLAT_ARRAYBUFFERS
+static inline bool jsvIsFlatBuffer(const JsVar *v) { return v && (v->flags&JSV_VARTYPEMASK)==JSV_FLAT_BUFFER; }
+#else
+static inline bool jsvIsFlatBuffer(const JsVar *v) { NOT_USED(v); return false; }
+#endif
 static inline bool jsvIsNative(const JsVar *v) { return v && (v->flags&JSV_NATIVE)!=0; }
 static inline bool jsvIsUndefined(const JsVar *v) { return v==0; }
 static inline bool jsvIsNull(const JsVar *v) { return v && (v->flags&JSV_VARTYPEMASK)==JSV_NULL; }
@@ -304,6 +323,67 @@ bool jsvGetBoolAndUnLock(JsVar *v);
 #endif
 
 
+#ifdef FLAT_ARRAYBUFFERS
+/** Create a flat buffer - byteLength zeroed bytes in a single malloc'd block that is
+ * freed along with the JsVar. Returns 0 if out of memory */
+JsVar *jsvNewFlatBuffer(size_t byteLength);
+static inline size_t jsvGetFlatBufferLength(const JsVar *v) { return *(size_t*)v->varData.flatBuffer; }
+static inline char *jsvGetFlatBufferPointer(const JsVar *v) { return v->varData.flatBuffer + sizeof(size_t); }
+#endif
+
+/** Create an ArrayBuffer of byteLength bytes that uses the given String (or flat buffer) for its data */
+JsVar *jsvNewArrayBufferWithData(JsVar *data, size_t byteLength);
+/** If the data for this ArrayBuffer/view is held in one flat block of memory, return a pointer to
+ * the first byte of the view and set byteLength. Otherwise return 0. The pointer is only valid while
+ * arrayBuffer is locked */
+char *jsvGetArrayBufferPointer(JsVar *arrayBuffer, size_t *byteLength);
+
+/* Expand the given code once for each type of ArrayBuffer, with ELEMENT
+ * typedef'd to the C type of its elements. This gives a separate tight loop
+ * over raw data for each type, which the compiler can unroll and vectorise.
+ * It can be nested (with a different ELEMENT name) to get a loop per pair of types */
+#define JSV_ARRAYBUFFER_FOR_TYPE(TYPE, ELEMENT, ...) \
+  switch (TYPE) { \
+    case ARRAYBUFFERVIEW_INT8:    { typedef int8_t ELEMENT; __VA_ARGS__ } break; \
+    case ARRAYBUFFERVIEW_UINT16:  { typedef uint16_t ELEMENT; __VA_ARGS__ } break; \
+    case ARRAYBUFFERVIEW_INT16:   { typedef int16_t ELEMENT; __VA_ARGS__ } break; \
+    case ARRAYBUFFERVIEW_UINT32:  { typedef uint32_t ELEMENT; __VA_ARGS__ } break; \
+    case ARRAYBUFFERVIEW_INT32:   { typedef int32_t ELEMENT; __VA_ARGS__ } break; \
+    case ARRAYBUFFERVIEW_FLOAT32: { typedef float ELEMENT; __VA_ARGS__ } break; \
+    case ARRAYBUFFERVIEW_FLOAT64: { typedef double ELEMENT; __VA_ARGS__ } break; \
+    default:                      { typedef uint8_t ELEMENT; __VA_ARGS__ } break; \
+  }
+
+/** Get element idx of raw ArrayBuffer data of the given type (eg. from jsvGetArrayBufferPointer).
+ * memcpy is used so data doesn't have to be aligned - it compiles to a single load */
+static inline JsVarFloat jsvArrayBufferDataGetFloat(const char *data, JsVarDataArrayBufferViewType type, size_t idx) {
+  switch (type) {
+    case ARRAYBUFFERVIEW_INT8: return ((const int8_t*)data)[idx];
+    case ARRAYBUFFERVIEW_UINT16: { uint16_t v; memcpy(&v, &data[idx*2], 2); return v; }
+    case ARRAYBUFFERVIEW_INT16: { int16_t v; memcpy(&v, &data[idx*2], 2); return v; }
+    case ARRAYBUFFERVIEW_UINT32: { uint32_t v; memcpy(&v, &data[idx*4], 4); return v; }
+    case ARRAYBUFFERVIEW_INT32: { int32_t v; memcpy(&v, &data[idx*4], 4); return v; }
+    case ARRAYBUFFERVIEW_FLOAT32: { float v; memcpy(&v, &data[idx*4], 4); return v; }
+    case ARRAYBUFFERVIEW_FLOAT64: { double v; memcpy(&v, &data[idx*8], 8); return v; }
+    default: return ((const uint8_t*)data)[idx]; // UINT8, or a plain ArrayBuffer
+  }
+}
+
+/** Set element idx of raw ArrayBuffer data of the given type, converting
+ * the value the same way as jsvArrayBufferIteratorSetValue */
+static inline void jsvArrayBufferDataSetFloat(char *data, JsVarDataArrayBufferViewType type, size_t idx, JsVarFloat v) {
+  if (type==ARRAYBUFFERVIEW_FLOAT32) { float f = (float)v; memcpy(&data[idx*4], &f, 4); }
+  else if (type==ARRAYBUFFERVIEW_FLOAT64) memcpy(&data[idx*8], &v, 8);
+  else {
+    JsVarInt i = isfinite(v) ? (JsVarInt)v : 0;
+    switch (JSV_ARRAYBUFFER_GET_SIZE(type)) {
+      case 2: { int16_t c = (int16_t)i; memcpy(&data[idx*2], &c, 2); break; }
+      case 4: { int32_t c = (int32_t)i; memcpy(&data[idx*4], &c, 4); break; }
+      default: data[idx] = (char)i; break;
+    }
+  }
+}
+
 /** Get the item at the given location in the array buffer and return the result */
 size_t jsvGetArrayBufferLength(JsVar *arrayBuffer);
 /** Get the item at the given location in the array buffer and return the result */
@@ -500,13 +580,45 @@ void jsvStringIteratorGotoEnd(JsvStringIterator *it);
 
 /// Append a character TO THE END of a string iterator
 void jsvStringIteratorAppend(JsvStringIterator *it, char ch);
+/// Append len characters TO THE END of a string iterator, filling each block in one go
+void jsvStringIteratorAppendString(JsvStringIterator *it, const char *str, size_t len);
 
 static inline void jsvStringIteratorFree(JsvStringIterator *it) {
   jsvUnLock(it->var);
 }
 
+/// Move the string iterator on by 'count' characters (a block at a time)
+void jsvStringIteratorSkip(JsvStringIterator *it, size_t count);
+/// Append 'len' characters from 'src' TO THE END of a string iterator, moving 'src' on
+void jsvStringIteratorAppendFromIterator(JsvStringIterator *it, JsvStringIterator *src, size_t len);
+
+// --------------------------------------------------------------------------------------------
+#define JSV_STRING_SEARCH_BUFFER 64 ///< How much of the haystack we buffer when searching a string
+
+/** Searches a string for another (non-empty) one. The haystack is read a block at a time into
+ * a buffer, so matches that straddle StringExts are found without going back to the start of
+ * the string. Short needles are found with memchr, and longer ones with a Horspool skip table. */
+typedef struct {
+  JsVar *haystack, *needle; ///< both locked
+  JsvStringIterator it;     ///< where we've read the haystack up to
+  size_t needleLen;
+  size_t haystackLen;       ///< only worked out if the needle is longer than 'window'
+  size_t windowLen;         ///< How many characters of the needle are in 'window'
+  size_t bufStart;          ///< index in the haystack of buf[0]
+  size_t bufLen;
+  size_t pos;               ///< where to start the next search - this can be set to skip forwards
+  unsigned char skip[32];   ///< Horspool shifts, indexed by the bottom bits of each character
+  char window[JSV_STRING_SEARCH_BUFFER/2]; ///< the start of the needle
+  char buf[JSV_STRING_SEARCH_BUFFER];
+} JsvStringSearch;
+
+void jsvStringSearchNew(JsvStringSearch *s, JsVar *haystack, JsVar *needle, size_t startIdx);
+/// Return the index of the next place the needle is found (or -1), and set 'pos' to the character after it
+int jsvStringSearchNext(JsvStringSearch *s);
+void jsvStringSearchFree(JsvStringSearch *s);
+
 /// Special version of append designed for use with vcbprintf_callback (See jsvAppendPrintf)
-void jsvStringIteratorPrintfCallback(const char *str, void *user_data);
+void jsvStringIteratorPrintfCallback(const char *str, size_t len, void *user_data);
 
 // --------------------------------------------------------------------------------------------
 typedef struct JsvArrayIterator {
@@ -625,7 +737,10 @@ static inline void jsvObjectIteratorFree(JsvObjectIterator *it) {
 }
 // --------------------------------------------------------------------------------------------
 typedef struct JsvArrayBufferIterator {
-  JsvStringIterator it;
+  JsvStringIterator it; ///< for flat buffers, only it.var is used (to keep the buffer locked)
+#ifdef FLAT_ARRAYBUFFERS
+  char *flatData; ///< If nonzero, the data is in a flat buffer and this points to the start of it
+#endif
   JsVarDataArrayBufferViewType type;
   size_t byteLength;
   size_t byteOffset;
@@ -652,6 +767,7 @@ JsVarInt jsvArrayBufferIteratorGetIntegerValue(JsvArrayBufferIterator *it);
 JsVarFloat jsvArrayBufferIteratorGetFloatValue(JsvArrayBufferIterator *it);
 void   jsvArrayBufferIteratorSetValue(JsvArrayBufferIterator *it, JsVar *value);
 void   jsvArrayBufferIteratorSetIntegerValue(JsvArrayBufferIterator *it, JsVarInt value);
+void   jsvArrayBufferIteratorSetFloatValue(JsvArrayBufferIterator *it, JsVarFloat value);
 JsVar* jsvArrayBufferIteratorGetIndex(JsvArrayBufferIterator *it);
 bool   jsvArrayBufferIteratorHasElement(JsvArrayBufferIterator *it);
 void   jsvArrayBufferIteratorNext(JsvArrayBufferIterator *it);
@@ -337,16 +337,190 @@ void jswrap_array_forEach(JsVar *parent, JsVar *funcVar, JsVar *thisVar) {
 }*/
 
 
-NO_INLINE static bool _jswrap_array_sort_leq(JsVar *a, JsVar *b, JsVar *compareFn) {
-  if (compareFn) {
+/// Returns true if 'a' should be sorted before 'b'
+NO_INLINE static bool _jswrap_array_sort_lt(JsVar *a, JsVar *b, JsVar *compareFn) {
+  if (jsvIsUndefined(a) || jsvIsUndefined(b)) {
+    return !jsvIsUndefined(a); // undefined always goes at the end
+  } else if (compareFn) {
     JsVar *args[2] = {a,b};
     JsVarInt r = jsvGetIntegerAndUnLock(jspeFunctionCall(compareFn, 0, 0, false, 2, args));
     return r<0;
+  } else if (jsvIsIntegerish(a) && jsvIsIntegerish(b)) {
+    return jsvGetInteger(a) < jsvGetInteger(b);
+  } else if (jsvIsNumeric(a) && jsvIsNumeric(b)) {
+    return jsvGetFloat(a) < jsvGetFloat(b);
   } else {
-    return jsvGetBoolAndUnLock(jsvMathsOp(a,b,LEX_LEQUAL));
+    return jsvGetBoolAndUnLock(jsvMathsOp(a,b,'<'));
   }
 }
 
+static bool _jswrap_array_sort_lt_ref(JsVarRef a, JsVarRef b, JsVar *compareFn) {
+  JsVar *va = a ? jsvLock(a) : 0;
+  JsVar *vb = b ? jsvLock(b) : 0;
+  bool r = _jswrap_array_sort_lt(va, vb, compareFn);
+  jsvUnLock(va);
+  jsvUnLock(vb);
+  return r;
+}
+
+/** Stable merge sort of a table of refs to the values being sorted. 'tmp' must
+ * have space for n/2 refs. Runs that are already in order aren't merged, so
+ * sorted input only takes n comparisons */
+NO_INLINE static void _jswrap_array_sort_refs(JsVarRef *refs, JsVarRef *tmp, size_t n, JsVar *compareFn) {
+  size_t i, j, k;
+  if (jspIsInterrupted()) return;
+  if (n <= 8) {
+    // insertion sort is quicker for small runs
+    for (i=1;i<n;i++) {
+      JsVarRef v = refs[i];
+      for (j=i; j>0 && _jswrap_array_sort_lt_ref(v, refs[j-1], compareFn); j--)
+        refs[j] = refs[j-1];
+      refs[j] = v;
+    }
+    return;
+  }
+  size_t mid = n/2;
+  _jswrap_array_sort_refs(refs, tmp, mid, compareFn);
+  _jswrap_array_sort_refs(refs+mid, tmp, n-mid, compareFn);
+  if (jspIsInterrupted() || !_jswrap_array_sort_lt_ref(refs[mid], refs[mid-1], compareFn))
+    return; // both halves already in order
+  // merge, taking from the left half first when equal so the sort is stable
+  memcpy(tmp, refs, mid*sizeof(JsVarRef));
+  i=0; j=mid; k=0;
+  while (i<mid && j<n)
+    refs[k++] = _jswrap_array_sort_lt_ref(refs[j], tmp[i], compareFn) ? refs[j++] : tmp[i++];
+  while (i<mid)
+    refs[k++] = tmp[i++];
+}
+
+#define _JSWRAP_ARRAY_SORT_CMP(NAME, TYPE) static int NAME(const void *a, const void *b) { TYPE x = *(const TYPE*)a, y = *(const TYPE*)b; return (x>y) - (x<y); }
+_JSWRAP_ARRAY_SORT_CMP(_jswrap_array_sort_cmp_uint8, uint8_t)
+_JSWRAP_ARRAY_SORT_CMP(_jswrap_array_sort_cmp_int8, int8_t)
+_JSWRAP_ARRAY_SORT_CMP(_jswrap_array_sort_cmp_uint16, uint16_t)
+_JSWRAP_ARRAY_SORT_CMP(_jswrap_array_sort_cmp_int16, int16_t)
+_JSWRAP_ARRAY_SORT_CMP(_jswrap_array_sort_cmp_uint32, uint32_t)
+_JSWRAP_ARRAY_SORT_CMP(_jswrap_array_sort_cmp_int32, int32_t)
+// NaN (x!=x) goes at the end, so the comparison stays consistent
+#define _JSWRAP_ARRAY_SORT_CMP_FLOAT(NAME, TYPE) static int NAME(const void *a, const void *b) { TYPE x = *(const TYPE*)a, y = *(const TYPE*)b; if (x!=x || y!=y) return (x!=x) - (y!=y); return (x>y) - (x<y); }
+_JSWRAP_ARRAY_SORT_CMP_FLOAT(_jswrap_array_sort_cmp_float32, float)
+_JSWRAP_ARRAY_SORT_CMP_FLOAT(_jswrap_array_sort_cmp_float64, double)
+
+typedef int (*_jswrap_array_sort_cmp_fn)(const void *, const void *);
+
+/// Get the qsort compare function for raw data of the given type
+static _jswrap_array_sort_cmp_fn _jswrap_array_sort_cmp(JsVarDataArrayBufferViewType type) {
+  switch (type) {
+    case ARRAYBUFFERVIEW_INT8: return _jswrap_array_sort_cmp_int8;
+    case ARRAYBUFFERVIEW_UINT16: return _jswrap_array_sort_cmp_uint16;
+    case ARRAYBUFFERVIEW_INT16: return _jswrap_array_sort_cmp_int16;
+    case ARRAYBUFFERVIEW_UINT32: return _jswrap_array_sort_cmp_uint32;
+    case ARRAYBUFFERVIEW_INT32: return _jswrap_array_sort_cmp_int32;
+    case ARRAYBUFFERVIEW_FLOAT32: return _jswrap_array_sort_cmp_float32;
+    case ARRAYBUFFERVIEW_FLOAT64: return _jswrap_array_sort_cmp_float64;
+    default: return _jswrap_array_sort_cmp_uint8;
+  }
+}
+
+#ifdef FLAT_ARRAYBUFFERS
+/** Sort a typed array's data in place, if it's held in one flat block.
+ * Returns false if it wasn't and it needs sorting the slow way */
+static bool _jswrap_array_sort_flat(JsVar *array) {
+  size_t byteLength;
+  char *data = jsvGetArrayBufferPointer(array, &byteLength);
+  JsVarDataArrayBufferViewType type = array->varData.arraybuffer.type;
+  size_t size = JSV_ARRAYBUFFER_GET_SIZE(type);
+  if (!data || ((size_t)data & (size-1))) return false; // not flat, or not aligned
+  qsort(data, byteLength/size, size, _jswrap_array_sort_cmp(type));
+  return true;
+}
+#endif
+
+/// Returns true if raw typed array element 'a' should be sorted before 'b'
+static bool _jswrap_array_sort_lt_elem(const char *a, const char *b, JsVarDataArrayBufferViewType type, JsVar *compareFn) {
+  JsVarFloat fa = jsvArrayBufferDataGetFloat(a, type, 0);
+  JsVarFloat fb = jsvArrayBufferDataGetFloat(b, type, 0);
+  JsVar *va, *vb;
+  if (JSV_ARRAYBUFFER_IS_FLOAT(type)) {
+    va = jsvNewFromFloat(fa);
+    vb = jsvNewFromFloat(fb);
+  } else {
+    va = jsvNewFromInteger((JsVarInt)fa);
+    vb = jsvNewFromInteger((JsVarInt)fb);
+  }
+  bool r = _jswrap_array_sort_lt(va, vb, compareFn);
+  jsvUnLock(va);
+  jsvUnLock(vb);
+  return r;
+}
+
+/** Stable merge sort of n raw typed array elements, the same as
+ * _jswrap_array_sort_refs. 'tmp' must have space for n/2 elements */
+NO_INLINE static void _jswrap_array_sort_elems(char *data, char *tmp, size_t n, JsVarDataArrayBufferViewType type, JsVar *compareFn) {
+  size_t size = JSV_ARRAYBUFFER_GET_SIZE(type);
+  size_t i, j, k;
+  if (jspIsInterrupted()) return;
+  if (n <= 8) {
+    char v[8];
+    for (i=1;i<n;i++) {
+      memcpy(v, &data[i*size], size);
+      for (j=i; j>0 && _jswrap_array_sort_lt_elem(v, &data[(j-1)*size], type, compareFn); j--)
+        memcpy(&data[j*size], &data[(j-1)*size], size);
+      memcpy(&data[j*size], v, size);
+    }
+    return;
+  }
+  size_t mid = n/2;
+  _jswrap_array_sort_elems(data, tmp, mid, type, compareFn);
+  _jswrap_array_sort_elems(&data[mid*size], tmp, n-mid, type, compareFn);
+  if (jspIsInterrupted() || !_jswrap_array_sort_lt_elem(&data[mid*size], &data[(mid-1)*size], type, compareFn))
+    return; // both halves already in order
+  memcpy(tmp, data, mid*size);
+  i=0; j=mid; k=0;
+  while (i<mid && j<n) {
+    if (_jswrap_array_sort_lt_elem(&data[j*size], &tmp[i*size], type, compareFn))
+      memcpy(&data[(k++)*size], &data[(j++)*size], size);
+    else
+      memcpy(&data[(k++)*size], &tmp[(i++)*size], size);
+  }
+  memcpy(&data[k*size], &tmp[i*size], (mid-i)*size);
+}
+
+/** Sort a typed array by copying its raw elements into a table on the stack.
+ * Unlike Arrays, every element would need a new var to go in a table of refs,
+ * and a big typed array can easily have more elements than there are free vars */
+static void _jswrap_array_sort_typed(JsVar *array, size_t n, JsVar *compareFn) {
+  JsVarDataArrayBufferViewType type = array->varData.arraybuffer.type;
+  size_t size = JSV_ARRAYBUFFER_GET_SIZE(type);
+  size_t tableSize = (n + (compareFn ? n/2 : 0)) * size;
+  if (jsuGetFreeStack() < 256+tableSize) {
+    jsError("Not enough free stack to sort %d elements", (int)n);
+    return;
+  }
+  char *data = (char*)alloca(tableSize);
+  JsvArrayBufferIterator it;
+  size_t i;
+  jsvArrayBufferIteratorNew(&it, array, 0);
+  for (i=0;i<n;i++) {
+    jsvArrayBufferDataSetFloat(data, type, i, jsvArrayBufferIteratorGetFloatValue(&it));
+    jsvArrayBufferIteratorNext(&it);
+  }
+  jsvArrayBufferIteratorFree(&it);
+
+  if (compareFn)
+    _jswrap_array_sort_elems(data, &data[n*size], n, type, compareFn);
+  else
+    qsort(data, n, size, _jswrap_array_sort_cmp(type));
+
+  jsvArrayBufferIteratorNew(&it, array, 0);
+  for (i=0;i<n;i++) {
+    jsvArrayBufferIteratorSetFloatValue(&it, jsvArrayBufferDataGetFloat(data, type, i));
+    jsvArrayBufferIteratorNext(&it);
+  }
+  jsvArrayBufferIteratorFree(&it);
+}
+
+/* In-place quicksort through iterators - only used if there isn't
+ * enough free stack for a table of refs */
 NO_INLINE static void _jswrap_array_sort(JsvIterator *head, int n, JsVar *compareFn) {
   if (n < 2) return; // sort done!
 
@@ -363,7 +537,7 @@ NO_INLINE static void _jswrap_array_sort(JsvIterator *head, int n, JsVar *compar
   /* Partition and count sizes. */
   while (--n && !jspIsInterrupted()) {
     JsVar *itValue = jsvIteratorGetValue(&it);
-    if (_jswrap_array_sort_leq(itValue, pivotValue, compareFn)) {
+    if (!_jswrap_array_sort_lt(pivotValue, itValue, compareFn)) {
       nlo++;
       /* 'it' <= 'pivot', so we need to move it behind.
          In this diagram, P=pivot, L=it
@@ -405,7 +579,7 @@ NO_INLINE static void _jswrap_array_sort(JsvIterator *head, int n, JsVar *compar
 }
 
 /*JSON{ "type":"method", "class": "Array", "name" : "sort", "ifndef" : "SAVE_ON_FLASH",
-         "description" : "Do an in-place quicksort of the array",
+         "description" : "Do an in-place sort of the array. The sort is stable (elements that compare equal stay in the same order)",
          "generate" : "jswrap_array_sort",
          "params" : [ [ "var", "JsVar", "A function to use to compare array elements (or undefined)"] ],
          "return" : [ "JsVar", "This array object" ]
@@ -438,8 +612,50 @@ JsVar *jswrap_array_sort (JsVar *array, JsVar *compareFn) {
     n = (int)jsvGetLength(array);
   }
 
+  if (jsvIsUndefined(compareFn)) compareFn = 0;
+  if (n < 2) return jsvLockAgain(array);
+  if (jsvIsArrayBuffer(array)) {
+#ifdef FLAT_ARRAYBUFFERS
+    if (!compareFn && _jswrap_array_sort_flat(array))
+      return jsvLockAgain(array);
+#endif
+    _jswrap_array_sort_typed(array, (size_t)n, compareFn);
+    return jsvLockAgain(array);
+  }
+
+  size_t tableSize = ((size_t)n + (size_t)n/2) * sizeof(JsVarRef);
+  if (jsuGetFreeStack() < 256+tableSize) {
+    jsvIteratorNew(&it, array);
+    _jswrap_array_sort(&it, n, compareFn);
+    jsvIteratorFree(&it);
+    return jsvLockAgain(array);
+  }
+
+  /* Gather refs to all the values into a table, sort that, then write the
+   * values back in one pass. The values are still referenced by the array
+   * while we sort, but we add a reference so they can't be freed if the
+   * compare function modifies it */
+  JsVarRef *refs = (JsVarRef*)alloca(tableSize);
+  int i;
+  jsvIteratorNew(&it, array);
+  for (i=0;i<n;i++) {
+    JsVar *v = jsvIteratorGetValue(&it);
+    refs[i] = v ? jsvGetRef(jsvRef(v)) : 0;
+    jsvUnLock(v);
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+
+  _jswrap_array_sort_refs(refs, refs+n, (size_t)n, compareFn);
+
   jsvIteratorNew(&it, array);
-  _jswrap_array_sort(&it, n, compareFn);
+  for (i=0;i<n;i++) {
+    JsVar *v = refs[i] ? jsvLock(refs[i]) : 0;
+    jsvIteratorSetValue(&it, v);
+    if (v) jsvUnRef(v);
+    jsvUnLock(v);
+    jsvIteratorNext(&it);
+  }
   jsvIteratorFree(&it);
   return jsvLockAgain(array);
 }
@@ -95,7 +95,7 @@
 
 }*/
 JsVar *jswrap_arraybuffer_constructor(JsVarInt byteLength) {
-  if (byteLength <= 0 || byteLength>65535) {
+  if (byteLength <= 0) {
     jsError("Invalid length for ArrayBuffer\n");
     return 0;
   }
@@ -103,18 +103,14 @@ JsVar *jswrap_arraybuffer_constructor(JsVarInt byteLength) {
     jsError("ArrayBuffer too long\n");
     return 0;
   }
+#ifdef FLAT_ARRAYBUFFERS
+  JsVar *arrData = jsvNewFlatBuffer((size_t)byteLength);
+#else
   JsVar *arrData = jsvNewStringOfLength((unsigned int)byteLength);
+#endif
   if (!arrData) return 0;
-  JsVar *arr = jsvNewWithFlags(JSV_ARRAYBUFFER);
-  if (!arr) {
-    jsvUnLock(arrData);
-    return 0;
-  }
-  arr->firstChild = jsvGetRef(jsvRef(arrData));
+  JsVar *arr = jsvNewArrayBufferWithData(arrData, (size_t)byteLength);
   jsvUnLock(arrData);
-  arr->varData.arraybuffer.type = ARRAYBUFFERVIEW_ARRAYBUFFER;
-  arr->varData.arraybuffer.byteOffset = 0;
-  arr->varData.arraybuffer.length = (unsigned short)byteLength;
   return arr;
 }
 
@@ -216,8 +212,8 @@ JsVar *jswrap_typedarray_constructor(JsVarDataArrayBufferViewType type, JsVar *a
   JsVar *typedArr = jsvNewWithFlags(JSV_ARRAYBUFFER);
   if (typedArr) {
     typedArr->varData.arraybuffer.type = type;
-    typedArr->varData.arraybuffer.byteOffset = (unsigned short)byteOffset;
-    typedArr->varData.arraybuffer.length = (unsigned short)length;
+    typedArr->varData.arraybuffer.byteOffset = (unsigned int)(byteOffset & JSV_ARRAYBUFFER_MAX_LENGTH);
+    typedArr->varData.arraybuffer.length = (unsigned int)(length & JSV_ARRAYBUFFER_MAX_LENGTH);
     typedArr->firstChild = jsvGetRef(jsvRef(arrayBuffer));
 
     if (jsvIsArray(arr)) {
@@ -264,9 +260,31 @@ JsVar *jswrap_typedarray_constructor(JsVarDataArrayBufferViewType type, JsVar *a
          "params" : [ [ "index", "float", "Floating point index to access" ] ],
          "return" : [ "float", "The result of interpolating between (int)index and (int)(index+1)" ]
 }*/
+/** If the view's data is in one flat block, return a pointer to it and set
+ * length (in elements) - see jswrap_arraybufferview_getFlatFloat */
+static const char *jswrap_arraybufferview_getFlatData(JsVar *parent, size_t *length) {
+  size_t byteLength;
+  const char *data = jsvGetArrayBufferPointer(parent, &byteLength);
+  if (data) *length = byteLength / JSV_ARRAYBUFFER_GET_SIZE(parent->varData.arraybuffer.type);
+  return data;
+}
+
+/// Get an element of flat data as a float - or 0 if it's out of range (as the iterator does)
+static JsVarFloat jswrap_arraybufferview_getFlatFloat(JsVar *parent, const char *data, size_t length, size_t idx) {
+  if (idx >= length) return 0;
+  return jsvArrayBufferDataGetFloat(data, parent->varData.arraybuffer.type, idx);
+}
+
 JsVarFloat jswrap_arraybufferview_interpolate(JsVar *parent, JsVarFloat findex) {
   size_t idx = (size_t)findex;
   JsVarFloat a = findex - (int)idx;
+  size_t length;
+  const char *data = jswrap_arraybufferview_getFlatData(parent, &length);
+  if (data) {
+    JsVarFloat fa = jswrap_arraybufferview_getFlatFloat(parent, data, length, idx);
+    JsVarFloat fb = jswrap_arraybufferview_getFlatFloat(parent, data, length, idx+1);
+    return fa*(1-a) + fb*a;
+  }
   JsvArrayBufferIterator it;
   jsvArrayBufferIteratorNew(&it, parent, idx);
   JsVarFloat fa = jsvArrayBufferIteratorGetFloatValue(&it);
@@ -292,6 +310,17 @@ JsVarFloat jswrap_arraybufferview_interpolate2d(JsVar *parent, JsVarInt width, J
   size_t idx = (size_t)findex;
   JsVarFloat ax = findex-(int)idx;
 
+  size_t length;
+  const char *data = jswrap_arraybufferview_getFlatData(parent, &length);
+  if (data) {
+    size_t idx2 = idx + (size_t)width;
+    JsVarFloat ya = jswrap_arraybufferview_getFlatFloat(parent, data, length, idx)*(1-ax) +
+                    jswrap_arraybufferview_getFlatFloat(parent, data, length, idx+1)*ax;
+    JsVarFloat yb = jswrap_arraybufferview_getFlatFloat(parent, data, length, idx2)*(1-ax) +
+                    jswrap_arraybufferview_getFlatFloat(parent, data, length, idx2+1)*ax;
+    return ya*(1-ay) + yb*ay;
+  }
+
   JsvArrayBufferIterator it;
   jsvArrayBufferIteratorNew(&it, parent, idx);
 
@@ -319,17 +348,77 @@ JsVarFloat jswrap_arraybufferview_interpolate2d(JsVar *parent, JsVarInt width, J
          "generate" : "jswrap_arraybufferview_set",
          "params" : [ [ "arr", "JsVar", "Floating point index to access" ], ["offset","int32","The offset in this array at which to write the values (optional)"] ]
 }*/
+#ifdef FLAT_ARRAYBUFFERS
+/** If dst and src both have flat data, copy src into dst starting at element
+ * 'offset' and return true. Matching types are copied with memmove, and
+ * everything else with one loop for each pair of types */
+static bool jswrap_arraybufferview_setFlat(JsVar *dst, JsVar *src, size_t offset) {
+  size_t dstBytes, srcBytes;
+  char *dstData = jsvGetArrayBufferPointer(dst, &dstBytes);
+  const char *srcData = jsvGetArrayBufferPointer(src, &srcBytes);
+  if (!dstData || !srcData) return false;
+  JsVarDataArrayBufferViewType dstType = dst->varData.arraybuffer.type;
+  JsVarDataArrayBufferViewType srcType = src->varData.arraybuffer.type;
+  size_t dstSize = JSV_ARRAYBUFFER_GET_SIZE(dstType);
+  size_t srcSize = JSV_ARRAYBUFFER_GET_SIZE(srcType);
+  size_t i, n = srcBytes / srcSize;
+  if (offset >= dstBytes / dstSize) return true; // nothing to copy
+  if (n > dstBytes / dstSize - offset) n = dstBytes / dstSize - offset;
+  dstData += offset*dstSize;
+
+  // integers of the same size (eg. Uint8 and Int8) have the same bits once truncated
+  if (dstSize==srcSize &&
+      (dstType==srcType || (!JSV_ARRAYBUFFER_IS_FLOAT(dstType) && !JSV_ARRAYBUFFER_IS_FLOAT(srcType)))) {
+    memmove(dstData, srcData, n*dstSize);
+    return true;
+  }
+  // If the two overlap, converting in place would overwrite data we haven't read yet
+  if (srcData < dstData+n*dstSize && dstData < srcData+n*srcSize) {
+    if (jsuGetFreeStack() < 100+n*srcSize) return false;
+    char *copy = (char*)alloca(n*srcSize);
+    memcpy(copy, srcData, n*srcSize);
+    srcData = copy;
+  }
+  if ((((size_t)dstData) & (dstSize-1)) || (((size_t)srcData) & (srcSize-1))) {
+    // unaligned - go through memcpy
+    for (i=0;i<n;i++)
+      jsvArrayBufferDataSetFloat(dstData, dstType, i, jsvArrayBufferDataGetFloat(srcData, srcType, i));
+    return true;
+  }
+  JSV_ARRAYBUFFER_FOR_TYPE(dstType, DST,
+    JSV_ARRAYBUFFER_FOR_TYPE(srcType, SRC,
+      DST *d = (DST*)dstData;
+      const SRC *s = (const SRC*)srcData;
+      if (JSV_ARRAYBUFFER_IS_FLOAT(srcType) && !JSV_ARRAYBUFFER_IS_FLOAT(dstType)) {
+        for (i=0;i<n;i++) {
+          JsVarFloat v = (JsVarFloat)s[i];
+          d[i] = (DST)(isfinite(v) ? (JsVarInt)v : 0);
+        }
+      } else {
+        for (i=0;i<n;i++) d[i] = (DST)s[i];
+      }
+    )
+  )
+  return true;
+}
+#endif
+
 void jswrap_arraybufferview_set(JsVar *parent, JsVar *arr, int offset) {
   if (!(jsvIsString(arr) || jsvIsArray(arr) || jsvIsArrayBuffer(arr))) {
     jsError("Expecting first argument to be an array, not %t", arr);
     return;
   }
+#ifdef FLAT_ARRAYBUFFERS
+  if (jsvIsArrayBuffer(arr) && offset>=0 &&
+      jswrap_arraybufferview_setFlat(parent, arr, (size_t)offset))
+    return;
+#endif
   JsvIterator itsrc;
   jsvIteratorNew(&itsrc, arr);
   JsvArrayBufferIterator itdst;
   jsvArrayBufferIteratorNew(&itdst, parent, (size_t)offset);
 
-  bool useInts = JSV_ARRAYBUFFER_IS_FLOAT(itdst.type) || jsvIsString(arr);
+  bool useInts = !JSV_ARRAYBUFFER_IS_FLOAT(itdst.type) || jsvIsString(arr);
 
   while (jsvIteratorHasElement(&itsrc) && jsvArrayBufferIteratorHasElement(&itdst)) {
     if (useInts) {
@@ -346,8 +435,108 @@ void jswrap_arraybufferview_set(JsVar *parent, JsVar *arr, int offset) {
   jsvIteratorFree(&itsrc);
 }
 
+/// Work out an index for fill/subarray/slice - negative values count back from the end, and undefined gives defaultIndex
+static size_t jswrap_arraybufferview_getIndex(JsVar *index, size_t length, size_t defaultIndex) {
+  if (jsvIsUndefined(index)) return defaultIndex;
+  JsVarInt i = jsvGetInteger(index);
+  if (i<0) i += (JsVarInt)length;
+  if (i<0) return 0;
+  if ((size_t)i > length) return length;
+  return (size_t)i;
+}
+
+/*JSON{ "type":"method", "class": "ArrayBufferView", "name" : "fill",
+         "description" : "Fill this array with the given value, from start up to (but not including) end. Negative indices count back from the end of the array",
+         "generate" : "jswrap_arraybufferview_fill",
+         "params" : [ [ "value", "JsVar", "The value to fill with" ],
+                      [ "start", "JsVar", "The index to start filling at (optional - default is 0)" ],
+                      [ "end", "JsVar", "The index to stop filling at (optional - default is the length of the array)" ] ],
+         "return" : [ "JsVar", "This array" ]
+}*/
+JsVar *jswrap_arraybufferview_fill(JsVar *parent, JsVar *value, JsVar *start, JsVar *end) {
+  size_t length = jsvGetArrayBufferLength(parent);
+  size_t from = jswrap_arraybufferview_getIndex(start, length, 0);
+  size_t to = jswrap_arraybufferview_getIndex(end, length, length);
+  if (from >= to) return jsvLockAgain(parent);
+
+#ifdef FLAT_ARRAYBUFFERS
+  size_t byteLength;
+  char *data = jsvGetArrayBufferPointer(parent, &byteLength);
+  if (data) {
+    JsVarDataArrayBufferViewType type = parent->varData.arraybuffer.type;
+    size_t size = JSV_ARRAYBUFFER_GET_SIZE(type);
+    size_t filled = size, bytes = (to-from)*size;
+    data += from*size;
+    jsvArrayBufferDataSetFloat(data, type, 0, jsvGetFloat(value));
+    // copy what we have filled so far onto the end, doubling it each time
+    while (filled < bytes) {
+      size_t n = (filled < bytes-filled) ? filled : bytes-filled;
+      memcpy(data+filled, data, n);
+      filled += n;
+    }
+    return jsvLockAgain(parent);
+  }
+#endif
+
+  JsvArrayBufferIterator it;
+  jsvArrayBufferIteratorNew(&it, parent, from);
+  while (from<to && jsvArrayBufferIteratorHasElement(&it)) {
+    jsvArrayBufferIteratorSetValue(&it, value);
+    jsvArrayBufferIteratorNext(&it);
+    from++;
+  }
+  jsvArrayBufferIteratorFree(&it);
+  return jsvLockAgain(parent);
+}
+
+/*JSON{ "type":"method", "class": "ArrayBufferView", "name" : "subarray",
+         "description" : "Return a new view of the same type onto the same data, from begin up to (but not including) end. Nothing is copied, so writing to one will change the other. Negative indices count back from the end of the array",
+         "generate" : "jswrap_arraybufferview_subarray",
+         "params" : [ [ "begin", "JsVar", "The first element of the new view (optional - default is 0)" ],
+                      [ "end", "JsVar", "The element to end the new view at (optional - default is the length of the array)" ] ],
+         "return" : [ "JsVar", "A new typed array" ]
+}*/
+JsVar *jswrap_arraybufferview_subarray(JsVar *parent, JsVar *begin, JsVar *end) {
+  size_t length = jsvGetArrayBufferLength(parent);
+  size_t from = jswrap_arraybufferview_getIndex(begin, length, 0);
+  size_t to = jswrap_arraybufferview_getIndex(end, length, length);
+  if (to < from) to = from;
+
+  JsVar *view = jsvNewWithFlags(JSV_ARRAYBUFFER);
+  if (!view) return 0; // out of memory
+  JsVarDataArrayBufferViewType type = parent->varData.arraybuffer.type;
+  size_t byteOffset = parent->varData.arraybuffer.byteOffset + from*JSV_ARRAYBUFFER_GET_SIZE(type);
+  view->varData.arraybuffer.type = type;
+  view->varData.arraybuffer.byteOffset = (unsigned int)(byteOffset & JSV_ARRAYBUFFER_MAX_LENGTH);
+  view->varData.arraybuffer.length = (unsigned int)((to-from) & JSV_ARRAYBUFFER_MAX_LENGTH);
+  // point at the same ArrayBuffer as parent, as iterators only use the outermost view's offset
+  view->firstChild = jsvRefRef(parent->firstChild);
+  return view;
+}
+
+/*JSON{ "type":"method", "class": "ArrayBufferView", "name" : "slice",
+         "description" : "Return a new typed array of the same type containing a copy of the elements from begin up to (but not including) end. Negative indices count back from the end of the array",
+         "generate" : "jswrap_arraybufferview_slice",
+         "params" : [ [ "begin", "JsVar", "The first element to copy (optional - default is 0)" ],
+                      [ "end", "JsVar", "The element to stop copying at (optional - default is the length of the array)" ] ],
+         "return" : [ "JsVar", "A new typed array" ]
+}*/
+JsVar *jswrap_arraybufferview_slice(JsVar *parent, JsVar *begin, JsVar *end) {
+  JsVar *sub = jswrap_arraybufferview_subarray(parent, begin, end);
+  if (!sub) return 0;
+  size_t length = jsvGetArrayBufferLength(sub);
+  if (!length) return sub; // ArrayBuffers can't be empty - but an empty view shares nothing anyway
+
+  JsVar *lengthVar = jsvNewFromInteger((JsVarInt)length);
+  JsVar *result = jswrap_typedarray_constructor(parent->varData.arraybuffer.type, lengthVar, 0, 0);
+  jsvUnLock(lengthVar);
+  if (result) jswrap_arraybufferview_set(result, sub, 0);
+  jsvUnLock(sub);
+  return result;
+}
+
 /*JSON{ "type":"method", "class": "ArrayBufferView", "name" : "sort", "ifndef" : "SAVE_ON_FLASH",
-         "description" : "Do an in-place quicksort of the array",
+         "description" : "Do an in-place sort of the array. Without a compare function, the data is sorted directly (rather than being converted to and from JavaScript numbers)",
          "generate" : "jswrap_array_sort",
          "params" : [ [ "var", "JsVar", "A function to use to compare array elements (or undefined)"] ],
          "return" : [ "JsVar", "This array object" ]
@@ -18,3 +18,6 @@ JsVar *jswrap_typedarray_constructor(JsVarDataArrayBufferViewType type, JsVar *a
 JsVarFloat jswrap_arraybufferview_interpolate(JsVar *parent, JsVarFloat index);
 JsVarFloat jswrap_arraybufferview_interpolate2d(JsVar *parent, JsVarInt width, JsVarFloat x, JsVarFloat y);
 void jswrap_arraybufferview_set(JsVar *parent, JsVar *arr, int offset);
+JsVar *jswrap_arraybufferview_fill(JsVar *parent, JsVar *value, JsVar *start, JsVar *end);
+JsVar *jswrap_arraybufferview_subarray(JsVar *parent, JsVar *begin, JsVar *end);
+JsVar *jswrap_arraybufferview_slice(JsVar *parent, JsVar *begin, JsVar *end);
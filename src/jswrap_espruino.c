@@ -53,6 +53,68 @@ JsVarFloat jswrap_espruino_clip(JsVarFloat x, JsVarFloat min, JsVarFloat max) {
 }
 
 
+/** If arr is an ArrayBuffer or typed array whose data is in one flat block of
+ * memory (and aligned for its element size), return a pointer to the data and
+ * set length (in elements) and type. Otherwise return 0, and an iterator must be used */
+static char *jswrap_espruino_getTypedData(JsVar *arr, size_t *length, JsVarDataArrayBufferViewType *type) {
+  if (!jsvIsArrayBuffer(arr)) return 0;
+  size_t byteLength;
+  char *data = jsvGetArrayBufferPointer(arr, &byteLength);
+  if (!data) return 0;
+  *type = arr->varData.arraybuffer.type;
+  size_t size = JSV_ARRAYBUFFER_GET_SIZE(*type);
+  if (((size_t)data) & (size-1)) return 0; // unaligned
+  *length = byteLength / size;
+  return data;
+}
+
+/// Read up to len values from arr into buf, and return how many were read
+static size_t jswrap_espruino_readFloats(JsVar *arr, JsVarFloat *buf, size_t len) {
+  size_t i, n;
+  JsVarDataArrayBufferViewType type;
+  const char *data = jswrap_espruino_getTypedData(arr, &n, &type);
+  if (data) {
+    if (n > len) n = len;
+    JSV_ARRAYBUFFER_FOR_TYPE(type, ELEMENT,
+      const ELEMENT *p = (const ELEMENT*)data;
+      for (i=0;i<n;i++) buf[i] = (JsVarFloat)p[i];
+    )
+    return n;
+  }
+
+  JsvIterator it;
+  jsvIteratorNew(&it, arr);
+  i = 0;
+  while (i<len && jsvIteratorHasElement(&it)) {
+    buf[i++] = jsvIteratorGetFloatValue(&it);
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  return i;
+}
+
+/// Write up to len values from buf into arr
+static void jswrap_espruino_writeFloats(JsVar *arr, const JsVarFloat *buf, size_t len) {
+  size_t i, n;
+  JsVarDataArrayBufferViewType type;
+  char *data = jswrap_espruino_getTypedData(arr, &n, &type);
+  if (data) {
+    if (n > len) n = len;
+    for (i=0;i<n;i++)
+      jsvArrayBufferDataSetFloat(data, type, i, buf[i]);
+    return;
+  }
+
+  JsvIterator it;
+  jsvIteratorNew(&it, arr);
+  i = 0;
+  while (i<len && jsvIteratorHasElement(&it)) {
+    jsvUnLock(jsvIteratorSetValue(&it, jsvNewFromFloat(buf[i++])));
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+}
+
 /*JSON{ "type":"staticmethod", "ifndef" : "SAVE_ON_FLASH",
          "class" : "E", "name" : "sum",
          "generate" : "jswrap_espruino_sum",
@@ -67,6 +129,17 @@ JsVarFloat jswrap_espruino_sum(JsVar *arr) {
   }
   JsVarFloat sum = 0;
 
+  size_t i, length;
+  JsVarDataArrayBufferViewType type;
+  const char *data = jswrap_espruino_getTypedData(arr, &length, &type);
+  if (data) {
+    JSV_ARRAYBUFFER_FOR_TYPE(type, ELEMENT,
+      const ELEMENT *p = (const ELEMENT*)data;
+      for (i=0;i<length;i++) sum += (JsVarFloat)p[i];
+    )
+    return sum;
+  }
+
   JsvIterator itsrc;
   jsvIteratorNew(&itsrc, arr);
   while (jsvIteratorHasElement(&itsrc)) {
@@ -91,6 +164,20 @@ JsVarFloat jswrap_espruino_variance(JsVar *arr, JsVarFloat mean) {
   }
   JsVarFloat variance = 0;
 
+  size_t i, length;
+  JsVarDataArrayBufferViewType type;
+  const char *data = jswrap_espruino_getTypedData(arr, &length, &type);
+  if (data) {
+    JSV_ARRAYBUFFER_FOR_TYPE(type, ELEMENT,
+      const ELEMENT *p = (const ELEMENT*)data;
+      for (i=0;i<length;i++) {
+        JsVarFloat val = (JsVarFloat)p[i] - mean;
+        variance += val*val;
+      }
+    )
+    return variance;
+  }
+
   JsvIterator itsrc;
   jsvIteratorNew(&itsrc, arr);
   while (jsvIteratorHasElement(&itsrc)) {
@@ -120,15 +207,33 @@ JsVarFloat jswrap_espruino_convolve(JsVar *arr1, JsVar *arr2, int offset) {
   }
   JsVarFloat conv = 0;
 
+  int l = (int)jsvGetLength(arr2);
+  if (l<=0) return conv;
+  offset = offset % l;
+  if (offset<0) offset += l;
+
+  size_t i, j, length1, length2;
+  JsVarDataArrayBufferViewType type1, type2;
+  const char *data1 = jswrap_espruino_getTypedData(arr1, &length1, &type1);
+  const char *data2 = jswrap_espruino_getTypedData(arr2, &length2, &type2);
+  if (data1 && data2) {
+    j = (size_t)offset;
+    JSV_ARRAYBUFFER_FOR_TYPE(type1, ELEMENT,
+      const ELEMENT *p = (const ELEMENT*)data1;
+      for (i=0;i<length1;i++) {
+        conv += (JsVarFloat)p[i] * jsvArrayBufferDataGetFloat(data2, type2, j);
+        if (++j >= length2) j = 0;
+      }
+    )
+    return conv;
+  }
+
   JsvIterator it1;
   jsvIteratorNew(&it1, arr1);
   JsvIterator it2;
   jsvIteratorNew(&it2, arr2);
 
   // get iterator2 at the correct offset
-  int l = (int)jsvGetLength(arr2);
-  offset = offset % l;
-  if (offset<0) offset += l;
   while (offset-->0)
     jsvIteratorNext(&it2);
 
@@ -148,6 +253,221 @@ JsVarFloat jswrap_espruino_convolve(JsVar *arr1, JsVar *arr2, int offset) {
   return conv;
 }
 
+/*JSON{ "type":"staticmethod", "ifndef" : "SAVE_ON_FLASH",
+         "class" : "E", "name" : "scale",
+         "generate" : "jswrap_espruino_scale",
+         "description" : "Multiply every element of the given Array or ArrayBuffer by scale and then add offset, in place. This is equivalent to `for (i in arr) arr[i] = arr[i]*scale + offset`",
+         "params" : [ [ "arr", "JsVar", "The array to modify"],
+                      [ "scale", "float", "The value to multiply each element by"],
+                      [ "offset", "float", "The value to add to each element after multiplying" ] ]
+}*/
+void jswrap_espruino_scale(JsVar *arr, JsVarFloat scale, JsVarFloat offset) {
+  if (!(jsvIsArray(arr) || jsvIsArrayBuffer(arr))) {
+    jsError("Expecting first argument to be an Array or ArrayBuffer, not %t", arr);
+    return;
+  }
+
+  size_t i, length;
+  JsVarDataArrayBufferViewType type;
+  char *data = jswrap_espruino_getTypedData(arr, &length, &type);
+  if (data) {
+    JSV_ARRAYBUFFER_FOR_TYPE(type, ELEMENT,
+      ELEMENT *p = (ELEMENT*)data;
+      if (JSV_ARRAYBUFFER_IS_FLOAT(type)) {
+        for (i=0;i<length;i++) p[i] = (ELEMENT)((JsVarFloat)p[i]*scale + offset);
+      } else {
+        for (i=0;i<length;i++) {
+          JsVarFloat v = (JsVarFloat)p[i]*scale + offset;
+          p[i] = (ELEMENT)(isfinite(v) ? (JsVarInt)v : 0);
+        }
+      }
+    )
+    return;
+  }
+
+  // read and write with separate iterators, as ArrayBuffer iterators can't write an element they've read
+  JsvIterator itsrc, itdst;
+  jsvIteratorNew(&itsrc, arr);
+  jsvIteratorNew(&itdst, arr);
+  while (jsvIteratorHasElement(&itsrc)) {
+    JsVarFloat v = jsvIteratorGetFloatValue(&itsrc)*scale + offset;
+    jsvUnLock(jsvIteratorSetValue(&itdst, jsvNewFromFloat(v)));
+    jsvIteratorNext(&itsrc);
+    jsvIteratorNext(&itdst);
+  }
+  jsvIteratorFree(&itsrc);
+  jsvIteratorFree(&itdst);
+}
+
+/*JSON{ "type":"staticmethod", "ifndef" : "SAVE_ON_FLASH",
+         "class" : "E", "name" : "minMax",
+         "generate" : "jswrap_espruino_minMax",
+         "description" : "Find the smallest and largest values in the given Array, String or ArrayBuffer in a single pass",
+         "params" : [ [ "arr", "JsVar", "The array to search"] ],
+         "return" : ["JsVar", "An object of the form `{min:..., max:...}`, or undefined if the array is empty"]
+}*/
+JsVar *jswrap_espruino_minMax(JsVar *arr) {
+  if (!(jsvIsIterable(arr))) {
+    jsError("Expecting first argument to be iterable, not %t", arr);
+    return 0;
+  }
+  JsVarFloat min = 0, max = 0;
+  bool found = false;
+
+  size_t i, length;
+  JsVarDataArrayBufferViewType type;
+  const char *data = jswrap_espruino_getTypedData(arr, &length, &type);
+  if (data) {
+    if (length) {
+      found = true;
+      JSV_ARRAYBUFFER_FOR_TYPE(type, ELEMENT,
+        const ELEMENT *p = (const ELEMENT*)data;
+        ELEMENT mn = p[0], mx = p[0];
+        for (i=1;i<length;i++) {
+          mn = (p[i]<mn) ? p[i] : mn;
+          mx = (p[i]>mx) ? p[i] : mx;
+        }
+        min = (JsVarFloat)mn;
+        max = (JsVarFloat)mx;
+      )
+    }
+  } else {
+    JsvIterator itsrc;
+    jsvIteratorNew(&itsrc, arr);
+    while (jsvIteratorHasElement(&itsrc)) {
+      JsVarFloat v = jsvIteratorGetFloatValue(&itsrc);
+      if (!found || v<min) min = v;
+      if (!found || v>max) max = v;
+      found = true;
+      jsvIteratorNext(&itsrc);
+    }
+    jsvIteratorFree(&itsrc);
+  }
+
+  if (!found) return 0;
+  JsVar *result = jsvNewWithFlags(JSV_OBJECT);
+  if (!result) return 0; // out of memory
+  jsvUnLock(jsvObjectSetChild(result, "min", jsvNewFromFloat(min)));
+  jsvUnLock(jsvObjectSetChild(result, "max", jsvNewFromFloat(max)));
+  return result;
+}
+
+/*JSON{ "type":"staticmethod", "ifndef" : "SAVE_ON_FLASH",
+         "class" : "E", "name" : "dot",
+         "generate" : "jswrap_espruino_dot",
+         "description" : "Work out the dot product of two Arrays, Strings or ArrayBuffers. This is equivalent to `v=0;for (i in arr1) v+=arr1[i]*arr2[i]`, stopping at the end of the shorter array",
+         "params" : [ [ "arr1", "JsVar", "The first array"],
+                      [ "arr2", "JsVar", "The second array"] ],
+         "return" : ["float", "The dot product of the two arrays"]
+}*/
+JsVarFloat jswrap_espruino_dot(JsVar *arr1, JsVar *arr2) {
+  if (!(jsvIsIterable(arr1)) ||
+      !(jsvIsIterable(arr2))) {
+    jsError("Expecting first 2 arguments to be iterable, not %t and %t", arr1, arr2);
+    return NAN;
+  }
+  JsVarFloat dot = 0;
+
+  size_t i, length1, length2;
+  JsVarDataArrayBufferViewType type1, type2;
+  const char *data1 = jswrap_espruino_getTypedData(arr1, &length1, &type1);
+  const char *data2 = jswrap_espruino_getTypedData(arr2, &length2, &type2);
+  if (data1 && data2) {
+    size_t length = (length1<length2) ? length1 : length2;
+    JSV_ARRAYBUFFER_FOR_TYPE(type1, ELEMENT,
+      const ELEMENT *p = (const ELEMENT*)data1;
+      if (type1==type2) {
+        const ELEMENT *q = (const ELEMENT*)data2;
+        for (i=0;i<length;i++) dot += (JsVarFloat)p[i] * (JsVarFloat)q[i];
+      } else {
+        for (i=0;i<length;i++) dot += (JsVarFloat)p[i] * jsvArrayBufferDataGetFloat(data2, type2, i);
+      }
+    )
+    return dot;
+  }
+
+  JsvIterator it1, it2;
+  jsvIteratorNew(&it1, arr1);
+  jsvIteratorNew(&it2, arr2);
+  while (jsvIteratorHasElement(&it1) && jsvIteratorHasElement(&it2)) {
+    dot += jsvIteratorGetFloatValue(&it1) * jsvIteratorGetFloatValue(&it2);
+    jsvIteratorNext(&it1);
+    jsvIteratorNext(&it2);
+  }
+  jsvIteratorFree(&it1);
+  jsvIteratorFree(&it2);
+  return dot;
+}
+
+/*JSON{ "type":"staticmethod", "ifndef" : "SAVE_ON_FLASH",
+         "class" : "E", "name" : "FIR",
+         "generate" : "jswrap_espruino_FIR",
+         "description" : ["Run a Finite Impulse Response filter over an Array or ArrayBuffer. For a separate dst, this is equivalent to `for (i in src) { v=0; for (k in coeffs) v+=coeffs[k]*(src[i-k]||0); dst[i]=v; }`",
+                          "Samples before the start of src are taken to be 0. dst may be the same as src, in which case the data is filtered in place. Only as many samples as fit in both src and dst are written." ],
+         "params" : [ [ "src", "JsVar", "The samples to filter"],
+                      [ "coeffs", "JsVar", "The filter coefficients - `coeffs[0]` is applied to the newest sample"],
+                      [ "dst", "JsVar", "An Array or ArrayBuffer to write the filtered samples to (if undefined, src is used)"] ]
+}*/
+void jswrap_espruino_FIR(JsVar *src, JsVar *coeffs, JsVar *dst) {
+  if (jsvIsUndefined(dst)) dst = src;
+  if (!(jsvIsIterable(src)) || !(jsvIsIterable(coeffs)) ||
+      !(jsvIsArray(dst) || jsvIsArrayBuffer(dst))) {
+    jsError("Expecting src and coeffs to be iterable and dst to be an Array or ArrayBuffer, not %t, %t and %t", src, coeffs, dst);
+    return;
+  }
+  size_t taps = (size_t)jsvGetLength(coeffs);
+  if (!taps) return;
+  if (jsuGetFreeStack() < 100+sizeof(JsVarFloat)*taps*2) {
+    jsError("Insufficient stack for FIR filter");
+    return;
+  }
+  JsVarFloat *c = (JsVarFloat*)alloca(sizeof(JsVarFloat)*taps);
+  taps = jswrap_espruino_readFloats(coeffs, c, taps);
+
+  size_t i, k, srcLength, dstLength;
+  JsVarDataArrayBufferViewType srcType, dstType;
+  const char *srcData = jswrap_espruino_getTypedData(src, &srcLength, &srcType);
+  char *dstData = jswrap_espruino_getTypedData(dst, &dstLength, &dstType);
+  if (srcData && dstData) {
+    /* Work backwards, so each output only depends on samples at or before
+     * the one being written - then it doesn't matter if dst is src */
+    i = (srcLength<dstLength) ? srcLength : dstLength;
+    JSV_ARRAYBUFFER_FOR_TYPE(srcType, ELEMENT,
+      const ELEMENT *p = (const ELEMENT*)srcData;
+      while (i--) {
+        size_t n = (i<taps) ? i+1 : taps;
+        JsVarFloat v = 0;
+        for (k=0;k<n;k++) v += c[k] * (JsVarFloat)p[i-k];
+        jsvArrayBufferDataSetFloat(dstData, dstType, i, v);
+      }
+    )
+    return;
+  }
+
+  // Otherwise keep a ring buffer of the last 'taps' samples
+  JsVarFloat *history = (JsVarFloat*)alloca(sizeof(JsVarFloat)*taps);
+  for (k=0;k<taps;k++) history[k] = 0;
+  size_t pos = 0;
+  JsvIterator itsrc, itdst;
+  jsvIteratorNew(&itsrc, src);
+  jsvIteratorNew(&itdst, dst);
+  while (jsvIteratorHasElement(&itsrc) && jsvIteratorHasElement(&itdst)) {
+    history[pos] = jsvIteratorGetFloatValue(&itsrc);
+    JsVarFloat v = 0;
+    size_t h = pos;
+    for (k=0;k<taps;k++) {
+      v += c[k] * history[h];
+      h = h ? h-1 : taps-1;
+    }
+    pos = (pos+1<taps) ? pos+1 : 0;
+    jsvUnLock(jsvIteratorSetValue(&itdst, jsvNewFromFloat(v)));
+    jsvIteratorNext(&itsrc);
+    jsvIteratorNext(&itdst);
+  }
+  jsvIteratorFree(&itsrc);
+  jsvIteratorFree(&itdst);
+}
+
 // http://paulbourke.net/miscellaneous/dft/
 /*
    This computes an in-place complex-to-complex FFT
@@ -264,54 +584,22 @@ void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse) {
   }
 
   // load data
-  JsvIterator it;
-  jsvIteratorNew(&it, arrReal);
-  i=0;
-  while (jsvIteratorHasElement(&it)) {
-    vReal[i++] = jsvIteratorGetFloatValue(&it);
-    jsvIteratorNext(&it);
-  }
-  jsvIteratorFree(&it);
-
-  if (jsvIsIterable(arrImag)) {
-    jsvIteratorNew(&it, arrImag);
-    i=0;
-    while (i<pow2 && jsvIteratorHasElement(&it)) {
-      vImag[i++] = jsvIteratorGetFloatValue(&it);
-      jsvIteratorNext(&it);
-    }
-    jsvIteratorFree(&it);
-  }
+  jswrap_espruino_readFloats(arrReal, vReal, pow2);
+  if (jsvIsIterable(arrImag))
+    jswrap_espruino_readFloats(arrImag, vImag, pow2);
 
   // do FFT
   FFT(inverse ? -1 : 1, order, vReal, vImag);
 
   // Put the results back
   bool useModulus = jsvIsIterable(arrImag);
-
-  jsvIteratorNew(&it, arrReal);
-  i=0;
-  while (jsvIteratorHasElement(&it)) {
-    JsVarFloat f;
-    if (useModulus)
-      f = jswrap_math_sqrt(vReal[i]*vReal[i] + vImag[i]*vImag[i]);
-    else
-      f = vReal[i];
-
-    jsvUnLock(jsvIteratorSetValue(&it, jsvNewFromFloat(f)));
-    i++;
-    jsvIteratorNext(&it);
-  }
-  jsvIteratorFree(&it);
-  if (jsvIsIterable(arrImag)) {
-    jsvIteratorNew(&it, arrImag);
-    i=0;
-    while (jsvIteratorHasElement(&it)) {
-      jsvUnLock(jsvIteratorSetValue(&it, jsvNewFromFloat(vImag[i++])));
-      jsvIteratorNext(&it);
-    }
-    jsvIteratorFree(&it);
+  if (useModulus) {
+    for (i=0;i<pow2;i++)
+      vReal[i] = jswrap_math_sqrt(vReal[i]*vReal[i] + vImag[i]*vImag[i]);
   }
+  jswrap_espruino_writeFloats(arrReal, vReal, pow2);
+  if (jsvIsIterable(arrImag))
+    jswrap_espruino_writeFloats(arrImag, vImag, pow2);
 }
 
 
@@ -18,6 +18,10 @@ JsVarFloat jswrap_espruino_clip(JsVarFloat x, JsVarFloat min, JsVarFloat max);
 JsVarFloat jswrap_espruino_sum(JsVar *arr);
 JsVarFloat jswrap_espruino_variance(JsVar *arr, JsVarFloat mean);
 JsVarFloat jswrap_espruino_convolve(JsVar *a, JsVar *b, int offset);
+void jswrap_espruino_scale(JsVar *arr, JsVarFloat scale, JsVarFloat offset);
+JsVar *jswrap_espruino_minMax(JsVar *arr);
+JsVarFloat jswrap_espruino_dot(JsVar *arr1, JsVar *arr2);
+void jswrap_espruino_FIR(JsVar *src, JsVar *coeffs, JsVar *dst);
 void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse);
 
 void jswrap_espruino_enableWatchdog(JsVarFloat time);
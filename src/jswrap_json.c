@@ -39,88 +39,566 @@ JsVar *jswrap_json_stringify(JsVar *v) {
 }
 
 
-JsVar *jswrap_json_parse_internal(JsLex *lex) {
-  switch (lex->tk) {
-    case LEX_R_TRUE:  jslGetNextToken(lex); return jsvNewFromBool(true);
-    case LEX_R_FALSE: jslGetNextToken(lex); return jsvNewFromBool(false);
-    case LEX_R_NULL:  jslGetNextToken(lex); return jsvNewWithFlags(JSV_NULL);
-    case LEX_INT: {
-      JsVarInt v = stringToInt(jslGetTokenValueAsString(lex));
-      jslGetNextToken(lex);
-      return jsvNewFromInteger(v);
+// ----------------------------------------------------------------------------- JSON parser
+
+/* A single-pass JSON parser. This goes through the source one character at a time
+ * rather than using JsLex, building strings straight into their StringExts. All of its
+ * state is in JsonParser (the objects and arrays we're inside are in an array rather than
+ * on the C stack), so parsing can stop at the end of one string and carry on with the next.
+ * JSON.parse uses it on a single string, and JSONPars saves it between calls to 'write'. */
+
+typedef enum {
+  JSONP_VALUE,         ///< expecting a value
+  JSONP_ARRAY_START,   ///< just had '[' (or ',' in an array) - a value or ']'
+  JSONP_OBJECT_START,  ///< just had '{' (or ',' in an object) - a key or '}'
+  JSONP_COLON,         ///< just had a key
+  JSONP_NEXT,          ///< just had a value in an array or object - ',' or the closing bracket
+  JSONP_STRING,
+  JSONP_STRING_ESCAPE, ///< just had a backslash in a string
+  JSONP_STRING_HEX,    ///< inside a \x or \u escape
+  JSONP_NUMBER,
+  JSONP_WORD,          ///< inside true, false or null
+  JSONP_DONE,          ///< had a complete value - only whitespace may follow
+  JSONP_ERROR,
+} PACKED_FLAGS JsonParseState;
+
+typedef enum {
+  JSONP_NUM_SIGN,      ///< had '-', so need a digit
+  JSONP_NUM_INT,
+  JSONP_NUM_FRACTION,
+  JSONP_NUM_EXP_SIGN,  ///< had 'e' - a sign or a digit
+  JSONP_NUM_EXP_DIGIT, ///< had the sign of the exponent, so need a digit
+  JSONP_NUM_EXP,
+} PACKED_FLAGS JsonNumberStage;
+
+typedef enum {
+  JSONP_FLAG_NONE = 0,
+  JSONP_FLAG_KEY = 1,          ///< the string being parsed is the key in an object
+  JSONP_FLAG_NEGATIVE = 2,     ///< the number being parsed is negative
+  JSONP_FLAG_FLOAT = 4,        ///< the number being parsed had a decimal point or exponent
+  JSONP_FLAG_EXP_NEGATIVE = 8, ///< the exponent of the number being parsed is negative
+} PACKED_FLAGS JsonParseFlags;
+
+typedef struct {
+  JsVarInt intValue;     ///< number: the value, if it turns out to be an integer
+  JsVarFloat floatValue; ///< number: the value as a float (accumulated the same way as stringToFloat)
+  JsVarFloat mul;        ///< number: what the next digit after the decimal point is worth
+  int exponent;          ///< number: the exponent
+  unsigned int depth;    ///< How many arrays/objects we're inside
+  unsigned short hex;    ///< string: the character code of a \x or \u escape
+  JsonParseState state;
+  JsonParseFlags flags;
+  unsigned char count;   ///< number: JsonNumberStage, word: characters matched, hex escape: digits left
+  char quote;            ///< string: the quote character, word: the first character of the word
+  unsigned char _blank;  ///< not stored - this is needed as jsvGetString wants to add a trailing zero
+} PACKED_FLAGS JsonParserData;
+
+typedef struct {
+  JsonParserData data;
+  JsVar *stack;    ///< The arrays/objects we're inside (items after 'depth' are left to be reused)
+  JsVar *top;      ///< The innermost array/object - the one values are added to (or 0)
+  JsVar *str;      ///< The string we're currently parsing (or 0)
+  JsvStringIterator strIt; ///< Iterator at the end of 'str'
+  JsVar *result;   ///< The value we're parsing (arrays and objects are added to it as soon as they start)
+} JsonParser;
+
+#define JSON_PARSER_NAME_STATE JS_HIDDEN_CHAR_STR"jst"
+#define JSON_PARSER_NAME_STACK JS_HIDDEN_CHAR_STR"jsk"
+#define JSON_PARSER_NAME_STRING JS_HIDDEN_CHAR_STR"jsr"
+#define JSON_PARSER_NAME_RESULT JS_HIDDEN_CHAR_STR"jrs"
+
+static void jsonParserInit(JsonParser *p) {
+  // the other fields of 'data' are set up when parsing of the thing they're used for starts
+  p->data.state = JSONP_VALUE;
+  p->data.flags = JSONP_FLAG_NONE;
+  p->data.depth = 0;
+  p->stack = 0;
+  p->top = 0;
+  p->str = 0;
+  p->result = 0;
+}
+
+static void jsonParserKill(JsonParser *p) {
+  if (p->str) {
+    jsvStringIteratorFree(&p->strIt);
+    jsvUnLock(p->str);
+  }
+  jsvUnLock(p->stack);
+  jsvUnLock(p->top);
+  jsvUnLock(p->result);
+}
+
+static void jsonParserSetString(JsonParser *p, JsVar *str) {
+  p->str = str;
+  jsvStringIteratorNew(&p->strIt, str, 0);
+  jsvStringIteratorGotoEnd(&p->strIt);
+}
+
+static void jsonParseError(JsonParser *p) {
+  p->data.state = JSONP_ERROR;
+}
+
+/// Get the name of item 'idx' in the stack. It's at (or near) the end, so search backwards
+static JsVar *jsonParserGetStackName(JsonParser *p, unsigned int idx) {
+  JsVarRef ref = p->stack->lastChild;
+  while (ref) {
+    JsVar *name = jsvLock(ref);
+    if (jsvGetInteger(name) == (JsVarInt)idx) return name;
+    ref = name->prevSibling;
+    jsvUnLock(name);
+  }
+  return 0;
+}
+
+static void jsonParserUpdateTop(JsonParser *p) {
+  jsvUnLock(p->top);
+  p->top = p->data.depth ? jsvSkipNameAndUnLock(jsonParserGetStackName(p, p->data.depth-1)) : 0;
+}
+
+/// Put a value into the array/object we're inside (or make it the result). Doesn't unlock 'value'
+static bool jsonParseAddValue(JsonParser *p, JsVar *value) {
+  if (!value) { // out of memory
+    jsonParseError(p);
+    return false;
+  }
+  if (!p->top) {
+    p->result = jsvLockAgain(value);
+  } else if (jsvIsArray(p->top)) {
+    // jsvArrayPush gets the index from lastChild, so this appends at the tail in constant time
+    jsvArrayPush(p->top, value);
+  } else {
+    // the key was added to the object when we parsed it, so it's the last child
+    JsVar *key = jsvLock(p->top->lastChild);
+    jsvSetValueOfName(key, value);
+    jsvUnLock(key);
+  }
+  return true;
+}
+
+/// We have had a complete value (which is unlocked)
+static void jsonParseValue(JsonParser *p, JsVar *value) {
+  if (jsonParseAddValue(p, value))
+    p->data.state = p->top ? JSONP_NEXT : JSONP_DONE;
+  jsvUnLock(value);
+}
+
+static void jsonParseStartContainer(JsonParser *p, JsVarFlags type) {
+  JsVar *container = jsvNewWithFlags(type);
+  if (!jsonParseAddValue(p, container)) return;
+  // reuse the stack item from last time we were this deep, rather than allocating a new one
+  JsVar *name = jsonParserGetStackName(p, p->data.depth);
+  if (name) {
+    jsvSetValueOfName(name, container);
+    jsvUnLock(name);
+  } else if (!jsvArrayPush(p->stack, container)) {
+    jsonParseError(p); // out of memory
+  }
+  p->data.depth++;
+  jsvUnLock(p->top);
+  p->top = container;
+  if (p->data.state != JSONP_ERROR)
+    p->data.state = (type==JSV_ARRAY) ? JSONP_ARRAY_START : JSONP_OBJECT_START;
+}
+
+static void jsonParseEndContainer(JsonParser *p) {
+  p->data.depth--;
+  jsonParserUpdateTop(p);
+  p->data.state = p->top ? JSONP_NEXT : JSONP_DONE;
+}
+
+static void jsonParseStartString(JsonParser *p, char quote, bool isKey) {
+  JsVar *str = jsvNewFromEmptyString();
+  if (!str) {
+    jsonParseError(p);
+    return;
+  }
+  jsonParserSetString(p, str);
+  p->data.state = JSONP_STRING;
+  p->data.quote = quote;
+  if (isKey) p->data.flags |= JSONP_FLAG_KEY;
+}
+
+static void jsonParseEndString(JsonParser *p) {
+  jsvStringIteratorFree(&p->strIt);
+  JsVar *str = p->str;
+  p->str = 0;
+  if (p->data.flags & JSONP_FLAG_KEY) {
+    p->data.flags &= (JsonParseFlags)~JSONP_FLAG_KEY;
+    jsvAddName(p->top, jsvMakeIntoVariableName(str, 0));
+    jsvUnLock(str);
+    p->data.state = JSONP_COLON;
+  } else
+    jsonParseValue(p, str);
+}
+
+/// Append the character code from a \u escape that won't fit in one char, as UTF-8
+static void jsonParseAppendUTF8(JsonParser *p, unsigned int code) {
+  if (code < 0x800) {
+    jsvStringIteratorAppend(&p->strIt, (char)(0xC0 | (code>>6)));
+  } else {
+    jsvStringIteratorAppend(&p->strIt, (char)(0xE0 | (code>>12)));
+    jsvStringIteratorAppend(&p->strIt, (char)(0x80 | ((code>>6)&63)));
+  }
+  jsvStringIteratorAppend(&p->strIt, (char)(0x80 | (code&63)));
+}
+
+static void jsonParseEscape(JsonParser *p, char ch) {
+  JsonParserData *d = &p->data;
+  d->state = JSONP_STRING;
+  switch (ch) {
+    case 'b': ch = '\b'; break;
+    case 'f': ch = '\f'; break;
+    case 'n': ch = '\n'; break;
+    case 'a': ch = '\a'; break;
+    case 'r': ch = '\r'; break;
+    case 't': ch = '\t'; break;
+    case 'x':
+    case 'u':
+      d->state = JSONP_STRING_HEX;
+      d->hex = 0;
+      d->count = (ch=='x') ? 2 : 4;
+      return;
+    default: break; // anything else (quotes, slashes) is just pushed through
+  }
+  jsvStringIteratorAppend(&p->strIt, ch);
+}
+
+static void jsonParseHexDigit(JsonParser *p, char ch) {
+  JsonParserData *d = &p->data;
+  if (!isHexadecimal(ch)) {
+    jsonParseError(p);
+    return;
+  }
+  int n;
+  if (ch<='9') n = ch-'0';
+  else if (ch<='F') n = ch-'A'+10;
+  else n = ch-'a'+10;
+  d->hex = (unsigned short)((d->hex<<4) | n);
+  if (--d->count == 0) {
+    if (d->hex < 0x100) jsvStringIteratorAppend(&p->strIt, (char)d->hex);
+    else jsonParseAppendUTF8(p, d->hex);
+    d->state = JSONP_STRING;
+  }
+}
+
+/// Add a character to the number we're parsing. Returns false if it isn't part of the number
+static bool jsonParseNumberChar(JsonParserData *d, char ch) {
+  if (isNumeric(ch)) {
+    int n = ch-'0';
+    switch ((JsonNumberStage)d->count) {
+      case JSONP_NUM_SIGN:
+        d->count = JSONP_NUM_INT; // fall through
+      case JSONP_NUM_INT:
+        d->intValue = d->intValue*10 + n;
+        d->floatValue = d->floatValue*10 + n;
+        break;
+      case JSONP_NUM_FRACTION:
+        d->floatValue += d->mul*n;
+        d->mul /= 10;
+        break;
+      case JSONP_NUM_EXP_SIGN:
+      case JSONP_NUM_EXP_DIGIT:
+        d->count = JSONP_NUM_EXP; // fall through
+      case JSONP_NUM_EXP:
+        d->exponent = d->exponent*10 + n;
+        break;
     }
-    case LEX_FLOAT: {
-      JsVarFloat v = stringToFloat(jslGetTokenValueAsString(lex));
-      jslGetNextToken(lex);
-      return jsvNewFromFloat(v);
+    return true;
+  }
+  if (ch=='.' && d->count==JSONP_NUM_INT) {
+    d->count = JSONP_NUM_FRACTION;
+    d->flags |= JSONP_FLAG_FLOAT;
+    d->mul = 0.1;
+    return true;
+  }
+  if ((ch=='e' || ch=='E') && (d->count==JSONP_NUM_INT || d->count==JSONP_NUM_FRACTION)) {
+    d->count = JSONP_NUM_EXP_SIGN;
+    d->flags |= JSONP_FLAG_FLOAT;
+    return true;
+  }
+  if ((ch=='-' || ch=='+') && d->count==JSONP_NUM_EXP_SIGN) {
+    d->count = JSONP_NUM_EXP_DIGIT;
+    if (ch=='-') d->flags |= JSONP_FLAG_EXP_NEGATIVE;
+    return true;
+  }
+  return false;
+}
+
+static void jsonParseEndNumber(JsonParser *p) {
+  JsonParserData *d = &p->data;
+  if (d->count==JSONP_NUM_SIGN || d->count==JSONP_NUM_EXP_SIGN || d->count==JSONP_NUM_EXP_DIGIT) {
+    jsonParseError(p);
+    return;
+  }
+  bool negative = (d->flags & JSONP_FLAG_NEGATIVE)!=0;
+  if (d->flags & JSONP_FLAG_FLOAT) {
+    JsVarFloat v = d->floatValue;
+    int e = (d->flags & JSONP_FLAG_EXP_NEGATIVE) ? -d->exponent : d->exponent;
+    while (e>0) {
+      v*=10;
+      e--;
     }
-    case LEX_STR: {
-      JsVar *a = jslGetTokenValueAsVar(lex);
-      jslGetNextToken(lex);
-      return a;
+    while (e<0) {
+      v/=10;
+      e++;
     }
-    case '[': {
-      JsVar *arr = jsvNewWithFlags(JSV_ARRAY); if (!arr) return 0;
-      jslGetNextToken(lex); // [
-      while (lex->tk != ']') {
-        JsVar *value = jswrap_json_parse_internal(lex);
-        if (!value ||
-            (lex->tk!=']' && !jslMatch(lex, ','))) {
-          jsvUnLock(value);
-          jsvUnLock(arr);
-          return 0;
-        }
-        jsvArrayPush(arr, value);
-        jsvUnLock(value);
+    jsonParseValue(p, jsvNewFromFloat(negative ? -v : v));
+  } else {
+    jsonParseValue(p, jsvNewFromInteger(negative ? -d->intValue : d->intValue));
+  }
+  d->flags &= (JsonParseFlags)~(JSONP_FLAG_NEGATIVE|JSONP_FLAG_FLOAT|JSONP_FLAG_EXP_NEGATIVE);
+}
+
+static const char *jsonParseGetWord(char firstChar) {
+  if (firstChar=='t') return "true";
+  if (firstChar=='f') return "false";
+  return "null";
+}
+
+static void jsonParseStartValue(JsonParser *p, char ch) {
+  JsonParserData *d = &p->data;
+  if (ch=='"' || ch=='\'') {
+    jsonParseStartString(p, ch, false);
+  } else if (ch=='[') {
+    jsonParseStartContainer(p, JSV_ARRAY);
+  } else if (ch=='{') {
+    jsonParseStartContainer(p, JSV_OBJECT);
+  } else if (ch=='-' || isNumeric(ch)) {
+    d->state = JSONP_NUMBER;
+    d->count = JSONP_NUM_SIGN;
+    d->intValue = 0;
+    d->floatValue = 0;
+    d->exponent = 0;
+    if (ch=='-') d->flags |= JSONP_FLAG_NEGATIVE;
+    else jsonParseNumberChar(d, ch);
+  } else if (ch=='t' || ch=='f' || ch=='n') {
+    d->state = JSONP_WORD;
+    d->quote = ch;
+    d->count = 1;
+  } else
+    jsonParseError(p);
+}
+
+static void jsonParseChar(JsonParser *p, char ch) {
+  JsonParserData *d = &p->data;
+  // first, states where whitespace matters
+  switch (d->state) {
+    case JSONP_STRING:
+      if (ch==d->quote) jsonParseEndString(p);
+      else if (ch=='\\') d->state = JSONP_STRING_ESCAPE;
+      else jsvStringIteratorAppend(&p->strIt, ch);
+      return;
+    case JSONP_STRING_ESCAPE:
+      jsonParseEscape(p, ch);
+      return;
+    case JSONP_STRING_HEX:
+      jsonParseHexDigit(p, ch);
+      return;
+    case JSONP_NUMBER:
+      if (jsonParseNumberChar(d, ch)) return;
+      // the number has finished - add it, then handle 'ch' as normal
+      jsonParseEndNumber(p);
+      break;
+    case JSONP_WORD: {
+      const char *word = jsonParseGetWord(d->quote);
+      if (ch!=word[d->count]) {
+        jsonParseError(p);
+        return;
       }
-      if (!jslMatch(lex, ']')) {
-        jsvUnLock(arr);
-        return 0;
+      d->count++;
+      if (!word[d->count]) {
+        if (d->quote=='n') jsonParseValue(p, jsvNewWithFlags(JSV_NULL));
+        else jsonParseValue(p, jsvNewFromBool(d->quote=='t'));
       }
-      return arr;
+      return;
     }
-    case '{': {
-      JsVar *obj = jsvNewWithFlags(JSV_OBJECT); if (!obj) return 0;
-      jslGetNextToken(lex); // {
-      while (lex->tk == LEX_STR) {
-        JsVar *key = jslGetTokenValueAsVar(lex);
-        jslGetNextToken(lex);
-        JsVar *value = 0;
-        if (!jslMatch(lex, ':') ||
-            !(value=jswrap_json_parse_internal(lex)) ||
-            (lex->tk!='}' && !jslMatch(lex, ','))) {
-          jsvUnLock(key);
-          jsvUnLock(value);
-          jsvUnLock(obj);
-          return 0;
-        }
-        jsvAddName(obj, jsvMakeIntoVariableName(key, value));
-        jsvUnLock(value);
-        jsvUnLock(key);
+    default: break;
+  }
+
+  if (isWhitespace(ch)) return;
+  switch (d->state) {
+    case JSONP_ARRAY_START:
+      if (ch==']') {
+        jsonParseEndContainer(p);
+        return;
+      } // fall through
+    case JSONP_VALUE:
+      jsonParseStartValue(p, ch);
+      return;
+    case JSONP_OBJECT_START:
+      if (ch=='}') {
+        jsonParseEndContainer(p);
+        return;
       }
-      if (!jslMatch(lex, '}')) {
-        jsvUnLock(obj);
-        return 0;
+      if (ch=='"' || ch=='\'') {
+        jsonParseStartString(p, ch, true);
+        return;
       }
-      return obj;
-    }
-    default: return 0; // undefined = error
+      break;
+    case JSONP_COLON:
+      if (ch==':') {
+        d->state = JSONP_VALUE;
+        return;
+      }
+      break;
+    case JSONP_NEXT: {
+      bool inArray = jsvIsArray(p->top);
+      if (ch==',') {
+        d->state = inArray ? JSONP_ARRAY_START : JSONP_OBJECT_START;
+        return;
+      }
+      if (ch==(inArray ? ']' : '}')) {
+        jsonParseEndContainer(p);
+        return;
+      }
+    } break;
+    default: break;
+  }
+  jsonParseError(p);
+}
+
+/// Parse all of the given string (or whatever it converts to)
+static void jsonParserFeed(JsonParser *p, JsVar *data) {
+  JsVar *str = jsvAsString(data, false);
+  if (!str) {
+    jsonParseError(p);
+    return;
+  }
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, str, 0);
+  while (jsvStringIteratorHasChar(&it) && p->data.state!=JSONP_ERROR) {
+    jsonParseChar(p, jsvStringIteratorGetChar(&it));
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  jsvUnLock(str);
+}
+
+/// There's no more data - return the parsed value, or 0 if it wasn't valid or was incomplete
+static JsVar *jsonParserEnd(JsonParser *p) {
+  if (p->data.state==JSONP_NUMBER)
+    jsonParseEndNumber(p);
+  if (p->data.state!=JSONP_DONE) return 0;
+  JsVar *result = p->result;
+  p->result = 0;
+  return result;
+}
+
+/// Load the parser's state from a JSONPars object
+static void jsonParserLoad(JsonParser *p, JsVar *parent) {
+  jsonParserInit(p);
+  JsVar *state = jsvObjectGetChild(parent, JSON_PARSER_NAME_STATE, 0);
+  if (state) {
+    jsvGetString(state, (char*)&p->data, sizeof(JsonParserData));
+    jsvUnLock(state);
+  }
+  p->stack = jsvObjectGetChild(parent, JSON_PARSER_NAME_STACK, JSV_ARRAY);
+  if (p->stack && p->data.depth) jsonParserUpdateTop(p);
+  p->result = jsvObjectGetChild(parent, JSON_PARSER_NAME_RESULT, 0);
+  JsVar *str = jsvObjectGetChild(parent, JSON_PARSER_NAME_STRING, 0);
+  if (str) {
+    // take it out of the object while we append to it, as it may become a key
+    jsvRemoveNamedChild(parent, JSON_PARSER_NAME_STRING);
+    jsonParserSetString(p, str);
   }
 }
 
+static void jsonParserSetChild(JsVar *parent, const char *name, JsVar *child) {
+  if (child) jsvObjectSetChild(parent, name, child);
+  else jsvRemoveNamedChild(parent, name);
+}
+
+/// Save the parser's state into a JSONPars object, and free it
+static void jsonParserSave(JsonParser *p, JsVar *parent) {
+  JsVar *state = jsvObjectGetChild(parent, JSON_PARSER_NAME_STATE, 0);
+  if (!state) {
+    state = jsvNewStringOfLength(sizeof(JsonParserData)-1/*_blank*/);
+    if (state) jsvObjectSetChild(parent, JSON_PARSER_NAME_STATE, state);
+  }
+  if (state) {
+    jsvSetString(state, (char*)&p->data, sizeof(JsonParserData)-1/*_blank*/);
+    jsvUnLock(state);
+  } else
+    p->data.state = JSONP_ERROR; // out of memory
+  jsonParserSetChild(parent, JSON_PARSER_NAME_STRING, p->str);
+  jsonParserSetChild(parent, JSON_PARSER_NAME_RESULT, p->result);
+  jsonParserKill(p);
+}
+
 /*JSON{ "type":"staticmethod",
          "class" : "JSON", "name" : "parse",
          "description" : [ "Parse the given JSON string into a JavaScript object",
-                           "NOTE: This implementation uses eval() internally, and as such it is unsafe as it can allow arbitrary JS commands to be executed."],
+                           "This goes through the string once without using the JavaScript lexer, so it can't execute any code. If the string isn't valid JSON, undefined is returned. To parse JSON as it arrives (for instance from an HTTP request) without joining it into one string first, use JSON.parser()"],
          "generate" : "jswrap_json_parse",
          "params" : [ [ "string", "JsVar", "A JSON string"] ],
          "return" : ["JsVar", "The JavaScript object created by parsing the data string"]
 }*/
 JsVar *jswrap_json_parse(JsVar *v) {
-  JsLex lex;
-  jslInit(&lex, v);
-  JsVar *res = jswrap_json_parse_internal(&lex);
-  jslKill(&lex);
+  JsonParser p;
+  jsonParserInit(&p);
+  p.stack = jsvNewWithFlags(JSV_ARRAY);
+  if (!p.stack) return 0;
+  jsonParserFeed(&p, v);
+  JsVar *res = jsonParserEnd(&p);
+  jsonParserKill(&p);
+  return res;
+}
+
+/*JSON{ "type":"class",
+        "class" : "JSONPars",
+        "description" : ["A JSON parser that is given its input a piece at a time, created by JSON.parser()",
+                         "```var p = JSON.parser(); req.on('data', function(d) { p.write(d); }); req.on('close', function() { var obj = p.end(); });```" ]
+}*/
+/*JSON{ "type":"staticmethod",
+         "class" : "JSON", "name" : "parser",
+         "description" : [ "Create a parser for JSON that arrives in pieces (for instance the body of an HTTP request). Each piece is parsed as it is written, so the pieces never have to be joined together" ],
+         "generate" : "jswrap_json_parser",
+         "return" : ["JsVar", "A new JSONPars object"]
+}*/
+JsVar *jswrap_json_parser() {
+  return jspNewObject(0, "JSONPars");
+}
+
+/*JSON{ "type":"method",
+         "class" : "JSONPars", "name" : "write",
+         "description" : [ "Parse the next piece of JSON" ],
+         "generate" : "jswrap_json_parser_write",
+         "params" : [ [ "data", "JsVar", "A string containing the next part of the JSON"] ],
+         "return" : ["bool", "false if the JSON written so far is invalid, true otherwise"]
+}*/
+bool jswrap_json_parser_write(JsVar *parent, JsVar *data) {
+  JsonParser p;
+  jsonParserLoad(&p, parent);
+  if (!p.stack) { // out of memory
+    jsonParserKill(&p);
+    return false;
+  }
+  jsonParserFeed(&p, data);
+  bool ok = p.data.state!=JSONP_ERROR;
+  jsonParserSave(&p, parent);
+  return ok;
+}
+
+/*JSON{ "type":"method",
+         "class" : "JSONPars", "name" : "end",
+         "description" : [ "Finish parsing and return the result. The parser is then reset, so it can be used again" ],
+         "generate" : "jswrap_json_parser_end",
+         "params" : [ [ "data", "JsVar", "(optional) A string containing the last part of the JSON"] ],
+         "return" : ["JsVar", "The JavaScript object that was parsed, or undefined if the JSON was invalid or incomplete"]
+}*/
+JsVar *jswrap_json_parser_end(JsVar *parent, JsVar *data) {
+  JsonParser p;
+  jsonParserLoad(&p, parent);
+  JsVar *res = 0;
+  if (p.stack) {
+    if (!jsvIsUndefined(data)) jsonParserFeed(&p, data);
+    res = jsonParserEnd(&p);
+  }
+  jsonParserKill(&p);
+  jsvRemoveNamedChild(parent, JSON_PARSER_NAME_STATE);
+  jsvRemoveNamedChild(parent, JSON_PARSER_NAME_STACK);
+  jsvRemoveNamedChild(parent, JSON_PARSER_NAME_STRING);
+  jsvRemoveNamedChild(parent, JSON_PARSER_NAME_RESULT);
   return res;
 }
 
@@ -157,17 +635,72 @@ void jsfGetJSONForFunctionWithCallback(JsVar *var, JSONFlags flags, vcbprintf_ca
   } else cbprintf(user_callback, user_data, "{}");
 }
 
-void jsfGetEscapedString(JsVar *var, vcbprintf_callback user_callback, void *user_data) {
-  user_callback("\"",user_data);
+/* JSON output is collected in a small buffer and passed to the callback in runs, rather than
+ * calling the callback for every character. The writer is passed down to nested calls as
+ * the callback's user_data, so jsfGetJSONForFunctionWithCallback/cbprintf can still be used. */
+#define JSON_WRITER_BUFFER_SIZE 64
+
+typedef struct {
+  vcbprintf_callback user_callback;
+  void *user_data;
+  size_t len;
+  char buf[JSON_WRITER_BUFFER_SIZE];
+} JsonWriter;
+
+static void jsonWriterFlush(JsonWriter *w) {
+  if (!w->len) return;
+  w->user_callback(w->buf, w->len, w->user_data);
+  w->len = 0;
+}
+
+static void jsonWriteChar(JsonWriter *w, char ch) {
+  if (w->len >= JSON_WRITER_BUFFER_SIZE) jsonWriterFlush(w);
+  w->buf[w->len++] = ch;
+}
+
+static void jsonWrite(JsonWriter *w, const char *str) {
+  while (*str) {
+    if (w->len >= JSON_WRITER_BUFFER_SIZE) jsonWriterFlush(w);
+    while (*str && w->len < JSON_WRITER_BUFFER_SIZE)
+      w->buf[w->len++] = *(str++);
+  }
+}
+
+/// vcbprintf_callback that writes into a JsonWriter. Runs too big to buffer are passed straight on
+static void jsonWriterCallback(const char *str, size_t len, void *user_data) {
+  JsonWriter *w = (JsonWriter*)user_data;
+  if (len > JSON_WRITER_BUFFER_SIZE) {
+    jsonWriterFlush(w);
+    w->user_callback(str, len, w->user_data);
+    return;
+  }
+  if (w->len+len > JSON_WRITER_BUFFER_SIZE) jsonWriterFlush(w);
+  memcpy(&w->buf[w->len], str, len);
+  w->len += len;
+}
+
+/// Write a String with quotes around it, escaping as we go
+static void jsonWriteEscaped(JsonWriter *w, JsVar *var) {
+  jsonWriteChar(w, '"');
   JsvStringIterator it;
   jsvStringIteratorNew(&it, var, 0);
   while (jsvStringIteratorHasChar(&it)) {
     char ch = jsvStringIteratorGetChar(&it);
-    user_callback(escapeCharacter(ch), user_data);
-    jsvStringIteratorNext(&it);
+    if (ch>=' ' && ch!='"' && ch!='\\') jsonWriteChar(w, ch);
+    else jsonWrite(w, escapeCharacter(ch));
+    jsvStringIteratorNextInline(&it);
   }
   jsvStringIteratorFree(&it);
-  user_callback("\"",user_data);
+  jsonWriteChar(w, '"');
+}
+
+void jsfGetEscapedString(JsVar *var, vcbprintf_callback user_callback, void *user_data) {
+  JsonWriter w;
+  w.user_callback = user_callback;
+  w.user_data = user_data;
+  w.len = 0;
+  jsonWriteEscaped(&w, var);
+  jsonWriterFlush(&w);
 }
 
 bool jsonNeedsNewLine(JsVar *v) {
@@ -175,44 +708,60 @@ bool jsonNeedsNewLine(JsVar *v) {
   // we're skipping strings here because they're usually long and want printing on multiple lines
 }
 
-void jsonNewLine(JSONFlags flags, vcbprintf_callback user_callback, void *user_data) {
-  cbprintf(user_callback, user_data, "\n");
+static void jsonNewLine(JSONFlags flags, JsonWriter *w) {
+  jsonWriteChar(w, '\n');
   // apply the indent
   unsigned int indent = flags / JSON_INDENT;
   while (indent--)
-    cbprintf(user_callback, user_data, "  ");
+    jsonWrite(w, "  ");
 }
 
-void jsfGetJSONWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user_callback, void *user_data) {
+static void jsfGetJSONWithWriter(JsVar *var, JSONFlags flags, JsonWriter *w) {
   JSONFlags nflags = flags + JSON_INDENT; // if we add a newline, make sure we indent any subsequent JSON more
 
   if (jsvIsUndefined(var)) {
-    cbprintf(user_callback, user_data, "undefined");
+    jsonWrite(w, "undefined");
   } else if (jsvIsArray(var)) {
     size_t length = (size_t)jsvGetArrayLength(var);
     bool limited = (flags&JSON_LIMIT) && (length>JSON_LIMIT_AMOUNT);
     bool needNewLine = false;
-    size_t i;
-    cbprintf(user_callback, user_data, "[");
-    for (i=0;i<length && !jspIsInterrupted();i++) {
-      if (!limited || i<JSON_LIMITED_AMOUNT || i>=length-JSON_LIMITED_AMOUNT) {
-        if (i>0) cbprintf(user_callback, user_data, ",");
-        if (limited && i==length-JSON_LIMITED_AMOUNT) cbprintf(user_callback, user_data, JSON_LIMIT_TEXT);
-        JsVar *item = jsvGetArrayItem(var, (JsVarInt)i);
-        bool newNeedsNewLine = (flags&JSON_NEWLINES) && jsonNeedsNewLine(item);
-        if (needNewLine || newNeedsNewLine) {
-          jsonNewLine(nflags, user_callback, user_data);
-          needNewLine = false;
+    size_t i = 0;
+    jsonWriteChar(w, '[');
+    // Walk forwards through the array's elements (which are in index order) rather than looking each index up
+    JsvArrayIterator it;
+    jsvArrayIteratorNew(&it, var);
+    while (i<length && !jspIsInterrupted()) {
+      if (limited && i==JSON_LIMITED_AMOUNT) i = length-JSON_LIMITED_AMOUNT; // skip the middle
+      // find element i, if it exists
+      JsVar *item = 0;
+      while (jsvArrayIteratorHasElement(&it)) {
+        JsVar *idxVar = jsvArrayIteratorGetIndex(&it);
+        bool isIndex = jsvIsInt(idxVar);
+        JsVarInt idx = jsvGetIntegerAndUnLock(idxVar);
+        if (isIndex && idx>=(JsVarInt)i) {
+          if (idx==(JsVarInt)i) item = jsvArrayIteratorGetElement(&it);
+          break;
         }
-        jsfGetJSONWithCallback(item, nflags, user_callback, user_data);
-        needNewLine = newNeedsNewLine;
-        jsvUnLock(item);
+        jsvArrayIteratorNext(&it);
+      }
+
+      if (i>0) jsonWriteChar(w, ',');
+      if (limited && i==length-JSON_LIMITED_AMOUNT) jsonWrite(w, JSON_LIMIT_TEXT);
+      bool newNeedsNewLine = (flags&JSON_NEWLINES) && jsonNeedsNewLine(item);
+      if (needNewLine || newNeedsNewLine) {
+        jsonNewLine(nflags, w);
+        needNewLine = false;
       }
+      jsfGetJSONWithWriter(item, nflags, w);
+      needNewLine = newNeedsNewLine;
+      jsvUnLock(item);
+      i++;
     }
-    if (needNewLine) jsonNewLine(flags, user_callback, user_data);
-    cbprintf(user_callback, user_data, "]");
+    jsvArrayIteratorFree(&it);
+    if (needNewLine) jsonNewLine(flags, w);
+    jsonWriteChar(w, ']');
   } else if (jsvIsArrayBuffer(var)) {
-    cbprintf(user_callback, user_data, "new %s([", jswGetBasicObjectName(var));
+    cbprintf(jsonWriterCallback, w, "new %s([", jswGetBasicObjectName(var));
     size_t length = jsvGetArrayBufferLength(var);
     bool limited = (flags&JSON_LIMIT) && (length>JSON_LIMIT_AMOUNT);
     // no newlines needed for array buffers as they only contain simple stuff
@@ -220,38 +769,40 @@ void jsfGetJSONWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user
     jsvArrayBufferIteratorNew(&it, var, 0);
     while (jsvArrayBufferIteratorHasElement(&it) && !jspIsInterrupted()) {
       if (!limited || it.index<JSON_LIMITED_AMOUNT || it.index>=length-JSON_LIMITED_AMOUNT) {
-        if (it.index>0) cbprintf(user_callback, user_data, ",");
-        if (limited && it.index==length-JSON_LIMITED_AMOUNT) cbprintf(user_callback, user_data, JSON_LIMIT_TEXT);
+        if (it.index>0) jsonWriteChar(w, ',');
+        if (limited && it.index==length-JSON_LIMITED_AMOUNT) jsonWrite(w, JSON_LIMIT_TEXT);
         JsVar *item = jsvArrayBufferIteratorGetValue(&it);
-        jsfGetJSONWithCallback(item, nflags, user_callback, user_data);
+        jsfGetJSONWithWriter(item, nflags, w);
         jsvUnLock(item);
       }
       jsvArrayBufferIteratorNext(&it);
     }
     jsvArrayBufferIteratorFree(&it);
-    cbprintf(user_callback, user_data, "])");
+    jsonWrite(w, "])");
   } else if (jsvIsObject(var)) {
     bool first = true;
     bool needNewLine = false;
     JsvObjectIterator it;
     jsvObjectIteratorNew(&it, var);
-    cbprintf(user_callback, user_data, "{");
+    jsonWriteChar(w, '{');
     while (jsvObjectIteratorHasElement(&it) && !jspIsInterrupted()) {
       JsVar *index = jsvObjectIteratorGetKey(&it);
       JsVar *item = jsvObjectIteratorGetValue(&it);
       bool hidden = jsvIsInternalObjectKey(index) ||
                     ((flags & JSON_IGNORE_FUNCTIONS) && jsvIsFunction(item));
       if (!hidden) {
-        if (!first) cbprintf(user_callback, user_data, ",");
+        if (!first) jsonWriteChar(w, ',');
         bool newNeedsNewLine = (flags&JSON_NEWLINES) && jsonNeedsNewLine(item);
         if (needNewLine || newNeedsNewLine) {
-          jsonNewLine(nflags, user_callback, user_data);
+          jsonNewLine(nflags, w);
           needNewLine = false;
         }
-        cbprintf(user_callback, user_data, "%q:", index);
+        if (jsvHasCharacterData(index)) jsonWriteEscaped(w, index);
+        else cbprintf(jsonWriterCallback, w, "%q", index);
+        jsonWriteChar(w, ':');
         if (first)
           first = false;
-        jsfGetJSONWithCallback(item, nflags, user_callback, user_data);
+        jsfGetJSONWithWriter(item, nflags, w);
         needNewLine = newNeedsNewLine;
       }
       jsvUnLock(index);
@@ -259,29 +810,49 @@ void jsfGetJSONWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user
       jsvObjectIteratorNext(&it);
     }
     jsvObjectIteratorFree(&it);
-    if (needNewLine) jsonNewLine(flags, user_callback, user_data);
-    cbprintf(user_callback, user_data, "}");
+    if (needNewLine) jsonNewLine(flags, w);
+    jsonWriteChar(w, '}');
   } else if (jsvIsFunction(var)) {
     if (flags & JSON_IGNORE_FUNCTIONS) {
-      cbprintf(user_callback, user_data, "undefined");
+      jsonWrite(w, "undefined");
     } else {
-      cbprintf(user_callback, user_data, "function ");
-      jsfGetJSONForFunctionWithCallback(var, nflags, user_callback, user_data);
+      jsonWrite(w, "function ");
+      jsfGetJSONForFunctionWithCallback(var, nflags, jsonWriterCallback, w);
     }
   } else if (jsvIsString(var) && !jsvIsName(var)) {
     if ((flags&JSON_LIMIT) && jsvGetStringLength(var)>JSON_LIMIT_STRING_AMOUNT) {
       // if the string is too big, split it and put dots in the middle
       JsVar *var1 = jsvNewFromStringVar(var, 0, JSON_LIMITED_STRING_AMOUNT);
       JsVar *var2 = jsvNewFromStringVar(var, jsvGetStringLength(var)-JSON_LIMITED_STRING_AMOUNT, JSON_LIMITED_STRING_AMOUNT);
-      cbprintf(user_callback, user_data, "%q%s%q", var1, JSON_LIMIT_TEXT, var2);
+      cbprintf(jsonWriterCallback, w, "%q%s%q", var1, JSON_LIMIT_TEXT, var2);
       jsvUnLock(var1);
       jsvUnLock(var2);
     } else {
-      cbprintf(user_callback, user_data, "%q", var);
+      jsonWriteEscaped(w, var);
     }
+  } else if (jsvIsFloat(var) || (jsvIsInt(var) && !jsvIsPin(var))) {
+    // numbers are common (and simple) - write them directly rather than converting to a String first
+    char buf[JS_NUMBER_BUFFER_SIZE];
+    if (jsvIsFloat(var)) ftoa_bounded(jsvGetFloat(var), buf, sizeof(buf));
+    else itoa(jsvGetInteger(var), buf, 10);
+    jsonWrite(w, buf);
   } else {
-    cbprintf(user_callback, user_data, "%v", var);
+    cbprintf(jsonWriterCallback, w, "%v", var);
+  }
+}
+
+void jsfGetJSONWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user_callback, void *user_data) {
+  if (user_callback == jsonWriterCallback) {
+    // we're being called from inside another JSON dump (eg. via jsfGetJSONForFunctionWithCallback)
+    jsfGetJSONWithWriter(var, flags, (JsonWriter*)user_data);
+    return;
   }
+  JsonWriter w;
+  w.user_callback = user_callback;
+  w.user_data = user_data;
+  w.len = 0;
+  jsfGetJSONWithWriter(var, flags, &w);
+  jsonWriterFlush(&w);
 }
 
 void jsfGetJSON(JsVar *var, JsVar *result, JSONFlags flags) {
@@ -290,14 +861,14 @@ void jsfGetJSON(JsVar *var, JsVar *result, JSONFlags flags) {
   jsvStringIteratorNew(&it, result, 0);
   jsvStringIteratorGotoEnd(&it);
 
-  jsfGetJSONWithCallback(var, flags, (vcbprintf_callback)&jsvStringIteratorPrintfCallback, &it);
+  jsfGetJSONWithCallback(var, flags, jsvStringIteratorPrintfCallback, &it);
 
   jsvStringIteratorFree(&it);
 }
 
 void jsfPrintJSON(JsVar *var, JSONFlags flags) {
-  jsfGetJSONWithCallback(var, flags, (vcbprintf_callback)jsiConsolePrint, 0);
+  jsfGetJSONWithCallback(var, flags, jsiConsolePrintCallback, 0);
 }
 void jsfPrintJSONForFunction(JsVar *var, JSONFlags flags) {
-  jsfGetJSONForFunctionWithCallback(var, flags, (vcbprintf_callback)jsiConsolePrint, 0);
+  jsfGetJSONForFunctionWithCallback(var, flags, jsiConsolePrintCallback, 0);
 }
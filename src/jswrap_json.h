@@ -15,6 +15,9 @@
 
 JsVar *jswrap_json_stringify(JsVar *v);
 JsVar *jswrap_json_parse(JsVar *v);
+JsVar *jswrap_json_parser();
+bool jswrap_json_parser_write(JsVar *parent, JsVar *data);
+JsVar *jswrap_json_parser_end(JsVar *parent, JsVar *data);
 
 typedef enum {
   JSON_NONE,
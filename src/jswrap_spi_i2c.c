@@ -215,6 +215,19 @@ JsVar *jswrap_spi_send(JsVar *parent, JsVar *srcdata, Pin nss_pin) {
   return dst;
 }
 
+// Send bytes without keeping what is received - used by native code that streams data out (eg. Graphics.flipTo)
+void spi_send_bytes(IOEventFlags device, const unsigned char *data, size_t count) {
+  if (!jshIsDeviceInitialised(device)) {
+    JshSPIInfo inf;
+    jshSPIInitInfo(&inf);
+    jshSPISetup(device, &inf);
+  }
+  size_t i;
+  for (i=0;i<count;i++)
+    jshSPISend(device, data[i]);
+  jshSPISend(device, -1); // wait for the last byte to be sent
+}
+
 // used by jswrap_spi_send4bit
 void spi_send4bit(IOEventFlags device, unsigned char data, int bit0, int bit1) {
   unsigned char lookup[] = {
@@ -13,6 +13,9 @@
  */
 #include "jsvar.h"
 #include "jspin.h"
+#include "jsdevices.h"
+
+void spi_send_bytes(IOEventFlags device, const unsigned char *data, size_t count);
 
 void jswrap_spi_setup(JsVar *parent, JsVar *options);
 JsVar *jswrap_spi_send(JsVar *parent, JsVar *data, Pin nss_pin);
@@ -101,40 +101,46 @@ int jswrap_string_charCodeAt(JsVar *parent, JsVarInt idx) {
          "return" : ["int32", "The index of the string, or -1 if not found"]
 }*/
 int jswrap_string_indexOf(JsVar *parent, JsVar *substring, JsVar *fromIndex, bool lastIndexOf) {
-  // slow, but simple!
   substring = jsvAsString(substring, false);
   if (!substring) return 0; // out of memory
   int parentLength = (int)jsvGetStringLength(parent);
-  int lastPossibleSearch = parentLength - (int)jsvGetStringLength(substring);
-  int idx, dir, end;
-  if (!lastIndexOf) { // normal indexOf
-    dir = 1;
-    end = lastPossibleSearch+1;
-    idx = 0;
-    if (jsvIsNumeric(fromIndex)) {
-      idx = (int)jsvGetInteger(fromIndex);
-      if (idx<0) idx=0;
-      if (idx>end) idx=end;
-    }
-  } else {
-    dir = -1;
-    end = -1;
-    idx = lastPossibleSearch;
-    if (jsvIsNumeric(fromIndex)) {
-      idx = (int)jsvGetInteger(fromIndex);
-      if (idx<0) idx=0;
-      if (idx>lastPossibleSearch) idx=lastPossibleSearch;
-    }
+  int substringLength = (int)jsvGetStringLength(substring);
+  int lastPossibleSearch = parentLength - substringLength;
+  if (lastPossibleSearch < 0) {
+    jsvUnLock(substring);
+    return -1;
+  }
+  int idx = lastIndexOf ? lastPossibleSearch : 0;
+  if (jsvIsNumeric(fromIndex)) {
+    idx = (int)jsvGetInteger(fromIndex);
+    if (idx<0) idx=0;
+    if (idx>parentLength) idx=parentLength;
+  }
+  if (idx>lastPossibleSearch) {
+    if (!lastIndexOf && substringLength) idx = -1; // starting too late to find it
+    else idx = lastPossibleSearch;
+  }
+  if (substringLength==0 || idx<0) { // the empty string is found wherever we start
+    jsvUnLock(substring);
+    return idx;
   }
 
-  for (;idx!=end;idx+=dir) {
-    if (jsvCompareString(parent, substring, (size_t)idx, 0, true)==0) {
-      jsvUnLock(substring);
-      return idx;
-    }
+  JsvStringSearch search;
+  int found;
+  if (!lastIndexOf) {
+    jsvStringSearchNew(&search, parent, substring, (size_t)idx);
+    found = jsvStringSearchNext(&search);
+  } else {
+    // strings can only be iterated forwards, so find the last match that starts at or before idx
+    jsvStringSearchNew(&search, parent, substring, 0);
+    found = -1;
+    int next;
+    while ((next = jsvStringSearchNext(&search))>=0 && next<=idx)
+      found = next;
   }
+  jsvStringSearchFree(&search);
   jsvUnLock(substring);
-  return -1;
+  return found;
 }
 
 /*JSON{ "type":"method", "class": "String", "name" : "substring",
@@ -180,34 +186,54 @@ JsVar *jswrap_string_substr(JsVar *parent, JsVarInt pStart, JsVar *vLen) {
 /*JSON{ "type":"method", "class": "String", "name" : "split",
          "description" : "Return an array made by splitting this string up by the separator. eg. ```'1,2,3'.split(',')==[1,2,3]```",
          "generate" : "jswrap_string_split",
-         "params" : [ [ "separator", "JsVar", "The start character index"] ],
-         "return" : ["JsVar", "Part of this string from start for len characters"]
+         "params" : [ [ "separator", "JsVar", "The string to split on. If this is an empty string, the string is split into characters"] ],
+         "return" : ["JsVar", "An array of the parts of this string between each separator"]
 }*/
 JsVar *jswrap_string_split(JsVar *parent, JsVar *split) {
-  JsVar *array;
-  int arraylen=0;
-  int idx, last = 0;
-  int splitlen =  (int)jsvGetStringLength(split);
-  int l = (int)jsvGetStringLength(parent) - splitlen;
-
-  array = jsvNewWithFlags(JSV_ARRAY);
+  JsVar *array = jsvNewWithFlags(JSV_ARRAY);
   if (!array) return 0; // out of memory
+  if (jsvIsUndefined(split)) {
+    jsvArrayPush(array, parent);
+    return array;
+  }
+  split = jsvAsString(split, false);
+  if (!split) return array; // out of memory
+  size_t splitlen = jsvGetStringLength(split);
 
-  for (idx=0;idx<=l;idx++) {
-    if (idx==l || jsvCompareString(parent, split, (size_t)idx, 0, true)==0) {
+  // The search and 'it' both go through the string once - 'it' copies out each part behind the search
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, parent, 0);
+  if (splitlen==0) { // split into characters
+    while (jsvStringIteratorHasChar(&it)) {
+      char ch[2] = { jsvStringIteratorGetChar(&it), 0 };
+      jsvArrayPushAndUnLock(array, jsvNewFromString(ch));
+      jsvStringIteratorNext(&it);
+    }
+  } else {
+    JsvStringSearch search;
+    jsvStringSearchNew(&search, parent, split, 0);
+    int idx;
+    size_t last = 0;
+    do {
+      idx = jsvStringSearchNext(&search);
       JsVar *part = jsvNewFromEmptyString();
       if (!part) break; // out of memory
-      JsVar *idxvar = jsvMakeIntoVariableName(jsvNewFromInteger(arraylen++), part);
-      if (idxvar) { // could be out of memory
-        if (idx==l) idx=l+splitlen; // if the last element, do to the end of the string
-        jsvAppendStringVar(part, parent, (size_t)last, (size_t)(idx-last));
-        jsvAddName(array, idxvar);
-        last = idx+splitlen;
-        jsvUnLock(idxvar);
+      JsvStringIterator dst;
+      jsvStringIteratorNew(&dst, part, 0);
+      // the last part is everything that's left
+      jsvStringIteratorAppendFromIterator(&dst, &it, (idx<0) ? JSVAPPENDSTRINGVAR_MAXLENGTH : (size_t)idx-last);
+      jsvStringIteratorFree(&dst);
+      jsvArrayPushAndUnLock(array, part);
+      if (idx>=0) {
+        jsvStringIteratorSkip(&it, splitlen);
+        last = (size_t)idx + splitlen;
+        search.pos = last; // don't find separators that overlap this one
       }
-      jsvUnLock(part);
-    }
+    } while (idx>=0);
+    jsvStringSearchFree(&search);
   }
+  jsvStringIteratorFree(&it);
+  jsvUnLock(split);
   return array;
 }
 
@@ -46,6 +46,24 @@ static JsVar *jswrap_waveform_getBuffer(JsVar *waveform, int bufferNumber, bool
   return buffer;
 }
 
+/* The utility timer reads samples straight out of the String's JsVars
+ * from an IRQ, so waveform buffers must always be backed by a String */
+static JsVar *jswrap_waveform_newBuffer(JsVarDataArrayBufferViewType type, int samples) {
+  int byteLength = samples * (int)JSV_ARRAYBUFFER_GET_SIZE(type);
+  if (byteLength > 65535) {
+    jsError("Too many samples");
+    return 0;
+  }
+  JsVar *str = jsvNewStringOfLength((unsigned int)byteLength);
+  if (!str) return 0;
+  JsVar *arrayBuffer = jsvNewArrayBufferWithData(str, (size_t)byteLength);
+  jsvUnLock(str);
+  if (!arrayBuffer) return 0;
+  JsVar *view = jswrap_typedarray_constructor(type, arrayBuffer, 0, 0);
+  jsvUnLock(arrayBuffer);
+  return view;
+}
+
 
 /*JSON{ "type":"idle", "generate" : "jswrap_waveform_idle", "ifndef" : "SAVE_ON_FLASH" }*/
 bool jswrap_waveform_idle() {
@@ -156,12 +174,10 @@ JsVar *jswrap_waveform_constructor(int samples, JsVar *options) {
     jsError("Expecting options to be undefined or an Object, not %t", options);
   }
 
-  JsVar *arrayLength = jsvNewFromInteger(samples);
   JsVarDataArrayBufferViewType bufferType = use16bit ? ARRAYBUFFERVIEW_UINT16 : ARRAYBUFFERVIEW_UINT8;
-  JsVar *arrayBuffer = jswrap_typedarray_constructor(bufferType, arrayLength, 0, 0);
+  JsVar *arrayBuffer = jswrap_waveform_newBuffer(bufferType, samples);
   JsVar *arrayBuffer2 = 0;
-  if (doubleBuffer) arrayBuffer2 = jswrap_typedarray_constructor(bufferType, arrayLength, 0, 0);
-  jsvUnLock(arrayLength);
+  if (doubleBuffer) arrayBuffer2 = jswrap_waveform_newBuffer(bufferType, samples);
   JsVar *waveform = jspNewObject(0, "Waveform");
 
 
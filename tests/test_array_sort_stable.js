@@ -0,0 +1,42 @@
+// Sort is stable, puts undefined at the end, and copes with sorted/reverse-sorted and typed data
+
+var objs = [];
+for (var i=0;i<60;i++) objs.push({k:(i*7)%4, i:i});
+objs.sort(function(a,b) { return a.k-b.k; });
+var stable = true;
+for (var i=1;i<objs.length;i++)
+  if (objs[i].k<objs[i-1].k || (objs[i].k==objs[i-1].k && objs[i].i<objs[i-1].i)) stable = false;
+
+var rev = [];
+for (var i=0;i<300;i++) rev.push(300-i);
+rev.sort();
+var sorted = true;
+for (var i=0;i<300;i++) if (rev[i]!=i+1) sorted = false;
+
+var u = [3,undefined,1,"b","a",2].sort().toString();
+
+var f = new Float32Array([2.5,-1,0,100,-50.25]);
+f.sort();
+var i16 = new Int16Array([5,-3,200,7,-1000]);
+i16.sort(function(a,b) { return b-a; });
+var sub = new Uint8Array([9,8,7,6,5,4]);
+sub.subarray(1,5).sort();
+
+// typed arrays with more elements than there are free vars don't lose any data
+var n = process.memory().free+500;
+var big = new Uint8Array(n), sum = 0;
+for (var i=0;i<n;i++) { big[i] = (i*37+11)&255; sum += big[i]; }
+big.sort(function(a,b) { return a-b; });
+var bigSorted = true;
+for (var i=0;i<n;i++) {
+  if (i && big[i]<big[i-1]) bigSorted = false;
+  sum -= big[i];
+}
+// a compare function that treats values as equal keeps them in order
+var tens = new Int8Array([31,12,35,17,14,33,19,38,11,36,15]);
+tens.sort(function(a,b) { return ((a/10)|0) - ((b/10)|0); });
+
+result = stable && sorted && u=="1,2,3,a,b," &&
+         f.toString()=="-50.25,-1,0,2.5,100" && i16.toString()=="200,7,5,-3,-1000" &&
+         sub.toString()=="9,5,6,7,8,4" && bigSorted && sum==0 &&
+         tens.toString()=="12,17,14,19,11,15,31,35,33,38,36";
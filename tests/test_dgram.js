@@ -0,0 +1,18 @@
+// UDP datagram send and receive test
+
+var result = 0;
+var dgram = require("dgram");
+var got = [];
+
+var server = dgram.createSocket("udp4", function(msg, rinfo) {
+  got.push(msg);
+  if (got.length==20) {
+    result = got[0]=="msg0" && got[19]=="msg19" && rinfo.address=="127.0.0.1" && rinfo.size==5;
+    server.close();
+    client.close();
+  }
+});
+server.bind(8125);
+
+var client = dgram.createSocket("udp4");
+for (var i=0;i<20;i++) client.send("msg"+i, 8125, "127.0.0.1");
@@ -0,0 +1,35 @@
+// E.* DSP functions on typed arrays and plain Arrays
+
+var arr = [3,-1,4,1,-5,9,2,-6];
+var i16 = new Int16Array(arr);
+var f32 = new Float32Array(arr);
+
+var mm = E.minMax(i16);
+var mmA = E.minMax(arr);
+
+var fir = new Float64Array(8);
+E.FIR(i16, [0.5,0.5], fir);
+var firA = [0,0,0,0,0,0,0,0];
+E.FIR(arr, [0.5,0.5], firA);
+var inPlace = new Int16Array(arr);
+E.FIR(inPlace, [1,1]); // in place
+
+var sc = new Uint8Array([1,2,3]);
+E.scale(sc, 2, 1);
+var scA = [1,2,3];
+E.scale(scA, 2, 1);
+
+var firOk = true;
+for (var i=0;i<8;i++) {
+  var expected = 0.5*arr[i] + 0.5*(i ? arr[i-1] : 0);
+  if (fir[i]!=expected || firA[i]!=expected) firOk = false;
+  if (inPlace[i]!=(arr[i] + (i ? arr[i-1] : 0))) firOk = false;
+}
+
+result = E.sum(i16)==7 && E.sum(f32)==7 &&
+         E.variance(i16, 1)==E.variance(arr, 1) &&
+         E.convolve(i16, f32, 1)==E.convolve(arr, arr, 1) &&
+         E.dot(i16, f32)==173 && E.dot(arr, [1,1])==2 &&
+         mm.min==-6 && mm.max==9 && mmA.min==-6 && mmA.max==9 &&
+         E.minMax([])===undefined && firOk &&
+         sc[0]==3 && sc[2]==7 && scA[1]==5;
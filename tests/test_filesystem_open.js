@@ -0,0 +1,72 @@
+// Test File handles from fs.open - reading, writing and seeking without loading the whole file
+var fs = require("fs");
+var name = "test_filesystem_open.tmp";
+
+result = 1;
+function expect(what, got, shouldBe) {
+  if (got!==shouldBe) {
+    console.log("FAIL: "+what+" gave "+JSON.stringify(got)+", should be "+JSON.stringify(shouldBe));
+    result = 0;
+  }
+}
+
+// keep one file open and write to it several times
+var f = fs.open(name, "w");
+for (var i=0;i<10;i++) f.write("line "+i+"\n");
+expect("write", f.write("end"), 3);
+f.close();
+expect("file length", fs.readFile(name).length, 10*7+3);
+
+// append
+f = fs.open(name, "a");
+f.write("!");
+f.close();
+expect("append", fs.readFile(name).substr(-4), "end!");
+
+// read in fixed windows
+f = fs.open(name);
+var windows = 0, longest = 0, total = "", d;
+while ((d = f.read(16))!==undefined) {
+  if (d.length>longest) longest = d.length;
+  total = total + d;
+  windows++;
+}
+expect("longest read", longest, 16);
+expect("read windows", windows, 5);
+expect("read everything", total, fs.readFile(name));
+// seek back and read again
+expect("seek", f.seek(5), true);
+expect("read after seek", f.read(2), "0\n");
+f.close();
+expect("read after close", f.read(1), undefined);
+
+// read and write the same file
+f = fs.open(name, "r+");
+f.seek(5);
+f.write("X");
+f.seek(0);
+expect("r+", f.read(7), "line X\n");
+f.close();
+
+expect("missing file", fs.open("not_a_file.tmp"), undefined);
+
+// only a few files can be open at once, and closing one frees it up
+var files = [];
+for (i=0;i<5;i++) files.push(fs.open(name));
+expect("too many files", files[4], undefined);
+files[0].close();
+files[4] = fs.open(name);
+expect("open after close", files[4].read(4), "line");
+for (i in files) files[i].close();
+
+// files stay open over save(), so can be written afterwards
+f = fs.open(name, "w");
+f.write("before ");
+save();
+setTimeout(function() {
+  fs.unlink("espruino.state");
+  expect("write after save", f.write("after"), 5);
+  f.close();
+  expect("file after save", fs.readFile(name), "before after");
+  fs.unlink(name);
+}, 10);
@@ -0,0 +1,50 @@
+// Check Graphics ArrayBuffer fills against a simple model, for each bpp and layout
+
+var seed = 1;
+function rnd(n) { seed = (seed*1103515245 + 12345) & 0x7FFFFFFF; return seed % n; }
+
+function check(bpp, opts, w, h) {
+  var g = Graphics.createArrayBuffer(w,h,bpp,opts);
+  var mask = bpp==32 ? 0xFFFFFFFF : (1<<bpp)-1;
+  var model = [];
+  for (var i=0;i<w*h;i++) model[i] = 0;
+  for (var n=0;n<40;n++) {
+    var x1 = rnd(w+10)-5, y1 = rnd(h+10)-5, x2 = rnd(w+10)-5, y2 = rnd(h+10)-5;
+    if (n==0) { x1=0; x2=w-1; y1=1; y2=3; } // whole rows
+    var col = rnd(0x1000000) | (rnd(256)<<24);
+    g.setColor(col);
+    g.fillRect(x1,y1,x2,y2);
+    if (x1>x2) { var t=x1; x1=x2; x2=t; }
+    if (y1>y2) { var t=y1; y1=y2; y2=t; }
+    for (var y=y1;y<=y2;y++)
+      for (var x=x1;x<=x2;x++)
+        if (x>=0 && y>=0 && x<w && y<h) model[x+y*w] = col & mask;
+    var px = rnd(w), py = rnd(h);
+    g.setPixel(px,py,n);
+    model[px+py*w] = n & mask;
+  }
+  for (var y=0;y<h;y++)
+    for (var x=0;x<w;x++)
+      if (((g.getPixel(x,y) ^ model[x+y*w]) & mask) != 0) {
+        console.log("Mismatch", bpp, JSON.stringify(opts), w, x, y, g.getPixel(x,y), model[x+y*w]);
+        return false;
+      }
+  return true;
+}
+
+result = 1;
+var bpps = [1,2,4,8,16,24,32];
+for (var i in bpps) {
+  if (!check(bpps[i], {}, 37, 9)) result = 0;
+  if (!check(bpps[i], {zigzag:true}, 21, 6)) result = 0;
+}
+if (!check(1, {vertical_byte:true}, 19, 24)) result = 0;
+if (!check(1, {vertical_byte:true, zigzag:true}, 19, 16)) result = 0;
+
+// 2bpp packs the first pixel into the low bits
+var g = Graphics.createArrayBuffer(8,1,2);
+g.setColor(1); g.fillRect(0,0,0,0);
+g.setColor(2); g.fillRect(1,0,1,0);
+g.setColor(3); g.fillRect(5,0,6,0);
+var b = new Uint8Array(g.buffer);
+if (b[0]!=9 || b[1]!=0x3C) result = 0;
@@ -0,0 +1,95 @@
+// Graphics.createCallback with 'spans' sends batches of x,y,length,color runs
+
+result = 1;
+var batches = [];
+var out = Graphics.createArrayBuffer(32,24,8);
+var g = Graphics.createCallback(32,24,8,{
+  spans : function(data,count) {
+    batches.push(count);
+    for (var i=0;i<count*4;i+=4) {
+      out.setColor(data[i+3]);
+      out.fillRect(data[i],data[i+1],data[i]+data[i+2]-1,data[i+1]);
+    }
+  },
+  batch : 4
+});
+// the same drawing, straight into an ArrayBuffer
+var ref = Graphics.createArrayBuffer(32,24,8);
+function draw(g) {
+  g.setColor(200);
+  g.fillRect(2,2,5,3);
+  g.setColor(100);
+  g.drawLine(0,23,31,0);
+  g.setColor(50);
+  g.fillPoly([10,5, 30,10, 15,20]);
+  g.setColor(255);
+  g.drawString("Hi!",1,10);
+}
+
+g.setColor(200);
+g.fillRect(2,2,5,3); // 2 spans - not enough for a batch yet
+if (batches.length!=0) {
+  console.log("FAIL: sent "+batches+" before the batch was full");
+  result = 0;
+}
+g.flip();
+if (batches.length!=1 || batches[0]!=2 || out.getPixel(2,2)!=200 || out.getPixel(5,3)!=200) {
+  console.log("FAIL: flip sent "+batches);
+  result = 0;
+}
+
+// pixels next to each other in the same colour are joined up
+batches = [];
+g.setPixel(10,10);
+g.setPixel(11,10);
+g.setPixel(12,10);
+g.flip();
+if (batches.length!=1 || batches[0]!=1) {
+  console.log("FAIL: adjacent pixels sent as "+batches);
+  result = 0;
+}
+
+// full batches are sent straight away, and the result matches drawing directly
+batches = [];
+out.clear();
+draw(g);
+draw(ref);
+if (batches.length<2 || batches[0]!=4) {
+  console.log("FAIL: full batches sent as "+batches);
+  result = 0;
+}
+g.flip();
+for (var y=0;y<24;y++) for (var x=0;x<32;x++)
+  if (out.getPixel(x,y)!=ref.getPixel(x,y)) {
+    if (result) console.log("FAIL: spans drew "+out.getPixel(x,y)+" at "+x+","+y+", should be "+ref.getPixel(x,y));
+    result = 0;
+  }
+
+// the callback can draw to another Graphics with spans, without its spans getting lost
+var inner = Graphics.createArrayBuffer(32,24,8);
+var b = Graphics.createCallback(32,24,8,{
+  spans : function(data,count) {
+    for (var i=0;i<count*4;i+=4) {
+      inner.setColor(data[i+3]);
+      inner.fillRect(data[i],data[i+1],data[i]+data[i+2]-1,data[i+1]);
+    }
+  },
+  batch : 16
+});
+var a = Graphics.createCallback(32,24,8,{
+  spans : function(data,count) {
+    for (var i=0;i<count*4;i+=4) {
+      b.setColor(data[i+3]);
+      b.fillRect(data[i],data[i+1],data[i]+data[i+2]-1,data[i+1]);
+    }
+  },
+  batch : 4
+});
+a.setColor(77);
+a.fillRect(1,1,8,6);
+a.flip();
+b.flip();
+if (inner.getPixel(1,1)!=77 || inner.getPixel(8,6)!=77 || inner.getPixel(9,6)!=0) {
+  console.log("FAIL: spans drawn from a spans callback were lost");
+  result = 0;
+}
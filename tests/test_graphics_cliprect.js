@@ -0,0 +1,75 @@
+// Graphics.setClipRect stops anything being drawn outside the clip rect
+
+function count(g) {
+  var n = 0;
+  for (var y=0;y<g.getHeight();y++) for (var x=0;x<g.getWidth();x++) if (g.getPixel(x,y)) n++;
+  return n;
+}
+// are all the set pixels inside x1,y1,x2,y2?
+function inside(g,x1,y1,x2,y2) {
+  for (var y=0;y<g.getHeight();y++) for (var x=0;x<g.getWidth();x++)
+    if (g.getPixel(x,y) && (x<x1 || y<y1 || x>x2 || y>y2)) return false;
+  return true;
+}
+
+result = 1;
+var g = Graphics.createArrayBuffer(32,32,8);
+g.setClipRect(20,4,8,12); // corners are sorted
+g.fillRect(0,0,31,31);
+if (count(g)!=13*9 || !inside(g,8,4,20,12)) {
+  console.log("FAIL: fillRect filled "+count(g)+" pixels");
+  result = 0;
+}
+g.clear();
+if (count(g)!=0) { // clear is clipped too, and cleared the whole clip rect
+  console.log("FAIL: clear left "+count(g)+" pixels");
+  result = 0;
+}
+
+g.setPixel(5,5);
+g.setPixel(10,5);
+if (count(g)!=1 || g.getPixel(10,5)!=255) {
+  console.log("FAIL: setPixel isn't clipped");
+  result = 0;
+}
+g.clear();
+g.drawLine(0,0,31,31);
+g.drawRect(0,0,31,31);
+g.fillPoly([0,0, 31,16, 0,31]);
+g.setFontVector(16);
+g.drawString("Hi",0,0);
+g.setFontBitmap();
+g.drawString("Hello",0,6);
+if (!count(g) || !inside(g,8,4,20,12)) {
+  console.log("FAIL: lines, polys or text aren't clipped");
+  result = 0;
+}
+
+// images are clipped, and so is the modified area
+g.clear();
+g.getModified(true);
+g.drawImage({width:8,height:8,bpp:1,buffer:new Uint8Array([255,255,255,255,255,255,255,255]).buffer},4,10);
+var m = g.getModified(true);
+if (count(g)!=4*3 || !inside(g,8,10,11,12)) {
+  console.log("FAIL: drawImage drew "+count(g)+" pixels");
+  result = 0;
+}
+if (m.x1!=8 || m.y1!=10 || m.x2!=11 || m.y2!=12) {
+  console.log("FAIL: modified area "+[m.x1,m.y1,m.x2,m.y2]+" isn't clipped");
+  result = 0;
+}
+
+// offscreen clip rects don't draw anything, and the whole screen can be drawn again
+g.clear();
+g.setClipRect(-10,-10,-5,-5);
+g.fillRect(0,0,31,31);
+if (count(g)!=0) {
+  console.log("FAIL: offscreen clip rect drew "+count(g)+" pixels");
+  result = 0;
+}
+g.setClipRect(0,0,g.getWidth()-1,g.getHeight()-1);
+g.fillRect(0,0,31,31);
+if (count(g)!=32*32) {
+  console.log("FAIL: resetting the clip rect only filled "+count(g)+" pixels");
+  result = 0;
+}
@@ -0,0 +1,87 @@
+// Graphics.drawImage compared against drawing the same image with setPixel
+
+var img8 = { width:5, height:3, bpp:8, buffer:new Uint8Array([1,2,3,4,5, 6,7,0,9,10, 11,12,13,14,15]).buffer };
+var img1 = { width:10, height:2, bpp:1, buffer:String.fromCharCode(0xA5,0x3C,0xF0) };
+var img16 = { width:2, height:2, bpp:16, buffer:new Uint16Array([0x1234,0xFFFF,0,0x8001]) };
+
+function imgPixel(img, x, y) {
+  var i = x + y*img.width;
+  if (img.bpp==1) return (img.buffer.charCodeAt(i>>3) >> (i&7)) & 1;
+  if (img.bpp==8) return new Uint8Array(img.buffer)[i];
+  return img.buffer[i];
+}
+
+// draw the image pixel by pixel, the way drawImage should
+function reference(g, img, px, py, opts) {
+  if (opts===undefined) opts = {};
+  var scale = 1;
+  if (opts.scale) scale = opts.scale;
+  var w = img.width, h = img.height;
+  if (opts.rotate90) { w = img.height; h = img.width; }
+  for (var y=0;y<h*scale;y++)
+    for (var x=0;x<w*scale;x++) {
+      var ix = Math.floor(x/scale), iy = Math.floor(y/scale);
+      var c;
+      if (opts.rotate90) c = imgPixel(img, iy, img.height-1-ix);
+      else c = imgPixel(img, ix, iy);
+      if (opts.transparent===undefined || c!=opts.transparent) {
+        if (img.bpp==1) {
+          if (c) c = g.getColor(); else c = g.getBgColor();
+        }
+        g.setPixel(px+x, py+y, c);
+      }
+    }
+}
+
+function compare(a, b) {
+  for (var y=0;y<a.getHeight();y++)
+    for (var x=0;x<a.getWidth();x++)
+      if (a.getPixel(x,y)!=b.getPixel(x,y)) return false;
+  return true;
+}
+
+var tests = [
+  [img8, 1, 1, undefined],
+  [img8, -2, 5, {rotate90:true}],
+  [img8, 3, -1, {scale:3, transparent:0}],
+  [img1, 0, 0, undefined],
+  [img1, 2, 3, {transparent:0}],
+  [img1, 9, 1, {rotate90:true, scale:2}],
+  [img16, 4, 4, {scale:2}],
+];
+
+result = 1;
+var bpps = [1,8,16,32];
+for (var b in bpps) {
+  for (var t in tests) {
+    var a = Graphics.createArrayBuffer(13,11,bpps[b]);
+    var r = Graphics.createArrayBuffer(13,11,bpps[b]);
+    [a,r].forEach(function(g) { g.setColor(0x7777); g.setBgColor(0x2222); g.clear(); g.setBgColor(0x5555); });
+    a.drawImage(tests[t][0], tests[t][1], tests[t][2], tests[t][3]);
+    reference(r, tests[t][0], tests[t][1], tests[t][2], tests[t][3]);
+    if (!compare(a, r)) {
+      console.log("Failed test "+t+" at "+bpps[b]+"bpp");
+      result = 0;
+    }
+  }
+}
+
+// A callback Graphics (uses fillRect spans)
+var pixels = new Uint8Array(8*8);
+var c = Graphics.createCallback(8,8,8,{setPixel:function(x,y,col) { pixels[x+y*8] = col; },
+                                       fillRect:function(x1,y1,x2,y2,col) { for (var y=y1;y<=y2;y++) for (var x=x1;x<=x2;x++) pixels[x+y*8] = col; }});
+c.drawImage(img8, 6, 6);
+if (pixels[6+6*8]!=1 || pixels[7+6*8]!=2 || pixels[6+7*8]!=6 || pixels[7+7*8]!=7 || pixels[5+6*8]!=0) {
+  console.log("Failed callback");
+  result = 0;
+}
+
+// Rows wider than the chunk of pixels drawImage converts at once
+var a = Graphics.createArrayBuffer(90,5,8);
+var r = Graphics.createArrayBuffer(90,5,8);
+a.drawImage(img1, 3, 0, {scale:8, transparent:0});
+reference(r, img1, 3, 0, {scale:8, transparent:0});
+if (!compare(a, r)) {
+  console.log("Failed wide image");
+  result = 0;
+}
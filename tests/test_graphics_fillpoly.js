@@ -0,0 +1,101 @@
+// Graphics.fillPoly fills the pixels whose centres are inside the polygon, and every pixel an edge passes through
+
+function count(g,w,h) {
+  var n = 0;
+  for (var y=0;y<h;y++) for (var x=0;x<w;x++) if (g.getPixel(x,y)) n++;
+  return n;
+}
+function same(a,b,w,h) {
+  for (var y=0;y<h;y++) for (var x=0;x<w;x++) if (a.getPixel(x,y)!=b.getPixel(x,y)) return false;
+  return true;
+}
+
+result = 1;
+function test(ok, what) {
+  if (!ok) {
+    console.log("FAIL: "+what);
+    result = 0;
+  }
+}
+
+var a = Graphics.createArrayBuffer(24,24,8);
+var b = Graphics.createArrayBuffer(24,24,8);
+// a 0..10 square covers 11x11 pixels, the same as fillRect(0,0,10,10)
+a.fillPoly([0,0, 10,0, 10,10, 0,10]);
+b.fillRect(0,0,10,10);
+test(same(a,b,24,24), "square");
+// concave 'L' shape
+a.clear(); b.clear();
+a.fillPoly([2,2, 6,2, 6,12, 16,12, 16,16, 2,16]);
+b.fillRect(2,2,6,16);
+b.fillRect(6,12,16,16);
+test(same(a,b,24,24), "L shape");
+// 'U' shape - rows through the arms are crossed 4 times, so the gap stays empty
+a.clear(); b.clear();
+a.fillPoly([2,2, 5,2, 5,10, 9,10, 9,2, 12,2, 12,14, 2,14]);
+b.fillRect(2,2,5,14);
+b.fillRect(9,2,12,14);
+b.fillRect(5,10,9,14);
+test(same(a,b,24,24), "U shape");
+// offscreen polys draw nothing
+a.clear();
+a.fillPoly([-20,-20, -5,-20, -5,-5]);
+a.fillPoly([30,5, 40,5, 40,20]);
+test(count(a,24,24)==0, "offscreen");
+
+// thin and zero-width polys still draw every pixel they cross
+var c = Graphics.createArrayBuffer(40,20,8);
+c.fillPoly([0,5, 20,5, 20,5, 0,5]);
+test(count(c,40,20)==21, "horizontal line has "+count(c,40,20)+" pixels");
+c.clear();
+c.fillPoly([5,0, 5,10]);
+test(count(c,40,20)==11, "vertical line has "+count(c,40,20)+" pixels");
+c.clear();
+c.fillPoly([0,0, 30,1, 30,2, 0,1]);
+for (var x=0;x<=30;x++)
+  if (!c.getPixel(x,0) && !c.getPixel(x,1) && !c.getPixel(x,2))
+    test(false, "sliver has a gap at "+x);
+
+// antialiasing blends edges with the background when bpp>=8...
+function hasPartial(g,w,h) {
+  for (var y=0;y<h;y++) for (var x=0;x<w;x++) {
+    var c = g.getPixel(x,y);
+    if (c!=0 && c!=255) return true;
+  }
+  return false;
+}
+a.clear();
+a.setColor(255);
+a.setAntialias(true);
+a.fillPoly([1,1, 20,4, 6,22]);
+test(hasPartial(a,24,24), "antialiasing");
+// ...but has no effect on 1bpp
+var m = Graphics.createArrayBuffer(24,24,1);
+var n = Graphics.createArrayBuffer(24,24,1);
+m.setAntialias(true);
+m.fillPoly([1,1, 20,4, 6,22]);
+n.fillPoly([1,1, 20,4, 6,22]);
+test(same(m,n,24,24) && count(m,24,24)>0, "antialiasing at 1bpp");
+
+// vector text draws, and moving it moves every pixel with it
+var t1 = Graphics.createArrayBuffer(40,24,1);
+var t2 = Graphics.createArrayBuffer(40,24,1);
+t1.setFontVector(12);
+t2.setFontVector(12);
+t1.drawString("Ab&8",0,0);
+t2.drawString("Ab&8",3,2);
+test(count(t1,40,24)>40, "vector text");
+var moved = true;
+for (var y=0;y<20;y++) for (var x=0;x<36;x++)
+  if (t1.getPixel(x,y)!=t2.getPixel(x+3,y+2)) moved = false;
+test(moved, "moved vector text");
+
+// small vector text keeps all its strokes - eg. the crossbar of the 'H'
+c.clear();
+c.setFontVector(8);
+c.drawString("Hello 42",0,0);
+test(count(c,40,20)>150, "small vector text has "+count(c,40,20)+" pixels");
+var crossbar = false;
+for (var y=1;y<9;y++)
+  if (c.getPixel(3,y) && c.getPixel(4,y) && c.getPixel(5,y)) crossbar = true;
+test(crossbar, "small 'H' has no crossbar");
@@ -0,0 +1,75 @@
+// Test Graphics.flipTo converting the modified area of an ArrayBuffer Graphics for SPI displays
+result = 1;
+var out = "";
+var spi = { send : function(d) { out = out + d; } };
+function bytes() {
+  var a = [];
+  for (var i=0;i<out.length;i++) a.push(out.charCodeAt(i));
+  out = "";
+  return a.join(",");
+}
+
+// 16 bit, only the modified pixel is sent (big-endian)
+var g = Graphics.createArrayBuffer(8,8,16);
+g.flipTo(spi, {window:function(){}}); // clear modified area
+out = "";
+var win;
+g.setColor(0xF800);
+g.setPixel(1,2);
+g.flipTo(spi, {window:function(x1,y1,x2,y2) { win = [x1,y1,x2,y2].join(","); }});
+var sent = bytes();
+if (win!="1,2,1,2" || sent!="248,0") {
+  console.log("Failed 16 bit - window "+win+", sent "+sent);
+  result = 0;
+}
+// nothing has changed, so nothing is sent
+g.flipTo(spi, {window:function(x1,y1,x2,y2) { win = "called"; }});
+if (out.length!=0 || win=="called") {
+  console.log("Failed unmodified - sent "+bytes());
+  result = 0;
+}
+
+// 24 bit colours are converted to RGB565
+g = Graphics.createArrayBuffer(4,4,24);
+g.setColor(0x00FF00);
+g.setPixel(0,0);
+g.flipTo(spi, {window:function(){}});
+sent = bytes();
+if (sent!="7,224") {
+  console.log("Failed 24 bit - sent "+sent);
+  result = 0;
+}
+
+// 1bpp pages - whole pages of 8 rows are sent, LSB at the top
+g = Graphics.createArrayBuffer(8,16,1);
+g.setPixel(3,9);
+g.flipTo(spi, {format:"1bpp", window:function(x1,y1,x2,y2) { win = [x1,y1,x2,y2].join(","); }});
+sent = bytes();
+if (win!="3,8,3,15" || sent!="2") {
+  console.log("Failed 1bpp - window "+win+", sent "+sent);
+  result = 0;
+}
+
+// no window, so the whole frame is sent
+g.setPixel(0,0);
+g.flipTo(spi, {format:"1bpp"});
+if (out.length!=16 || out.charCodeAt(0)!=1 || out.charCodeAt(11)!=2) {
+  console.log("Failed whole frame - sent "+bytes());
+  result = 0;
+}
+
+// changes made to the Graphics by the callbacks aren't lost
+g = Graphics.createArrayBuffer(8,8,8);
+g.setPixel(1,1);
+g.flipTo(spi, {window:function() { g.setColor(42); g.setPixel(6,6); }});
+out = "";
+if (g.getColor()!=42) {
+  console.log("Failed keeping the colour set in the window callback");
+  result = 0;
+}
+g.flipTo(spi, {window:function(x1,y1,x2,y2) { win = [x1,y1,x2,y2].join(","); }});
+if (win!="6,6,6,6") {
+  console.log("Failed keeping the area drawn in the window callback - window "+win);
+  result = 0;
+}
+out = "";
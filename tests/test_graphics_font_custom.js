@@ -0,0 +1,53 @@
+// Custom fonts drawn with the offset table made by setFontCustom
+
+// 'A','B','C' of widths 2,3,4 and height 5 - column first, MSB first
+var bmp = String.fromCharCode(0xF8,0x9F,0x5A,0xC3,0x3C,0x81,0x7E);
+var widths = String.fromCharCode(2,3,4);
+
+// draw text pixel by pixel, the way drawString should
+function reference(g, str, x, y) {
+  for (var i=0;i<str.length;i++) {
+    var c = str.charCodeAt(i)-65;
+    if (c>=0 && c<3) {
+      var col = 0;
+      for (var j=0;j<c;j++) col += widths.charCodeAt(j);
+      for (var cx=0;cx<widths.charCodeAt(c);cx++)
+        for (var cy=0;cy<5;cy++) {
+          var bit = (col+cx)*5 + cy;
+          if ((bmp.charCodeAt(bit>>3) << (bit&7)) & 128) g.setPixel(x+cx, y+cy);
+        }
+      x += widths.charCodeAt(c);
+    }
+  }
+}
+
+function same(a, b) {
+  var ba = new Uint8Array(a.buffer), bb = new Uint8Array(b.buffer);
+  for (var i=0;i<ba.length;i++) if (ba[i]!=bb[i]) return false;
+  return true;
+}
+
+var g = Graphics.createArrayBuffer(24,12,8);
+var g2 = Graphics.createArrayBuffer(24,12,8);
+g.setColor(3);
+g2.setColor(3);
+g.setFontCustom(bmp, 65, widths, 5);
+g.drawString("CAB@BA", 1, 1);
+g.drawString("BC", -2, 8); // partly offscreen
+reference(g2, "CAB@BA", 1, 1);
+reference(g2, "BC", -2, 8);
+
+result = 1;
+if (!same(g, g2)) {
+  console.log("FAIL: drawString doesn't match the reference");
+  result = 0;
+}
+if (g.stringWidth("CAB@BA")!=14) {
+  console.log("FAIL: stringWidth is "+g.stringWidth("CAB@BA")+", should be 14");
+  result = 0;
+}
+// characters that aren't in the font have no width
+if (g.stringWidth("AD@")!=2) {
+  console.log("FAIL: stringWidth of missing characters is "+g.stringWidth("AD@")+", should be 2");
+  result = 0;
+}
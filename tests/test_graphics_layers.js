@@ -0,0 +1,37 @@
+// ArrayBuffer Graphics can be drawn onto other Graphics with drawImage
+
+var g = Graphics.createArrayBuffer(16,16,16);
+var layer = Graphics.createArrayBuffer(4,4,8);
+layer.setColor(7);
+layer.fillRect(0,0,3,3);
+layer.setColor(0);
+layer.setPixel(1,1);
+// straight copy - the pixel values are drawn as they are
+g.drawImage(layer,2,3);
+var copied = g.getPixel(2,3)==7 && g.getPixel(5,6)==7 && g.getPixel(3,4)==0 && g.getPixel(6,3)==0;
+// colour key transparency
+g.setBgColor(0x1234);
+g.clear();
+g.drawImage(layer,0,0,{transparent:0});
+var keyed = g.getPixel(0,0)==7 && g.getPixel(1,1)==0x1234;
+
+// palette mapping from a 2bpp layer onto 16bpp
+var l2 = Graphics.createArrayBuffer(4,1,2);
+for (var i=0;i<4;i++) { l2.setColor(i); l2.setPixel(i,0); }
+g.clear();
+g.drawImage(l2,0,8,{palette:new Uint16Array([0x0000,0xF800,0x07E0,0x001F])});
+var paletted = g.getPixel(0,8)==0 && g.getPixel(1,8)==0xF800 && g.getPixel(2,8)==0x07E0 && g.getPixel(3,8)==0x001F;
+g.drawImage(l2,0,9,{palette:[10,20,30,40], transparent:0});
+var palettedKeyed = g.getPixel(0,9)==0x1234 && g.getPixel(1,9)==20 && g.getPixel(3,9)==40;
+
+// double buffering with a clip rect - only redraw part of the screen
+var back = Graphics.createArrayBuffer(16,16,16);
+back.setColor(0xFFFF);
+back.fillRect(0,0,15,15);
+g.clear();
+g.setClipRect(4,4,7,7);
+g.drawImage(back,0,0);
+var n = 0;
+for (var y=0;y<16;y++) for (var x=0;x<16;x++) if (g.getPixel(x,y)==0xFFFF) n++;
+
+result = copied && keyed && paletted && palettedKeyed && n==16;
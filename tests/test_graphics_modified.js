@@ -0,0 +1,46 @@
+// Graphics.getModified tracks the area drawn to since it was last reset
+
+var g = Graphics.createArrayBuffer(32,16,8);
+result = 1;
+function expectModified(area, reset, what) {
+  var m = g.getModified(reset);
+  if (m!==undefined) m = m.x1+","+m.y1+","+m.x2+","+m.y2;
+  if (m!==area) {
+    console.log("FAIL: after "+what+" modified area was "+m+", should be "+area);
+    result = 0;
+  }
+}
+
+expectModified(undefined, true, "nothing");
+g.setPixel(3,4);
+expectModified("3,4,3,4", false, "setPixel");
+g.fillRect(10,2,12,6);
+expectModified("3,2,12,6", false, "fillRect");
+expectModified("3,2,12,6", true, "getModified(true)");
+expectModified(undefined, false, "reset");
+g.drawLine(-10,15,40,15); // clipped to the screen
+expectModified("0,15,31,15", true, "offscreen drawLine");
+g.setPixel(100,100); // offscreen - nothing modified
+expectModified(undefined, false, "offscreen setPixel");
+g.clear();
+expectModified("0,0,31,15", true, "clear");
+
+// flip() calls the backend's flip with the modified area, then resets it
+var flips = [];
+var c = Graphics.createCallback(16,16,1,{
+  setPixel:function(x,y,col){},
+  fillRect:function(x1,y1,x2,y2,col){},
+  flip:function(x1,y1,x2,y2){ flips.push([x1,y1,x2,y2].join(",")); }
+});
+c.flip(); // nothing modified, so flip isn't called
+c.fillRect(2,3,5,7);
+c.setPixel(9,1);
+c.flip();
+if (flips.join(" ")!="2,1,9,7") {
+  console.log("FAIL: flip was called with "+flips.join(" "));
+  result = 0;
+}
+if (c.getModified()!==undefined) {
+  console.log("FAIL: flip didn't reset the modified area");
+  result = 0;
+}
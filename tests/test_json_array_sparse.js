@@ -0,0 +1,17 @@
+// JSON.stringify of sparse arrays, arrays with non-index keys, and escaping
+
+var a = [];
+a[2] = 1;
+a[5] = "x";
+a.foo = "not an index";
+var b = [];
+for (var i=0;i<100;i++) b.push(i);
+
+var r = [
+  JSON.stringify(a) == '[undefined,undefined,1,undefined,undefined,"x"]',
+  JSON.stringify(b).length == 291,
+  JSON.stringify(["\t\"\\"]) == '["\\t\\"\\\\"]',
+  JSON.stringify({"a\nb":[1.5,{c:[]}]}) == '{"a\\nb":[1.5,{"c":[]}]}',
+];
+result = 1;
+for (var i in r) if (!r[i]) result = 0;
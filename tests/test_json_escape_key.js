@@ -0,0 +1,10 @@
+// Object keys are written with %q - check long keys that need escaping survive a round trip
+
+var key = "a long key with \"quotes\", a \\ backslash,\nnew lines\tand tabs that spans several blocks";
+var o = {};
+o[key] = 1;
+o["x"] = "y";
+var j = JSON.stringify(o);
+var p = JSON.parse(j);
+
+result = j.indexOf("\\\"quotes\\\"")>0 && j.indexOf("\\n")>0 && p[key]==1 && p.x=="y";
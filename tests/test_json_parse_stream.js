@@ -0,0 +1,29 @@
+// JSON.parse without the lexer, and JSON.parser() fed a piece at a time
+
+var obj = {a:[1,2,-3,{b:"a string with \"quotes\" and\nnewlines",c:-12.5e-1}],d:true,e:null,f:[[],{}]};
+var s = JSON.stringify(obj);
+
+var p = JSON.parser();
+var ok = true;
+for (var i=0;i<s.length;i+=3) ok = ok && p.write(s.substr(i,3));
+var streamed = p.end();
+
+var q = JSON.parser();
+var bad = q.write('[1,}');
+
+var r = [
+  JSON.stringify(JSON.parse(s)) == s,
+  ok, JSON.stringify(streamed) == s,
+  p.write("[1,") && p.write("2") && JSON.stringify(p.end("3]")) == "[1,23]",
+  p.end("1.5") == 1.5,
+  !bad, q.end() === undefined,
+  JSON.parse("[1 2]") === undefined,
+  JSON.parse('{"a":1') === undefined,
+  JSON.parse("tru") === undefined,
+  JSON.parse(" -42 ") == -42,
+  JSON.parse("1e3") == 1000,
+  JSON.parse('"\\x41\\u0042"') == "AB",
+  JSON.parse('{"a":{"b":{"c":[1]}}}').a.b.c[0] == 1,
+];
+result = 1;
+for (var i in r) if (!r[i]) result = 0;
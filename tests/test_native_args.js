@@ -0,0 +1,36 @@
+// Native functions with int/float/bool/pin arguments parse them directly
+
+var x = 0.5, two = 2;
+function f() { return 3; }
+
+// bool arguments - true/false literals should act like 1/0
+function fft(inv) {
+  var re = [1,2,3,4], im = [0,0,0,0];
+  if (inv===true) E.FFT(re,im,true);
+  else if (inv===false) E.FFT(re,im,false);
+  else E.FFT(re,im,inv);
+  return re.join(",");
+}
+
+var r = [
+ E.clip(two+f()+4,0,100)==9,
+ E.clip(x*x,0,1)==0.25,
+ E.clip(-2.5,-10,10)==-2.5,
+ isNaN(Math.sqrt()),
+ isNaN(Math.sqrt(-1)),
+ E.clip(f(),0,two)==2,
+ E.clip(5,0,1)==1,
+ E.clip(-5,0,1)==0,
+ E.clip(x,0,1)==0.5,
+ E.clip(2 , 0 , 10)==2,
+ E.clip(0.25,0,1)==0.25,
+ Math.round(2.7)==3,
+ parseInt("12",16)==18,
+ fft(true)==fft(1),
+ fft(false)==fft(0),
+ fft(true)!=fft(false),
+ (function() { var A0 = 5; return E.clip(A0,0,2); })()==2,
+];
+
+result = 1;
+for (var i in r) if (!r[i]) { console.log("Failed "+i); result = 0; }
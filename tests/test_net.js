@@ -0,0 +1,26 @@
+// Raw TCP socket server and client test
+
+var result = 0;
+var net = require("net");
+var big = "";
+for (var i=0;i<200;i++) big += "0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789";
+
+var server = net.createServer(function (socket) {
+  socket.on('data', function(data) {
+    socket.write(data);
+  });
+});
+server.listen(8081);
+
+var received = "";
+var client = net.connect({host: "localhost", port: 8081}, function(socket) {
+  client.on('data', function(data) {
+    received += data;
+    if (received.length == big.length) {
+      result = received==big;
+      client.end();
+      server.close();
+    }
+  });
+  client.write(big);
+});
@@ -0,0 +1,27 @@
+// indexOf, lastIndexOf and split on strings that span many blocks, with matches that straddle blocks
+
+var line = "Header-Name: some value here\r\n";
+var b = "";
+for (var i=0;i<50;i++) b = b + line;
+var body = b + "\r\n" + "payload";
+var longNeedle = "some value here\r\nHeader-Name: some"; // longer than the search window
+
+var parts = body.split("\r\n");
+var r = [
+  body.indexOf("\r\n\r\n") == b.length-2,
+  body.indexOf("payload") == b.length+2,
+  body.indexOf("missing") == -1,
+  body.indexOf("Header", 1) == line.length,
+  body.lastIndexOf("Header") == line.length*49,
+  body.lastIndexOf("Header", line.length*49-1) == line.length*48,
+  body.indexOf(longNeedle) == 13,
+  body.lastIndexOf(longNeedle) == line.length*48+13,
+  body.indexOf(longNeedle+"x") == -1,
+  parts.length == 52, parts[0] == "Header-Name: some value here", parts[50] == "", parts[51] == "payload",
+  "aaa".lastIndexOf("aa") == 1, "aaaa".split("aa").length == 3,
+  "abc".indexOf("c", 3) == -1, "abc".indexOf("", 10) == 3, "abc".lastIndexOf("") == 3,
+  "a,b,".split(",").length == 3, "".split(",").length == 1, "abc".split("").length == 3,
+  "abc".split().length == 1, "a1b1c".split(1).length == 3,
+];
+result = 1;
+for (var i in r) if (!r[i]) result = 0;
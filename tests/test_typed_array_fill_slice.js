@@ -0,0 +1,27 @@
+// TypedArray set (between types, and overlapping), fill, subarray and slice
+
+var u8 = new Uint8Array(8);
+u8.fill(300); // 300&255
+var allFilled = true;
+for (var i=0;i<8;i++) if (u8[i]!=44) allFilled = false;
+u8.fill(1, 2, -2);
+
+var f = new Float32Array([1.5, -2.5, 300.75]);
+var i16 = new Int16Array(4);
+i16.set(f, 1);
+
+var b = new Uint16Array([1,2,3,4,5,6,7,8,0,0]);
+b.set(b.subarray(0,8), 2); // overlapping copy
+
+var s = new Uint8Array([10,20,30,40,50]);
+var sub = s.subarray(1,-1);
+sub[0] = 99; // shares data with s
+var sl = s.slice(-2);
+sl[0] = 1; // a copy
+var empty = s.slice(3,1);
+
+result = allFilled && u8[1]==44 && u8[2]==1 && u8[5]==1 && u8[6]==44 &&
+         i16[0]==0 && i16[1]==1 && i16[2]==-2 && i16[3]==300 &&
+         b[2]==1 && b[9]==8 && b[0]==1 &&
+         sub.length==3 && s[1]==99 && sub[2]==40 &&
+         sl.length==2 && sl[1]==50 && s[3]==40 && empty.length==0;
@@ -0,0 +1,27 @@
+// Typed arrays bigger than 64K, and views that read and write the same data
+
+var a = new Uint8Array(100000);
+a[0] = 1;
+a[70000] = 77;
+a[99999] = 200;
+a[100000] = 5; // past the end - ignored
+
+var f = new Float64Array(70000);
+f[3] = -2.25;
+f[69999] = 1.5;
+
+var buf = new ArrayBuffer(16);
+var b = new Uint8Array(buf, 4, 4);
+b[0] = 255;
+b[3] = 9;
+var w = new Uint32Array(buf);
+// runs past the end of buf - shouldn't read or write anything there
+var o = new Uint16Array(buf, 4, 8);
+o[7] = 1234;
+
+var sum = 0;
+for (var i=0;i<a.length;i+=1000) sum += a[i];
+
+result = a.length==100000 && a[70000]==77 && a[99999]==200 && a[100000]===undefined &&
+         sum==78 && f.length==70000 && f[3]==-2.25 && f[69999]==1.5 &&
+         w[1]==150995199 && o[7]===undefined;